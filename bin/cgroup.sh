@@ -13,6 +13,20 @@ then
     exit 0
 fi
 
+if [ "$CGROUP_MODE" == "v2" ];
+then
+    # With cgroup v2 Faasm moves itself into this group and creates the
+    # per-function sub-groups, we just need to create it with the controllers
+    # enabled
+    CGROUP_ROOT=/sys/fs/cgroup
+    echo "Setting up cgroup v2 ${CGROUP_ROOT}/faasm for ${CGROUP_USER}"
+
+    echo "+cpu +memory" > ${CGROUP_ROOT}/cgroup.subtree_control
+    mkdir -p ${CGROUP_ROOT}/faasm
+    chown -R ${CGROUP_USER}:${CGROUP_USER} ${CGROUP_ROOT}/faasm
+    exit 0
+fi
+
 echo "Setting up cgroup ${CGROUP} for ${CGROUP_USER}"
 
-cgcreate -t ${CGROUP_USER}:${CGROUP_USER} -a ${CGROUP_USER}:${CGROUP_USER} -g ${CGROUP}
\ No newline at end of file
+cgcreate -t ${CGROUP_USER}:${CGROUP_USER} -a ${CGROUP_USER}:${CGROUP_USER} -g ${CGROUP}
@@ -9,8 +9,29 @@ class FaasmConfig
     std::string hostType;
 
     std::string cgroupMode;
+    std::string cgroupGranularity;
+    std::string cgroupCpuWeight;
+    std::string cgroupCpuMax;
+    std::string cgroupMemoryMax;
     std::string netNsMode;
     int maxNetNs;
+    std::string netNsPrejoin;
+
+    std::string connPoolMode;
+    std::string connPoolPorts;
+    int connPoolMaxPerDest;
+    int connPoolIdleTimeoutMs;
+    std::string dnsCacheMode;
+    std::string dnsHostsFile;
+    int dnsCacheMaxTtlSeconds;
+    int dnsCacheNegativeTtlSeconds;
+
+    int guestNiceMin;
+    int guestNiceMax;
+
+    std::string pthreadDispatchMode;
+    int pthreadBatchWindowUs;
+    std::string guestMutexMode;
 
     std::string pythonPreload;
     std::string captureStdout;
@@ -23,6 +44,16 @@ class FaasmConfig
     std::string objectFileDir;
     std::string runtimeFilesDir;
     std::string sharedFilesDir;
+    int sharedFilesNegativeTtlMs;
+    std::string sharedFilesPrefetch;
+
+    std::string storageBackend;
+    std::string localStorageDir;
+    std::string fileIoBackend;
+
+    std::string fsOverlayPaths;
+    std::string fsOverlayDir;
+    int fsOverlayMaxMb;
 
     std::string s3Bucket;
     std::string s3Host;
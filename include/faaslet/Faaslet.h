@@ -7,6 +7,7 @@
 #include <system/NetworkNamespace.h>
 #include <wasm/WasmModule.h>
 
+#include <mutex>
 #include <string>
 
 namespace faaslet {
@@ -39,7 +40,12 @@ class Faaslet final : public faabric::scheduler::Executor
   private:
     std::string localResetSnapshotKey;
 
+    std::string cgroupName;
+
     std::shared_ptr<isolation::NetworkNamespace> ns;
+    std::once_flag nsFlag;
+
+    void claimFaasletNamespace();
 };
 
 class FaasletFactory final : public faabric::scheduler::ExecutorFactory
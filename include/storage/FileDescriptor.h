@@ -1,5 +1,8 @@
 #pragma once
 
+#include <storage/MemoryOverlay.h>
+#include <storage/PathCache.h>
+
 #include <dirent.h>
 #include <fcntl.h>
 #include <string>
@@ -96,6 +99,10 @@ class FileDescriptor
 
     void iterReset();
 
+    void iterSeek(uint64_t cookie);
+
+    uint64_t iterCookie() const;
+
     size_t copyDirentsToWasiBuffer(uint8_t* buffer, size_t bufferLen);
 
     Stat stat(const std::string& relativePath = "");
@@ -115,8 +122,35 @@ class FileDescriptor
 
     bool updateFlags(int32_t fdFlags);
 
+    ssize_t read(std::vector<::iovec>& nativeIovecs, int iovecCount);
+
     ssize_t write(std::vector<::iovec>& nativeIovecs, int iovecCount);
 
+    ssize_t pread(std::vector<::iovec>& nativeIovecs,
+                  int iovecCount,
+                  uint64_t offset);
+
+    ssize_t pwrite(std::vector<::iovec>& nativeIovecs,
+                   int iovecCount,
+                   uint64_t offset);
+
+    bool sync(bool dataOnly);
+
+    bool allocate(uint64_t offset, uint64_t len);
+
+    bool truncate(uint64_t size);
+
+    bool setTimes(const std::string& relativePath,
+                  uint64_t accessTime,
+                  uint64_t modTime,
+                  uint16_t fstFlags,
+                  bool followSymlinks = true);
+
+    bool link(const std::string& newPath,
+              const std::string& relativePath = "");
+
+    bool symlink(const std::string& target, const std::string& relativePath);
+
     void close() const;
 
     bool mkdir(const std::string& dirPath);
@@ -149,10 +183,28 @@ class FileDescriptor
 
     int duplicate(const FileDescriptor& other);
 
+    void setPathCache(PathCache* pathCacheIn);
+
+    void setOverlay(MemoryOverlay* overlayIn);
+
   private:
     static FileDescriptor stdFdFactory(int stdFd, const std::string& devPath);
 
-    void loadDirContents();
+    void invalidateCachedPath(const std::string& relativePath = "");
+
+    void invalidateCachedContents();
+
+    std::string realPathFor(const std::string& guestPath) const;
+
+    bool isInOverlay(const std::string& guestPath) const;
+
+    int64_t reserveOverlayGrowth(int64_t offset, uint64_t len);
+
+    void releaseOverlayGrowth(int64_t reserved, uint64_t len, ssize_t done);
+
+    void openDirStream();
+
+    bool readDirStream();
 
     std::string path;
 
@@ -167,8 +219,18 @@ class FileDescriptor
 
     uint16_t wasiErrno = 0;
 
-    bool dirContentsLoaded = false;
-    std::vector<DirEnt> dirContents;
-    int dirContentsIdx = 0;
+    // Owned by the FileSystem this descriptor belongs to, may be null
+    PathCache* pathCache = nullptr;
+    MemoryOverlay* overlay = nullptr;
+
+    // Directory entries are streamed in batches from getdents64, and the
+    // cookies are the kernel's own directory offsets so they can be seeked to
+    int dirStreamFd = -1;
+    bool dirStreamFinished = false;
+    std::vector<DirEnt> dirBatch;
+    size_t dirBatchIdx = 0;
+    uint64_t dirCookie = 0;
+    uint64_t dirPrevCookie = 0;
+    bool dirCanGoBack = false;
 };
 }
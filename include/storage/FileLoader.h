@@ -1,12 +1,15 @@
 #pragma once
 
 #include <conf/FaasmConfig.h>
-#include <storage/S3Wrapper.h>
+#include <storage/MappedFile.h>
+#include <storage/StorageBackend.h>
 
 #include <faabric/util/config.h>
 #include <faabric/util/exception.h>
 #include <faabric/util/func.h>
 
+#include <memory>
+
 #define EMPTY_FILE_RESPONSE "Empty response"
 #define IS_DIR_RESPONSE "IS_DIR"
 #define FILE_PATH_HEADER "FilePath"
@@ -41,6 +44,11 @@ class FileLoader
 
     void uploadFunction(faabric::Message& msg);
 
+    // ----- Function limits -----
+    std::string getFunctionLimitsFile(const faabric::Message& msg);
+
+    std::string loadFunctionLimits(const faabric::Message& msg);
+
     // ----- Function object files -----
     std::string getFunctionObjectFile(const faabric::Message& msg);
 
@@ -59,6 +67,8 @@ class FileLoader
 
     std::vector<uint8_t> loadFunctionWamrAotFile(const faabric::Message& msg);
 
+    MappedFile mapFunctionWamrAotFile(const faabric::Message& msg);
+
     std::vector<uint8_t> loadFunctionWamrAotHash(const faabric::Message& msg);
 
     void uploadFunctionWamrAotFile(const faabric::Message& msg,
@@ -94,6 +104,8 @@ class FileLoader
 
     std::vector<uint8_t> loadSharedFile(const std::string& path);
 
+    std::vector<std::string> listSharedFiles(const std::string& dirPath);
+
     void deleteSharedFile(const std::string& path);
 
     void uploadSharedFile(const std::string& path,
@@ -106,11 +118,19 @@ class FileLoader
 
     std::string getPythonFunctionFile(const faabric::Message& msg);
 
+    std::string getPythonFunctionPrefetchRelativePath(
+      const faabric::Message& msg);
+
+    std::string getPythonFunctionVersionRelativePath(
+      const faabric::Message& msg);
+
+    std::string loadPythonFunctionVersion(const faabric::Message& msg);
+
     void uploadPythonFunction(faabric::Message& msg);
 
   private:
     conf::FaasmConfig& conf;
-    storage::S3Wrapper s3;
+    std::unique_ptr<StorageBackend> storageBackend;
 
     bool useLocalFsCache = true;
 
@@ -122,6 +142,9 @@ class FileLoader
                                        const std::string& localCachePath,
                                        bool tolerateMissing = false);
 
+    MappedFile mapFileBytes(const std::string& path,
+                            const std::string& localCachePath);
+
     std::vector<uint8_t> loadHashFileBytes(const std::string& path,
                                            const std::string& localCachePath);
 
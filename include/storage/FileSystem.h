@@ -1,15 +1,29 @@
 #pragma once
 
 #include "FileDescriptor.h"
+#include "MemoryOverlay.h"
+#include "PathCache.h"
 
 #include <faabric/proto/faabric.pb.h>
 
-#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <vector>
 
 namespace storage {
 class FileSystem
 {
   public:
+    FileSystem();
+
+    // Copies get their own path cache, overlay and host fds, as they may
+    // diverge from the original
+    FileSystem(const FileSystem& other);
+
+    FileSystem& operator=(const FileSystem& other);
+
+    ~FileSystem();
+
     void prepareFilesystem();
 
     bool fileDescriptorExists(int fd);
@@ -28,17 +42,49 @@ class FileSystem
 
     int dup(int fd);
 
+    // Closes the fd and frees its slot for reuse. Standard streams and
+    // preopened directories are left open, as guests' libcs may close them
+    bool closeFileDescriptor(int fd);
+
+    // Closes all the host fds owned by this filesystem. Copies own
+    // duplicates of the original's fds, so only their own are closed
     void tearDown();
 
     std::string getPathForFd(int fd);
 
     void printDebugInfo();
 
+    void clearPathCache();
+
+    // Host path for a guest path, taking the overlay into account
+    std::string realPathFor(const std::string& guestPath);
+
+    MemoryOverlay* getOverlay();
+
   private:
-    int nextFd;
+    struct FdSlot
+    {
+        bool inUse = false;
+        bool preopened = false;
+        storage::FileDescriptor fileDesc;
+    };
+
+    // Guests look up fds on every I/O call, so they index straight into the
+    // table. A deque rather than a vector keeps references to descriptors
+    // valid while new fds are added. Freed fds are kept in a min-heap so that,
+    // as with POSIX, the lowest one is reused first
+    std::deque<FdSlot> fdTable;
+
+    std::vector<int> freeFds;
 
-    std::unordered_map<int, storage::FileDescriptor> fileDescriptors;
+    std::unique_ptr<PathCache> pathCache;
+
+    std::unique_ptr<MemoryOverlay> overlay;
 
     int getNewFd();
+
+    FileDescriptor& claimFd(int fd);
+
+    void releaseFd(int fd);
 };
 }
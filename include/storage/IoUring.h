@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Each ring only ever has a single request in flight at once
+#define IO_URING_ENTRIES 8
+
+// Offset that tells io_uring to use (and update) the file position
+#define IO_URING_CURRENT_POS ((uint64_t)-1)
+
+namespace storage {
+
+/**
+ * Minimal io_uring ring, driven through the raw syscalls so we don't need
+ * liburing. Methods mirror their blocking syscall counterparts, i.e. they
+ * return -1 and set errno on failure.
+ *
+ * Rings are not thread-safe, so each executor thread gets its own through
+ * getThreadIoUring. This returns null if io_uring is unavailable (e.g. old
+ * kernels or seccomp profiles that block it), in which case callers should
+ * fall back to plain syscalls.
+ */
+class IoUring
+{
+  public:
+    IoUring();
+
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool isReady() const { return ringFd >= 0; }
+
+    ssize_t readv(int fd,
+                  const ::iovec* iovecs,
+                  int iovecCount,
+                  uint64_t offset);
+
+    ssize_t writev(int fd,
+                   const ::iovec* iovecs,
+                   int iovecCount,
+                   uint64_t offset);
+
+    int fsync(int fd, bool dataOnly);
+
+  private:
+    int ringFd = -1;
+
+    void* sqRingPtr = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRingPtr = nullptr;
+    size_t cqRingSize = 0;
+    ::io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    ::io_uring_cqe* cqes = nullptr;
+
+    ::io_uring_sqe* getSqe();
+
+    long submitAndWait();
+
+    void release();
+};
+
+IoUring* getThreadIoUring();
+}
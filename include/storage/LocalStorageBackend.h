@@ -0,0 +1,61 @@
+#pragma once
+
+#include <storage/StorageBackend.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace storage {
+
+/**
+ * Storage backend that keeps objects as plain files under a root directory,
+ * with one subdirectory per bucket. The root can be a local disk for
+ * single-host deployments, or a shared mount (e.g. NFS) across hosts.
+ */
+class LocalStorageBackend final : public StorageBackend
+{
+  public:
+    LocalStorageBackend();
+
+    explicit LocalStorageBackend(const std::string& rootDirIn);
+
+    void createBucket(const std::string& bucketName) override;
+
+    void deleteBucket(const std::string& bucketName) override;
+
+    std::vector<std::string> listBuckets() override;
+
+    std::vector<std::string> listKeys(const std::string& bucketName,
+                                      const std::string& prefix = "") override;
+
+    void deleteKey(const std::string& bucketName,
+                   const std::string& keyName) override;
+
+    void addKeyBytes(const std::string& bucketName,
+                     const std::string& keyName,
+                     const std::vector<uint8_t>& data) override;
+
+    void addKeyStr(const std::string& bucketName,
+                   const std::string& keyName,
+                   const std::string& data) override;
+
+    std::vector<uint8_t> getKeyBytes(const std::string& bucketName,
+                                     const std::string& keyName,
+                                     bool tolerateMissing = false) override;
+
+    std::string getKeyStr(const std::string& bucketName,
+                          const std::string& keyName) override;
+
+    std::string getKeyPath(const std::string& bucketName,
+                           const std::string& keyName);
+
+  private:
+    std::filesystem::path rootDir;
+
+    void writeKey(const std::string& bucketName,
+                  const std::string& keyName,
+                  const uint8_t* data,
+                  size_t dataLen);
+};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace storage {
+
+/**
+ * Read-only view of a file's contents backed by a private memory mapping.
+ *
+ * Pages come straight from the page cache, so several processes mapping the
+ * same artifact share its physical memory. The mapping is private, so a
+ * consumer that writes to the buffer gets its own copy of the touched pages
+ * and never modifies the file. A view can also wrap an in-memory buffer when
+ * there is no file to map (e.g. when the local cache is disabled).
+ */
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& filePath);
+
+    explicit MappedFile(std::vector<uint8_t>&& bytesIn);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    uint8_t* data() const { return ptr; }
+
+    size_t size() const { return len; }
+
+    bool empty() const { return len == 0; }
+
+    bool isMapped() const { return mapped; }
+
+    std::vector<uint8_t> toVector() const;
+
+  private:
+    uint8_t* ptr = nullptr;
+    size_t len = 0;
+    bool mapped = false;
+
+    std::vector<uint8_t> bytes;
+
+    void release();
+};
+}
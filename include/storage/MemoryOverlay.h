@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace storage {
+
+/**
+ * Scratch space for guest paths (e.g. /tmp) that shouldn't outlive a single
+ * invocation.
+ *
+ * Overlaid paths are redirected to a private directory on a memory-backed
+ * filesystem (/dev/shm by default), so guests never touch the disk for their
+ * temporary files. Each FileSystem gets its own directory, which is emptied
+ * whenever the filesystem is prepared (i.e. on bind and reset), and removed
+ * when the FileSystem goes away.
+ *
+ * Writes through the FileSystem are counted against a per-invocation size
+ * cap, and guests get ENOSPC once they reach it.
+ */
+class MemoryOverlay
+{
+  public:
+    MemoryOverlay(const std::string& rootDirIn,
+                  const std::vector<std::string>& mountPathsIn,
+                  size_t maxBytesIn);
+
+    ~MemoryOverlay();
+
+    MemoryOverlay(const MemoryOverlay&) = delete;
+
+    MemoryOverlay& operator=(const MemoryOverlay&) = delete;
+
+    // Whether the given guest path lives in the overlay
+    bool covers(const std::string& guestPath) const;
+
+    // Host path backing a guest path the overlay covers
+    std::string realPath(const std::string& guestPath) const;
+
+    // Claim space ahead of growing a file, returns false if over the cap
+    bool reserve(size_t bytes);
+
+    void release(size_t bytes);
+
+    // Drop all contents and recreate the empty mount points
+    void clear();
+
+    size_t getUsedBytes() const;
+
+    size_t getMaxBytes() const;
+
+    const std::string& getRootDir() const;
+
+  private:
+    std::string rootDir;
+
+    std::vector<std::string> mountPaths;
+
+    size_t maxBytes = 0;
+
+    std::atomic<size_t> usedBytes = 0;
+};
+
+// Builds an overlay from the config, or returns null if none is configured
+std::unique_ptr<MemoryOverlay> createMemoryOverlay();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <faabric/util/locks.h>
+
+#include <shared_mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+// Above this many entries the cache is dropped rather than grown further
+#define PATH_CACHE_MAX_ENTRIES 16384
+
+namespace storage {
+
+/**
+ * Per-module cache of host stat results, keyed on the resolved host path.
+ *
+ * Guests like CPython probe the same paths over and over at startup, mostly
+ * for files that don't exist. Failed lookups are cached as well as successful
+ * ones, so repeat probes don't hit the host at all.
+ *
+ * Entries are only invalidated by changes made through the owning
+ * FileSystem, so the cache is cleared at the start of every invocation, and
+ * on reset. Shared files are never cached, as they can change on other hosts.
+ *
+ * Resolving guest paths to host paths is only string manipulation, so it
+ * isn't cached, only the syscalls made on the result are.
+ */
+class PathCache
+{
+  public:
+    bool getStat(const std::string& realPath,
+                 struct ::stat& statOut,
+                 int& errnoOut);
+
+    void putStat(const std::string& realPath,
+                 const struct ::stat& nativeStat,
+                 int statErrno);
+
+    // Invalidate a path and its parent directory, whose timestamps and link
+    // count change when entries are added or removed
+    void invalidate(const std::string& realPath);
+
+    // As above, but also invalidates everything under the path (e.g. when a
+    // directory is renamed or removed)
+    void invalidateTree(const std::string& realPath);
+
+    // Invalidates only the path itself, for changes to a file's contents that
+    // leave its directory alone. This is called on every write, so only takes
+    // the write lock if the path is actually cached
+    void invalidateContents(const std::string& realPath);
+
+    void clear();
+
+    size_t size();
+
+  private:
+    struct PathCacheEntry
+    {
+        int statErrno = 0;
+        struct ::stat nativeStat
+        {};
+    };
+
+    std::shared_mutex mx;
+    std::unordered_map<std::string, PathCacheEntry> entries;
+
+    void doInvalidate(const std::string& realPath);
+};
+}
@@ -9,6 +9,7 @@
 #include <aws/s3/S3Client.h>
 
 #include <conf/FaasmConfig.h>
+#include <storage/StorageBackend.h>
 
 #include <faabric/util/logging.h>
 
@@ -21,35 +22,37 @@ void initFaasmS3();
 
 void shutdownFaasmS3();
 
-class S3Wrapper
+class S3Wrapper final : public StorageBackend
 {
   public:
     S3Wrapper();
 
-    void createBucket(const std::string& bucketName);
+    void createBucket(const std::string& bucketName) override;
 
-    void deleteBucket(const std::string& bucketName);
+    void deleteBucket(const std::string& bucketName) override;
 
-    std::vector<std::string> listBuckets();
+    std::vector<std::string> listBuckets() override;
 
-    std::vector<std::string> listKeys(const std::string& bucketName);
+    std::vector<std::string> listKeys(const std::string& bucketName,
+                                      const std::string& prefix = "") override;
 
-    void deleteKey(const std::string& bucketName, const std::string& keyName);
+    void deleteKey(const std::string& bucketName,
+                   const std::string& keyName) override;
 
     void addKeyBytes(const std::string& bucketName,
                      const std::string& keyName,
-                     const std::vector<uint8_t>& data);
+                     const std::vector<uint8_t>& data) override;
 
     void addKeyStr(const std::string& bucketName,
                    const std::string& keyName,
-                   const std::string& data);
+                   const std::string& data) override;
 
     std::vector<uint8_t> getKeyBytes(const std::string& bucketName,
                                      const std::string& keyName,
-                                     bool tolerateMissing = false);
+                                     bool tolerateMissing = false) override;
 
     std::string getKeyStr(const std::string& bucketName,
-                          const std::string& keyName);
+                          const std::string& keyName) override;
 
   private:
     const conf::FaasmConfig& faasmConf;
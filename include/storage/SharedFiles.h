@@ -3,6 +3,8 @@
 #include <faabric/proto/faabric.pb.h>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace storage {
 class SharedFiles
@@ -25,9 +27,23 @@ class SharedFiles
 
     static void syncPythonFunctionFile(const faabric::Message& msg);
 
+    static void invalidatePythonFunctionFile(const faabric::Message& msg);
+
+    static std::string checkPythonFunctionVersion(const faabric::Message& msg);
+
+    static int prefetchSharedDirectory(const std::string& sharedDir);
+
+    static int prefetchSharedDirectories(
+      const std::vector<std::string>& sharedDirs);
+
+    static int prefetchForPythonFunction(const faabric::Message& msg);
+
     static void clear();
 
   private:
     static std::string prependSharedRoot(const std::string& originalPath);
+
+    static std::pair<std::string, std::string> getPythonFunctionPaths(
+      const faabric::Message& msg);
 };
 }
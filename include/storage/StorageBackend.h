@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace storage {
+
+/**
+ * Interface to the object store holding function artifacts and shared files.
+ * Objects are addressed by bucket and key, as in S3.
+ */
+class StorageBackend
+{
+  public:
+    virtual ~StorageBackend() = default;
+
+    virtual void createBucket(const std::string& bucketName) = 0;
+
+    virtual void deleteBucket(const std::string& bucketName) = 0;
+
+    virtual std::vector<std::string> listBuckets() = 0;
+
+    virtual std::vector<std::string> listKeys(
+      const std::string& bucketName,
+      const std::string& prefix = "") = 0;
+
+    virtual void deleteKey(const std::string& bucketName,
+                           const std::string& keyName) = 0;
+
+    virtual void addKeyBytes(const std::string& bucketName,
+                             const std::string& keyName,
+                             const std::vector<uint8_t>& data) = 0;
+
+    virtual void addKeyStr(const std::string& bucketName,
+                           const std::string& keyName,
+                           const std::string& data) = 0;
+
+    virtual std::vector<uint8_t> getKeyBytes(const std::string& bucketName,
+                                             const std::string& keyName,
+                                             bool tolerateMissing = false) = 0;
+
+    virtual std::string getKeyStr(const std::string& bucketName,
+                                  const std::string& keyName) = 0;
+};
+
+/**
+ * Creates the backend selected by the STORAGE_BACKEND config
+ */
+std::unique_ptr<StorageBackend> createStorageBackend();
+}
@@ -1,13 +1,31 @@
 #pragma once
 
+#include <faabric/proto/faabric.pb.h>
+
 #include <string>
 #define BASE_CGROUP_NAME "faasm"
 
+// Threaded child of the base cgroup (with cgroup v2) that makes the base a
+// threaded domain
+#define BASE_CGROUP_MAIN_NAME "main"
+
 namespace isolation {
 enum CgroupMode
 {
     cg_off,
-    cg_on
+    cg_on,
+    cg_v2
+};
+
+/**
+ * Limits for a cgroup v2 sub-group, written verbatim to the cgroup interface
+ * file of the same name (e.g. "50000 100000" for cpu.max). Empty values are
+ * left as they are.
+ */
+struct CgroupLimits
+{
+    std::string cpuWeight;
+    std::string cpuMax;
 };
 
 class CGroup
@@ -15,6 +33,13 @@ class CGroup
   public:
     explicit CGroup(const std::string& name);
 
+    /**
+     * With cgroup v2, creates this group as a threaded sub-group of the base
+     * Faasm cgroup (if it doesn't exist already) and applies the given
+     * limits. Does nothing with cgroup v1 or cgroups turned off.
+     */
+    void create(const CgroupLimits& limits);
+
     void addCurrentThread();
 
     const std::string getName();
@@ -25,4 +50,25 @@ class CGroup
     std::string name;
     CgroupMode mode;
 };
+
+/**
+ * Sets up the cgroup v2 group at the given path as the threaded domain for
+ * function sub-groups, enabling the cpu controller, and moves this process
+ * into it. The group must already exist.
+ */
+void setUpBaseCgroup(const std::string& basePath);
+
+/**
+ * Name of the cgroup for the given function. With cgroup v2 this is a
+ * sub-group of the base Faasm cgroup, one per function or one per user
+ * depending on CGROUP_GRANULARITY. Otherwise it's the base Faasm cgroup.
+ */
+std::string getFunctionCgroupName(const faabric::Message& msg);
+
+/**
+ * Parses a function's limits metadata, made up of "key=value" lines with the
+ * cgroup interface file as the key (cpu.weight or cpu.max). Anything not set
+ * falls back to the defaults in the FaasmConfig.
+ */
+CgroupLimits parseCgroupLimits(const std::string& metadata);
 }
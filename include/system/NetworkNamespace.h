@@ -1,7 +1,7 @@
 #pragma once
 
 #include <memory>
-#include <shared_mutex>
+#include <mutex>
 #include <string>
 
 #define BASE_NETNS_NAME "faasmns"
@@ -12,6 +12,18 @@ class NetworkNamespace
   public:
     explicit NetworkNamespace(const std::string& name);
 
+    ~NetworkNamespace();
+
+    NetworkNamespace(const NetworkNamespace&) = delete;
+
+    NetworkNamespace& operator=(const NetworkNamespace&) = delete;
+
+    /**
+     * Opens the namespace's fd if it isn't already open. Joining does this
+     * lazily, but calling it up front keeps it off the request path.
+     */
+    void prepare();
+
     void addCurrentThread();
 
     void removeCurrentThread();
@@ -19,9 +31,12 @@ class NetworkNamespace
     const std::string getName();
 
   private:
-    std::string name;
+    const std::string name;
 
-    std::shared_mutex mx;
+    // Opened once and kept for the namespace's lifetime, so joining is a
+    // single setns with no locking
+    int nsFd = -1;
+    std::once_flag nsFdFlag;
 };
 
 std::shared_ptr<NetworkNamespace> claimNetworkNamespace();
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <bitset>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -8,6 +10,10 @@
 #include <faabric/util/environment.h>
 #include <faabric/util/locks.h>
 
+// Limits on pthread keys, as in musl
+#define PTHREAD_KEYS_MAX 128
+#define PTHREAD_DESTRUCTOR_ITERATIONS 4
+
 namespace threads {
 
 // A Level is a layer of threads in an OpenMP application.
@@ -74,6 +80,58 @@ class PthreadCall
     int32_t argsPtr;
 };
 
+/**
+ * The pthread keys created by a module, along with their destructors (function
+ * table indices, zero if none). Values set for each key are held per thread.
+ *
+ * Keys are shipped to threads in their batch request, so that threads running
+ * on another host from a snapshot can use the keys created by the main thread.
+ */
+class PthreadKeys
+{
+  public:
+    // Returns the new key, or -1 if all keys are in use
+    int createKey(uint32_t destructor);
+
+    bool deleteKey(uint32_t key);
+
+    bool isKeyInUse(uint32_t key);
+
+    uint32_t getDestructor(uint32_t key);
+
+    void clear();
+
+    // Serialises the keys, tagged with the app they belong to
+    std::vector<uint8_t> serialise(int appId);
+
+    // Loads keys serialised by the main thread, unless they're from the same
+    // app and no newer than the keys already here
+    void deserialise(const std::vector<uint8_t>& bytes);
+
+  private:
+    std::mutex mx;
+
+    struct KeyTable
+    {
+        int appId = 0;
+        uint32_t version = 0;
+        std::bitset<PTHREAD_KEYS_MAX> inUse;
+        std::array<uint32_t, PTHREAD_KEYS_MAX> destructors{};
+    };
+
+    KeyTable table;
+};
+
+// Values of pthread keys for the guest thread on this host thread
+uint32_t getPthreadKeyValue(uint32_t key);
+
+void setPthreadKeyValue(uint32_t key, uint32_t value);
+
+// Returns the non-null values as (key, value) pairs, and nulls them
+std::vector<std::pair<uint32_t, uint32_t>> takePthreadKeyValues();
+
+void clearPthreadKeyValues();
+
 std::shared_ptr<Level> levelFromBatchRequest(
   const std::shared_ptr<faabric::BatchExecuteRequest>& req);
 
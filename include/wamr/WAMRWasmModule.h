@@ -1,11 +1,10 @@
 #pragma once
 
+#include <storage/MappedFile.h>
 #include <wamr/WAMRModuleMixin.h>
 #include <wasm/WasmModule.h>
 #include <wasm_runtime_common.h>
 
-#include <setjmp.h>
-
 #define ERROR_BUFFER_SIZE 256
 #define STACK_SIZE_KB 8192
 #define HEAP_SIZE_KB 8192
@@ -45,6 +44,10 @@ class WAMRWasmModule final
 
     int32_t executeFunction(faabric::Message& msg) override;
 
+    int32_t executePthread(int threadPoolIdx,
+                           uint32_t stackTop,
+                           faabric::Message& msg) override;
+
     // ----- Exception handling -----
     void doThrowException(std::exception& e) override;
 
@@ -53,6 +56,20 @@ class WAMRWasmModule final
 
     void writeWasmEnvToWamrMemory(uint32_t* envOffsetsWasm, char* envBuffWasm);
 
+    // Sets errno in the guest's libc, if it exports __errno_location
+    void setGuestErrno(WASMExecEnv* execEnv, int err);
+
+    // ----- Threading -----
+
+    // Threads can only share linear memory if the module declares its memory
+    // as shared, i.e. if it was built with shared memory
+    bool isMemoryShared();
+
+    // Returns the exec env for the given executor thread, spawning it if need
+    // be, with its stack pointer at the given stack top. Exec envs are kept
+    // until the module is reset
+    WASMExecEnv* getPthreadExecEnv(int threadPoolIdx, uint32_t stackTop);
+
     // ----- Address translation and validation -----
 
     // Check if WASM offset belongs to WASM memory
@@ -77,11 +94,15 @@ class WAMRWasmModule final
   private:
     char errorBuffer[ERROR_BUFFER_SIZE];
 
-    std::vector<uint8_t> wasmBytes;
+    // Mapped AoT file, must outlive the loaded module as WAMR refers to it
+    storage::MappedFile wasmBytes;
     WASMModuleCommon* wasmModule;
     WASMModuleInstanceCommon* moduleInstance;
 
-    jmp_buf wamrExceptionJmpBuf;
+    // Pthreads run in exec envs spawned from this one, which is never used to
+    // execute code itself. Each executor thread keeps its own spawned exec env
+    WASMExecEnv* threadsParentExecEnv = nullptr;
+    std::vector<WASMExecEnv*> pthreadExecEnvs;
 
     int executeWasmFunction(const std::string& funcName);
 
@@ -92,8 +113,18 @@ class WAMRWasmModule final
                                int argc,
                                std::vector<uint32_t>& argv);
 
+    bool executeCatchException(WASMExecEnv* execEnv,
+                               WASMFunctionInstanceCommon* func,
+                               int wasmFuncPtr,
+                               int argc,
+                               std::vector<uint32_t>& argv);
+
     void bindInternal(faabric::Message& msg);
 
+    WASMExecEnv* createExecEnv();
+
+    void destroyThreadExecEnvs();
+
     bool doGrowMemory(uint32_t pageChange) override;
 };
 
@@ -14,3 +14,14 @@ struct wasi_prestat_app_t
     __wasi_preopentype_t pr_type;
     uint32_t pr_name_len;
 };
+
+struct wasm_pthread_app_t
+{
+    int32_t selfPtr;
+};
+
+struct wasm_timespec_app_t
+{
+    int64_t tv_sec;
+    int32_t tv_nsec;
+};
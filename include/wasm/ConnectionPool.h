@@ -0,0 +1,99 @@
+#pragma once
+
+#include <faabric/util/timing.h>
+
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace wasm {
+
+/**
+ * Keeps guests' outbound TCP connections open between invocations, so that
+ * calls to the same backend don't pay for a new handshake every time.
+ *
+ * Guest sockets are host fds. When the guest connects, a healthy idle
+ * connection to the same destination is swapped in under its fd if there is
+ * one. When it closes the socket, or the invocation ends with the socket
+ * still open, the connection goes back to the pool if it's still healthy.
+ *
+ * Pools belong to a single module, so connections are never shared between
+ * functions or network namespaces. Pooling is off unless CONN_POOL_MODE=on,
+ * in which case the guest sockets are only tracked so that they're closed at
+ * the end of the invocation.
+ */
+class ConnectionPool
+{
+  public:
+    ConnectionPool() = default;
+
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    void addGuestSocket(int fd);
+
+    /**
+     * Connects the guest's socket, reusing a pooled connection if possible.
+     * Returns zero on success, or -errno.
+     */
+    int connect(int fd, const ::sockaddr* addr, socklen_t addrLen);
+
+    /**
+     * Sets an option on one of the guest's sockets. Pooled connections can't
+     * be reset to their defaults, so sockets the guest has set options on are
+     * neither swapped for pooled connections nor returned to the pool.
+     * Returns zero on success, or -errno.
+     */
+    int setSockOpt(int fd,
+                   int level,
+                   int optName,
+                   const void* optVal,
+                   socklen_t optLen);
+
+    /**
+     * Closes one of the guest's sockets, or returns it to the pool. Returns
+     * false if the fd isn't a guest socket.
+     */
+    bool closeGuestSocket(int fd);
+
+    /**
+     * Called at the end of an invocation to close or return any sockets the
+     * guest left open.
+     */
+    void releaseGuestSockets();
+
+    /**
+     * Closes all idle connections
+     */
+    void clear();
+
+    int getIdleCount();
+
+  private:
+    struct IdleConnection
+    {
+        int fd;
+        faabric::util::TimePoint idleSince;
+    };
+
+    std::mutex mx;
+
+    // Guest socket fd to its destination key, empty if it's not poolable
+    std::unordered_map<int, std::string> guestSockets;
+
+    // Guest sockets with options set, which mustn't be pooled
+    std::unordered_set<int> customisedSockets;
+
+    std::unordered_map<std::string, std::vector<IdleConnection>> idle;
+
+    int claimIdleConnection(const std::string& destKey);
+
+    void returnOrClose(int fd, const std::string& destKey);
+};
+}
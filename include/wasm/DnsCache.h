@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <netinet/in.h>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wasm {
+
+/**
+ * Process-wide cache of hostname lookups made by guests, shared by all
+ * Faaslets on the host.
+ *
+ * Names are looked up in the hosts file first, then in DNS, and only IPv4
+ * addresses are returned. Answers from DNS are cached for their TTL (capped
+ * at DNS_CACHE_MAX_TTL_S), and names that don't exist for
+ * DNS_CACHE_NEGATIVE_TTL_S. Transient resolver failures aren't cached.
+ *
+ * With DNS_CACHE_MODE=hosts, only the hosts file is used, which lets tests
+ * run without a resolver. With DNS_CACHE_MODE=off, nothing is cached.
+ */
+class DnsCache
+{
+  public:
+    /**
+     * Returns the addresses for the given hostname, or nothing if it doesn't
+     * resolve. IP address literals are returned as they are.
+     */
+    std::vector<::in_addr> resolve(const std::string& hostname);
+
+    void clear();
+
+    size_t size();
+
+  private:
+    struct CacheEntry
+    {
+        std::vector<::in_addr> addrs;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    std::shared_mutex mx;
+    std::unordered_map<std::string, CacheEntry> entries;
+};
+
+DnsCache& getDnsCache();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <wasm/ParkingLot.h>
+
+#include <cstdint>
+
+// Offset of the lock word in a guest pthread_mutex_t. This is where musl
+// keeps its lock, but we intercept all the pthread mutex functions so musl
+// never touches it.
+#define GUEST_MUTEX_LOCK_OFFSET 4
+
+namespace wasm {
+
+/**
+ * Guest mutexes built on a lock word in linear memory. The word is 0 when
+ * unlocked, 1 when locked, and 2 when locked with threads waiting. Locking
+ * and unlocking an uncontended mutex is a single atomic operation, and
+ * threads are only parked (on the lock word's address) under contention.
+ *
+ * Threads on other hosts see their own copy of the lock word, so these only
+ * exclude threads on the same host.
+ */
+class GuestMutex
+{
+  public:
+    GuestMutex(ParkingLot& parkingLotIn, uint32_t lockAddrIn, uint32_t* wordIn);
+
+    void lock();
+
+    bool tryLock();
+
+    void unlock();
+
+  private:
+    ParkingLot& parkingLot;
+    uint32_t lockAddr;
+    uint32_t* word;
+};
+}
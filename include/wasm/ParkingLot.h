@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+
+namespace wasm {
+
+/**
+ * Lets a module's threads sleep until another thread wakes them, keyed on
+ * addresses in the module's linear memory. This backs guest futexes and
+ * condition variables.
+ *
+ * Parking is only visible to threads of the same module on this host, which
+ * is where a module's threads run unless they're distributed.
+ */
+class ParkingLot
+{
+  public:
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    ParkingLot() = default;
+
+    ParkingLot(const ParkingLot&) = delete;
+
+    ParkingLot& operator=(const ParkingLot&) = delete;
+
+    /**
+     * Parks the calling thread on the given address until it's woken, or the
+     * deadline passes.
+     *
+     * The validate check runs first, and the thread is only parked if it
+     * returns true. Validation runs with the address locked, so it must not
+     * call back into the parking lot, and a wake can't slip in between it and
+     * the thread being queued. Once the thread is queued, beforeSleep is run
+     * (e.g. to release a mutex), and a wake from then on isn't lost.
+     *
+     * Returns zero when woken, -EAGAIN if validation failed, or -ETIMEDOUT.
+     */
+    int park(uint32_t addr,
+             const std::function<bool()>& validate,
+             const std::function<void()>& beforeSleep,
+             std::optional<Deadline> deadline);
+
+    /**
+     * Wakes up to maxWaiters threads parked on the address, in the order
+     * they were parked. Returns the number woken.
+     */
+    int unpark(uint32_t addr, int maxWaiters);
+
+    int getParkedCount(uint32_t addr);
+
+  private:
+    struct Waiter
+    {
+        uint32_t addr;
+        bool woken = false;
+        std::condition_variable cv;
+    };
+
+    struct Bucket
+    {
+        std::mutex mx;
+        std::list<Waiter*> waiters;
+    };
+
+    std::array<Bucket, 64> buckets;
+
+    Bucket& getBucket(uint32_t addr);
+};
+}
@@ -8,17 +8,26 @@
 #include <faabric/util/snapshot.h>
 #include <storage/FileSystem.h>
 #include <threads/ThreadState.h>
+#include <wasm/ConnectionPool.h>
+#include <wasm/ParkingLot.h>
 #include <wasm/WasmCommon.h>
 #include <wasm/WasmEnvironment.h>
 
 #include <atomic>
 #include <exception>
+#include <functional>
+#include <future>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <sys/uio.h>
 #include <thread>
 #include <tuple>
 
+namespace faabric::scheduler {
+class Executor;
+}
+
 namespace wasm {
 
 // Note - avoid a zero default on the thread request type otherwise it can
@@ -32,6 +41,10 @@ enum ThreadRequestType
 
 bool isWasmPageAligned(int32_t offset);
 
+// Results of a batch of pthreads, as (message ID, return value) pairs
+typedef std::shared_future<std::vector<std::pair<uint32_t, int32_t>>>
+  PthreadBatchResults;
+
 class WasmModule
 {
   public:
@@ -76,6 +89,9 @@ class WasmModule
     // ----- Filesystem -----
     storage::FileSystem& getFileSystem();
 
+    // ----- Networking -----
+    ConnectionPool& getConnectionPool();
+
     // ----- Exception handling -----
     // Faasm supports three different WASM runtimes, WAVM, WAMR, and WAMR
     // inside SGX. Unfortunately, only WAVM is written in C++ and correctly
@@ -132,16 +148,51 @@ class WasmModule
     void restore(const std::string& snapshotKey);
 
     // ----- Threading -----
-    // Queues a pthread call that will be executed along with all other queued
-    // calls on the first call to await
+    ParkingLot& getParkingLot();
+
+    threads::PthreadKeys& getPthreadKeys();
+
+    // Queues a pthread call. In eager dispatch mode, and when the threads all
+    // run on this host, queued calls are sent as a single batch once the
+    // batch window has passed, otherwise they're sent on the first call to
+    // await
     void queuePthreadCall(threads::PthreadCall call);
 
-    // Executes all queued pthread calls and awaits the call relating to the
+    // Dispatches any queued pthread calls and awaits the call relating to the
     // given pointer
     int awaitPthreadCall(faabric::Message* msg, int pthreadPtr);
 
+    // Waits for all dispatched pthread calls, including those never joined
+    void awaitAllPthreadCalls();
+
     std::vector<uint32_t> getThreadStacks();
 
+    // Records whether this call's threads all run on this host, and fixes the
+    // guest mutex mode from GUEST_MUTEX_MODE for the whole call
+    void setThreadsSingleHost(bool singleHost);
+
+    bool usesHostGuestMutexes();
+
+    // Guest pthread mutexes, keyed on the address of the guest's mutex. With
+    // GUEST_MUTEX_MODE=host, these use the host-side mutexes below rather
+    // than a lock word in linear memory
+    void initGuestMutex(uint32_t mxPtr);
+
+    void lockGuestMutex(uint32_t mxPtr);
+
+    bool tryLockGuestMutex(uint32_t mxPtr);
+
+    void unlockGuestMutex(uint32_t mxPtr);
+
+    // Waits on the guest condition variable, releasing the given guest mutex
+    // while parked. Returns zero, or ETIMEDOUT if the deadline passed. Waits
+    // without a deadline fail straight away with EDEADLK if no other thread
+    // is running to signal them, or ENOTSUP if the threads aren't all on
+    // this host
+    int waitOnGuestCond(uint32_t condPtr,
+                        uint32_t mxPtr,
+                        std::optional<ParkingLot::Deadline> deadline);
+
     // Returns the given pthread mutex and errors if it doesn't exist
     std::shared_ptr<std::mutex> getPthreadMutex(uint32_t id);
 
@@ -182,6 +233,10 @@ class WasmModule
 
     storage::FileSystem filesystem;
 
+    ConnectionPool connectionPool;
+
+    ParkingLot parkingLot;
+
     WasmEnvironment wasmEnvironment;
 
     int stdoutMemFd = 0;
@@ -196,10 +251,18 @@ class WasmModule
     size_t argvBufferSize;
 
     // Threads
+    std::mutex pthreadCallsMx;
     std::vector<threads::PthreadCall> queuedPthreadCalls;
-    std::unordered_map<int32_t, uint32_t> pthreadPtrsToChainedCalls;
-    std::vector<std::pair<uint32_t, int32_t>> lastPthreadResults;
+    std::unordered_map<int32_t, std::pair<uint32_t, PthreadBatchResults>>
+      pthreadPtrsToChainedCalls;
+    std::vector<PthreadBatchResults> pthreadBatches;
+    std::vector<std::future<void>> pthreadDispatchTimers;
+    int nextPthreadIdx = 1;
+    int inFlightPthreads = 0;
+    bool pthreadsSingleHost = true;
+    std::atomic<bool> hostGuestMutexes = false;
     std::vector<faabric::util::SnapshotMergeRegion> mergeRegions;
+    threads::PthreadKeys pthreadKeys;
 
     std::shared_mutex pthreadLocksMx;
     std::unordered_map<uint32_t, std::shared_ptr<std::mutex>> pthreadLocks;
@@ -227,6 +290,22 @@ class WasmModule
 
     // Threads
     void createThreadStacks();
+
+    // Runs the destructors for the calling thread's pthread key values, using
+    // the given function to call into the guest
+    void runPthreadKeyDestructors(
+      const std::function<void(uint32_t, uint32_t)>& callDestructor);
+
+    bool dispatchesPthreadsEagerly();
+
+    void dispatchQueuedPthreadCalls(
+      faabric::scheduler::Executor* executor,
+      std::shared_ptr<faabric::BatchExecuteRequest> parentReq,
+      int parentMsgIdx);
+
+    // Returns zero if another thread could signal a condition variable the
+    // calling thread waits on, or EDEADLK if none ever can
+    int checkGuestCondCanBeSignalled();
 };
 
 // Convenience functions
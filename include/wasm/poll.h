@@ -0,0 +1,80 @@
+#pragma once
+
+#include <storage/FileSystem.h>
+
+#include <cstdint>
+#include <time.h>
+#include <vector>
+
+namespace wasm {
+
+/**
+ * Runtime-agnostic poll_oneoff. WAVM and WAMR lay out the WASI subscription
+ * and event structs differently, so each converts to and from these, but
+ * the values (event types, clock IDs, flags and errnos) are the WASI ones.
+ */
+struct PollSubscription
+{
+    uint64_t userdata = 0;
+    uint8_t type = 0;
+
+    // Clock subscriptions
+    uint32_t clockId = 0;
+    uint64_t timeout = 0;
+    uint16_t flags = 0;
+
+    // Fd read/ write subscriptions
+    int32_t fd = -1;
+};
+
+struct PollEvent
+{
+    uint64_t userdata = 0;
+    uint16_t error = 0;
+    uint8_t type = 0;
+    uint64_t nBytes = 0;
+    uint16_t flags = 0;
+};
+
+/**
+ * Blocks until at least one subscription fires, and returns an event for
+ * every one that has. Clock subscriptions wait for the earliest deadline
+ * rather than sleeping in turn, and fds are waited on together.
+ *
+ * Fds are looked up in the given filesystem. If allowHostFds is set, fds it
+ * doesn't know about are polled as host fds (e.g. WAVM's sockets), otherwise
+ * they get EBADF.
+ */
+std::vector<PollEvent> pollOneoff(storage::FileSystem& fs,
+                                  const std::vector<PollSubscription>& subs,
+                                  bool allowHostFds);
+
+/**
+ * Maps a WASI clock ID onto the host's, returning -1 if it's unknown. Both
+ * runtimes share this, as well as the helpers below, so that they agree on
+ * which clocks exist and which can be slept on.
+ */
+int wasiClockToLinux(uint32_t wasiClockId);
+
+/**
+ * Whether the guest may sleep on the given host clock. CPU-time clocks are
+ * excluded, as they'd measure the whole host process.
+ */
+bool canSleepOnClock(clockid_t linuxClockId);
+
+/**
+ * Writes the resolution of the given WASI clock in nanoseconds, returning a
+ * WASI errno.
+ */
+uint16_t wasiClockResolution(uint32_t wasiClockId, uint64_t* resNanos);
+
+/**
+ * Sleeps on the host with the guest's requested precision, returning zero or
+ * a host errno. If interrupted, relative sleeps write the time remaining to
+ * rem (if not null), as the guest may retry with it.
+ */
+int sleepOnClock(clockid_t linuxClockId,
+                 int flags,
+                 const timespec& req,
+                 timespec* rem);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace wasm {
+
+/**
+ * Guest priorities are applied as the nice level of the executor thread
+ * running the Faaslet, clamped to the range allowed by the FaasmConfig
+ * (GUEST_NICE_MIN/ GUEST_NICE_MAX).
+ */
+int getGuestPriority();
+
+/**
+ * Clamps the requested nice level to the allowed range and applies it to the
+ * calling thread. Returns zero on success, or -errno if the host refuses.
+ *
+ * Raising the level is refused with -EPERM if we couldn't lower it back again
+ * in resetGuestPriority, i.e. without CAP_SYS_NICE or a permissive
+ * RLIMIT_NICE.
+ */
+int setGuestPriority(int nice);
+
+/**
+ * Restores the thread's nice level from before the guest changed it. This is
+ * a no-op if the guest never changed its priority.
+ */
+void resetGuestPriority();
+
+/**
+ * Yields the host thread, so that guest spin loops don't starve other
+ * Faaslets on oversubscribed hosts.
+ */
+void yieldGuest();
+}
@@ -110,6 +110,13 @@ class WAVMWasmModule final
       const std::vector<WAVM::IR::UntaggedValue>& arguments,
       WAVM::IR::UntaggedValue& result);
 
+    // Returns the guest buffer for gethostbyname results, growing memory if
+    // it's smaller than the given size
+    uint32_t getHostentBuffer(size_t size);
+
+    // Sets errno in the guest's libc, if it exports __errno_location
+    void setGuestErrno(WAVM::Runtime::Context* ctx, int err);
+
     void writeArgvToMemory(uint32_t wasmArgvPointers,
                            uint32_t wasmArgvBuffer) override;
 
@@ -133,6 +140,9 @@ class WAVMWasmModule final
       uint32_t stackTop,
       WAVM::Runtime::ContextRuntimeData* contextRuntimeData);
 
+    static void resetThreadContext(WAVM::Runtime::Context* ctx,
+                                   uint32_t stackTop);
+
     // ----- Disassembly -----
     std::map<std::string, std::string> buildDisassemblyMap();
 
@@ -189,6 +199,19 @@ class WAVMWasmModule final
     // OpenMP
     std::vector<WAVM::Runtime::Context*> openMPContexts;
 
+    // Pthreads, reset between threads
+    std::vector<WAVM::Runtime::Context*> pthreadContexts;
+
+    // Reused by every call to gethostbyname, reset with the module
+    uint32_t hostentBuffer = 0;
+    size_t hostentBufferSize = 0;
+
+    // Python function file last synced by this module
+    std::string syncedPythonFunction;
+    std::string syncedPythonFunctionVersion;
+
+    void syncPythonFunctionFile(const faabric::Message& msg);
+
     static WAVM::Runtime::Instance* getEnvModule();
 
     static WAVM::Runtime::Instance* getWasiModule();
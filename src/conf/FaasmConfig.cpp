@@ -21,8 +21,32 @@ void FaasmConfig::initialise()
     hostType = getEnvVar("HOST_TYPE", "default");
 
     cgroupMode = getEnvVar("CGROUP_MODE", "on");
+    cgroupGranularity = getEnvVar("CGROUP_GRANULARITY", "function");
+    cgroupCpuWeight = getEnvVar("CGROUP_CPU_WEIGHT", "");
+    cgroupCpuMax = getEnvVar("CGROUP_CPU_MAX", "");
+    cgroupMemoryMax = getEnvVar("CGROUP_MEMORY_MAX", "");
     netNsMode = getEnvVar("NETNS_MODE", "off");
     maxNetNs = this->getIntParam("MAX_NET_NAMESPACES", "100");
+    netNsPrejoin = getEnvVar("NETNS_PREJOIN", "off");
+
+    connPoolMode = getEnvVar("CONN_POOL_MODE", "off");
+    connPoolPorts = getEnvVar("CONN_POOL_PORTS", "");
+    connPoolMaxPerDest = this->getIntParam("CONN_POOL_MAX_PER_DEST", "8");
+    connPoolIdleTimeoutMs =
+      this->getIntParam("CONN_POOL_IDLE_TIMEOUT_MS", "30000");
+
+    dnsCacheMode = getEnvVar("DNS_CACHE_MODE", "on");
+    dnsHostsFile = getEnvVar("DNS_HOSTS_FILE", "/etc/hosts");
+    dnsCacheMaxTtlSeconds = this->getIntParam("DNS_CACHE_MAX_TTL_S", "300");
+    dnsCacheNegativeTtlSeconds =
+      this->getIntParam("DNS_CACHE_NEGATIVE_TTL_S", "30");
+
+    guestNiceMin = this->getIntParam("GUEST_NICE_MIN", "0");
+    guestNiceMax = this->getIntParam("GUEST_NICE_MAX", "19");
+
+    pthreadDispatchMode = getEnvVar("PTHREAD_DISPATCH_MODE", "join");
+    pthreadBatchWindowUs = this->getIntParam("PTHREAD_BATCH_WINDOW_US", "500");
+    guestMutexMode = getEnvVar("GUEST_MUTEX_MODE", "atomic");
 
     pythonPreload = getEnvVar("PYTHON_PRELOAD", "off");
     captureStdout = getEnvVar("CAPTURE_STDOUT", "off");
@@ -36,6 +60,18 @@ void FaasmConfig::initialise()
     objectFileDir = fmt::format("{}/{}", faasmLocalDir, "object");
     runtimeFilesDir = fmt::format("{}/{}", faasmLocalDir, "runtime_root");
     sharedFilesDir = fmt::format("{}/{}", faasmLocalDir, "shared");
+    sharedFilesNegativeTtlMs =
+      this->getIntParam("SHARED_FILES_NEGATIVE_TTL_MS", "5000");
+    sharedFilesPrefetch = getEnvVar("SHARED_FILES_PREFETCH", "");
+
+    storageBackend = getEnvVar("STORAGE_BACKEND", "s3");
+    localStorageDir = getEnvVar(
+      "LOCAL_STORAGE_DIR", fmt::format("{}/{}", faasmLocalDir, "storage"));
+    fileIoBackend = getEnvVar("FILE_IO_BACKEND", "syscall");
+
+    fsOverlayPaths = getEnvVar("FS_OVERLAY_PATHS", "");
+    fsOverlayDir = getEnvVar("FS_OVERLAY_DIR", "/dev/shm/faasm-overlay");
+    fsOverlayMaxMb = this->getIntParam("FS_OVERLAY_MAX_MB", "64");
 
     s3Bucket = getEnvVar("S3_BUCKET", "faasm");
     s3Host = getEnvVar("S3_HOST", "minio");
@@ -62,9 +98,26 @@ void FaasmConfig::print()
 {
     SPDLOG_INFO("--- HOST ---");
     SPDLOG_INFO("Cgroup mode:          {}", cgroupMode);
+    SPDLOG_INFO("Cgroup granularity:   {}", cgroupGranularity);
+    SPDLOG_INFO("Cgroup CPU weight:    {}", cgroupCpuWeight);
+    SPDLOG_INFO("Cgroup CPU max:       {}", cgroupCpuMax);
+    SPDLOG_INFO("Cgroup memory max:    {}", cgroupMemoryMax);
     SPDLOG_INFO("Host type:            {}", hostType);
     SPDLOG_INFO("Network ns mode:      {}", netNsMode);
     SPDLOG_INFO("Max. network ns:      {}", maxNetNs);
+    SPDLOG_INFO("Network ns prejoin:   {}", netNsPrejoin);
+    SPDLOG_INFO("Conn. pool mode:      {}", connPoolMode);
+    SPDLOG_INFO("Conn. pool ports:     {}", connPoolPorts);
+    SPDLOG_INFO("Conn. pool max/dest:  {}", connPoolMaxPerDest);
+    SPDLOG_INFO("Conn. pool idle TTL:  {}ms", connPoolIdleTimeoutMs);
+    SPDLOG_INFO("DNS cache mode:       {}", dnsCacheMode);
+    SPDLOG_INFO("DNS hosts file:       {}", dnsHostsFile);
+    SPDLOG_INFO("DNS cache max TTL:    {}s", dnsCacheMaxTtlSeconds);
+    SPDLOG_INFO("DNS cache neg. TTL:   {}s", dnsCacheNegativeTtlSeconds);
+    SPDLOG_INFO("Guest nice range:     {}-{}", guestNiceMin, guestNiceMax);
+    SPDLOG_INFO("Pthread dispatch:     {}", pthreadDispatchMode);
+    SPDLOG_INFO("Pthread batch window: {}us", pthreadBatchWindowUs);
+    SPDLOG_INFO("Guest mutex mode:     {}", guestMutexMode);
 
     SPDLOG_INFO("--- MISC ---");
     SPDLOG_INFO("Capture stdout:       {}", captureStdout);
@@ -77,5 +130,13 @@ void FaasmConfig::print()
     SPDLOG_INFO("Object file dir:      {}", objectFileDir);
     SPDLOG_INFO("Runtime files dir:    {}", runtimeFilesDir);
     SPDLOG_INFO("Shared files dir:     {}", sharedFilesDir);
+    SPDLOG_INFO("Shared files neg TTL: {}ms", sharedFilesNegativeTtlMs);
+    SPDLOG_INFO("Shared prefetch:      {}", sharedFilesPrefetch);
+    SPDLOG_INFO("Storage backend:      {}", storageBackend);
+    SPDLOG_INFO("Local storage dir:    {}", localStorageDir);
+    SPDLOG_INFO("File I/O backend:     {}", fileIoBackend);
+    SPDLOG_INFO("FS overlay paths:     {}", fsOverlayPaths);
+    SPDLOG_INFO("FS overlay dir:       {}", fsOverlayDir);
+    SPDLOG_INFO("FS overlay max:       {}MB", fsOverlayMaxMb);
 }
 }
@@ -15,12 +15,14 @@
 #include <faaslet/Faaslet.h>
 #include <storage/FileLoader.h>
 #include <storage/FileSystem.h>
+#include <storage/SharedFiles.h>
 #include <system/CGroup.h>
 #include <system/NetworkNamespace.h>
 #include <threads/ThreadState.h>
 #include <wamr/WAMRWasmModule.h>
 #include <wavm/WAVMWasmModule.h>
 
+#include <sstream>
 #include <stdexcept>
 
 static thread_local bool threadIsIsolated = false;
@@ -39,6 +41,23 @@ void preloadPythonRuntime()
 
     SPDLOG_INFO("Preparing python runtime");
 
+    // Pull any shared directories the runtime will need into the local cache
+    // before the first function touches them
+    if (!conf.sharedFilesPrefetch.empty()) {
+        std::vector<std::string> sharedDirs;
+        std::istringstream dirsStream(conf.sharedFilesPrefetch);
+        std::string dir;
+        while (std::getline(dirsStream, dir, ',')) {
+            if (!dir.empty()) {
+                sharedDirs.emplace_back(dir);
+            }
+        }
+
+        int nFiles =
+          storage::SharedFiles::prefetchSharedDirectories(sharedDirs);
+        SPDLOG_INFO("Prefetched {} shared files", nFiles);
+    }
+
     auto req = faabric::util::batchExecFactory(PYTHON_USER, PYTHON_FUNC, 1);
     auto& msg = *req->mutable_messages(0);
     msg.set_ispython(true);
@@ -74,6 +93,9 @@ Faaslet::Faaslet(faabric::Message& msg)
         throw std::runtime_error("Unrecognised wasm VM");
     }
 
+    // Prefetch any shared files listed in the function's manifest
+    storage::SharedFiles::prefetchForPythonFunction(msg);
+
     // Bind to the function
     module->bindToFunction(msg);
 
@@ -83,6 +105,29 @@ Faaslet::Faaslet(faabric::Message& msg)
         localResetSnapshotKey =
           wasm::getWAVMModuleCache().registerResetSnapshot(*module, msg);
     }
+
+    // Set up the function's cgroup, with any limits it ships with. Only
+    // cgroup v2 has per-function groups, so there's nothing to load otherwise
+    cgroupName = getFunctionCgroupName(msg);
+    CGroup cgroup(cgroupName);
+    if (cgroup.getMode() == CgroupMode::cg_v2) {
+        storage::FileLoader& loader = storage::getFileLoader();
+        cgroup.create(parseCgroupLimits(loader.loadFunctionLimits(msg)));
+    }
+
+    // Claim the network namespace and open its fd up front, so that threads
+    // only have to call setns when they first execute
+    if (conf.netNsPrejoin == "on") {
+        claimFaasletNamespace();
+    }
+}
+
+void Faaslet::claimFaasletNamespace()
+{
+    std::call_once(nsFlag, [this] {
+        ns = claimNetworkNamespace();
+        ns->prepare();
+    });
 }
 
 int32_t Faaslet::executeTask(int threadPoolIdx,
@@ -98,11 +143,12 @@ int32_t Faaslet::executeTask(int threadPoolIdx,
 
     if (!threadIsIsolated) {
         // Add this thread to the cgroup
-        CGroup cgroup(BASE_CGROUP_NAME);
+        CGroup cgroup(cgroupName);
         cgroup.addCurrentThread();
 
-        // Set up network namespace
-        ns = claimNetworkNamespace();
+        // Join the network namespace. All threads in this Faaslet share the
+        // same one, so it's only claimed once
+        claimFaasletNamespace();
         ns->addCurrentThread();
 
         threadIsIsolated = true;
@@ -0,0 +1,128 @@
+#include <conf/FaasmConfig.h>
+#include <storage/FileDescriptor.h>
+#include <storage/FileSystem.h>
+
+#include <faabric/util/logging.h>
+#include <faabric/util/timing.h>
+
+#include <WAVM/WASI/WASIABI.h>
+#include <boost/filesystem.hpp>
+#include <random>
+#include <vector>
+
+#define BENCH_FILE "file_io_bench.dat"
+#define BENCH_BLOCK_SIZE (128 * 1024)
+#define BENCH_RANDOM_BLOCK_SIZE 4096
+#define BENCH_RANDOM_READS 20000
+
+static double throughputMbs(size_t nBytes, double millis)
+{
+    return ((double)nBytes / (1024 * 1024)) / (millis / 1000);
+}
+
+static void runBenchmark(const std::string& backend, size_t fileSizeMb)
+{
+    conf::FaasmConfig& conf = conf::getFaasmConfig();
+    conf.fileIoBackend = backend;
+
+    storage::FileSystem fs;
+    fs.prepareFilesystem();
+
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int fd = fs.openFileDescriptor(DEFAULT_ROOT_FD,
+                                   BENCH_FILE,
+                                   rights,
+                                   0,
+                                   0,
+                                   __WASI_O_CREAT | __WASI_O_TRUNC,
+                                   0);
+    if (fd < 0) {
+        SPDLOG_ERROR("Failed to open benchmark file: {}", fd);
+        throw std::runtime_error("Failed to open benchmark file");
+    }
+
+    storage::FileDescriptor& fileDesc = fs.getFileDescriptor(fd);
+
+    size_t nBlocks = (fileSizeMb * 1024 * 1024) / BENCH_BLOCK_SIZE;
+    size_t fileSize = nBlocks * BENCH_BLOCK_SIZE;
+
+    // Split each block over a few iovecs like a guest's stdio would
+    std::vector<uint8_t> buffer(BENCH_BLOCK_SIZE, 1);
+    size_t quarter = BENCH_BLOCK_SIZE / 4;
+    std::vector<::iovec> iovecs;
+    for (int i = 0; i < 4; i++) {
+        iovecs.push_back({ buffer.data() + i * quarter, quarter });
+    }
+
+    // Sequential write
+    auto writeStart = faabric::util::startTimer();
+    for (size_t i = 0; i < nBlocks; i++) {
+        if (fileDesc.write(iovecs, iovecs.size()) != BENCH_BLOCK_SIZE) {
+            throw std::runtime_error("Short write in benchmark");
+        }
+    }
+    fileDesc.sync(false);
+    double writeMillis = faabric::util::getTimeDiffMillis(writeStart);
+
+    // Sequential read
+    uint64_t newOffset = 0;
+    fileDesc.seek(0, __WASI_WHENCE_SET, &newOffset);
+    auto readStart = faabric::util::startTimer();
+    for (size_t i = 0; i < nBlocks; i++) {
+        if (fileDesc.read(iovecs, iovecs.size()) != BENCH_BLOCK_SIZE) {
+            throw std::runtime_error("Short read in benchmark");
+        }
+    }
+    double readMillis = faabric::util::getTimeDiffMillis(readStart);
+
+    // Random positional reads
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<uint64_t> dist(
+      0, (fileSize / BENCH_RANDOM_BLOCK_SIZE) - 1);
+    std::vector<::iovec> randomIovecs = {
+        { buffer.data(), BENCH_RANDOM_BLOCK_SIZE },
+    };
+
+    auto randomStart = faabric::util::startTimer();
+    for (int i = 0; i < BENCH_RANDOM_READS; i++) {
+        uint64_t offset = dist(gen) * BENCH_RANDOM_BLOCK_SIZE;
+        if (fileDesc.pread(randomIovecs, 1, offset) !=
+            BENCH_RANDOM_BLOCK_SIZE) {
+            throw std::runtime_error("Short random read in benchmark");
+        }
+    }
+    double randomMillis = faabric::util::getTimeDiffMillis(randomStart);
+
+    SPDLOG_INFO("{:<10} seq write {:>8.1f} MB/s, seq read {:>8.1f} MB/s, "
+                "random read {:>8.1f} MB/s",
+                backend,
+                throughputMbs(fileSize, writeMillis),
+                throughputMbs(fileSize, readMillis),
+                throughputMbs((size_t)BENCH_RANDOM_READS *
+                                BENCH_RANDOM_BLOCK_SIZE,
+                              randomMillis));
+
+    boost::filesystem::remove(conf.runtimeFilesDir + "/" + BENCH_FILE);
+}
+
+int main(int argc, char* argv[])
+{
+    faabric::util::initLogging();
+
+    size_t fileSizeMb = 256;
+    if (argc > 1) {
+        fileSizeMb = std::stoul(argv[1]);
+    }
+
+    SPDLOG_INFO("Running file I/O benchmark with {}MB file", fileSizeMb);
+
+    // Note that the page cache will be warm for the second backend's reads,
+    // run with each backend in isolation for cold numbers
+    for (const auto& backend : { "syscall", "io_uring" }) {
+        runBenchmark(backend, fileSizeMb);
+    }
+
+    conf::getFaasmConfig().reset();
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <conf/FaasmConfig.h>
+#include <faaslet/Faaslet.h>
+#include <storage/S3Wrapper.h>
+
+#include <faabric/planner/PlannerClient.h>
+#include <faabric/runner/FaabricMain.h>
+#include <faabric/scheduler/ExecutorFactory.h>
+#include <faabric/util/batch.h>
+#include <faabric/util/config.h>
+#include <faabric/util/logging.h>
+#include <faabric/util/timing.h>
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#define BENCH_DEFAULT_RUNS 200
+#define BENCH_RESULT_TIMEOUT_MS 60000
+
+/**
+ * Measures pthread create/join throughput by repeatedly invoking a function
+ * that creates and joins threads. Thread contexts are only pooled within an
+ * invocation, as resetting the Faaslet between invocations drops them, so the
+ * number of create/join rounds to run in each invocation is passed to the
+ * function as its input. Only rounds after the first reuse pooled contexts.
+ */
+static int runBenchmark(const std::string& user,
+                        const std::string& function,
+                        int nRuns,
+                        int threadsPerRound,
+                        int roundsPerRun)
+{
+    auto& plannerCli = faabric::planner::getPlannerClient();
+    std::vector<double> runMillis;
+
+    // The first run creates the Faaslet and loads the function, so leave it
+    // out of the results
+    for (int r = 0; r <= nRuns; r++) {
+        auto req = faabric::util::batchExecFactory(user, function, 1);
+        req->mutable_messages(0)->set_inputdata(std::to_string(roundsPerRun));
+        faabric::Message msg = req->messages().at(0);
+
+        auto start = faabric::util::startTimer();
+        plannerCli.callFunctions(req);
+        faabric::Message res =
+          plannerCli.getMessageResult(msg, BENCH_RESULT_TIMEOUT_MS);
+        double millis = faabric::util::getTimeDiffMillis(start);
+
+        if (res.returnvalue() != 0) {
+            SPDLOG_ERROR("{}/{} failed on run {} with value {}",
+                         user,
+                         function,
+                         r,
+                         res.returnvalue());
+            return 1;
+        }
+
+        if (r > 0) {
+            runMillis.push_back(millis);
+        }
+    }
+
+    std::sort(runMillis.begin(), runMillis.end());
+    double totalMillis =
+      std::accumulate(runMillis.begin(), runMillis.end(), 0.0);
+    double p50 = runMillis.at(runMillis.size() / 2);
+    double p99 = runMillis.at((runMillis.size() * 99) / 100);
+
+    SPDLOG_INFO("{}/{} x{} ({} rounds each): mean {:.3f}ms, p50 {:.3f}ms, "
+                "p99 {:.3f}ms",
+                user,
+                function,
+                nRuns,
+                roundsPerRun,
+                totalMillis / nRuns,
+                p50,
+                p99);
+
+    if (threadsPerRound > 0) {
+        double nThreads = (double)threadsPerRound * roundsPerRun * nRuns;
+        SPDLOG_INFO("{:.1f} threads created and joined per second",
+                    nThreads / (totalMillis / 1000));
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    storage::initFaasmS3();
+    faabric::util::initLogging();
+
+    // Args: [runs] [user] [function] [threads per round] [rounds per run]
+    int nRuns = argc > 1 ? std::stoi(argv[1]) : BENCH_DEFAULT_RUNS;
+    std::string user = argc > 2 ? argv[2] : "demo";
+    std::string function = argc > 3 ? argv[3] : "threads_local";
+    int threadsPerRound = argc > 4 ? std::stoi(argv[4]) : 0;
+    int roundsPerRun = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    if (nRuns < 1 || roundsPerRun < 1) {
+        SPDLOG_ERROR("Usage: pthread_bench [runs] [user] [function] "
+                     "[threads per round] [rounds per run]");
+        return 1;
+    }
+
+    faabric::util::SystemConfig& conf = faabric::util::getSystemConfig();
+    conf.boundTimeout = BENCH_RESULT_TIMEOUT_MS;
+    conf.globalMessageTimeout = BENCH_RESULT_TIMEOUT_MS;
+
+    auto fac = std::make_shared<faaslet::FaasletFactory>();
+    faabric::scheduler::setExecutorFactory(fac);
+    faabric::runner::FaabricMain m(fac);
+    m.startRunner();
+
+    int returnValue =
+      runBenchmark(user, function, nRuns, threadsPerRound, roundsPerRun);
+
+    m.shutdown();
+    storage::shutdownFaasmS3();
+
+    return returnValue;
+}
@@ -7,16 +7,20 @@
 #include <faabric/util/timing.h>
 
 #include <conf/FaasmConfig.h>
+#include <storage/IoUring.h>
 #include <storage/SharedFiles.h>
 
 #include <WAVM/WASI/WASIABI.h>
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <dirent.h>
 #include <fcntl.h>
 #include <stdexcept>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/uio.h>
+#include <unistd.h>
 
 #define WASI_FD_FLAGS                                                          \
     (__WASI_FDFLAG_RSYNC | __WASI_FDFLAG_APPEND | __WASI_FDFLAG_DSYNC |        \
@@ -31,6 +35,31 @@ std::string prependRuntimeRoot(const std::string& originalPath)
     return p.string();
 }
 
+static uint64_t iovecsLength(const std::vector<::iovec>& nativeIovecs,
+                             int iovecCount)
+{
+    uint64_t len = 0;
+    for (int i = 0; i < iovecCount; i++) {
+        len += nativeIovecs[i].iov_len;
+    }
+
+    return len;
+}
+
+// Space a file takes up in the overlay, which is only given back when its
+// last link goes
+static uint64_t overlayFileSize(const std::string& realPath)
+{
+    struct ::stat nativeStat
+    {};
+    if (::lstat(realPath.c_str(), &nativeStat) != 0 ||
+        !S_ISREG(nativeStat.st_mode) || nativeStat.st_nlink != 1) {
+        return 0;
+    }
+
+    return nativeStat.st_size;
+}
+
 int32_t wasiFdFlagsToLinux(int32_t fdFlags)
 {
     int32_t result = 0;
@@ -135,6 +164,24 @@ uint16_t errnoToWasi(int errnoIn)
             return __WASI_EMFILE;
         case ESPIPE:
             return __WASI_ESPIPE;
+        case EINTR:
+            return __WASI_EINTR;
+        case ENOSPC:
+            return __WASI_ENOSPC;
+        case EFBIG:
+            return __WASI_EFBIG;
+        case EROFS:
+            return __WASI_EROFS;
+        case EMLINK:
+            return __WASI_EMLINK;
+        case EXDEV:
+            return __WASI_EXDEV;
+        case ELOOP:
+            return __WASI_ELOOP;
+        case ENAMETOOLONG:
+            return __WASI_ENAMETOOLONG;
+        case ENOTSUP:
+            return __WASI_ENOTSUP;
         default:
             throw std::runtime_error("Unsupported WASI errno: " +
                                      std::to_string(errnoIn));
@@ -193,17 +240,47 @@ FileDescriptor FileDescriptor::stderrFactory()
     return FileDescriptor::stdFdFactory(STDERR_FILENO, "/dev/stderr");
 }
 
+// Size of the host buffer passed to each getdents64 call
+#define DIR_STREAM_BUFFER_SIZE 4096
+
+static uint8_t direntTypeToWasi(uint8_t direntType)
+{
+    switch (direntType) {
+        case DT_REG:
+            return __WASI_FILETYPE_REGULAR_FILE;
+        case DT_DIR:
+            return __WASI_FILETYPE_DIRECTORY;
+        case DT_LNK:
+            return __WASI_FILETYPE_SYMBOLIC_LINK;
+        case DT_CHR:
+            return __WASI_FILETYPE_CHARACTER_DEVICE;
+        case DT_BLK:
+            return __WASI_FILETYPE_BLOCK_DEVICE;
+        case DT_SOCK:
+            return __WASI_FILETYPE_SOCKET_STREAM;
+        default:
+            return __WASI_FILETYPE_UNKNOWN;
+    }
+}
+
 void FileDescriptor::iterReset()
 {
+    if (dirStreamFd >= 0) {
+        ::close(dirStreamFd);
+    }
+
     // Reset iterator state
-    dirContentsLoaded = false;
-    dirContentsIdx = 0;
-    dirContents.clear();
+    dirStreamFd = -1;
+    dirStreamFinished = false;
+    dirBatch.clear();
+    dirBatchIdx = 0;
+    dirCookie = __WASI_DIRCOOKIE_START;
+    dirPrevCookie = __WASI_DIRCOOKIE_START;
+    dirCanGoBack = false;
 }
 
-void FileDescriptor::loadDirContents()
+void FileDescriptor::openDirStream()
 {
-
     // Work out the local filesystem path
     std::string realPath;
     if (SharedFiles::isPathShared(path)) {
@@ -215,86 +292,155 @@ void FileDescriptor::loadDirContents()
 
         realPath = SharedFiles::realPathForSharedFile(path);
     } else {
-        realPath = prependRuntimeRoot(path);
+        realPath = realPathFor(path);
     }
 
-    // Open the directory
-    SPDLOG_DEBUG("Loading dir contents: {}", realPath);
-    DIR* dirPtr = ::opendir(realPath.c_str());
-    if (dirPtr == nullptr) {
+    // Open a descriptor just for the listing, so that its offset is
+    // independent of anything else done with this file descriptor
+    SPDLOG_DEBUG("Opening dir stream: {}", realPath);
+    dirStreamFd = ::open(realPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirStreamFd < 0) {
+        SPDLOG_ERROR("Failed to open dir {}: {}", realPath, strerror(errno));
         throw std::runtime_error("Failed to open dir");
     }
 
-    // Load all directory entries
-    uint64_t nextIdx = 0;
-    struct dirent* direntPtr;
-    while ((direntPtr = ::readdir(dirPtr)) != nullptr) {
-        nextIdx++;
+    dirStreamFinished = false;
+    dirBatch.clear();
+    dirBatchIdx = 0;
+    dirCookie = __WASI_DIRCOOKIE_START;
+    dirPrevCookie = __WASI_DIRCOOKIE_START;
+    dirCanGoBack = false;
+}
+
+bool FileDescriptor::readDirStream()
+{
+    if (dirStreamFinished) {
+        return false;
+    }
+
+    std::vector<uint8_t> nativeBuf(DIR_STREAM_BUFFER_SIZE);
+    long nativeBytesRead = ::syscall(
+      SYS_getdents64, dirStreamFd, nativeBuf.data(), nativeBuf.size());
+
+    if (nativeBytesRead < 0) {
+        SPDLOG_ERROR("getdents64 failed on {}: {}", path, strerror(errno));
+        throw std::runtime_error("Failed to read dir");
+    }
+
+    dirBatch.clear();
+    dirBatchIdx = 0;
+
+    if (nativeBytesRead == 0) {
+        dirStreamFinished = true;
+        return false;
+    }
 
+    for (long offset = 0; offset < nativeBytesRead;) {
+        auto* d = reinterpret_cast<::dirent64*>(nativeBuf.data() + offset);
+
+        // The "next" value is passed back as the cookie to fd_readdir, so we
+        // use the kernel's offset for the following entry
         DirEnt nextEnt;
+        nextEnt.next = (uint64_t)d->d_off;
+        nextEnt.type = direntTypeToWasi(d->d_type);
+        nextEnt.ino = d->d_ino;
+        nextEnt.path = std::string(d->d_name);
+        dirBatch.emplace_back(std::move(nextEnt));
+
+        offset += d->d_reclen;
+    }
 
-        // We have to set "next" here to specify the offset of this
-        // directory entry. It seems this is only used to be passed
-        // back as the "cookie" value to fd_readdir
-        nextEnt.next = nextIdx;
+    return true;
+}
 
-        nextEnt.type = direntPtr->d_type;
-        nextEnt.ino = direntPtr->d_ino;
-        nextEnt.path = std::string(direntPtr->d_name);
+void FileDescriptor::iterSeek(uint64_t cookie)
+{
+    if (dirStreamFd < 0) {
+        openDirStream();
+        if (cookie == __WASI_DIRCOOKIE_START) {
+            return;
+        }
+    } else if (cookie == dirCookie) {
+        // Already in the right place, the common case for sequential reads
+        return;
+    }
 
-        dirContents.push_back(nextEnt);
+    if (::lseek(dirStreamFd, (off_t)cookie, SEEK_SET) < 0) {
+        SPDLOG_ERROR(
+          "Failed to seek dir {} to {}: {}", path, cookie, strerror(errno));
+        throw std::runtime_error("Failed to seek dir");
     }
 
-    // Close iterator
-    closedir(dirPtr);
-    SPDLOG_DEBUG("Loaded {} entries for {}", dirContents.size(), realPath);
+    dirStreamFinished = false;
+    dirBatch.clear();
+    dirBatchIdx = 0;
+    dirCookie = cookie;
+    dirCanGoBack = false;
+}
 
-    // Set flag
-    dirContentsLoaded = true;
+uint64_t FileDescriptor::iterCookie() const
+{
+    return dirCookie;
 }
 
 void FileDescriptor::iterBack()
 {
-    if (!dirContentsLoaded) {
+    if (dirStreamFd < 0) {
         throw std::runtime_error("Iterator not started, cannot go back");
     }
 
-    if (dirContentsIdx == 0) {
+    if (!dirCanGoBack) {
         throw std::runtime_error("Iterator already at zero, cannot go back");
     }
 
-    dirContentsIdx--;
+    // If the previous entry is still in the current batch we can just step
+    // back, otherwise we have to seek to it
+    uint64_t prevCookie = dirPrevCookie;
+    if (dirBatchIdx > 0) {
+        dirBatchIdx--;
+        dirCookie = prevCookie;
+    } else {
+        iterSeek(prevCookie);
+    }
+
+    dirCanGoBack = false;
 }
 
 bool FileDescriptor::iterStarted() const
 {
-    return dirContentsLoaded;
+    return dirStreamFd >= 0;
 }
 
 bool FileDescriptor::iterFinished()
 {
-    return dirContentsLoaded && (dirContentsIdx >= dirContents.size());
+    if (dirStreamFd < 0) {
+        return false;
+    }
+
+    if (dirBatchIdx < dirBatch.size()) {
+        return false;
+    }
+
+    return !readDirStream();
 }
 
 DirEnt FileDescriptor::iterNext()
 {
-    // Check if contents are initialised
-    if (!dirContentsLoaded) {
-        loadDirContents();
+    if (dirStreamFd < 0) {
+        openDirStream();
     }
 
-    // Check
     if (iterFinished()) {
         throw std::runtime_error(
-          fmt::format("Accessing index {} in directory length {}",
-                      dirContentsIdx,
-                      dirContents.size()));
+          fmt::format("Reading past the end of directory {}", path));
     }
 
-    DirEnt nextEntry = dirContents.at(dirContentsIdx);
+    DirEnt nextEntry = dirBatch.at(dirBatchIdx);
+    dirBatchIdx++;
 
-    // Increment the iterator
-    dirContentsIdx++;
+    dirPrevCookie = dirCookie;
+    dirCookie = nextEntry.next;
+    dirCanGoBack = true;
 
     return nextEntry;
 }
@@ -447,7 +593,29 @@ bool FileDescriptor::pathOpen(uint32_t lookupFlags,
 
         realPath = SharedFiles::realPathForSharedFile(path);
     } else {
-        realPath = prependRuntimeRoot(path);
+        realPath = realPathFor(path);
+    }
+
+    // Skip the open altogether if we already know the path doesn't exist
+    bool isCreate = linuxFlags & O_CREAT;
+    if (!isShared && !isCreate && pathCache != nullptr) {
+        struct ::stat cachedStat
+        {};
+        int cachedErrno = 0;
+        if (pathCache->getStat(realPath, cachedStat, cachedErrno) &&
+            cachedErrno != 0) {
+            linuxFd = -1;
+            linuxErrno = cachedErrno;
+            wasiErrno = errnoToWasi(linuxErrno);
+            return false;
+        }
+    }
+
+    // Truncating a file in the overlay gives its space back
+    bool isTrunc = linuxFlags & O_TRUNC;
+    uint64_t overlayFreed = 0;
+    if (isTrunc && isInOverlay(path)) {
+        overlayFreed = overlayFileSize(realPath);
     }
 
     // Attempt to open the local file
@@ -467,12 +635,21 @@ bool FileDescriptor::pathOpen(uint32_t lookupFlags,
         return false;
     }
 
+    if (overlayFreed > 0) {
+        overlay->release(overlayFreed);
+    }
+
+    // Creating or truncating changes the file and possibly its directory
+    if (!isShared && pathCache != nullptr && (isCreate || isTrunc)) {
+        pathCache->invalidate(realPath);
+    }
+
     return true;
 }
 
 bool FileDescriptor::mkdir(const std::string& dirPath)
 {
-    std::string fullPath = prependRuntimeRoot(dirPath);
+    std::string fullPath = realPathFor(dirPath);
     int res = ::mkdir(fullPath.c_str(), 0755);
 
     if (res < 0) {
@@ -480,6 +657,10 @@ bool FileDescriptor::mkdir(const std::string& dirPath)
         return false;
     }
 
+    if (pathCache != nullptr) {
+        pathCache->invalidate(fullPath);
+    }
+
     return true;
 }
 
@@ -499,33 +680,431 @@ bool FileDescriptor::updateFlags(int32_t fdFlags)
     return true;
 }
 
+// Returns this thread's io_uring if it's the configured backend and is
+// available, otherwise null to signal that plain syscalls should be used
+static IoUring* getIoRing()
+{
+    if (conf::getFaasmConfig().fileIoBackend != "io_uring") {
+        return nullptr;
+    }
+
+    return getThreadIoUring();
+}
+
+ssize_t FileDescriptor::read(std::vector<::iovec>& nativeIovecs,
+                             int iovecCount)
+{
+    // All the iovecs go in a single submission, so one guest call is only
+    // ever one trip to the kernel
+    IoUring* ring = getIoRing();
+    ssize_t bytesRead =
+      ring != nullptr
+        ? ring->readv(
+            linuxFd, nativeIovecs.data(), iovecCount, IO_URING_CURRENT_POS)
+        : ::readv(linuxFd, nativeIovecs.data(), iovecCount);
+
+    if (bytesRead < 0) {
+        wasiErrno = errnoToWasi(errno);
+        return -1;
+    }
+
+    return bytesRead;
+}
+
 ssize_t FileDescriptor::write(std::vector<::iovec>& nativeIovecs,
                               int iovecCount)
 {
+    uint64_t len = iovecsLength(nativeIovecs, iovecCount);
+    int64_t reserved = reserveOverlayGrowth(-1, len);
+    if (reserved < 0) {
+        return -1;
+    }
+
+    IoUring* ring = getIoRing();
     ssize_t bytesWritten =
-      ::writev(getLinuxFd(), nativeIovecs.data(), iovecCount);
+      ring != nullptr
+        ? ring->writev(
+            linuxFd, nativeIovecs.data(), iovecCount, IO_URING_CURRENT_POS)
+        : ::writev(linuxFd, nativeIovecs.data(), iovecCount);
 
     if (bytesWritten < 0) {
-        SPDLOG_ERROR(
-          "writev failed on fd {}: {}", getLinuxFd(), strerror(errno));
+        SPDLOG_ERROR("writev failed on fd {}: {}", linuxFd, strerror(errno));
         wasiErrno = errnoToWasi(errno);
-        return false;
+        releaseOverlayGrowth(reserved, len, 0);
+        return -1;
     }
 
-    bool isShared = SharedFiles::isPathShared(path);
-    std::string realPath;
-    if (isShared) {
+    releaseOverlayGrowth(reserved, len, bytesWritten);
+
+    if (SharedFiles::isPathShared(path)) {
         SharedFiles::updateSharedFile(path);
+    } else {
+        invalidateCachedContents();
     }
 
     return bytesWritten;
 }
 
+ssize_t FileDescriptor::pread(std::vector<::iovec>& nativeIovecs,
+                              int iovecCount,
+                              uint64_t offset)
+{
+    IoUring* ring = getIoRing();
+    ssize_t bytesRead =
+      ring != nullptr
+        ? ring->readv(linuxFd, nativeIovecs.data(), iovecCount, offset)
+        : ::preadv(linuxFd, nativeIovecs.data(), iovecCount, (off_t)offset);
+
+    if (bytesRead < 0) {
+        wasiErrno = errnoToWasi(errno);
+        return -1;
+    }
+
+    return bytesRead;
+}
+
+ssize_t FileDescriptor::pwrite(std::vector<::iovec>& nativeIovecs,
+                               int iovecCount,
+                               uint64_t offset)
+{
+    uint64_t len = iovecsLength(nativeIovecs, iovecCount);
+    int64_t reserved = reserveOverlayGrowth((int64_t)offset, len);
+    if (reserved < 0) {
+        return -1;
+    }
+
+    IoUring* ring = getIoRing();
+    ssize_t bytesWritten =
+      ring != nullptr
+        ? ring->writev(linuxFd, nativeIovecs.data(), iovecCount, offset)
+        : ::pwritev(linuxFd, nativeIovecs.data(), iovecCount, (off_t)offset);
+
+    if (bytesWritten < 0) {
+        SPDLOG_ERROR("pwritev failed on fd {}: {}", linuxFd, strerror(errno));
+        wasiErrno = errnoToWasi(errno);
+        releaseOverlayGrowth(reserved, len, 0);
+        return -1;
+    }
+
+    releaseOverlayGrowth(reserved, len, bytesWritten);
+
+    if (SharedFiles::isPathShared(path)) {
+        SharedFiles::updateSharedFile(path);
+    } else {
+        invalidateCachedContents();
+    }
+
+    return bytesWritten;
+}
+
+bool FileDescriptor::sync(bool dataOnly)
+{
+    IoUring* ring = getIoRing();
+    int res = 0;
+    if (ring != nullptr) {
+        res = ring->fsync(linuxFd, dataOnly);
+    } else {
+        res = dataOnly ? ::fdatasync(linuxFd) : ::fsync(linuxFd);
+    }
+
+    if (res != 0) {
+        wasiErrno = errnoToWasi(errno);
+        return false;
+    }
+
+    return true;
+}
+
+bool FileDescriptor::allocate(uint64_t offset, uint64_t len)
+{
+    int64_t reserved = reserveOverlayGrowth((int64_t)offset, len);
+    if (reserved < 0) {
+        return false;
+    }
+
+    // Note that posix_fallocate returns the error rather than setting errno
+    int res = ::posix_fallocate(linuxFd, (off_t)offset, (off_t)len);
+    if (res != 0) {
+        wasiErrno = errnoToWasi(res);
+        releaseOverlayGrowth(reserved, len, 0);
+        return false;
+    }
+
+    invalidateCachedContents();
+
+    return true;
+}
+
+bool FileDescriptor::truncate(uint64_t size)
+{
+    // Growing needs space claiming up front, shrinking gives it back after
+    uint64_t oldSize = 0;
+    int64_t reserved = 0;
+    if (isInOverlay(path)) {
+        oldSize = overlayFileSize(realPathFor(path));
+        reserved = reserveOverlayGrowth(0, size);
+        if (reserved < 0) {
+            return false;
+        }
+    }
+
+    int res = ::ftruncate(linuxFd, (off_t)size);
+    if (res != 0) {
+        wasiErrno = errnoToWasi(errno);
+        releaseOverlayGrowth(reserved, size, 0);
+        return false;
+    }
+
+    if (size < oldSize) {
+        overlay->release(oldSize - size);
+    }
+
+    if (SharedFiles::isPathShared(path)) {
+        SharedFiles::updateSharedFile(path);
+    } else {
+        invalidateCachedPath();
+    }
+
+    return true;
+}
+
+static struct timespec wasiTimeToTimespec(uint64_t time,
+                                          bool set,
+                                          bool setNow)
+{
+    struct timespec ts
+    {};
+
+    if (setNow) {
+        ts.tv_nsec = UTIME_NOW;
+    } else if (set) {
+        ts.tv_sec = (time_t)(time / 1000000000);
+        ts.tv_nsec = (long)(time % 1000000000);
+    } else {
+        ts.tv_nsec = UTIME_OMIT;
+    }
+
+    return ts;
+}
+
+bool FileDescriptor::setTimes(const std::string& relativePath,
+                              uint64_t accessTime,
+                              uint64_t modTime,
+                              uint16_t fstFlags,
+                              bool followSymlinks)
+{
+    struct timespec times[2];
+    times[0] = wasiTimeToTimespec(accessTime,
+                                  fstFlags & __WASI_FILESTAT_SET_ATIM,
+                                  fstFlags & __WASI_FILESTAT_SET_ATIM_NOW);
+    times[1] = wasiTimeToTimespec(modTime,
+                                  fstFlags & __WASI_FILESTAT_SET_MTIM,
+                                  fstFlags & __WASI_FILESTAT_SET_MTIM_NOW);
+
+    int res;
+    if (relativePath.empty()) {
+        res = ::futimens(linuxFd, times);
+    } else {
+        std::string fullPath = absPath(relativePath);
+        if (SharedFiles::isPathShared(fullPath)) {
+            wasiErrno = errnoToWasi(ENOTSUP);
+            return false;
+        }
+
+        std::string maskedPath = realPathFor(fullPath);
+        int flags = followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+        res = ::utimensat(AT_FDCWD, maskedPath.c_str(), times, flags);
+    }
+
+    if (res != 0) {
+        wasiErrno = errnoToWasi(errno);
+        return false;
+    }
+
+    invalidateCachedPath(relativePath);
+
+    return true;
+}
+
+bool FileDescriptor::link(const std::string& newPath,
+                          const std::string& relativePath)
+{
+    std::string fullPath = absPath(relativePath);
+    if (SharedFiles::isPathShared(fullPath) ||
+        SharedFiles::isPathShared(newPath)) {
+        SPDLOG_ERROR("Hard links on shared files not supported ({} -> {})",
+                     fullPath,
+                     newPath);
+        wasiErrno = errnoToWasi(ENOTSUP);
+        return false;
+    }
+
+    // The overlay is a separate filesystem, so like any other mount point
+    // links can't cross into or out of it
+    if (isInOverlay(fullPath) != isInOverlay(newPath)) {
+        wasiErrno = errnoToWasi(EXDEV);
+        return false;
+    }
+
+    std::string fullOldPath = realPathFor(fullPath);
+    std::string fullNewPath = realPathFor(newPath);
+
+    int res = ::link(fullOldPath.c_str(), fullNewPath.c_str());
+    if (res != 0) {
+        wasiErrno = errnoToWasi(errno);
+        return false;
+    }
+
+    // The link count of the original changes too
+    if (pathCache != nullptr) {
+        pathCache->invalidate(fullOldPath);
+        pathCache->invalidate(fullNewPath);
+    }
+
+    return true;
+}
+
+bool FileDescriptor::symlink(const std::string& target,
+                             const std::string& relativePath)
+{
+    std::string fullPath = absPath(relativePath);
+    if (SharedFiles::isPathShared(fullPath) ||
+        SharedFiles::isPathShared(target)) {
+        SPDLOG_ERROR("Symlinks on shared files not supported ({} -> {})",
+                     fullPath,
+                     target);
+        wasiErrno = errnoToWasi(ENOTSUP);
+        return false;
+    }
+
+    // Relative targets resolve against the link's directory, so only absolute
+    // targets need masking to keep them inside the runtime root
+    std::string maskedTarget = target;
+    if (!target.empty() && target.front() == '/') {
+        maskedTarget = realPathFor(target);
+    }
+
+    std::string linkPath = realPathFor(fullPath);
+    int res = ::symlink(maskedTarget.c_str(), linkPath.c_str());
+    if (res != 0) {
+        wasiErrno = errnoToWasi(errno);
+        return false;
+    }
+
+    if (pathCache != nullptr) {
+        pathCache->invalidate(linkPath);
+    }
+
+    return true;
+}
+
+void FileDescriptor::setPathCache(PathCache* pathCacheIn)
+{
+    pathCache = pathCacheIn;
+}
+
+void FileDescriptor::invalidateCachedPath(const std::string& relativePath)
+{
+    // Nothing to do for the standard streams
+    if (pathCache == nullptr ||
+        (relativePath.empty() && linuxFd <= STDERR_FILENO)) {
+        return;
+    }
+
+    std::string fullPath = absPath(relativePath);
+    if (SharedFiles::isPathShared(fullPath)) {
+        return;
+    }
+
+    pathCache->invalidate(realPathFor(fullPath));
+}
+
+void FileDescriptor::invalidateCachedContents()
+{
+    if (pathCache == nullptr || linuxFd <= STDERR_FILENO) {
+        return;
+    }
+
+    pathCache->invalidateContents(realPathFor(path));
+}
+
+void FileDescriptor::setOverlay(MemoryOverlay* overlayIn)
+{
+    overlay = overlayIn;
+}
+
+std::string FileDescriptor::realPathFor(const std::string& guestPath) const
+{
+    if (isInOverlay(guestPath)) {
+        return overlay->realPath(guestPath);
+    }
+
+    return prependRuntimeRoot(guestPath);
+}
+
+bool FileDescriptor::isInOverlay(const std::string& guestPath) const
+{
+    return overlay != nullptr && overlay->covers(guestPath);
+}
+
+// Claims overlay space for writing len bytes at the given offset (or the
+// current position if negative) to this file. Returns the bytes claimed, or
+// -1 with ENOSPC if the overlay is full
+int64_t FileDescriptor::reserveOverlayGrowth(int64_t offset, uint64_t len)
+{
+    if (!isInOverlay(path)) {
+        return 0;
+    }
+
+    struct ::stat nativeStat
+    {};
+    if (::fstat(linuxFd, &nativeStat) != 0) {
+        return 0;
+    }
+
+    if (offset < 0) {
+        offset = (linuxFlags & O_APPEND) ? nativeStat.st_size
+                                         : ::lseek(linuxFd, 0, SEEK_CUR);
+    }
+
+    uint64_t newEnd = (uint64_t)offset + len;
+    if (offset < 0 || newEnd <= (uint64_t)nativeStat.st_size) {
+        return 0;
+    }
+
+    uint64_t growth = newEnd - nativeStat.st_size;
+    if (!overlay->reserve(growth)) {
+        wasiErrno = errnoToWasi(ENOSPC);
+        return -1;
+    }
+
+    return (int64_t)growth;
+}
+
+// Gives back whatever a reservation didn't end up using. Falling k bytes
+// short of the requested length shrinks the growth by up to k bytes
+void FileDescriptor::releaseOverlayGrowth(int64_t reserved,
+                                          uint64_t len,
+                                          ssize_t done)
+{
+    if (reserved <= 0) {
+        return;
+    }
+
+    uint64_t written = done > 0 ? std::min<uint64_t>(len, done) : 0;
+    uint64_t shortfall = len - written;
+    overlay->release(std::min<uint64_t>((uint64_t)reserved, shortfall));
+}
+
 void FileDescriptor::close() const
 {
     if (linuxFd > 0) {
         ::close(linuxFd);
     }
+
+    if (dirStreamFd >= 0) {
+        ::close(dirStreamFd);
+    }
 }
 
 bool FileDescriptor::unlink(const std::string& relativePath)
@@ -534,13 +1113,23 @@ bool FileDescriptor::unlink(const std::string& relativePath)
         SharedFiles::deleteSharedFile(relativePath);
     } else {
         std::string fullPath = absPath(relativePath);
-        const std::string maskedPath = prependRuntimeRoot(fullPath);
-        int res = ::unlink(maskedPath.c_str());
+        const std::string maskedPath = realPathFor(fullPath);
+        uint64_t overlayFreed =
+          isInOverlay(fullPath) ? overlayFileSize(maskedPath) : 0;
 
+        int res = ::unlink(maskedPath.c_str());
         if (res != 0) {
             wasiErrno = errnoToWasi(errno);
             return false;
         }
+
+        if (overlayFreed > 0) {
+            overlay->release(overlayFreed);
+        }
+
+        if (pathCache != nullptr) {
+            pathCache->invalidate(maskedPath);
+        }
     }
 
     return true;
@@ -549,7 +1138,7 @@ bool FileDescriptor::unlink(const std::string& relativePath)
 bool FileDescriptor::rmdir(const std::string& relativePath)
 {
     std::string fullPath = absPath(relativePath);
-    const std::string maskedPath = prependRuntimeRoot(fullPath);
+    const std::string maskedPath = realPathFor(fullPath);
     int res = ::rmdir(maskedPath.c_str());
 
     if (res != 0) {
@@ -557,6 +1146,10 @@ bool FileDescriptor::rmdir(const std::string& relativePath)
         return false;
     }
 
+    if (pathCache != nullptr) {
+        pathCache->invalidateTree(maskedPath);
+    }
+
     return true;
 }
 
@@ -564,8 +1157,17 @@ bool FileDescriptor::rename(const std::string& newPath,
                             const std::string& relativePath)
 {
     std::string fullPath = absPath(relativePath);
-    std::string fullOldPath = prependRuntimeRoot(fullPath);
-    std::string fullNewPath = prependRuntimeRoot(newPath);
+    if (isInOverlay(fullPath) != isInOverlay(newPath)) {
+        wasiErrno = errnoToWasi(EXDEV);
+        return false;
+    }
+
+    std::string fullOldPath = realPathFor(fullPath);
+    std::string fullNewPath = realPathFor(newPath);
+
+    // Renaming over an existing file in the overlay frees its space
+    uint64_t overlayFreed =
+      isInOverlay(newPath) ? overlayFileSize(fullNewPath) : 0;
 
     int res = ::rename(fullOldPath.c_str(), fullNewPath.c_str());
 
@@ -574,6 +1176,16 @@ bool FileDescriptor::rename(const std::string& newPath,
         return false;
     }
 
+    if (overlayFreed > 0) {
+        overlay->release(overlayFreed);
+    }
+
+    // Either side may be a directory, so drop anything cached beneath them
+    if (pathCache != nullptr) {
+        pathCache->invalidateTree(fullOldPath);
+        pathCache->invalidateTree(fullNewPath);
+    }
+
     return true;
 }
 
@@ -583,6 +1195,7 @@ Stat FileDescriptor::stat(const std::string& relativePath)
     {};
 
     int statErrno = 0;
+    bool isCacheable = false;
     if (linuxFd == STDOUT_FILENO || linuxFd == STDIN_FILENO ||
         linuxFd == STDERR_FILENO) {
         int result = ::fstat(linuxFd, &nativeStat);
@@ -599,16 +1212,23 @@ Stat FileDescriptor::stat(const std::string& relativePath)
                 realPath = SharedFiles::realPathForSharedFile(statPath);
             }
         } else {
-            realPath = prependRuntimeRoot(statPath);
+            realPath = realPathFor(statPath);
+            isCacheable = pathCache != nullptr;
         }
 
-        // Do the actual stat
-        int result;
-        if (!realPath.empty()) {
-            result = ::stat(realPath.c_str(), &nativeStat);
+        // Do the actual stat, unless we've already got the result
+        if (isCacheable &&
+            pathCache->getStat(realPath, nativeStat, statErrno)) {
+            SPDLOG_TRACE("Using cached stat for {}", realPath);
+        } else if (!realPath.empty()) {
+            int result = ::stat(realPath.c_str(), &nativeStat);
             if (result < 0) {
                 statErrno = errno;
             }
+
+            if (isCacheable) {
+                pathCache->putStat(realPath, nativeStat, statErrno);
+            }
         }
     }
 
@@ -656,7 +1276,7 @@ ssize_t FileDescriptor::readLink(const std::string& relativePath,
                                  char* buffer,
                                  size_t bufferLen)
 {
-    std::string linkPath = prependRuntimeRoot(absPath(relativePath));
+    std::string linkPath = realPathFor(absPath(relativePath));
 
     if (SharedFiles::isPathShared(linkPath)) {
         SPDLOG_ERROR("Readlink on shared not yet supported ({})", path);
@@ -750,10 +1370,14 @@ int FileDescriptor::duplicate(const FileDescriptor& other)
     rightsSet = other.rightsSet;
     actualRightsBase = other.actualRightsBase;
     actualRightsInheriting = other.actualRightsInheriting;
+    pathCache = other.pathCache;
+    overlay = other.overlay;
 
-    dirContentsLoaded = other.dirContentsLoaded;
-    dirContents = other.dirContents;
-    dirContentsIdx = other.dirContentsIdx;
+    // Don't share the directory stream, the duplicate opens its own and
+    // resumes from the same cookie
+    if (other.dirStreamFd >= 0) {
+        iterSeek(other.dirCookie);
+    }
 
     return linuxFd;
 }
@@ -3,11 +3,14 @@
 #include <storage/SharedFiles.h>
 
 #include <faabric/util/bytes.h>
+#include <faabric/util/clock.h>
 #include <faabric/util/config.h>
 #include <faabric/util/files.h>
 #include <faabric/util/func.h>
+#include <faabric/util/gids.h>
 #include <faabric/util/testing.h>
 
+#include <chrono>
 #include <filesystem>
 #include <stdexcept>
 
@@ -21,12 +24,26 @@ namespace storage {
 
 #define FUNC_FILENAME "function.wasm"
 #define FUNC_OBJECT_FILENAME "function.wasm.o"
+#define FUNC_LIMITS_FILENAME "function.limits"
 #define PYTHON_FUNCTION_FILENAME "function.py"
+#define PYTHON_PREFETCH_FILENAME "function.prefetch"
+#define PYTHON_VERSION_FILENAME "function.version"
 #define FUNC_ENCRYPTED_FILENAME "function.wasm.enc"
 #define FUNCTION_SYMBOLS_FILENAME "function.symbols"
 #define WAMR_AOT_FILENAME "function.aot"
 #define SGX_WAMR_AOT_FILENAME "function.aot.sgx"
 
+// Cached artifacts may be memory-mapped by running modules, so replace them
+// with a rename rather than truncating and rewriting in place
+static void writeCacheFile(const std::string& localCachePath,
+                           const std::vector<uint8_t>& bytes)
+{
+    std::string tmpPath =
+      fmt::format("{}.{}.tmp", localCachePath, faabric::util::generateGid());
+    writeBytesToFile(tmpPath, bytes);
+    std::filesystem::rename(tmpPath, localCachePath);
+}
+
 static int removeAllInside(const std::filesystem::path& dir)
 {
     int removedItemsCount = 0;
@@ -114,11 +131,13 @@ static std::filesystem::path getDir(std::string baseDir,
 
 FileLoader::FileLoader()
   : conf(conf::getFaasmConfig())
+  , storageBackend(createStorageBackend())
   , useLocalFsCache(true)
 {}
 
 FileLoader::FileLoader(bool useLocalFsCacheIn)
   : conf(conf::getFaasmConfig())
+  , storageBackend(createStorageBackend())
   , useLocalFsCache(useLocalFsCacheIn)
 {}
 
@@ -177,35 +196,57 @@ std::vector<uint8_t> FileLoader::loadFileBytes(
         return readFileToBytes(localCachePath);
     }
 
-    // Load from S3 if not found
+    // Load from the object store if not found
     std::string pathCopy = trimLeadingSlashes(path);
     std::vector<uint8_t> bytes =
-      s3.getKeyBytes(conf.s3Bucket, pathCopy, tolerateMissing);
+      storageBackend->getKeyBytes(conf.s3Bucket, pathCopy, tolerateMissing);
 
     if (!bytes.empty() && useLocalFsCache) {
         SPDLOG_TRACE("Caching S3 key {}/{} at {}",
                      conf.s3Bucket,
                      pathCopy,
                      localCachePath);
-        writeBytesToFile(localCachePath, bytes);
+        writeCacheFile(localCachePath, bytes);
     }
 
     return bytes;
 }
 
+MappedFile FileLoader::mapFileBytes(const std::string& path,
+                                    const std::string& localCachePath)
+{
+    // Without a local cache there is no file to map
+    if (!useLocalFsCache) {
+        return MappedFile(loadFileBytes(path, localCachePath));
+    }
+
+    // Make sure the file is in the local cache, then map it from there. The
+    // bytes loaded here are only needed if the file wasn't cached already
+    if (!std::filesystem::exists(localCachePath)) {
+        loadFileBytes(path, localCachePath);
+    } else if (std::filesystem::is_directory(localCachePath)) {
+        SPDLOG_ERROR("Local cache path ({}) exists but is a directory",
+                     localCachePath);
+        throw SharedFileIsDirectoryException(localCachePath);
+    }
+
+    SPDLOG_TRACE("Mapping {} from filesystem at {}", path, localCachePath);
+    return MappedFile(localCachePath);
+}
+
 void FileLoader::uploadFileBytes(const std::string& path,
                                  const std::string& localCachePath,
                                  const std::vector<uint8_t>& bytes)
 {
     std::string pathCopy = trimLeadingSlashes(path);
-    s3.addKeyBytes(conf.s3Bucket, pathCopy, bytes);
+    storageBackend->addKeyBytes(conf.s3Bucket, pathCopy, bytes);
 
     if (useLocalFsCache && !localCachePath.empty()) {
         SPDLOG_TRACE("Caching S3 key {}/{} at {}",
                      conf.s3Bucket,
                      pathCopy,
                      localCachePath);
-        writeBytesToFile(localCachePath, bytes);
+        writeCacheFile(localCachePath, bytes);
     }
 }
 
@@ -216,14 +257,14 @@ void FileLoader::uploadFileString(const std::string& path,
     SPDLOG_TRACE("Uploading file string {} ({})", path, localCachePath);
 
     std::string pathCopy = trimLeadingSlashes(path);
-    s3.addKeyStr(conf.s3Bucket, pathCopy, bytes);
+    storageBackend->addKeyStr(conf.s3Bucket, pathCopy, bytes);
 
     if (useLocalFsCache && !localCachePath.empty()) {
         SPDLOG_TRACE("Caching S3 key {}/{} at {}",
                      conf.s3Bucket,
                      pathCopy,
                      localCachePath);
-        writeBytesToFile(localCachePath, stringToBytes(bytes));
+        writeCacheFile(localCachePath, stringToBytes(bytes));
     }
 }
 
@@ -280,6 +321,60 @@ void FileLoader::uploadFunction(faabric::Message& msg)
     uploadFileString(key, localCachePath, inputBytes);
 }
 
+// -------------------------------------
+// FUNCTION LIMITS
+// -------------------------------------
+
+std::string FileLoader::getFunctionLimitsFile(const faabric::Message& msg)
+{
+    auto path = getDir(conf.functionDir, msg, true);
+    path.append(FUNC_LIMITS_FILENAME);
+    return path.string();
+}
+
+// Whether an empty cache file was written recently enough to still count
+static bool isMissMarkerValid(const std::string& localCachePath)
+{
+    // As with shared files, zero means misses are cached forever
+    long ttlMs = conf::getFaasmConfig().sharedFilesNegativeTtlMs;
+    if (ttlMs <= 0) {
+        return true;
+    }
+
+    auto age = std::filesystem::file_time_type::clock::now() -
+               std::filesystem::last_write_time(localCachePath);
+    return age < std::chrono::milliseconds(ttlMs);
+}
+
+/**
+ * Functions can optionally ship resource limits alongside their wasm. Most
+ * don't, so a missing file gives an empty string rather than an error.
+ *
+ * This is checked on every invocation, so misses are cached locally as an
+ * empty file, which expires like a missing shared file.
+ */
+std::string FileLoader::loadFunctionLimits(const faabric::Message& msg)
+{
+    const std::string key = getKey(msg, FUNC_LIMITS_FILENAME);
+    const std::string localCachePath = getFunctionLimitsFile(msg);
+
+    if (useLocalFsCache && std::filesystem::is_regular_file(localCachePath) &&
+        std::filesystem::file_size(localCachePath) == 0) {
+        if (isMissMarkerValid(localCachePath)) {
+            return "";
+        }
+
+        std::filesystem::remove(localCachePath);
+    }
+
+    std::vector<uint8_t> bytes = loadFileBytes(key, localCachePath, true);
+    if (bytes.empty() && useLocalFsCache) {
+        writeCacheFile(localCachePath, bytes);
+    }
+
+    return std::string(bytes.begin(), bytes.end());
+}
+
 // -------------------------------------
 // FUNCTION OBJECT FILES
 // -------------------------------------
@@ -356,6 +451,13 @@ std::vector<uint8_t> FileLoader::loadFunctionWamrAotFile(
     return loadFileBytes(key, localCachePath);
 }
 
+MappedFile FileLoader::mapFunctionWamrAotFile(const faabric::Message& msg)
+{
+    const std::string key = getWamrAotKey(msg);
+    const std::string localCachePath = getFunctionAotFile(msg);
+    return mapFileBytes(key, localCachePath);
+}
+
 std::vector<uint8_t> FileLoader::loadFunctionWamrAotHash(
   const faabric::Message& msg)
 {
@@ -496,12 +598,38 @@ std::vector<uint8_t> FileLoader::loadSharedFile(const std::string& path)
     return bytes;
 }
 
+std::vector<std::string> FileLoader::listSharedFiles(const std::string& dirPath)
+{
+    // Make sure we only match keys inside the directory, not siblings that
+    // share the same prefix
+    std::string prefix = trimLeadingSlashes(dirPath);
+    if (!prefix.empty() && prefix.back() != '/') {
+        prefix += "/";
+    }
+
+    std::vector<std::string> keys =
+      storageBackend->listKeys(conf.s3Bucket, prefix);
+
+    std::vector<std::string> files;
+    for (const auto& k : keys) {
+        // Skip directory placeholders
+        if (k.empty() || k.back() == '/') {
+            continue;
+        }
+
+        files.emplace_back(k);
+    }
+
+    SPDLOG_TRACE("Listed {} shared files under {}", files.size(), prefix);
+    return files;
+}
+
 void FileLoader::deleteSharedFile(const std::string& path)
 {
     std::string pathCopy = trimLeadingSlashes(path);
     SPDLOG_TRACE(
       "Deleting shared file {} in S3 at {}/{}", path, conf.s3Bucket, pathCopy);
-    s3.deleteKey(conf.s3Bucket, pathCopy);
+    storageBackend->deleteKey(conf.s3Bucket, pathCopy);
 
     const std::string localCachePath = getSharedFileFile(path);
     if (useLocalFsCache && !localCachePath.empty()) {
@@ -561,11 +689,50 @@ std::string FileLoader::getPythonFunctionFile(const faabric::Message& msg)
     return getSharedFileFile(getPythonFunctionRelativePath(msg));
 }
 
+std::string FileLoader::getPythonFunctionPrefetchRelativePath(
+  const faabric::Message& msg)
+{
+    // The prefetch manifest lives next to the function's source
+    std::filesystem::path path(getPythonFunctionRelativePath(msg));
+    path.replace_filename(PYTHON_PREFETCH_FILENAME);
+    return path.string();
+}
+
+std::string FileLoader::getPythonFunctionVersionRelativePath(
+  const faabric::Message& msg)
+{
+    std::filesystem::path path(getPythonFunctionRelativePath(msg));
+    path.replace_filename(PYTHON_VERSION_FILENAME);
+    return path.string();
+}
+
+std::string FileLoader::loadPythonFunctionVersion(const faabric::Message& msg)
+{
+    // Always go to the object store, a locally cached copy would hide uploads
+    // made through other hosts
+    std::string key = getPythonFunctionVersionRelativePath(msg);
+    std::vector<uint8_t> bytes =
+      storageBackend->getKeyBytes(conf.s3Bucket, key, true);
+
+    return std::string(bytes.begin(), bytes.end());
+}
+
 void FileLoader::uploadPythonFunction(faabric::Message& msg)
 {
     // Note that Python functions are handled like shared files
     const std::string relativePath = getPythonFunctionRelativePath(msg);
     const std::string localCachePath = getSharedFileFile(relativePath);
     uploadFileString(relativePath, localCachePath, msg.inputdata());
+
+    // Record a new version alongside the function, so that every host can
+    // tell its synced copy is stale
+    std::string version =
+      fmt::format("{}-{}",
+                  faabric::util::getGlobalClock().epochMillis(),
+                  faabric::util::generateGid());
+    uploadFileString(getPythonFunctionVersionRelativePath(msg), "", version);
+
+    // Make sure modules on this host pick up the new version straight away
+    SharedFiles::invalidatePythonFunctionFile(msg);
 }
 }
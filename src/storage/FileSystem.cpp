@@ -4,29 +4,92 @@
 #include <conf/FaasmConfig.h>
 
 #include <WASI/WASIPrivate.h>
+#include <algorithm>
 #include <boost/filesystem.hpp>
+#include <functional>
+#include <unistd.h>
 
 #include <faabric/util/config.h>
 #include <faabric/util/logging.h>
 
 namespace storage {
+FileSystem::FileSystem()
+  : pathCache(std::make_unique<PathCache>())
+{}
+
+FileSystem::FileSystem(const FileSystem& other)
+  : FileSystem()
+{
+    *this = other;
+}
+
+FileSystem::~FileSystem()
+{
+    tearDown();
+}
+
+FileSystem& FileSystem::operator=(const FileSystem& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+
+    tearDown();
+
+    // Point the copied descriptors at our own (empty) cache and overlay. WAVM
+    // resets by cloning its cached module, so this is what drops the
+    // previous invocation's overlay there (WAMR goes through
+    // prepareFilesystem instead)
+    pathCache->clear();
+    overlay = other.overlay != nullptr ? createMemoryOverlay() : nullptr;
+
+    // Each copy owns its host fds, so that closing one in a copy doesn't
+    // close it under the original and its other copies. Stdio is shared
+    freeFds = other.freeFds;
+    for (int fd = 0; fd < (int)other.fdTable.size(); fd++) {
+        const FdSlot& otherSlot = other.fdTable[fd];
+        FdSlot& slot = fdTable.emplace_back();
+        slot.inUse = otherSlot.inUse;
+        slot.preopened = otherSlot.preopened;
+
+        if (!slot.inUse) {
+            continue;
+        }
+
+        if (fd <= STDERR_FILENO) {
+            slot.fileDesc = otherSlot.fileDesc;
+        } else {
+            slot.fileDesc.duplicate(otherSlot.fileDesc);
+            slot.fileDesc.wasiPreopenType = otherSlot.fileDesc.wasiPreopenType;
+        }
+
+        slot.fileDesc.setPathCache(pathCache.get());
+        slot.fileDesc.setOverlay(overlay.get());
+    }
+
+    return *this;
+}
+
 void FileSystem::prepareFilesystem()
 {
-    // Clear existing file descriptors if any
-    fileDescriptors.clear();
+    // Close existing file descriptors if any
+    tearDown();
+    pathCache->clear();
+
+    // Start with an empty overlay, dropping anything written to the old one
+    overlay = createMemoryOverlay();
 
     // Predefined stdin, stdout and stderr
-    fileDescriptors.emplace(0, storage::FileDescriptor::stdinFactory());
-    fileDescriptors.emplace(1, storage::FileDescriptor::stdoutFactory());
-    fileDescriptors.emplace(2, storage::FileDescriptor::stderrFactory());
+    claimFd(0) = storage::FileDescriptor::stdinFactory();
+    claimFd(1) = storage::FileDescriptor::stdoutFactory();
+    claimFd(2) = storage::FileDescriptor::stderrFactory();
 
     // Add roots, note that they are predefined as the file descriptors
     // just above the stdxxx's (i.e. > 3)
+    // Subsequent file descriptors reuse the lowest free fd, or go on the end
+    // of the table if none are free
     createPreopenedFileDescriptor(3, "/");
     createPreopenedFileDescriptor(4, ".");
-
-    // Set the starting point for subsequent file descriptors
-    nextFd = 5;
 }
 
 void FileSystem::createPreopenedFileDescriptor(int fd, const std::string& path)
@@ -34,6 +97,8 @@ void FileSystem::createPreopenedFileDescriptor(int fd, const std::string& path)
     // Open the descriptor as a directory
     storage::FileDescriptor fileDesc;
     fileDesc.setPath(path);
+    fileDesc.setPathCache(pathCache.get());
+    fileDesc.setOverlay(overlay.get());
     fileDesc.setActualRights(DIRECTORY_RIGHTS, INHERITING_DIRECTORY_RIGHTS);
 
     bool success = fileDesc.pathOpen(0, __WASI_O_DIRECTORY, 0);
@@ -53,24 +118,74 @@ void FileSystem::createPreopenedFileDescriptor(int fd, const std::string& path)
 
     // Add to this module's fds
     fileDesc.wasiPreopenType = __WASI_PREOPENTYPE_DIR;
-    fileDescriptors.emplace(fd, fileDesc);
+    claimFd(fd) = fileDesc;
+    fdTable[fd].preopened = true;
 }
 
 int FileSystem::getNewFd()
 {
-    // Assign a new file descriptor
-    int thisFd = nextFd;
-    nextFd++;
+    // Reuse the lowest freed fd if there is one
+    if (!freeFds.empty()) {
+        std::pop_heap(freeFds.begin(), freeFds.end(), std::greater<int>());
+        int thisFd = freeFds.back();
+        freeFds.pop_back();
+
+        claimFd(thisFd);
+        return thisFd;
+    }
+
+    int thisFd = (int)fdTable.size();
+    claimFd(thisFd);
     return thisFd;
 }
 
+FileDescriptor& FileSystem::claimFd(int fd)
+{
+    // Any slots we skip over are free for later
+    while ((int)fdTable.size() <= fd) {
+        int skippedFd = (int)fdTable.size();
+        fdTable.emplace_back();
+
+        if (skippedFd != fd) {
+            freeFds.push_back(skippedFd);
+            std::push_heap(freeFds.begin(), freeFds.end(), std::greater<int>());
+        }
+    }
+
+    FdSlot& slot = fdTable[fd];
+    if (!slot.inUse) {
+        // Take it off the free list if it's there (only on explicit claims)
+        auto it = std::find(freeFds.begin(), freeFds.end(), fd);
+        if (it != freeFds.end()) {
+            freeFds.erase(it);
+            std::make_heap(freeFds.begin(), freeFds.end(), std::greater<int>());
+        }
+    }
+
+    slot.inUse = true;
+    slot.preopened = false;
+    slot.fileDesc = FileDescriptor();
+
+    return slot.fileDesc;
+}
+
+void FileSystem::releaseFd(int fd)
+{
+    FdSlot& slot = fdTable[fd];
+    slot.inUse = false;
+    slot.fileDesc = FileDescriptor();
+
+    freeFds.push_back(fd);
+    std::push_heap(freeFds.begin(), freeFds.end(), std::greater<int>());
+}
+
 std::string FileSystem::getPathForFd(int fd)
 {
-    if (fileDescriptors.count(fd) == 0) {
+    if (!fileDescriptorExists(fd)) {
         return "";
     }
 
-    return fileDescriptors[fd].getPath();
+    return fdTable[fd].fileDesc.getPath();
 }
 
 int FileSystem::openFileDescriptor(int rootFd,
@@ -97,8 +212,10 @@ int FileSystem::openFileDescriptor(int rootFd,
 
     // Initialise the new fd
     int thisFd = getNewFd();
-    FileDescriptor& fileDesc = fileDescriptors[thisFd];
+    FileDescriptor& fileDesc = fdTable[thisFd].fileDesc;
     fileDesc.setPath(fullPath);
+    fileDesc.setPathCache(pathCache.get());
+    fileDesc.setOverlay(overlay.get());
 
     // AND requested rights with those of the root file descriptor. Rights for
     // this file descriptor are only permitted if they can be inherited, and
@@ -114,7 +231,9 @@ int FileSystem::openFileDescriptor(int rootFd,
     // Open the path
     bool success = fileDesc.pathOpen(lookupFlags, openFlags, fdFlags);
     if (!success) {
-        return -1 * fileDesc.getWasiErrno();
+        int wasiErrno = fileDesc.getWasiErrno();
+        releaseFd(thisFd);
+        return -1 * wasiErrno;
     }
 
     return thisFd;
@@ -122,44 +241,85 @@ int FileSystem::openFileDescriptor(int rootFd,
 
 bool FileSystem::fileDescriptorExists(int fd)
 {
-    return fileDescriptors.count(fd) > 0;
+    return fd >= 0 && fd < (int)fdTable.size() && fdTable[fd].inUse;
 }
 
 storage::FileDescriptor& FileSystem::getFileDescriptor(int fd)
 {
-    if (fileDescriptors.count(fd) == 0) {
+    if (!fileDescriptorExists(fd)) {
         throw std::runtime_error("File descriptor does not exist");
     }
 
-    return fileDescriptors.at(fd);
+    return fdTable[fd].fileDesc;
 }
 
 int FileSystem::dup(int fd)
 {
-    int newFd = getNewFd();
-
     FileDescriptor& originalDesc = getFileDescriptor(fd);
-    FileDescriptor& newDesc = fileDescriptors[newFd];
+
+    int newFd = getNewFd();
+    FileDescriptor& newDesc = fdTable[newFd].fileDesc;
     newDesc.duplicate(originalDesc);
 
     return newFd;
 }
 
+bool FileSystem::closeFileDescriptor(int fd)
+{
+    if (!fileDescriptorExists(fd)) {
+        return false;
+    }
+
+    if (fd <= STDERR_FILENO || fdTable[fd].preopened) {
+        return true;
+    }
+
+    fdTable[fd].fileDesc.close();
+    releaseFd(fd);
+
+    return true;
+}
+
 void FileSystem::tearDown()
 {
-    for (auto& f : fileDescriptors) {
-        // Only close non-preopened fds
-        if (f.second.wasiPreopenType != __WASI_PREOPENTYPE_DIR) {
-            f.second.close();
+    // Closes every host fd this filesystem owns, including preopens, and
+    // empties the table. Stdio isn't ours to close
+    for (int fd = STDERR_FILENO + 1; fd < (int)fdTable.size(); fd++) {
+        if (fdTable[fd].inUse) {
+            fdTable[fd].fileDesc.close();
         }
     }
+
+    fdTable.clear();
+    freeFds.clear();
+}
+
+void FileSystem::clearPathCache()
+{
+    pathCache->clear();
+}
+
+std::string FileSystem::realPathFor(const std::string& guestPath)
+{
+    if (overlay != nullptr && overlay->covers(guestPath)) {
+        return overlay->realPath(guestPath);
+    }
+
+    return prependRuntimeRoot(guestPath);
+}
+
+MemoryOverlay* FileSystem::getOverlay()
+{
+    return overlay.get();
 }
 
 void FileSystem::printDebugInfo()
 {
     printf("--- Open file descriptors ---\n");
-    for (auto& p : fileDescriptors) {
-        printf("    %s\n", p.second.getPath().c_str());
+    for (int fd = 0; fd < (int)fdTable.size(); fd++) {
+        if (fdTable[fd].inUse) {
+            printf("    %i: %s\n", fd, fdTable[fd].fileDesc.getPath().c_str());
+        }
     }
 }
 
@@ -0,0 +1,242 @@
+#include <storage/IoUring.h>
+
+#include <faabric/util/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace storage {
+
+static int ioUringSetup(unsigned entries, ::io_uring_params* params)
+{
+    return (int)::syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int ringFd,
+                        unsigned toSubmit,
+                        unsigned minComplete,
+                        unsigned flags)
+{
+    return (int)::syscall(
+      __NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+template<typename T>
+static T* ringPtr(void* base, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+IoUring::IoUring()
+{
+    ::io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    ringFd = ioUringSetup(IO_URING_ENTRIES, &params);
+    if (ringFd < 0) {
+        // Only warn once, otherwise every executor thread will log this
+        static std::atomic<bool> warned = false;
+        if (!warned.exchange(true)) {
+            SPDLOG_WARN("io_uring unavailable, using syscalls: {}",
+                        strerror(errno));
+        }
+        return;
+    }
+
+    // We rely on the kernel tracking the file position for plain reads and
+    // writes, and on being able to map both rings at once (both 5.6+)
+    uint32_t requiredFeatures =
+      IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS;
+    if ((params.features & requiredFeatures) != requiredFeatures) {
+        SPDLOG_WARN("io_uring missing required features, using syscalls");
+        release();
+        return;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+    sqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRingPtr = ::mmap(nullptr,
+                       sqRingSize,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE,
+                       ringFd,
+                       IORING_OFF_SQ_RING);
+    if (sqRingPtr == MAP_FAILED) {
+        SPDLOG_WARN("Failed to map io_uring rings: {}", strerror(errno));
+        sqRingPtr = nullptr;
+        release();
+        return;
+    }
+
+    // With a single mapping the completion ring shares the submission one
+    cqRingPtr = sqRingPtr;
+    cqRingSize = 0;
+
+    sqesSize = params.sq_entries * sizeof(::io_uring_sqe);
+    void* sqesPtr = ::mmap(nullptr,
+                           sqesSize,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE,
+                           ringFd,
+                           IORING_OFF_SQES);
+    if (sqesPtr == MAP_FAILED) {
+        SPDLOG_WARN("Failed to map io_uring entries: {}", strerror(errno));
+        release();
+        return;
+    }
+    sqes = static_cast<::io_uring_sqe*>(sqesPtr);
+
+    sqTail = ringPtr<unsigned>(sqRingPtr, params.sq_off.tail);
+    sqMask = ringPtr<unsigned>(sqRingPtr, params.sq_off.ring_mask);
+    sqArray = ringPtr<unsigned>(sqRingPtr, params.sq_off.array);
+
+    cqHead = ringPtr<unsigned>(cqRingPtr, params.cq_off.head);
+    cqTail = ringPtr<unsigned>(cqRingPtr, params.cq_off.tail);
+    cqMask = ringPtr<unsigned>(cqRingPtr, params.cq_off.ring_mask);
+    cqes = ringPtr<::io_uring_cqe>(cqRingPtr, params.cq_off.cqes);
+
+    SPDLOG_DEBUG("Set up io_uring ring (fd {})", ringFd);
+}
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+void IoUring::release()
+{
+    if (sqes != nullptr) {
+        ::munmap(sqes, sqesSize);
+        sqes = nullptr;
+    }
+
+    if (sqRingPtr != nullptr) {
+        ::munmap(sqRingPtr, sqRingSize);
+        sqRingPtr = nullptr;
+        cqRingPtr = nullptr;
+    }
+
+    if (ringFd >= 0) {
+        ::close(ringFd);
+        ringFd = -1;
+    }
+}
+
+::io_uring_sqe* IoUring::getSqe()
+{
+    // Only one request is ever in flight, so there's always a free entry
+    unsigned tail = *sqTail;
+    unsigned idx = tail & *sqMask;
+
+    ::io_uring_sqe* sqe = &sqes[idx];
+    std::memset(sqe, 0, sizeof(::io_uring_sqe));
+    sqArray[idx] = idx;
+
+    return sqe;
+}
+
+long IoUring::submitAndWait()
+{
+    // Publish the entry to the kernel
+    __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+
+    int res;
+    do {
+        res = ioUringEnter(ringFd, 1, 1, IORING_ENTER_GETEVENTS);
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0) {
+        return -errno;
+    }
+
+    // The wait can be interrupted after submission, so keep waiting until
+    // the completion turns up
+    unsigned head = *cqHead;
+    while (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        res = ioUringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (res < 0 && errno != EINTR) {
+            return -errno;
+        }
+    }
+
+    long result = cqes[head & *cqMask].res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+    return result;
+}
+
+static ssize_t toSyscallResult(long res)
+{
+    if (res < 0) {
+        errno = (int)-res;
+        return -1;
+    }
+
+    return res;
+}
+
+ssize_t IoUring::readv(int fd,
+                       const ::iovec* iovecs,
+                       int iovecCount,
+                       uint64_t offset)
+{
+    ::io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (uint64_t)iovecs;
+    sqe->len = iovecCount;
+
+    return toSyscallResult(submitAndWait());
+}
+
+ssize_t IoUring::writev(int fd,
+                        const ::iovec* iovecs,
+                        int iovecCount,
+                        uint64_t offset)
+{
+    ::io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (uint64_t)iovecs;
+    sqe->len = iovecCount;
+
+    return toSyscallResult(submitAndWait());
+}
+
+int IoUring::fsync(int fd, bool dataOnly)
+{
+    ::io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = dataOnly ? IORING_FSYNC_DATASYNC : 0;
+
+    return (int)toSyscallResult(submitAndWait());
+}
+
+IoUring* getThreadIoUring()
+{
+    static thread_local std::unique_ptr<IoUring> ring = nullptr;
+    static thread_local bool setupAttempted = false;
+
+    if (!setupAttempted) {
+        setupAttempted = true;
+        ring = std::make_unique<IoUring>();
+        if (!ring->isReady()) {
+            ring = nullptr;
+        }
+    }
+
+    return ring.get();
+}
+}
@@ -0,0 +1,186 @@
+#include <conf/FaasmConfig.h>
+#include <storage/LocalStorageBackend.h>
+
+#include <faabric/util/bytes.h>
+#include <faabric/util/files.h>
+#include <faabric/util/gids.h>
+#include <faabric/util/logging.h>
+#include <faabric/util/macros.h>
+
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace storage {
+
+LocalStorageBackend::LocalStorageBackend()
+  : LocalStorageBackend(conf::getFaasmConfig().localStorageDir)
+{}
+
+LocalStorageBackend::LocalStorageBackend(const std::string& rootDirIn)
+  : rootDir(rootDirIn)
+{}
+
+std::string LocalStorageBackend::getKeyPath(const std::string& bucketName,
+                                            const std::string& keyName)
+{
+    // Make sure keys can't escape the bucket
+    std::filesystem::path keyPath =
+      std::filesystem::path(keyName).lexically_normal();
+    if (keyPath.is_absolute() || keyPath.empty() || *keyPath.begin() == "..") {
+        SPDLOG_ERROR("Invalid storage key {}/{}", bucketName, keyName);
+        throw std::runtime_error("Invalid storage key");
+    }
+
+    std::filesystem::path p = rootDir / bucketName / keyPath;
+    return p.string();
+}
+
+void LocalStorageBackend::createBucket(const std::string& bucketName)
+{
+    SPDLOG_DEBUG(
+      "Creating local bucket {} in {}", bucketName, rootDir.string());
+    std::filesystem::create_directories(rootDir / bucketName);
+}
+
+void LocalStorageBackend::deleteBucket(const std::string& bucketName)
+{
+    SPDLOG_DEBUG("Deleting local bucket {}", bucketName);
+    std::filesystem::remove_all(rootDir / bucketName);
+}
+
+std::vector<std::string> LocalStorageBackend::listBuckets()
+{
+    std::vector<std::string> bucketNames;
+    if (!std::filesystem::is_directory(rootDir)) {
+        return bucketNames;
+    }
+
+    for (const auto& entry : std::filesystem::directory_iterator(rootDir)) {
+        if (entry.is_directory()) {
+            bucketNames.emplace_back(entry.path().filename().string());
+        }
+    }
+
+    return bucketNames;
+}
+
+std::vector<std::string> LocalStorageBackend::listKeys(
+  const std::string& bucketName,
+  const std::string& prefix)
+{
+    SPDLOG_TRACE("Listing keys in local bucket {} (prefix {})",
+                 bucketName,
+                 prefix);
+
+    std::vector<std::string> keys;
+    std::filesystem::path bucketDir = rootDir / bucketName;
+    if (!std::filesystem::is_directory(bucketDir)) {
+        SPDLOG_WARN("Listing keys of missing bucket {}", bucketName);
+        return keys;
+    }
+
+    for (const auto& entry :
+         std::filesystem::recursive_directory_iterator(bucketDir)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+
+        std::string key =
+          entry.path().lexically_relative(bucketDir).generic_string();
+        if (key.rfind(prefix, 0) == 0) {
+            keys.emplace_back(key);
+        }
+    }
+
+    return keys;
+}
+
+void LocalStorageBackend::deleteKey(const std::string& bucketName,
+                                    const std::string& keyName)
+{
+    SPDLOG_TRACE("Deleting local key {}/{}", bucketName, keyName);
+    std::filesystem::remove(getKeyPath(bucketName, keyName));
+}
+
+void LocalStorageBackend::writeKey(const std::string& bucketName,
+                                   const std::string& keyName,
+                                   const uint8_t* data,
+                                   size_t dataLen)
+{
+    std::filesystem::path keyPath(getKeyPath(bucketName, keyName));
+    std::filesystem::create_directories(keyPath.parent_path());
+
+    // Write to a temporary file and rename into place, so that readers (and
+    // anyone with the file mapped) never see a partially written object
+    std::string tmpPath =
+      fmt::format("{}.{}.tmp", keyPath.string(), faabric::util::generateGid());
+
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        SPDLOG_ERROR("Failed to open {}: {}", tmpPath, strerror(errno));
+        throw std::runtime_error("Failed writing local storage key");
+    }
+
+    size_t written = 0;
+    while (written < dataLen) {
+        ssize_t res = ::write(fd, data + written, dataLen - written);
+        if (res < 0) {
+            SPDLOG_ERROR("Failed to write {}: {}", tmpPath, strerror(errno));
+            ::close(fd);
+            ::unlink(tmpPath.c_str());
+            throw std::runtime_error("Failed writing local storage key");
+        }
+        written += res;
+    }
+    ::close(fd);
+
+    std::filesystem::rename(tmpPath, keyPath);
+}
+
+void LocalStorageBackend::addKeyBytes(const std::string& bucketName,
+                                      const std::string& keyName,
+                                      const std::vector<uint8_t>& data)
+{
+    SPDLOG_TRACE("Writing local key {}/{} as bytes", bucketName, keyName);
+    writeKey(bucketName, keyName, data.data(), data.size());
+}
+
+void LocalStorageBackend::addKeyStr(const std::string& bucketName,
+                                    const std::string& keyName,
+                                    const std::string& data)
+{
+    SPDLOG_TRACE("Writing local key {}/{} as string", bucketName, keyName);
+    writeKey(bucketName, keyName, BYTES_CONST(data.data()), data.size());
+}
+
+std::vector<uint8_t> LocalStorageBackend::getKeyBytes(
+  const std::string& bucketName,
+  const std::string& keyName,
+  bool tolerateMissing)
+{
+    SPDLOG_TRACE("Getting local key {}/{} as bytes", bucketName, keyName);
+    std::string keyPath = getKeyPath(bucketName, keyName);
+
+    if (!std::filesystem::is_regular_file(keyPath)) {
+        if (tolerateMissing) {
+            SPDLOG_TRACE(
+              "Tolerating missing local key {}/{}", bucketName, keyName);
+            return {};
+        }
+
+        SPDLOG_ERROR("Local key {}/{} does not exist", bucketName, keyName);
+        throw std::runtime_error("Local storage key does not exist");
+    }
+
+    return faabric::util::readFileToBytes(keyPath);
+}
+
+std::string LocalStorageBackend::getKeyStr(const std::string& bucketName,
+                                           const std::string& keyName)
+{
+    std::vector<uint8_t> bytes = getKeyBytes(bucketName, keyName);
+    return std::string(bytes.begin(), bytes.end());
+}
+}
@@ -0,0 +1,106 @@
+#include <storage/MappedFile.h>
+
+#include <faabric/util/logging.h>
+
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace storage {
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+    int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SPDLOG_ERROR(
+          "Failed to open {} for mapping: {}", filePath, strerror(errno));
+        throw std::runtime_error("Failed to open file for mapping");
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        SPDLOG_ERROR("Failed to stat {}: {}", filePath, strerror(errno));
+        ::close(fd);
+        throw std::runtime_error("Failed to stat file for mapping");
+    }
+
+    // Zero-length mappings are invalid, leave the view empty
+    if (st.st_size == 0) {
+        ::close(fd);
+        return;
+    }
+
+    // Map writable but private so that consumers which patch the buffer in
+    // place get copy-on-write pages rather than a fault. Untouched pages stay
+    // shared with the page cache
+    void* mem =
+      ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mem == MAP_FAILED) {
+        SPDLOG_ERROR("Failed to map {}: {}", filePath, strerror(errno));
+        throw std::runtime_error("Failed to map file");
+    }
+
+    ptr = static_cast<uint8_t*>(mem);
+    len = st.st_size;
+    mapped = true;
+}
+
+MappedFile::MappedFile(std::vector<uint8_t>&& bytesIn)
+  : bytes(std::move(bytesIn))
+{
+    ptr = bytes.data();
+    len = bytes.size();
+}
+
+MappedFile::~MappedFile()
+{
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this == &other) {
+        return *this;
+    }
+
+    release();
+
+    mapped = other.mapped;
+    len = other.len;
+    bytes = std::move(other.bytes);
+    ptr = mapped ? other.ptr : bytes.data();
+
+    other.ptr = nullptr;
+    other.len = 0;
+    other.mapped = false;
+
+    return *this;
+}
+
+std::vector<uint8_t> MappedFile::toVector() const
+{
+    return std::vector<uint8_t>(ptr, ptr + len);
+}
+
+void MappedFile::release()
+{
+    if (mapped && ptr != nullptr) {
+        ::munmap(ptr, len);
+    }
+
+    ptr = nullptr;
+    len = 0;
+    mapped = false;
+    bytes.clear();
+}
+}
@@ -0,0 +1,168 @@
+#include <storage/MemoryOverlay.h>
+
+#include <conf/FaasmConfig.h>
+
+#include <faabric/util/gids.h>
+#include <faabric/util/logging.h>
+
+#include <boost/filesystem.hpp>
+#include <filesystem>
+#include <sstream>
+
+namespace storage {
+
+// Guest paths come in relative to either preopened root (i.e. "/tmp/x" and
+// "tmp/x" are the same file), so strip them back to a common relative form
+static std::string guestKey(const std::string& guestPath)
+{
+    std::string key =
+      std::filesystem::path(guestPath).lexically_normal().string();
+
+    size_t start = key.find_first_not_of('/');
+    if (start == std::string::npos) {
+        return "";
+    }
+    key = key.substr(start);
+
+    if (key == ".") {
+        return "";
+    }
+
+    if (key.rfind("./", 0) == 0) {
+        key = key.substr(2);
+    }
+
+    if (!key.empty() && key.back() == '/') {
+        key.pop_back();
+    }
+
+    return key;
+}
+
+MemoryOverlay::MemoryOverlay(const std::string& rootDirIn,
+                             const std::vector<std::string>& mountPathsIn,
+                             size_t maxBytesIn)
+  : rootDir(rootDirIn)
+  , maxBytes(maxBytesIn)
+{
+    for (const auto& p : mountPathsIn) {
+        std::string key = guestKey(p);
+        if (key.empty()) {
+            SPDLOG_ERROR("Cannot overlay the filesystem root ({})", p);
+            throw std::runtime_error("Invalid overlay path");
+        }
+
+        mountPaths.emplace_back(key);
+    }
+
+    clear();
+}
+
+MemoryOverlay::~MemoryOverlay()
+{
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(rootDir, ec);
+    if (ec) {
+        SPDLOG_WARN("Failed to remove overlay {}: {}", rootDir, ec.message());
+    }
+}
+
+bool MemoryOverlay::covers(const std::string& guestPath) const
+{
+    std::string key = guestKey(guestPath);
+    for (const auto& m : mountPaths) {
+        if (key == m) {
+            return true;
+        }
+
+        if (key.size() > m.size() && key.rfind(m, 0) == 0 &&
+            key[m.size()] == '/') {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string MemoryOverlay::realPath(const std::string& guestPath) const
+{
+    return rootDir + "/" + guestKey(guestPath);
+}
+
+bool MemoryOverlay::reserve(size_t bytes)
+{
+    size_t current = usedBytes.load(std::memory_order_relaxed);
+    do {
+        if (current + bytes > maxBytes) {
+            SPDLOG_DEBUG("Overlay {} full ({} + {} > {})",
+                         rootDir,
+                         current,
+                         bytes,
+                         maxBytes);
+            return false;
+        }
+    } while (!usedBytes.compare_exchange_weak(
+      current, current + bytes, std::memory_order_relaxed));
+
+    return true;
+}
+
+void MemoryOverlay::release(size_t bytes)
+{
+    size_t current = usedBytes.load(std::memory_order_relaxed);
+    size_t updated;
+    do {
+        updated = bytes > current ? 0 : current - bytes;
+    } while (!usedBytes.compare_exchange_weak(
+      current, updated, std::memory_order_relaxed));
+}
+
+void MemoryOverlay::clear()
+{
+    boost::filesystem::remove_all(rootDir);
+
+    for (const auto& m : mountPaths) {
+        boost::filesystem::create_directories(rootDir + "/" + m);
+    }
+
+    usedBytes.store(0, std::memory_order_relaxed);
+}
+
+size_t MemoryOverlay::getUsedBytes() const
+{
+    return usedBytes.load(std::memory_order_relaxed);
+}
+
+size_t MemoryOverlay::getMaxBytes() const
+{
+    return maxBytes;
+}
+
+const std::string& MemoryOverlay::getRootDir() const
+{
+    return rootDir;
+}
+
+std::unique_ptr<MemoryOverlay> createMemoryOverlay()
+{
+    conf::FaasmConfig& conf = conf::getFaasmConfig();
+    if (conf.fsOverlayPaths.empty()) {
+        return nullptr;
+    }
+
+    std::vector<std::string> mountPaths;
+    std::istringstream pathsStream(conf.fsOverlayPaths);
+    std::string p;
+    while (std::getline(pathsStream, p, ',')) {
+        if (!p.empty()) {
+            mountPaths.emplace_back(p);
+        }
+    }
+
+    std::string rootDir =
+      fmt::format("{}/{}", conf.fsOverlayDir, faabric::util::generateGid());
+    size_t maxBytes = (size_t)conf.fsOverlayMaxMb * 1024 * 1024;
+
+    return std::make_unique<MemoryOverlay>(rootDir, mountPaths, maxBytes);
+}
+}
@@ -0,0 +1,114 @@
+#include <storage/PathCache.h>
+
+#include <faabric/util/logging.h>
+
+#include <filesystem>
+
+namespace storage {
+
+// Resolved paths can reach us in different forms (e.g. with "." segments or
+// trailing slashes), so normalise them before using them as keys
+static std::string cacheKey(const std::string& realPath)
+{
+    std::string key =
+      std::filesystem::path(realPath).lexically_normal().string();
+    if (key.size() > 1 && key.back() == '/') {
+        key.pop_back();
+    }
+
+    return key;
+}
+
+bool PathCache::getStat(const std::string& realPath,
+                        struct ::stat& statOut,
+                        int& errnoOut)
+{
+    faabric::util::SharedLock lock(mx);
+
+    auto it = entries.find(cacheKey(realPath));
+    if (it == entries.end()) {
+        return false;
+    }
+
+    statOut = it->second.nativeStat;
+    errnoOut = it->second.statErrno;
+    return true;
+}
+
+void PathCache::putStat(const std::string& realPath,
+                        const struct ::stat& nativeStat,
+                        int statErrno)
+{
+    // Only cache results that are a property of the path itself, transient
+    // errors like EACCES or EIO are left to be retried
+    if (statErrno != 0 && statErrno != ENOENT && statErrno != ENOTDIR) {
+        return;
+    }
+
+    faabric::util::FullLock lock(mx);
+
+    if (entries.size() >= PATH_CACHE_MAX_ENTRIES) {
+        SPDLOG_DEBUG("Path cache full ({} entries), clearing", entries.size());
+        entries.clear();
+    }
+
+    PathCacheEntry& entry = entries[cacheKey(realPath)];
+    entry.nativeStat = nativeStat;
+    entry.statErrno = statErrno;
+}
+
+void PathCache::doInvalidate(const std::string& realPath)
+{
+    std::string key = cacheKey(realPath);
+    entries.erase(key);
+    entries.erase(std::filesystem::path(key).parent_path().string());
+}
+
+void PathCache::invalidate(const std::string& realPath)
+{
+    faabric::util::FullLock lock(mx);
+    doInvalidate(realPath);
+}
+
+void PathCache::invalidateTree(const std::string& realPath)
+{
+    faabric::util::FullLock lock(mx);
+    doInvalidate(realPath);
+
+    std::string prefix = cacheKey(realPath) + "/";
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->first.rfind(prefix, 0) == 0) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PathCache::invalidateContents(const std::string& realPath)
+{
+    std::string key = cacheKey(realPath);
+    {
+        faabric::util::SharedLock lock(mx);
+        if (entries.find(key) == entries.end()) {
+            return;
+        }
+    }
+
+    faabric::util::FullLock lock(mx);
+    entries.erase(key);
+}
+
+void PathCache::clear()
+{
+    faabric::util::FullLock lock(mx);
+    entries.clear();
+}
+
+size_t PathCache::size()
+{
+    faabric::util::SharedLock lock(mx);
+    return entries.size();
+}
+}
@@ -1,4 +1,5 @@
 #include <conf/FaasmConfig.h>
+#include <storage/LocalStorageBackend.h>
 #include <storage/S3Wrapper.h>
 
 #include <faabric/util/bytes.h>
@@ -85,6 +86,16 @@ ClientConfiguration getClientConf(long timeout)
 void initFaasmS3()
 {
     const auto& conf = conf::getFaasmConfig();
+
+    // With the local backend we don't talk to S3 at all
+    if (conf.storageBackend == "local") {
+        SPDLOG_INFO("Initialising Faasm local storage at {}",
+                    conf.localStorageDir);
+        LocalStorageBackend local;
+        local.createBucket(conf.s3Bucket);
+        return;
+    }
+
     SPDLOG_INFO(
       "Initialising Faasm S3 setup at {}:{}", conf.s3Host, conf.s3Port);
     Aws::InitAPI(options);
@@ -107,9 +118,28 @@ void initFaasmS3()
 
 void shutdownFaasmS3()
 {
+    if (conf::getFaasmConfig().storageBackend == "local") {
+        return;
+    }
+
     Aws::ShutdownAPI(options);
 }
 
+std::unique_ptr<StorageBackend> createStorageBackend()
+{
+    const auto& conf = conf::getFaasmConfig();
+    if (conf.storageBackend == "local") {
+        return std::make_unique<LocalStorageBackend>();
+    }
+
+    if (conf.storageBackend != "s3") {
+        SPDLOG_ERROR("Unrecognised storage backend: {}", conf.storageBackend);
+        throw std::runtime_error("Unrecognised storage backend");
+    }
+
+    return std::make_unique<S3Wrapper>();
+}
+
 S3Wrapper::S3Wrapper()
   : faasmConf(conf::getFaasmConfig())
   , clientConf(getClientConf(S3_REQUEST_TIMEOUT_MS))
@@ -181,33 +211,53 @@ std::vector<std::string> S3Wrapper::listBuckets()
     return bucketNames;
 }
 
-std::vector<std::string> S3Wrapper::listKeys(const std::string& bucketName)
+std::vector<std::string> S3Wrapper::listKeys(const std::string& bucketName,
+                                             const std::string& prefix)
 {
-    SPDLOG_TRACE("Listing keys in bucket {}", bucketName);
-    auto request = reqFactory<ListObjectsRequest>(bucketName);
-    auto response = client.ListObjects(request);
+    SPDLOG_TRACE("Listing keys in bucket {} (prefix {})", bucketName, prefix);
 
     std::vector<std::string> keys;
-    if (!response.IsSuccess()) {
-        const auto& err = response.GetError();
-        auto errType = err.GetErrorType();
 
-        if (errType == Aws::S3::S3Errors::NO_SUCH_BUCKET) {
-            SPDLOG_WARN("Listing keys of deleted bucket {}", bucketName);
-            return keys;
+    // S3 returns listings in pages, so we have to follow the marker until the
+    // listing is no longer truncated
+    std::string marker;
+    bool isTruncated = true;
+    while (isTruncated) {
+        auto request = reqFactory<ListObjectsRequest>(bucketName);
+        if (!prefix.empty()) {
+            request.SetPrefix(prefix);
+        }
+        if (!marker.empty()) {
+            request.SetMarker(marker);
         }
 
-        CHECK_ERRORS(response, bucketName, "");
-    }
+        auto response = client.ListObjects(request);
 
-    Aws::Vector<Object> keyObjects = response.GetResult().GetContents();
-    if (keyObjects.empty()) {
-        return keys;
-    }
+        if (!response.IsSuccess()) {
+            const auto& err = response.GetError();
+            auto errType = err.GetErrorType();
+
+            if (errType == Aws::S3::S3Errors::NO_SUCH_BUCKET) {
+                SPDLOG_WARN("Listing keys of deleted bucket {}", bucketName);
+                return keys;
+            }
+
+            CHECK_ERRORS(response, bucketName, "");
+        }
+
+        const auto& result = response.GetResult();
+        Aws::Vector<Object> keyObjects = result.GetContents();
+        if (keyObjects.empty()) {
+            return keys;
+        }
+
+        for (auto const& keyObject : keyObjects) {
+            const Aws::String& awsStr = keyObject.GetKey();
+            keys.emplace_back(awsStr.c_str());
+        }
 
-    for (auto const& keyObject : keyObjects) {
-        const Aws::String& awsStr = keyObject.GetKey();
-        keys.emplace_back(awsStr.c_str());
+        isTruncated = result.GetIsTruncated();
+        marker = keys.back();
     }
 
     return keys;
@@ -2,6 +2,7 @@
 
 #include <boost/filesystem.hpp>
 
+#include <faabric/util/clock.h>
 #include <faabric/util/config.h>
 #include <faabric/util/files.h>
 #include <faabric/util/func.h>
@@ -11,6 +12,16 @@
 #include <conf/FaasmConfig.h>
 #include <storage/FileLoader.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Number of threads used to fetch shared files concurrently when prefetching
+#define PREFETCH_THREADS 8
+
 namespace storage {
 enum FileState
 {
@@ -20,8 +31,152 @@ enum FileState
     EXISTS
 };
 
+/**
+ * Each shared path gets its own entry, so that a slow sync of one file (e.g. a
+ * download from S3) only blocks callers waiting on that same path. The global
+ * map lock is only ever held to look up or insert an entry, never while doing
+ * I/O.
+ */
+struct SharedFileEntry
+{
+    std::mutex syncMutex;
+    std::atomic<FileState> state = NOT_CHECKED;
+    std::atomic<long> checkedAtMillis = 0;
+};
+
 static std::shared_mutex sharedFileMapMutex;
-static std::unordered_map<std::string, FileState> sharedFileMap;
+static std::unordered_map<std::string, std::shared_ptr<SharedFileEntry>>
+  sharedFileMap;
+
+/**
+ * What we found for a Python function's prefetch manifest, keyed on the
+ * manifest's path. These aren't shared files, so they're kept out of the
+ * shared file map.
+ */
+struct PrefetchManifestEntry
+{
+    std::mutex mx;
+    bool checked = false;
+    bool found = false;
+    long checkedAtMillis = 0;
+};
+
+static void recordManifestCheck(PrefetchManifestEntry& entry, bool found)
+{
+    entry.checked = true;
+    entry.found = found;
+    entry.checkedAtMillis = faabric::util::getGlobalClock().epochMillis();
+}
+
+static std::mutex prefetchManifestsMutex;
+static std::unordered_map<std::string, std::shared_ptr<PrefetchManifestEntry>>
+  prefetchManifests;
+
+// Bumped whenever entries are invalidated, so that threads can tell when their
+// local caches are stale
+static std::atomic<uint64_t> sharedFileMapEpoch = 0;
+
+// The version of each Python function last seen in the object store by this
+// host, used to spot uploads made through other hosts
+static std::mutex pythonFunctionVersionsMutex;
+static std::unordered_map<std::string, std::string> pythonFunctionVersions;
+
+// Positive results never expire unless explicitly cleared, so we keep a
+// per-thread copy which can be read without taking any locks
+static thread_local std::unordered_map<std::string, FileState>
+  threadLocalFileStates;
+static thread_local uint64_t threadLocalEpoch = 0;
+
+// Negative results are only valid for the configured TTL (zero means they
+// never expire)
+static bool isMissValid(long checkedAtMillis)
+{
+    long ttlMs = conf::getFaasmConfig().sharedFilesNegativeTtlMs;
+    if (ttlMs <= 0) {
+        return true;
+    }
+
+    long nowMillis = faabric::util::getGlobalClock().epochMillis();
+    return (nowMillis - checkedAtMillis) < ttlMs;
+}
+
+static bool isStateValid(const SharedFileEntry& entry)
+{
+    FileState state = entry.state.load(std::memory_order_acquire);
+    if (state == NOT_CHECKED) {
+        return false;
+    }
+
+    if (state != NOT_EXISTS) {
+        return true;
+    }
+
+    return isMissValid(entry.checkedAtMillis.load(std::memory_order_acquire));
+}
+
+static int getReturnValueForSharedFileState(FileState state)
+{
+    switch (state) {
+        case (NOT_EXISTS): {
+            return ENOENT;
+        }
+        case (EXISTS_DIR):
+        case (EXISTS): {
+            return 0;
+        }
+        default: {
+            return ENOENT;
+        }
+    }
+}
+
+static void setEntryState(SharedFileEntry& entry, FileState state)
+{
+    entry.checkedAtMillis.store(faabric::util::getGlobalClock().epochMillis(),
+                                std::memory_order_release);
+    entry.state.store(state, std::memory_order_release);
+}
+
+static void cacheStateForThread(const std::string& sharedPath,
+                                FileState state,
+                                uint64_t epoch)
+{
+    if (state != EXISTS && state != EXISTS_DIR) {
+        return;
+    }
+
+    if (threadLocalEpoch != epoch) {
+        threadLocalFileStates.clear();
+        threadLocalEpoch = epoch;
+    }
+
+    threadLocalFileStates[sharedPath] = state;
+}
+
+static std::shared_ptr<SharedFileEntry> getOrCreateEntry(
+  const std::string& sharedPath)
+{
+    {
+        faabric::util::SharedLock lock(sharedFileMapMutex);
+        auto it = sharedFileMap.find(sharedPath);
+        if (it != sharedFileMap.end()) {
+            return it->second;
+        }
+    }
+
+    faabric::util::FullLock lock(sharedFileMapMutex);
+    auto [it, inserted] = sharedFileMap.try_emplace(sharedPath, nullptr);
+    if (inserted) {
+        it->second = std::make_shared<SharedFileEntry>();
+    }
+
+    return it->second;
+}
+
+static void invalidateThreadLocalCaches()
+{
+    sharedFileMapEpoch.fetch_add(1, std::memory_order_acq_rel);
+}
 
 std::string SharedFiles::prependSharedRoot(const std::string& originalPath)
 {
@@ -67,58 +222,54 @@ void SharedFiles::updateSharedFile(const std::string& p)
     loader.uploadSharedFile(relativePath, bytes);
 }
 
-int getReturnValueForSharedFileState(const std::string& sharedPath)
-{
-    FileState& state = sharedFileMap[sharedPath];
-    switch (state) {
-        case (NOT_EXISTS): {
-            return ENOENT;
-        }
-        case (EXISTS_DIR):
-        case (EXISTS): {
-            return 0;
-        }
-        default: {
-            return ENOENT;
-        }
-    }
-}
-
 void SharedFiles::clearCacheForSharedFile(const std::string& sharedPath)
 {
     SPDLOG_TRACE("Clearing shared file cache for {}", sharedPath);
     faabric::util::FullLock lock(sharedFileMapMutex);
 
     sharedFileMap.erase(sharedPath);
+    invalidateThreadLocalCaches();
 }
 
 int SharedFiles::syncSharedFile(const std::string& sharedPath,
                                 const std::string& localPath)
 {
-    // See if file already synced
-    {
-        faabric::util::SharedLock lock(sharedFileMapMutex);
-        if (sharedFileMap.find(sharedPath) != sharedFileMap.end()) {
-            if (localPath.empty()) {
-                SPDLOG_TRACE("Not syncing shared file {}, already checked",
-                             sharedPath);
-            } else {
-                SPDLOG_TRACE("Not syncing shared file {}, cached at {}",
-                             sharedPath,
-                             localPath);
-            }
+    // Check this thread's cache first, this requires no locking
+    uint64_t epoch = sharedFileMapEpoch.load(std::memory_order_acquire);
+    if (threadLocalEpoch == epoch) {
+        auto it = threadLocalFileStates.find(sharedPath);
+        if (it != threadLocalFileStates.end()) {
+            return getReturnValueForSharedFileState(it->second);
+        }
+    }
 
-            return getReturnValueForSharedFileState(sharedPath);
+    // See if file already synced
+    std::shared_ptr<SharedFileEntry> entry = getOrCreateEntry(sharedPath);
+    if (isStateValid(*entry)) {
+        if (localPath.empty()) {
+            SPDLOG_TRACE("Not syncing shared file {}, already checked",
+                         sharedPath);
+        } else {
+            SPDLOG_TRACE("Not syncing shared file {}, cached at {}",
+                         sharedPath,
+                         localPath);
         }
+
+        FileState state = entry->state.load(std::memory_order_acquire);
+        cacheStateForThread(sharedPath, state, epoch);
+        return getReturnValueForSharedFileState(state);
     }
 
-    // At this point, file has not been synced, therefore need a lock
-    faabric::util::FullLock fullLock(sharedFileMapMutex);
+    // At this point, file has not been synced (or the negative entry has
+    // expired), so we need to lock this path only
+    std::unique_lock<std::mutex> syncLock(entry->syncMutex);
 
-    // Check again
-    if (sharedFileMap.count(sharedPath) > 0) {
+    // Check again, another thread may have synced it while we waited
+    if (isStateValid(*entry)) {
         SPDLOG_TRACE("Not syncing {}, cached at {}", sharedPath, localPath);
-        return getReturnValueForSharedFileState(sharedPath);
+        FileState state = entry->state.load(std::memory_order_acquire);
+        cacheStateForThread(sharedPath, state, epoch);
+        return getReturnValueForSharedFileState(state);
     }
 
     if (localPath.empty()) {
@@ -138,13 +289,13 @@ int SharedFiles::syncSharedFile(const std::string& sharedPath,
     }
 
     // Check the filesystem
-    sharedFileMap[sharedPath] = NOT_CHECKED;
+    FileState newState = NOT_CHECKED;
     if (boost::filesystem::exists(realPath)) {
         // If already exists on filesystem, just mark it as such
         if (boost::filesystem::is_directory(realPath)) {
-            sharedFileMap[sharedPath] = EXISTS_DIR;
+            newState = EXISTS_DIR;
         } else {
-            sharedFileMap[sharedPath] = EXISTS;
+            newState = EXISTS;
         }
     } else {
         boost::filesystem::path p(realPath);
@@ -165,9 +316,9 @@ int SharedFiles::syncSharedFile(const std::string& sharedPath,
         if (isDir) {
             // Create directory if path is a directory
             boost::filesystem::create_directories(p);
-            sharedFileMap[sharedPath] = EXISTS_DIR;
+            newState = EXISTS_DIR;
         } else if (bytes.empty()) {
-            sharedFileMap[sharedPath] = NOT_EXISTS;
+            newState = NOT_EXISTS;
         } else {
             // Create parent directory
             if (p.has_parent_path()) {
@@ -176,23 +327,19 @@ int SharedFiles::syncSharedFile(const std::string& sharedPath,
 
             // Write to file
             faabric::util::writeBytesToFile(realPath, bytes);
-            sharedFileMap[sharedPath] = EXISTS;
+            newState = EXISTS;
         }
     }
 
-    return getReturnValueForSharedFileState(sharedPath);
+    setEntryState(*entry, newState);
+    cacheStateForThread(sharedPath, newState, epoch);
+
+    return getReturnValueForSharedFileState(newState);
 }
 
-void SharedFiles::syncPythonFunctionFile(const faabric::Message& msg)
+std::pair<std::string, std::string> SharedFiles::getPythonFunctionPaths(
+  const faabric::Message& msg)
 {
-    if (!msg.ispython()) {
-        return;
-    }
-
-    SPDLOG_TRACE("Syncing file for Python function {}/{}",
-                 msg.pythonuser(),
-                 msg.pythonfunction());
-
     conf::FaasmConfig& conf = conf::getFaasmConfig();
     FileLoader& loader = getFileLoader();
     std::string relativePath = loader.getPythonFunctionRelativePath(msg);
@@ -208,11 +355,234 @@ void SharedFiles::syncPythonFunctionFile(const faabric::Message& msg)
     boost::filesystem::path runtimePath(conf.runtimeFilesDir);
     runtimePath.append(relativePath);
 
-    syncSharedFile(sharedUrl.string(), runtimePath.string());
+    return { sharedUrl.string(), runtimePath.string() };
+}
+
+void SharedFiles::syncPythonFunctionFile(const faabric::Message& msg)
+{
+    if (!msg.ispython()) {
+        return;
+    }
+
+    SPDLOG_TRACE("Syncing file for Python function {}/{}",
+                 msg.pythonuser(),
+                 msg.pythonfunction());
+
+    auto [sharedUrl, runtimePath] = getPythonFunctionPaths(msg);
+    syncSharedFile(sharedUrl, runtimePath);
+}
+
+/**
+ * Drops any synced copy of the given Python function, e.g. when it is
+ * re-uploaded, so that it is fetched again on its next invocation.
+ */
+void SharedFiles::invalidatePythonFunctionFile(const faabric::Message& msg)
+{
+    SPDLOG_TRACE("Invalidating file for Python function {}/{}",
+                 msg.pythonuser(),
+                 msg.pythonfunction());
+
+    auto [sharedUrl, runtimePath] = getPythonFunctionPaths(msg);
+    clearCacheForSharedFile(sharedUrl);
+    boost::filesystem::remove(runtimePath);
+
+    // The function's prefetch manifest may have changed with it
+    std::string manifestPath =
+      getFileLoader().getPythonFunctionPrefetchRelativePath(msg);
+    {
+        std::unique_lock<std::mutex> lock(prefetchManifestsMutex);
+        prefetchManifests.erase(manifestPath);
+    }
+}
+
+/**
+ * Reads the version of the given Python function from the object store. If
+ * it has changed since this host last checked, the function was re-uploaded
+ * (possibly through another host), so the synced copy and the locally cached
+ * copy are both dropped.
+ */
+std::string SharedFiles::checkPythonFunctionVersion(const faabric::Message& msg)
+{
+    FileLoader& loader = getFileLoader();
+    std::string version = loader.loadPythonFunctionVersion(msg);
+    std::string relativePath = loader.getPythonFunctionRelativePath(msg);
+
+    std::unique_lock<std::mutex> lock(pythonFunctionVersionsMutex);
+    auto [it, inserted] = pythonFunctionVersions.try_emplace(relativePath);
+    if (!inserted && it->second != version) {
+        SPDLOG_DEBUG("Python function {}/{} changed version ({} -> {})",
+                     msg.pythonuser(),
+                     msg.pythonfunction(),
+                     it->second,
+                     version);
+
+        invalidatePythonFunctionFile(msg);
+        boost::filesystem::remove(loader.getPythonFunctionFile(msg));
+    }
+
+    it->second = version;
+    return version;
+}
+
+/**
+ * Pulls every shared file under the given directory into the local cache ahead
+ * of first use. The S3 listing of the directory acts as the manifest, and the
+ * files are fetched concurrently. Each file goes through the normal sync path,
+ * so subsequent accesses hit the cache. Returns the number of files synced.
+ */
+int SharedFiles::prefetchSharedDirectory(const std::string& sharedDir)
+{
+    std::string relativeDir = stripSharedPrefix(sharedDir);
+
+    FileLoader& loader = getFileLoader();
+    std::vector<std::string> relativePaths =
+      loader.listSharedFiles(relativeDir);
+
+    if (relativePaths.empty()) {
+        SPDLOG_DEBUG("No shared files to prefetch under {}", relativeDir);
+        return 0;
+    }
+
+    SPDLOG_DEBUG("Prefetching {} shared files under {}",
+                 relativePaths.size(),
+                 relativeDir);
+
+    std::atomic<size_t> nextIdx = 0;
+    std::atomic<int> nSynced = 0;
+    auto fetchLoop = [&relativePaths, &nextIdx, &nSynced] {
+        while (true) {
+            size_t idx = nextIdx.fetch_add(1);
+            if (idx >= relativePaths.size()) {
+                break;
+            }
+
+            std::string sharedPath =
+              SHARED_FILE_PREFIX + relativePaths.at(idx);
+            try {
+                if (syncSharedFile(sharedPath) == 0) {
+                    nSynced++;
+                }
+            } catch (std::exception& e) {
+                SPDLOG_ERROR("Failed prefetching shared file {}: {}",
+                             sharedPath,
+                             e.what());
+            }
+        }
+    };
+
+    size_t nThreads = std::min<size_t>(PREFETCH_THREADS, relativePaths.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; i++) {
+        threads.emplace_back(fetchLoop);
+    }
+
+    for (auto& t : threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+
+    SPDLOG_DEBUG("Prefetched {}/{} shared files under {}",
+                 nSynced.load(),
+                 relativePaths.size(),
+                 relativeDir);
+
+    return nSynced.load();
+}
+
+int SharedFiles::prefetchSharedDirectories(
+  const std::vector<std::string>& sharedDirs)
+{
+    int nSynced = 0;
+    for (const auto& d : sharedDirs) {
+        nSynced += prefetchSharedDirectory(d);
+    }
+
+    return nSynced;
+}
+
+/**
+ * Python functions can ship a manifest alongside their source listing the
+ * shared directories (one per line) they will need, e.g. site-packages trees.
+ */
+int SharedFiles::prefetchForPythonFunction(const faabric::Message& msg)
+{
+    if (!msg.ispython()) {
+        return 0;
+    }
+
+    FileLoader& loader = getFileLoader();
+    std::string manifestPath =
+      loader.getPythonFunctionPrefetchRelativePath(msg);
+
+    // This runs whenever a Python Faaslet is created, so we remember what we
+    // found. Most functions have no manifest, and misses are kept for the
+    // negative TTL rather than going to storage every time. A manifest that
+    // was found has already been prefetched, so there's nothing more to do
+    std::shared_ptr<PrefetchManifestEntry> entry;
+    {
+        std::unique_lock<std::mutex> lock(prefetchManifestsMutex);
+        auto& e = prefetchManifests[manifestPath];
+        if (e == nullptr) {
+            e = std::make_shared<PrefetchManifestEntry>();
+        }
+        entry = e;
+    }
+
+    std::unique_lock<std::mutex> entryLock(entry->mx);
+    bool stillValid =
+      entry->checked && (entry->found || isMissValid(entry->checkedAtMillis));
+    if (stillValid) {
+        SPDLOG_TRACE("Not prefetching for {}/{}, manifest {} already checked",
+                     msg.pythonuser(),
+                     msg.pythonfunction(),
+                     manifestPath);
+        return 0;
+    }
+
+    std::vector<uint8_t> manifestBytes;
+    try {
+        manifestBytes = loader.loadSharedFile(manifestPath);
+    } catch (storage::SharedFileNotExistsException& e) {
+        SPDLOG_TRACE("No prefetch manifest for Python function {}/{}",
+                     msg.pythonuser(),
+                     msg.pythonfunction());
+        recordManifestCheck(*entry, false);
+        return 0;
+    } catch (storage::SharedFileIsDirectoryException& e) {
+        SPDLOG_WARN("Prefetch manifest {} is a directory, ignoring",
+                    manifestPath);
+        recordManifestCheck(*entry, false);
+        return 0;
+    }
+
+    recordManifestCheck(*entry, true);
+
+    std::vector<std::string> sharedDirs;
+    std::istringstream manifest(
+      std::string(manifestBytes.begin(), manifestBytes.end()));
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty()) {
+            sharedDirs.emplace_back(line);
+        }
+    }
+
+    return prefetchSharedDirectories(sharedDirs);
 }
 
 void SharedFiles::clear()
 {
+    {
+        std::unique_lock<std::mutex> lock(prefetchManifestsMutex);
+        prefetchManifests.clear();
+    }
+
+    faabric::util::FullLock lock(sharedFileMapMutex);
     sharedFileMap.clear();
+    invalidateThreadLocalCaches();
+
+    std::unique_lock<std::mutex> versionsLock(pythonFunctionVersionsMutex);
+    pythonFunctionVersions.clear();
 }
 }
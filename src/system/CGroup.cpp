@@ -6,10 +6,17 @@
 #include <faabric/util/logging.h>
 #include <faabric/util/timing.h>
 
-#include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <mutex>
+#include <sstream>
+#include <sys/stat.h>
 #include <syscall.h>
+#include <unistd.h>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
 using namespace boost::filesystem;
@@ -20,7 +27,7 @@ static const std::string CG_CPU = "cpu";
 
 static const std::vector<std::string> controllers = { CG_CPU };
 
-static std::mutex groupMutex;
+static std::once_flag baseGroupFlag;
 
 CGroup::CGroup(const std::string& name)
   : name(name)
@@ -29,6 +36,8 @@ CGroup::CGroup(const std::string& name)
 
     if (conf.cgroupMode == "on") {
         mode = CgroupMode::cg_on;
+    } else if (conf.cgroupMode == "v2") {
+        mode = CgroupMode::cg_v2;
     } else {
         mode = CgroupMode::cg_off;
     }
@@ -50,39 +59,213 @@ pid_t getCurrentTid()
     return tid;
 }
 
-void addCurrentThreadToTasks(const path& tasksPath)
+// Each value goes in a single write, which the kernel applies atomically, so
+// concurrent writers don't need to lock
+static bool writeCgroupFile(const path& filePath, const std::string& value)
 {
+    int fd = open(filePath.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SPDLOG_ERROR(
+          "Failed to open {}: {}", filePath.string(), strerror(errno));
+        return false;
+    }
 
-    pid_t threadId = getCurrentTid();
+    ssize_t written = write(fd, value.c_str(), value.size());
+    int err = errno;
+    close(fd);
 
-    std::ofstream outfile;
-    outfile.open(tasksPath.string(), std::ios_base::app);
-    outfile << threadId << std::endl;
-    outfile.flush();
+    if (written != (ssize_t)value.size()) {
+        SPDLOG_ERROR("Failed to write {} to {}: {}",
+                     value,
+                     filePath.string(),
+                     strerror(err));
+        return false;
+    }
 
-    SPDLOG_DEBUG("Added thread id {} to {}", threadId, tasksPath.string());
+    return true;
 }
 
-void CGroup::addCurrentThread()
+static void writeCgroupFileOrThrow(const path& filePath,
+                                   const std::string& value)
 {
+    if (!writeCgroupFile(filePath, value)) {
+        throw std::runtime_error("Failed to configure cgroup");
+    }
+}
+
+// Threads of the same process can only be placed in different groups if
+// those groups are threaded. This is a no-op if it already is.
+static void createThreadedGroup(const path& groupPath)
+{
+    if (mkdir(groupPath.c_str(), 0755) != 0 && errno != EEXIST) {
+        SPDLOG_ERROR("Failed to create cgroup {}: {}",
+                     groupPath.string(),
+                     strerror(errno));
+        throw std::runtime_error("Failed to create cgroup");
+    }
+
+    writeCgroupFileOrThrow(groupPath / "cgroup.type", "threaded");
+}
+
+void setUpBaseCgroup(const std::string& basePathStr)
+{
+    conf::FaasmConfig& conf = conf::getFaasmConfig();
+
+    path basePath(basePathStr);
+    if (!exists(basePath)) {
+        SPDLOG_ERROR("Base cgroup does not exist at {}", basePath.string());
+        throw std::runtime_error("Base cgroup does not exist");
+    }
+
+    // The kernel won't enable controllers on a domain group that already
+    // has processes in it, nor move a process into a domain group with
+    // controllers enabled. Enabling them first and then giving the group a
+    // threaded child turns it into a threaded domain, which can hold both
+    writeCgroupFileOrThrow(basePath / "cgroup.subtree_control", "+cpu");
+    createThreadedGroup(basePath / BASE_CGROUP_MAIN_NAME);
+    writeCgroupFileOrThrow(basePath / "cgroup.procs", std::to_string(getpid()));
+
+    // Memory is a domain controller, so can't be split between the threads
+    // of a single process, hence it can only be limited for all functions
+    if (!conf.cgroupMemoryMax.empty()) {
+        writeCgroupFileOrThrow(basePath / "memory.max", conf.cgroupMemoryMax);
+    }
+}
+
+// The base cgroup is the threaded domain that all function sub-groups live
+// under. It must already exist, but we set it up and move this process into
+// it the first time it's used.
+static void setUpBaseGroup()
+{
+    path basePath(BASE_DIR);
+    basePath.append(BASE_CGROUP_NAME);
+
+    setUpBaseCgroup(basePath.string());
+}
+
+void CGroup::create(const CgroupLimits& limits)
+{
+    if (mode != CgroupMode::cg_v2) {
+        return;
+    }
+
+    std::call_once(baseGroupFlag, setUpBaseGroup);
+
+    if (name == BASE_CGROUP_NAME) {
+        return;
+    }
+
+    path groupPath(BASE_DIR);
+    groupPath.append(name);
 
+    createThreadedGroup(groupPath);
+
+    if (!limits.cpuWeight.empty()) {
+        writeCgroupFileOrThrow(groupPath / "cpu.weight", limits.cpuWeight);
+    }
+
+    if (!limits.cpuMax.empty()) {
+        writeCgroupFileOrThrow(groupPath / "cpu.max", limits.cpuMax);
+    }
+
+    SPDLOG_DEBUG("Created cgroup {} (cpu.weight={}, cpu.max={})",
+                 name,
+                 limits.cpuWeight,
+                 limits.cpuMax);
+}
+
+void CGroup::addCurrentThread()
+{
     if (mode == CgroupMode::cg_off) {
         SPDLOG_DEBUG("Not adding thread. cgroup support off");
         return;
     }
 
     PROF_START(cGroupAdd)
-    // Get lock and add to controllers
-    std::scoped_lock<std::mutex> guard(groupMutex);
+    pid_t threadId = getCurrentTid();
+    std::string tidStr = std::to_string(threadId);
 
-    for (const std::string& controller : controllers) {
-        path tasksPath(BASE_DIR);
-        tasksPath.append(controller);
-        tasksPath.append(this->name);
-        tasksPath.append("tasks");
+    if (mode == CgroupMode::cg_v2) {
+        path threadsPath(BASE_DIR);
+        threadsPath.append(this->name);
+        threadsPath.append("cgroup.threads");
+
+        if (writeCgroupFile(threadsPath, tidStr)) {
+            SPDLOG_DEBUG(
+              "Added thread id {} to {}", threadId, threadsPath.string());
+        }
+    } else {
+        for (const std::string& controller : controllers) {
+            path tasksPath(BASE_DIR);
+            tasksPath.append(controller);
+            tasksPath.append(this->name);
+            tasksPath.append("tasks");
 
-        addCurrentThreadToTasks(tasksPath);
+            if (writeCgroupFile(tasksPath, tidStr)) {
+                SPDLOG_DEBUG(
+                  "Added thread id {} to {}", threadId, tasksPath.string());
+            }
+        }
     }
     PROF_END(cGroupAdd)
 }
+
+std::string getFunctionCgroupName(const faabric::Message& msg)
+{
+    conf::FaasmConfig& conf = conf::getFaasmConfig();
+    if (conf.cgroupMode != "v2") {
+        return BASE_CGROUP_NAME;
+    }
+
+    std::string subGroup = msg.user();
+    if (conf.cgroupGranularity == "function") {
+        subGroup += "-" + msg.function();
+    } else if (conf.cgroupGranularity != "user") {
+        SPDLOG_ERROR("Unrecognised cgroup granularity: {}",
+                     conf.cgroupGranularity);
+        throw std::runtime_error("Unrecognised cgroup granularity");
+    }
+
+    // Cgroup names are directory names
+    std::replace(subGroup.begin(), subGroup.end(), '/', '_');
+
+    return std::string(BASE_CGROUP_NAME) + "/" + subGroup;
+}
+
+CgroupLimits parseCgroupLimits(const std::string& metadata)
+{
+    conf::FaasmConfig& conf = conf::getFaasmConfig();
+
+    CgroupLimits limits;
+    limits.cpuWeight = conf.cgroupCpuWeight;
+    limits.cpuMax = conf.cgroupCpuMax;
+
+    std::istringstream lines(metadata);
+    std::string line;
+    while (std::getline(lines, line)) {
+        boost::algorithm::trim(line);
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        size_t eqIdx = line.find('=');
+        if (eqIdx == std::string::npos) {
+            SPDLOG_WARN("Ignoring malformed cgroup limit: {}", line);
+            continue;
+        }
+
+        std::string key = boost::algorithm::trim_copy(line.substr(0, eqIdx));
+        std::string value = boost::algorithm::trim_copy(line.substr(eqIdx + 1));
+
+        if (key == "cpu.weight") {
+            limits.cpuWeight = value;
+        } else if (key == "cpu.max") {
+            limits.cpuMax = value;
+        } else {
+            SPDLOG_WARN("Ignoring unsupported cgroup limit: {}", key);
+        }
+    }
+
+    return limits;
+}
 }
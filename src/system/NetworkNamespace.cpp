@@ -12,6 +12,8 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
 
 namespace isolation {
 
@@ -69,43 +71,80 @@ std::shared_ptr<NetworkNamespace> claimNetworkNamespace()
 NetworkNamespace::NetworkNamespace(const std::string& name)
   : name(name){};
 
+NetworkNamespace::~NetworkNamespace()
+{
+    if (nsFd >= 0) {
+        close(nsFd);
+    }
+}
+
 const std::string NetworkNamespace::getName()
 {
-    faabric::util::SharedLock lock(mx);
     return this->name;
 }
 
-void joinNamespace(const boost::filesystem::path& nsPath)
+static int openNamespace(const boost::filesystem::path& nsPath)
 {
-    const auto& conf = conf::getFaasmConfig();
-    if (conf.netNsMode == "off") {
-        return;
-    }
-
-    SPDLOG_DEBUG("Setting network ns to {}", nsPath.string());
-
-    int fd;
-    fd = open(nsPath.c_str(), O_RDONLY, 0);
+    int fd = open(nsPath.c_str(), O_RDONLY | O_CLOEXEC, 0);
     if (fd == -1) {
+        SPDLOG_ERROR("Failed to open namespace at {} - {}",
+                     nsPath.string(),
+                     std::strerror(errno));
         std::string errorMsg = "Failed to open fd at " + nsPath.string();
         throw std::runtime_error(errorMsg);
     }
 
-    int result = setns(fd, 0);
-    close(fd);
+    return fd;
+}
+
+static void joinNamespace(int fd, const std::string& nsName)
+{
+    SPDLOG_DEBUG("Setting network ns to {}", nsName);
 
-    if (result != 0) {
-        SPDLOG_ERROR("Failed to join namespace at {} - {}",
-                     nsPath.string(),
+    if (setns(fd, CLONE_NEWNET) != 0) {
+        SPDLOG_ERROR("Failed to join namespace {} - {}",
+                     nsName,
                      std::strerror(errno));
         std::string errorMsg = "setns failed " + std::to_string(errno);
         throw std::runtime_error(errorMsg);
     }
 }
 
+// Threads leave their namespace by rejoining the parent's, which never
+// changes, so we only need to open it once per process
+static int getParentNamespaceFd()
+{
+    static int parentFd = [] {
+        boost::filesystem::path nsPath("/proc");
+        nsPath.append(std::to_string(getppid()));
+        nsPath.append("ns/net");
+
+        return openNamespace(nsPath);
+    }();
+
+    return parentFd;
+}
+
+void NetworkNamespace::prepare()
+{
+    const auto& conf = conf::getFaasmConfig();
+    if (conf.netNsMode == "off") {
+        return;
+    }
+
+    // If opening fails, call_once lets the next caller retry
+    std::call_once(nsFdFlag, [this] {
+        boost::filesystem::path nsPath("/var/run/netns");
+        nsPath.append(name);
+
+        nsFd = openNamespace(nsPath);
+    });
+
+    getParentNamespaceFd();
+}
+
 void NetworkNamespace::addCurrentThread()
 {
-    faabric::util::FullLock lock(mx);
     const auto& conf = conf::getFaasmConfig();
     if (conf.netNsMode == "off") {
         SPDLOG_DEBUG("Not using network ns, support off");
@@ -115,30 +154,20 @@ void NetworkNamespace::addCurrentThread()
     PROF_START(netNsAdd)
     SPDLOG_DEBUG("Adding thread to network ns: {}", name);
 
-    // Open path to the namespace
-    boost::filesystem::path nsPath("/var/run/netns");
-    nsPath.append(name);
-
-    joinNamespace(nsPath);
+    prepare();
+    joinNamespace(nsFd, name);
     PROF_END(netNsAdd)
 };
 
 void NetworkNamespace::removeCurrentThread()
 {
-    faabric::util::FullLock lock(mx);
     const auto& conf = conf::getFaasmConfig();
     if (conf.netNsMode == "off") {
         SPDLOG_DEBUG("Not using network ns, support off");
         return;
     }
 
-    // Return process to its parent namespace
-    pid_t parentPid = getppid();
-
-    boost::filesystem::path nsPath("/proc");
-    nsPath.append(std::to_string(parentPid));
-    nsPath.append("ns/net");
-
-    joinNamespace(nsPath);
+    // Return thread to its parent namespace
+    joinNamespace(getParentNamespaceFd(), "parent");
 }
 }
@@ -13,6 +13,9 @@
 #include <faabric/util/timing.h>
 #include <threads/ThreadState.h>
 
+#include <cstring>
+#include <type_traits>
+
 using namespace faabric::util;
 
 #define LEVEL_WAIT_TIMEOUT_MS 20000
@@ -21,6 +24,8 @@ namespace threads {
 
 static thread_local std::shared_ptr<Level> currentLevel = nullptr;
 
+static thread_local std::array<uint32_t, PTHREAD_KEYS_MAX> pthreadKeyValues{};
+
 void setCurrentOpenMPLevel(const std::shared_ptr<Level>& level)
 {
     currentLevel = level;
@@ -61,6 +66,128 @@ std::shared_ptr<Level> levelFromBatchRequest(
     return Level::deserialise(faabric::util::stringToBytes(req->contextdata()));
 }
 
+int PthreadKeys::createKey(uint32_t destructor)
+{
+    std::unique_lock<std::mutex> lock(mx);
+
+    for (uint32_t key = 0; key < PTHREAD_KEYS_MAX; key++) {
+        if (!table.inUse.test(key)) {
+            table.inUse.set(key);
+            table.destructors.at(key) = destructor;
+            table.version++;
+
+            return key;
+        }
+    }
+
+    return -1;
+}
+
+bool PthreadKeys::deleteKey(uint32_t key)
+{
+    std::unique_lock<std::mutex> lock(mx);
+
+    if (key >= PTHREAD_KEYS_MAX || !table.inUse.test(key)) {
+        return false;
+    }
+
+    table.inUse.reset(key);
+    table.destructors.at(key) = 0;
+    table.version++;
+
+    return true;
+}
+
+bool PthreadKeys::isKeyInUse(uint32_t key)
+{
+    std::unique_lock<std::mutex> lock(mx);
+    return key < PTHREAD_KEYS_MAX && table.inUse.test(key);
+}
+
+uint32_t PthreadKeys::getDestructor(uint32_t key)
+{
+    std::unique_lock<std::mutex> lock(mx);
+    if (key >= PTHREAD_KEYS_MAX || !table.inUse.test(key)) {
+        return 0;
+    }
+
+    return table.destructors.at(key);
+}
+
+void PthreadKeys::clear()
+{
+    std::unique_lock<std::mutex> lock(mx);
+    table = KeyTable();
+}
+
+std::vector<uint8_t> PthreadKeys::serialise(int appId)
+{
+    static_assert(std::is_trivially_copyable_v<KeyTable>);
+
+    std::unique_lock<std::mutex> lock(mx);
+    table.appId = appId;
+
+    std::vector<uint8_t> bytes(sizeof(KeyTable), 0);
+    std::memcpy(bytes.data(), &table, sizeof(KeyTable));
+
+    return bytes;
+}
+
+void PthreadKeys::deserialise(const std::vector<uint8_t>& bytes)
+{
+    if (bytes.size() != sizeof(KeyTable)) {
+        SPDLOG_ERROR("Invalid pthread keys size {} (expected {})",
+                     bytes.size(),
+                     sizeof(KeyTable));
+        throw std::runtime_error("Invalid pthread keys");
+    }
+
+    KeyTable other;
+    std::memcpy(&other, bytes.data(), sizeof(KeyTable));
+
+    std::unique_lock<std::mutex> lock(mx);
+
+    // On the main host the keys are already here, and may have changed since
+    // the batch was sent
+    if (other.appId == table.appId && other.version <= table.version) {
+        return;
+    }
+
+    SPDLOG_TRACE("Loading {} pthread keys for app {} (version {})",
+                 other.inUse.count(),
+                 other.appId,
+                 other.version);
+    table = other;
+}
+
+uint32_t getPthreadKeyValue(uint32_t key)
+{
+    return key < PTHREAD_KEYS_MAX ? pthreadKeyValues.at(key) : 0;
+}
+
+void setPthreadKeyValue(uint32_t key, uint32_t value)
+{
+    pthreadKeyValues.at(key) = value;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> takePthreadKeyValues()
+{
+    std::vector<std::pair<uint32_t, uint32_t>> values;
+    for (uint32_t key = 0; key < PTHREAD_KEYS_MAX; key++) {
+        if (pthreadKeyValues.at(key) != 0) {
+            values.emplace_back(key, pthreadKeyValues.at(key));
+            pthreadKeyValues.at(key) = 0;
+        }
+    }
+
+    return values;
+}
+
+void clearPthreadKeyValues()
+{
+    pthreadKeyValues.fill(0);
+}
+
 Level::Level(int numThreadsIn)
   : numThreads(numThreadsIn)
 {}
@@ -22,6 +22,9 @@
 
 #define NO_WASM_FUNC_PTR -1
 
+// Bit in a memory's limits flags marking it as shared between threads
+#define SHARED_MEMORY_FLAG 0x02
+
 namespace wasm {
 // The high level API for WAMR can be found here:
 // https://github.com/bytecodealliance/wasm-micro-runtime/blob/main/core/iwasm/include/wasm_export.h
@@ -32,6 +35,13 @@ static bool wamrInitialised = false;
 // so it may cause performance issues under high churn of short-lived functions.
 static std::mutex wamrGlobalsMutex;
 
+// WAMR caps the number of exec envs that can be spawned from a single one
+static int wamrMaxThreads = 0;
+
+// Native functions may be called from several threads at once, each of which
+// needs to jump back to its own call into WAMR
+static thread_local jmp_buf wamrExceptionJmpBuf;
+
 void WAMRWasmModule::initialiseWAMRGlobally()
 {
     faabric::util::UniqueLock lock(wamrGlobalsMutex);
@@ -75,6 +85,12 @@ WAMRWasmModule::WAMRWasmModule(int threadPoolSizeIn)
   : WasmModule(threadPoolSizeIn)
 {
     initialiseWAMRGlobally();
+
+    faabric::util::UniqueLock lock(wamrGlobalsMutex);
+    if (threadPoolSize > wamrMaxThreads) {
+        wamrMaxThreads = threadPoolSize;
+        wasm_runtime_set_max_thread_num(wamrMaxThreads);
+    }
 }
 
 WAMRWasmModule::~WAMRWasmModule()
@@ -84,6 +100,7 @@ WAMRWasmModule::~WAMRWasmModule()
 
     faabric::util::UniqueLock lock(wamrGlobalsMutex);
 
+    destroyThreadExecEnvs();
     wasm_runtime_deinstantiate(moduleInstance);
     wasm_runtime_unload(wasmModule);
 }
@@ -105,6 +122,7 @@ void WAMRWasmModule::reset(faabric::Message& msg,
     std::string funcStr = faabric::util::funcToString(msg, true);
     SPDLOG_DEBUG("WAMR resetting after {} (snap key {})", funcStr, snapshotKey);
 
+    destroyThreadExecEnvs();
     wasm_runtime_deinstantiate(moduleInstance);
     bindInternal(msg);
 }
@@ -116,9 +134,10 @@ void WAMRWasmModule::doBindToFunction(faabric::Message& msg, bool cache)
                  msg.function(),
                  msg.id());
 
-    // Load the wasm file
+    // Map the AoT file rather than copying it onto the heap, so that code
+    // pages are shared with the page cache and across workers
     storage::FileLoader& functionLoader = storage::getFileLoader();
-    wasmBytes = functionLoader.loadFunctionWamrAotFile(msg);
+    wasmBytes = functionLoader.mapFunctionWamrAotFile(msg);
 
     {
         faabric::util::UniqueLock lock(wamrGlobalsMutex);
@@ -167,6 +186,11 @@ void WAMRWasmModule::bindInternal(faabric::Message& msg)
 
     // Set up thread stacks
     createThreadStacks();
+
+    // Exec envs for pthreads are spawned lazily, as most functions don't
+    // create any threads
+    threadsParentExecEnv = createExecEnv();
+    pthreadExecEnvs = std::vector<WASMExecEnv*>(threadPoolSize, nullptr);
 }
 
 int32_t WAMRWasmModule::executeFunction(faabric::Message& msg)
@@ -193,6 +217,49 @@ int32_t WAMRWasmModule::executeFunction(faabric::Message& msg)
     return returnValue;
 }
 
+int32_t WAMRWasmModule::executePthread(int threadPoolIdx,
+                                       uint32_t stackTop,
+                                       faabric::Message& msg)
+{
+    std::string funcStr = faabric::util::funcToString(msg, false);
+    SPDLOG_DEBUG(
+      "WAMR module executing pthread {} for {}", threadPoolIdx, funcStr);
+
+    WASMExecEnv* threadExecEnv = getPthreadExecEnv(threadPoolIdx, stackTop);
+    WASMModuleInstanceCommon* threadInstance =
+      wasm_runtime_get_module_inst(threadExecEnv);
+
+    // The entrypoint takes a single pointer to its args, and WAMR writes the
+    // return value back into argv
+    int wasmFuncPtr = msg.funcptr();
+    std::vector<uint32_t> argv = { (uint32_t)std::stoi(msg.inputdata()) };
+    bool success =
+      executeCatchException(threadExecEnv, nullptr, wasmFuncPtr, 1, argv);
+    if (!success) {
+        SPDLOG_ERROR("Error executing pthread {}: {}",
+                     wasmFuncPtr,
+                     wasm_runtime_get_exception(threadInstance));
+        throw std::runtime_error("Error executing pthread with WAMR");
+    }
+
+    int32_t returnValue = argv[0];
+    msg.set_returnvalue(returnValue);
+
+    runPthreadKeyDestructors([this, threadExecEnv, threadInstance](
+                               uint32_t destructor, uint32_t value) {
+        std::vector<uint32_t> destructorArgv = { value };
+        if (!executeCatchException(
+              threadExecEnv, nullptr, destructor, 1, destructorArgv)) {
+            SPDLOG_ERROR("Error executing pthread key destructor {}: {}",
+                         destructor,
+                         wasm_runtime_get_exception(threadInstance));
+            throw std::runtime_error("Error executing pthread key destructor");
+        }
+    });
+
+    return returnValue;
+}
+
 int WAMRWasmModule::executeWasmFunctionFromPointer(faabric::Message& msg)
 {
     // WASM function pointers are indices into the module's function table
@@ -314,16 +381,6 @@ bool WAMRWasmModule::executeCatchException(WASMFunctionInstanceCommon* func,
                                            int argc,
                                            std::vector<uint32_t>& argv)
 {
-    bool isIndirect;
-    if (wasmFuncPtr == NO_WASM_FUNC_PTR && func != nullptr) {
-        isIndirect = false;
-    } else if (wasmFuncPtr != NO_WASM_FUNC_PTR && func == nullptr) {
-        isIndirect = true;
-    } else {
-        throw std::runtime_error(
-          "Incorrect combination of arguments to execute WAMR function");
-    }
-
     auto execEnvDtor = [&](WASMExecEnv* execEnv) {
         if (execEnv != nullptr) {
             wasm_runtime_destroy_exec_env(execEnv);
@@ -335,13 +392,29 @@ bool WAMRWasmModule::executeCatchException(WASMFunctionInstanceCommon* func,
 
     // Create an execution environment
     std::unique_ptr<WASMExecEnv, decltype(execEnvDtor)> execEnv(
-      wasm_exec_env_create(moduleInstance, STACK_SIZE_KB), execEnvDtor);
-    if (execEnv == nullptr) {
-        throw std::runtime_error("Error creating execution environment");
+      createExecEnv(), execEnvDtor);
+
+    return executeCatchException(execEnv.get(), func, wasmFuncPtr, argc, argv);
+}
+
+bool WAMRWasmModule::executeCatchException(WASMExecEnv* execEnv,
+                                           WASMFunctionInstanceCommon* func,
+                                           int wasmFuncPtr,
+                                           int argc,
+                                           std::vector<uint32_t>& argv)
+{
+    bool isIndirect;
+    if (wasmFuncPtr == NO_WASM_FUNC_PTR && func != nullptr) {
+        isIndirect = false;
+    } else if (wasmFuncPtr != NO_WASM_FUNC_PTR && func == nullptr) {
+        isIndirect = true;
+    } else {
+        throw std::runtime_error(
+          "Incorrect combination of arguments to execute WAMR function");
     }
 
     // Set thread handle and stack boundary (required by WAMR)
-    wasm_exec_env_set_thread_info(execEnv.get());
+    wasm_exec_env_set_thread_info(execEnv);
 
     bool success;
     {
@@ -353,10 +426,10 @@ bool WAMRWasmModule::executeCatchException(WASMFunctionInstanceCommon* func,
             case 0: {
                 if (isIndirect) {
                     success = wasm_runtime_call_indirect(
-                      execEnv.get(), wasmFuncPtr, argc, argv.data());
+                      execEnv, wasmFuncPtr, argc, argv.data());
                 } else {
-                    success = wasm_runtime_call_wasm(
-                      execEnv.get(), func, argc, argv.data());
+                    success =
+                      wasm_runtime_call_wasm(execEnv, func, argc, argv.data());
                 }
                 break;
             }
@@ -383,6 +456,92 @@ bool WAMRWasmModule::executeCatchException(WASMFunctionInstanceCommon* func,
     return success;
 }
 
+WASMExecEnv* WAMRWasmModule::createExecEnv()
+{
+    WASMExecEnv* execEnv = wasm_exec_env_create(moduleInstance, STACK_SIZE_KB);
+    if (execEnv == nullptr) {
+        throw std::runtime_error("Error creating execution environment");
+    }
+
+    // WAMR's thread manager splits the module's stack between the threads it
+    // spawns, but our threads run on their own stacks, so the main thread
+    // keeps all of it
+    auto* aotModule = reinterpret_cast<AOTModule*>(wasmModule);
+    if (!wasm_exec_env_set_aux_stack(
+          execEnv, aotModule->aux_stack_bottom, aotModule->aux_stack_size)) {
+        wasm_runtime_destroy_exec_env(execEnv);
+        SPDLOG_ERROR("Failed to set WAMR stack for {}/{}",
+                     boundUser,
+                     boundFunction);
+        throw std::runtime_error("Failed to set WAMR stack");
+    }
+
+    return execEnv;
+}
+
+WASMExecEnv* WAMRWasmModule::getPthreadExecEnv(int threadPoolIdx,
+                                               uint32_t stackTop)
+{
+    // Spawned exec envs have their own module instance, so each thread gets
+    // its own globals (including the stack pointer), but the instance shares
+    // the parent's linear memory
+    WASMExecEnv* execEnv = pthreadExecEnvs.at(threadPoolIdx);
+    if (execEnv == nullptr) {
+        // Memories are only shared if the module declares them as shared,
+        // otherwise the spawned instance gets its own copy
+        if (!isMemoryShared()) {
+            SPDLOG_ERROR("WAMR thread memory not shared for {}/{}",
+                         boundUser,
+                         boundFunction);
+            throw std::runtime_error("WAMR threads need shared memory");
+        }
+
+        execEnv = wasm_runtime_spawn_exec_env(threadsParentExecEnv);
+        if (execEnv == nullptr) {
+            SPDLOG_ERROR("Failed to spawn WAMR exec env for thread {} of {}",
+                         threadPoolIdx,
+                         wamrMaxThreads);
+            throw std::runtime_error("Failed to spawn WAMR exec env");
+        }
+        pthreadExecEnvs.at(threadPoolIdx) = execEnv;
+    }
+
+    // Pthreads expect to start on a clean stack
+    if (!wasm_exec_env_set_aux_stack(
+          execEnv, stackTop, THREAD_STACK_SIZE - 16)) {
+        SPDLOG_ERROR("Failed to set WAMR stack for thread {}", threadPoolIdx);
+        throw std::runtime_error("Failed to set WAMR thread stack");
+    }
+
+    return execEnv;
+}
+
+bool WAMRWasmModule::isMemoryShared()
+{
+    auto* aotModule = reinterpret_cast<AOTModule*>(wasmModule);
+    if (aotModule->memory_count == 0) {
+        return false;
+    }
+
+    return (aotModule->memories[0].memory_flags & SHARED_MEMORY_FLAG) != 0;
+}
+
+void WAMRWasmModule::destroyThreadExecEnvs()
+{
+    // Spawned exec envs must go before the one they were spawned from
+    for (auto& execEnv : pthreadExecEnvs) {
+        if (execEnv != nullptr) {
+            wasm_runtime_destroy_spawned_exec_env(execEnv);
+            execEnv = nullptr;
+        }
+    }
+
+    if (threadsParentExecEnv != nullptr) {
+        wasm_runtime_destroy_exec_env(threadsParentExecEnv);
+        threadsParentExecEnv = nullptr;
+    }
+}
+
 // -----
 // Exception handling
 // -----
@@ -428,6 +587,30 @@ void WAMRWasmModule::writeWasmEnvToWamrMemory(uint32_t* envOffsetsWasm,
       wasmEnvironment.getVars(), envOffsetsWasm, envBuffWasm);
 }
 
+void WAMRWasmModule::setGuestErrno(WASMExecEnv* execEnv, int err)
+{
+    // As with WAVM, errno lives in the guest's memory, so we ask the guest
+    // where it is using the calling exec env (i.e. the right thread)
+    WASMFunctionInstanceCommon* errnoFunc =
+      wasm_runtime_lookup_function(moduleInstance, "__errno_location", nullptr);
+    if (errnoFunc == nullptr) {
+        SPDLOG_DEBUG("Guest does not export __errno_location, not setting {}",
+                     err);
+        return;
+    }
+
+    // We're already inside a native call here, so we don't go through
+    // executeCatchException, which would clobber its jump buffer
+    uint32_t argv[1] = { 0 };
+    if (!wasm_runtime_call_wasm(execEnv, errnoFunc, 0, argv)) {
+        SPDLOG_WARN("Failed to get guest errno location");
+        return;
+    }
+
+    validateWasmOffset(argv[0], sizeof(int32_t));
+    *reinterpret_cast<int32_t*>(wasmPointerToNative(argv[0])) = err;
+}
+
 void WAMRWasmModule::validateWasmOffset(uint32_t wasmOffset, size_t size)
 {
     if (!wasm_runtime_validate_app_addr(moduleInstance, wasmOffset, size)) {
@@ -2,6 +2,7 @@
 #include <storage/FileDescriptor.h>
 #include <wamr/WAMRWasmModule.h>
 #include <wamr/native.h>
+#include <wasm/scheduling.h>
 
 #include <stdexcept>
 #include <sys/random.h>
@@ -107,6 +108,15 @@ static uint32_t wasi_random_get(wasm_exec_env_t exec_env,
     return __WASI_ESUCCESS;
 }
 
+static uint32_t wasi_sched_yield(wasm_exec_env_t exec_env)
+{
+    SPDLOG_TRACE("S - sched_yield");
+
+    yieldGuest();
+
+    return __WASI_ESUCCESS;
+}
+
 static NativeSymbol wasiNs[] = {
     REG_WASI_NATIVE_FUNC(args_get, "(**)i"),
     REG_WASI_NATIVE_FUNC(args_sizes_get, "(**)i"),
@@ -114,6 +124,7 @@ static NativeSymbol wasiNs[] = {
     REG_WASI_NATIVE_FUNC(environ_sizes_get, "(**)i"),
     REG_WASI_NATIVE_FUNC(proc_exit, "(i)"),
     REG_WASI_NATIVE_FUNC(random_get, "(*~)i"),
+    REG_WASI_NATIVE_FUNC(sched_yield, "()i"),
 };
 
 uint32_t getFaasmWasiEnvApi(NativeSymbol** nativeSymbols)
@@ -87,9 +87,11 @@ static int32_t wasi_fd_close(wasm_exec_env_t exec_env, int32_t fd)
 {
     SPDLOG_DEBUG("S - fd_close {}", fd);
 
-    // Ignore for now
+    // Unknown fds are ignored, as they may be host sockets. Preopened fds are
+    // also left open
+    getExecutingWAMRModule()->getFileSystem().closeFileDescriptor(fd);
 
-    return 0;
+    return __WASI_ESUCCESS;
 }
 
 static int32_t wasi_fd_fdstat_get(wasm_exec_env_t exec_env,
@@ -185,6 +187,27 @@ static int32_t wasi_fd_filestat_set_size(wasm_exec_env_t execEnv,
     throw std::runtime_error("wasi_fd_filestat_set_size not implemented!");
 }
 
+static std::vector<::iovec> wasiIovecsToNative(WAMRWasmModule* module,
+                                               const iovec_app_t* iovecWasm,
+                                               uint32_t iovecLen)
+{
+    module->validateNativePointer((void*)iovecWasm,
+                                  sizeof(iovec_app_t) * iovecLen);
+
+    std::vector<::iovec> iovecNative(iovecLen, (::iovec){});
+    for (uint32_t i = 0; i < iovecLen; i++) {
+        module->validateWasmOffset(iovecWasm[i].buffOffset,
+                                   sizeof(char) * iovecWasm[i].buffLen);
+
+        iovecNative[i] = {
+            .iov_base = module->wasmPointerToNative(iovecWasm[i].buffOffset),
+            .iov_len = iovecWasm[i].buffLen,
+        };
+    }
+
+    return iovecNative;
+}
+
 static uint32_t wasi_fd_pread(wasm_exec_env_t exec_env,
                               __wasi_fd_t fd,
                               iovec_app_t* iovecWasm,
@@ -192,8 +215,24 @@ static uint32_t wasi_fd_pread(wasm_exec_env_t exec_env,
                               __wasi_filesize_t offset,
                               uint32_t* nReadWasm)
 {
-    SPDLOG_DEBUG("S - fd_pread {}");
-    throw std::runtime_error("fd_pread not implemented");
+    SPDLOG_TRACE("S - fd_pread {} {} {}", fd, iovecLen, offset);
+
+    WAMRWasmModule* module = getExecutingWAMRModule();
+    module->validateNativePointer(nReadWasm, sizeof(uint32_t));
+
+    std::vector<::iovec> iovecNative =
+      wasiIovecsToNative(module, iovecWasm, iovecLen);
+
+    storage::FileDescriptor& fileDesc =
+      module->getFileSystem().getFileDescriptor(fd);
+    ssize_t bytesRead = fileDesc.pread(iovecNative, iovecLen, offset);
+    if (bytesRead < 0) {
+        return fileDesc.getWasiErrno();
+    }
+
+    *nReadWasm = bytesRead;
+
+    return __WASI_ESUCCESS;
 }
 
 static int32_t wasi_fd_prestat_dir_name(wasm_exec_env_t exec_env,
@@ -244,8 +283,24 @@ static uint32_t wasi_fd_pwrite(wasm_exec_env_t exec_env,
                                __wasi_filesize_t offset,
                                uint32_t* nWrittenWasm)
 {
-    SPDLOG_DEBUG("S - fd_pwrite {}");
-    throw std::runtime_error("fd_pwrite not implemented");
+    SPDLOG_TRACE("S - fd_pwrite {} {} {}", fd, iovecLen, offset);
+
+    WAMRWasmModule* module = getExecutingWAMRModule();
+    module->validateNativePointer(nWrittenWasm, sizeof(uint32_t));
+
+    std::vector<::iovec> iovecNative =
+      wasiIovecsToNative(module, iovecWasm, iovecLen);
+
+    storage::FileDescriptor& fileDesc =
+      module->getFileSystem().getFileDescriptor(fd);
+    ssize_t bytesWritten = fileDesc.pwrite(iovecNative, iovecLen, offset);
+    if (bytesWritten < 0) {
+        return fileDesc.getWasiErrno();
+    }
+
+    *nWrittenWasm = bytesWritten;
+
+    return __WASI_ESUCCESS;
 }
 
 static int32_t wasi_fd_read(wasm_exec_env_t exec_env,
@@ -260,25 +315,17 @@ static int32_t wasi_fd_read(wasm_exec_env_t exec_env,
 
     SPDLOG_TRACE("S - fd_read {} ({})", fd, path);
 
-    storage::FileDescriptor fileDesc = fileSystem.getFileDescriptor(fd);
-
-    // Translate app iovecs to native ones
-    std::vector<::iovec> ioVecBuffNative(ioVecCountWasm, (::iovec){});
-    for (int i = 0; i < ioVecCountWasm; i++) {
-        module->validateWasmOffset(ioVecBuffWasm[i].buffOffset,
-                                   sizeof(char) * ioVecBuffWasm[i].buffLen);
+    storage::FileDescriptor& fileDesc = fileSystem.getFileDescriptor(fd);
+    std::vector<::iovec> ioVecBuffNative =
+      wasiIovecsToNative(module, ioVecBuffWasm, ioVecCountWasm);
 
-        ioVecBuffNative[i] = {
-            .iov_base =
-              module->wasmPointerToNative(ioVecBuffWasm[i].buffOffset),
-            .iov_len = ioVecBuffWasm[i].buffLen,
-        };
+    module->validateNativePointer(bytesRead, sizeof(int32_t));
+    ssize_t res = fileDesc.read(ioVecBuffNative, ioVecCountWasm);
+    if (res < 0) {
+        return fileDesc.getWasiErrno();
     }
 
-    // Read from fd
-    module->validateNativePointer(bytesRead, sizeof(int32_t));
-    *bytesRead =
-      ::readv(fileDesc.getLinuxFd(), ioVecBuffNative.data(), ioVecCountWasm);
+    *bytesRead = (int32_t)res;
 
     return __WASI_ESUCCESS;
 }
@@ -365,8 +412,7 @@ static int32_t wasi_fd_write(wasm_exec_env_t exec_env,
     storage::FileDescriptor& fileDesc = fileSystem.getFileDescriptor(fd);
     ssize_t n = fileDesc.write(ioVecBuffNative, ioVecCountWasm);
     if (n < 0) {
-        SPDLOG_ERROR(
-          "writev failed on fd {}: {}", fileDesc.getLinuxFd(), strerror(errno));
+        return fileDesc.getWasiErrno();
     }
 
     // Write number of bytes to wasm
@@ -1,7 +1,10 @@
 #include <faabric/util/logging.h>
+#include <wamr/WAMRWasmModule.h>
 #include <wamr/native.h>
 #include <wasm/WasmEnvironment.h>
+#include <wasm/scheduling.h>
 
+#include <sys/resource.h>
 #include <wasm_export.h>
 
 namespace wasm {
@@ -11,6 +14,26 @@ static uint32_t getpid_wrapper(wasm_exec_env_t exec_env, uint32_t a)
     return FAKE_PID;
 }
 
+// Guests can only see and change their own priority
+static bool isOwnPriority(int32_t which, int32_t who)
+{
+    return which == PRIO_PROCESS && (who == 0 || who == FAKE_PID);
+}
+
+static int32_t getpriority_wrapper(wasm_exec_env_t exec_env,
+                                   int32_t which,
+                                   int32_t who)
+{
+    SPDLOG_DEBUG("S - getpriority {} {}", which, who);
+
+    if (!isOwnPriority(which, who)) {
+        getExecutingWAMRModule()->setGuestErrno(exec_env, ESRCH);
+        return -1;
+    }
+
+    return getGuestPriority();
+}
+
 static uint32_t pclose_wrapper(wasm_exec_env_t exec_env, uint32_t a)
 {
     SPDLOG_DEBUG("pclose");
@@ -29,6 +52,22 @@ static uint32_t raise_wrapper(wasm_exec_env_t exec_env, uint32_t a)
     throw std::runtime_error("raise not implemented");
 }
 
+static int32_t setpriority_wrapper(wasm_exec_env_t exec_env,
+                                   int32_t which,
+                                   int32_t who,
+                                   int32_t prio)
+{
+    SPDLOG_DEBUG("S - setpriority {} {} {}", which, who, prio);
+
+    int err = isOwnPriority(which, who) ? -setGuestPriority(prio) : ESRCH;
+    if (err != 0) {
+        getExecutingWAMRModule()->setGuestErrno(exec_env, err);
+        return -1;
+    }
+
+    return 0;
+}
+
 static uint32_t system_wrapper(wasm_exec_env_t exec_env, uint32_t a)
 {
     SPDLOG_DEBUG("system");
@@ -36,8 +75,12 @@ static uint32_t system_wrapper(wasm_exec_env_t exec_env, uint32_t a)
 }
 
 static NativeSymbol ns[] = {
-    REG_NATIVE_FUNC(getpid, "()i"),  REG_NATIVE_FUNC(pclose, "(i)i"),
-    REG_NATIVE_FUNC(popen, "(ii)i"), REG_NATIVE_FUNC(raise, "(i)i"),
+    REG_NATIVE_FUNC(getpid, "()i"),
+    REG_NATIVE_FUNC(getpriority, "(ii)i"),
+    REG_NATIVE_FUNC(pclose, "(i)i"),
+    REG_NATIVE_FUNC(popen, "(ii)i"),
+    REG_NATIVE_FUNC(raise, "(i)i"),
+    REG_NATIVE_FUNC(setpriority, "(iii)i"),
     REG_NATIVE_FUNC(system, "(i)i"),
 };
 
@@ -1,33 +1,91 @@
+#include <faabric/proto/faabric.pb.h>
+#include <faabric/scheduler/ExecutorContext.h>
+#include <faabric/util/logging.h>
+#include <threads/ThreadState.h>
+#include <wamr/WAMRWasmModule.h>
 #include <wamr/native.h>
+#include <wamr/types.h>
+#include <wasm/ParkingLot.h>
+#include <wasm/WasmExecutionContext.h>
+#include <wasm/WasmModule.h>
+
 #include <wasm_export.h>
 
-#include <faabric/util/logging.h>
+#include <chrono>
+#include <climits>
+#include <optional>
+
+using namespace faabric::scheduler;
 
 namespace wasm {
 
 // -------------------------------------------
-// 14/04/21 - WAMR threading not implemented
-// All of these functions are stubbed as threading with WAMR isn't yet
-// implemented. Once it is, we will need to implement the function here,
-// exepctially the locking which is used to manage thread-safe memory
-// provisioning.
+// PTHREADS - As with WAVM, we intercept the pthread API at a high level and
+// run threads as batches of thread calls, using the int value of the pthread
+// pointer as its ID. Each thread runs in its own exec env, spawned from the
+// module's, with its own stack in the shared linear memory.
 // -------------------------------------------
 
 static int32_t pthread_create_wrapper(wasm_exec_env_t exec_env,
-                                      int32_t a,
-                                      int32_t b,
-                                      int32_t c,
-                                      int32_t d)
+                                      int32_t pthreadPtr,
+                                      int32_t attrPtr,
+                                      int32_t entryFunc,
+                                      int32_t argsPtr)
 {
-    SPDLOG_DEBUG("S - pthread_create {} {} {} {}", a, b, c, d);
+    SPDLOG_DEBUG("S - pthread_create {} {} {} {}",
+                 pthreadPtr,
+                 attrPtr,
+                 entryFunc,
+                 argsPtr);
+
+    // Setting the self pointer is crucial for inter-operation with existing C
+    // code
+    WAMRWasmModule* module = getExecutingWAMRModule();
+    module->validateWasmOffset(pthreadPtr, sizeof(wasm_pthread_app_t));
+    auto* pthreadNative = reinterpret_cast<wasm_pthread_app_t*>(
+      module->wasmPointerToNative(pthreadPtr));
+    pthreadNative->selfPtr = pthreadPtr;
+
+    threads::PthreadCall pthreadCall;
+    pthreadCall.pthreadPtr = pthreadPtr;
+    pthreadCall.entryFunc = entryFunc;
+    pthreadCall.argsPtr = argsPtr;
+
+    module->queuePthreadCall(pthreadCall);
+
     return 0;
 }
 
 static int32_t pthread_join_wrapper(wasm_exec_env_t exec_env,
-                                    int32_t a,
-                                    int32_t b)
+                                    int32_t pthreadPtr,
+                                    int32_t resPtrPtr)
 {
-    SPDLOG_DEBUG("S - pthread_join {} {}", a, b);
+    SPDLOG_DEBUG("S - pthread_join {} {}", pthreadPtr, resPtrPtr);
+
+    faabric::Message* call = &ExecutorContext::get()->getMsg();
+    WAMRWasmModule* module = getExecutingWAMRModule();
+
+    int returnValue = module->awaitPthreadCall(call, pthreadPtr);
+
+    // The result is written through a pointer to a wasm pointer, which may be
+    // null if the caller doesn't want it
+    if (resPtrPtr != 0) {
+        module->validateWasmOffset(resPtrPtr, sizeof(int32_t));
+        *reinterpret_cast<int32_t*>(module->wasmPointerToNative(resPtrPtr)) =
+          returnValue;
+    }
+
+    return 0;
+}
+
+static void pthread_exit_wrapper(wasm_exec_env_t exec_env, int32_t code)
+{
+    SPDLOG_DEBUG("S - pthread_exit {}", code);
+}
+
+static int32_t pthread_self_wrapper(wasm_exec_env_t exec_env)
+{
+    SPDLOG_TRACE("S - pthread_self");
     return 0;
 }
 
@@ -40,106 +98,237 @@ static int32_t pthread_once_wrapper(wasm_exec_env_t exec_env,
     return 0;
 }
 
+static int32_t pthread_equal_wrapper(wasm_exec_env_t exec_env,
+                                     int32_t a,
+                                     int32_t b)
+{
+    SPDLOG_TRACE("S - pthread_equal {} {}", a, b);
+    return a == b;
+}
+
+// -------------------------------------------
+// PTHREAD MUTEXES - These use the same lock word (or host-side mutex) as WAVM,
+// so only work between threads on the same host. Trace logging as these are
+// invoked a lot
+// -------------------------------------------
+
 static int32_t pthread_mutex_init_wrapper(wasm_exec_env_t exec_env,
-                                          int32_t a,
-                                          int32_t b)
+                                          int32_t mx,
+                                          int32_t attr)
+{
+    SPDLOG_TRACE("S - pthread_mutex_init {} {}", mx, attr);
+    getExecutingModule()->initGuestMutex(mx);
+
+    return 0;
+}
+
+static int32_t pthread_mutex_lock_wrapper(wasm_exec_env_t exec_env, int32_t mx)
 {
-    SPDLOG_DEBUG("S - pthread_mutex_init {} {}", a, b);
+    SPDLOG_TRACE("S - pthread_mutex_lock {}", mx);
+    getExecutingModule()->lockGuestMutex(mx);
+
     return 0;
 }
 
-static int32_t pthread_mutex_lock_wrapper(wasm_exec_env_t exec_env, int32_t a)
+static int32_t pthread_mutex_trylock_wrapper(wasm_exec_env_t exec_env,
+                                             int32_t mx)
 {
-    SPDLOG_TRACE("S - pthread_mutex_lock {}", a);
+    SPDLOG_TRACE("S - pthread_mutex_trylock {}", mx);
+
+    if (!getExecutingModule()->tryLockGuestMutex(mx)) {
+        return EBUSY;
+    }
+
     return 0;
 }
 
-static int32_t pthread_mutex_unlock_wrapper(wasm_exec_env_t exec_env, int32_t a)
+static int32_t pthread_mutex_unlock_wrapper(wasm_exec_env_t exec_env,
+                                            int32_t mx)
 {
-    SPDLOG_TRACE("S - pthread_mutex_unlock {}", a);
+    SPDLOG_TRACE("S - pthread_mutex_unlock {}", mx);
+    getExecutingModule()->unlockGuestMutex(mx);
+
     return 0;
 }
 
 static int32_t pthread_mutex_destroy_wrapper(wasm_exec_env_t exec_env,
-                                             int32_t a)
+                                             int32_t mx)
 {
-    SPDLOG_DEBUG("S - pthread_mutex_destroy {}", a);
+    SPDLOG_TRACE("S - pthread_mutex_destroy {}", mx);
     return 0;
 }
 
-static int32_t pthread_cond_init_wrapper(wasm_exec_env_t exec_env,
-                                         int32_t a,
-                                         int32_t b)
+static int32_t pthread_mutexattr_init_wrapper(wasm_exec_env_t exec_env,
+                                              int32_t a)
 {
-    SPDLOG_DEBUG("S - pthread_cond_init {}", a, b);
+    SPDLOG_TRACE("S - pthread_mutexattr_init {}", a);
     return 0;
 }
 
-static int32_t pthread_cond_signal_wrapper(wasm_exec_env_t exec_env, int32_t a)
+static int32_t pthread_mutexattr_destroy_wrapper(wasm_exec_env_t exec_env,
+                                                 int32_t a)
 {
-    SPDLOG_DEBUG("S - pthread_cond_signal {}", a);
+    SPDLOG_TRACE("S - pthread_mutexattr_destroy {}", a);
+    return 0;
+}
+
+// -------------------------------------------
+// CONDITION VARIABLES
+// -------------------------------------------
+
+static int32_t pthread_cond_init_wrapper(wasm_exec_env_t exec_env,
+                                         int32_t cond,
+                                         int32_t attr)
+{
+    SPDLOG_TRACE("S - pthread_cond_init {} {}", cond, attr);
     return 0;
 }
 
 static int32_t pthread_cond_wait_wrapper(wasm_exec_env_t exec_env,
-                                         int32_t a,
-                                         int32_t b)
+                                         int32_t cond,
+                                         int32_t mx)
+{
+    SPDLOG_TRACE("S - pthread_cond_wait {} {}", cond, mx);
+
+    return getExecutingModule()->waitOnGuestCond(cond, mx, std::nullopt);
+}
+
+static int32_t pthread_cond_timedwait_wrapper(wasm_exec_env_t exec_env,
+                                              int32_t cond,
+                                              int32_t mx,
+                                              wasm_timespec_app_t* abstime)
+{
+    SPDLOG_TRACE("S - pthread_cond_timedwait {} {}", cond, mx);
+
+    WAMRWasmModule* module = getExecutingWAMRModule();
+    module->validateNativePointer(abstime, sizeof(wasm_timespec_app_t));
+    if (abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000) {
+        return EINVAL;
+    }
+
+    // The timeout is on the realtime clock, but we wait on the steady clock
+    auto target = std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::seconds(abstime->tv_sec) +
+        std::chrono::nanoseconds(abstime->tv_nsec)));
+    ParkingLot::Deadline deadline =
+      std::chrono::steady_clock::now() +
+      (target - std::chrono::system_clock::now());
+
+    return module->waitOnGuestCond(cond, mx, deadline);
+}
+
+static int32_t pthread_cond_signal_wrapper(wasm_exec_env_t exec_env,
+                                           int32_t cond)
 {
-    SPDLOG_DEBUG("S - pthread_cond_wait {}", a, b);
+    SPDLOG_TRACE("S - pthread_cond_signal {}", cond);
+    getExecutingModule()->getParkingLot().unpark(cond, 1);
+
     return 0;
 }
 
 static int32_t pthread_cond_broadcast_wrapper(wasm_exec_env_t exec_env,
-                                              int32_t a)
+                                              int32_t cond)
 {
-    SPDLOG_DEBUG("S - pthread_cond_broadcast {}", a);
+    SPDLOG_TRACE("S - pthread_cond_broadcast {}", cond);
+    getExecutingModule()->getParkingLot().unpark(cond, INT_MAX);
+
     return 0;
 }
 
-static int32_t pthread_cond_destroy_wrapper(wasm_exec_env_t exec_env, int32_t a)
+static int32_t pthread_cond_destroy_wrapper(wasm_exec_env_t exec_env,
+                                            int32_t cond)
 {
-    SPDLOG_DEBUG("S - pthread_cond_destroy {}", a);
+    SPDLOG_TRACE("S - pthread_cond_destroy {}", cond);
     return 0;
 }
 
-static int32_t pthread_mutexattr_init_wrapper(wasm_exec_env_t exec_env,
-                                              int32_t a)
+// -------------------------------------------
+// PTHREAD KEYS
+// -------------------------------------------
+
+static int32_t pthread_key_create_wrapper(wasm_exec_env_t exec_env,
+                                          uint32_t* keyPtr,
+                                          int32_t destructor)
 {
-    SPDLOG_DEBUG("S - pthread_mutexattr_init {}", a);
+    SPDLOG_TRACE("S - pthread_key_create {}", destructor);
+
+    WAMRWasmModule* module = getExecutingWAMRModule();
+    module->validateNativePointer(keyPtr, sizeof(uint32_t));
+
+    int key = module->getPthreadKeys().createKey(destructor);
+    if (key < 0) {
+        return EAGAIN;
+    }
+
+    *keyPtr = key;
+
     return 0;
 }
 
-static int32_t pthread_mutexattr_destroy_wrapper(wasm_exec_env_t exec_env,
-                                                 int32_t a)
+static int32_t pthread_key_delete_wrapper(wasm_exec_env_t exec_env,
+                                          int32_t key)
 {
-    SPDLOG_DEBUG("S - pthread_mutexattr_destroy {}", a);
+    SPDLOG_TRACE("S - pthread_key_delete {}", key);
+
+    if (!getExecutingModule()->getPthreadKeys().deleteKey(key)) {
+        return EINVAL;
+    }
+
     return 0;
 }
 
-static int32_t pthread_equal_wrapper(wasm_exec_env_t exec_env,
-                                     int32_t a,
-                                     int32_t b)
+static int32_t pthread_getspecific_wrapper(wasm_exec_env_t exec_env,
+                                           int32_t key)
+{
+    SPDLOG_TRACE("S - pthread_getspecific {}", key);
+
+    if (!getExecutingModule()->getPthreadKeys().isKeyInUse(key)) {
+        return 0;
+    }
+
+    return threads::getPthreadKeyValue(key);
+}
+
+static int32_t pthread_setspecific_wrapper(wasm_exec_env_t exec_env,
+                                           int32_t key,
+                                           int32_t value)
 {
-    SPDLOG_DEBUG("S - pthread_equal {} {}", a, b);
+    SPDLOG_TRACE("S - pthread_setspecific {} {}", key, value);
+
+    if (!getExecutingModule()->getPthreadKeys().isKeyInUse(key)) {
+        return EINVAL;
+    }
+
+    threads::setPthreadKeyValue(key, value);
+
     return 0;
 }
 
 static NativeSymbol ns[] = {
     REG_NATIVE_FUNC(pthread_create, "(iiii)i"),
     REG_NATIVE_FUNC(pthread_join, "(ii)i"),
+    REG_NATIVE_FUNC(pthread_exit, "(i)"),
+    REG_NATIVE_FUNC(pthread_self, "()i"),
     REG_NATIVE_FUNC(pthread_once, "(ii)i"),
+    REG_NATIVE_FUNC(pthread_equal, "(ii)i"),
     REG_NATIVE_FUNC(pthread_mutex_init, "(ii)i"),
     REG_NATIVE_FUNC(pthread_mutex_lock, "(i)i"),
+    REG_NATIVE_FUNC(pthread_mutex_trylock, "(i)i"),
     REG_NATIVE_FUNC(pthread_mutex_unlock, "(i)i"),
     REG_NATIVE_FUNC(pthread_mutex_destroy, "(i)i"),
+    REG_NATIVE_FUNC(pthread_mutexattr_init, "(i)i"),
+    REG_NATIVE_FUNC(pthread_mutexattr_destroy, "(i)i"),
     REG_NATIVE_FUNC(pthread_cond_init, "(ii)i"),
-    REG_NATIVE_FUNC(pthread_cond_signal, "(i)i"),
     REG_NATIVE_FUNC(pthread_cond_wait, "(ii)i"),
+    REG_NATIVE_FUNC(pthread_cond_timedwait, "(ii*)i"),
+    REG_NATIVE_FUNC(pthread_cond_signal, "(i)i"),
     REG_NATIVE_FUNC(pthread_cond_broadcast, "(i)i"),
     REG_NATIVE_FUNC(pthread_cond_destroy, "(i)i"),
-    REG_NATIVE_FUNC(pthread_mutexattr_init, "(i)i"),
-    REG_NATIVE_FUNC(pthread_mutexattr_destroy, "(i)i"),
-    REG_NATIVE_FUNC(pthread_equal, "(ii)i"),
+    REG_NATIVE_FUNC(pthread_key_create, "(*i)i"),
+    REG_NATIVE_FUNC(pthread_key_delete, "(i)i"),
+    REG_NATIVE_FUNC(pthread_getspecific, "(i)i"),
+    REG_NATIVE_FUNC(pthread_setspecific, "(ii)i"),
 };
 
 uint32_t getFaasmPthreadApi(NativeSymbol** nativeSymbols)
@@ -3,6 +3,7 @@
 #include <wamr/WAMRWasmModule.h>
 #include <wamr/native.h>
 #include <wamr/types.h>
+#include <wasm/poll.h>
 
 #include <stdexcept>
 #include <sys/time.h>
@@ -16,31 +17,13 @@ uint32_t wasi_clock_time_get(wasm_exec_env_t exec_env,
 {
     SPDLOG_TRACE("S - clock_time_get");
 
-    timespec ts{};
-
-    // This switch statement is duplicated in src/wavm/timing.cpp the reason
-    // being that, even though the constants should be the same, they are
-    // defined in runtime-specific headers. Instead of mixing them up, we
-    // keep the code duplicated
-    int linuxClockId;
-    switch (clockId) {
-        case __WASI_CLOCK_REALTIME:
-            linuxClockId = CLOCK_REALTIME;
-            break;
-        case __WASI_CLOCK_MONOTONIC:
-            linuxClockId = CLOCK_MONOTONIC;
-            break;
-        case __WASI_CLOCK_PROCESS_CPUTIME_ID:
-            linuxClockId = CLOCK_PROCESS_CPUTIME_ID;
-            break;
-        case __WASI_CLOCK_THREAD_CPUTIME_ID:
-            linuxClockId = CLOCK_THREAD_CPUTIME_ID;
-            break;
-        default:
-            SPDLOG_ERROR("Unknown clock ID: {}", clockId);
-            throw std::runtime_error("Unknown clock ID");
+    int linuxClockId = wasiClockToLinux(clockId);
+    if (linuxClockId < 0) {
+        SPDLOG_ERROR("Unknown clock ID: {}", clockId);
+        throw std::runtime_error("Unknown clock ID");
     }
 
+    timespec ts{};
     int retVal = clock_gettime(linuxClockId, &ts);
     if (retVal < 0) {
         if (EINVAL) {
@@ -56,6 +39,23 @@ uint32_t wasi_clock_time_get(wasm_exec_env_t exec_env,
     return __WASI_ESUCCESS;
 }
 
+uint32_t wasi_clock_res_get(wasm_exec_env_t exec_env,
+                            int32_t clockId,
+                            int64_t* result)
+{
+    SPDLOG_TRACE("S - clock_res_get");
+
+    getExecutingWAMRModule()->validateNativePointer(result, sizeof(int64_t));
+
+    uint64_t resNanos = 0;
+    uint16_t err = wasiClockResolution(clockId, &resNanos);
+    if (err == __WASI_ESUCCESS) {
+        *result = resNanos;
+    }
+
+    return err;
+}
+
 uint32_t wasi_poll_oneoff(wasm_exec_env_t exec_env,
                           int32_t* subscriptionsPtr,
                           int64_t* eventsPtr,
@@ -64,6 +64,10 @@ uint32_t wasi_poll_oneoff(wasm_exec_env_t exec_env,
 {
     SPDLOG_DEBUG("S - poll_oneoff");
 
+    if (nSubs <= 0) {
+        return __WASI_EINVAL;
+    }
+
     WAMRWasmModule* module = getExecutingWAMRModule();
 
     module->validateNativePointer(subscriptionsPtr,
@@ -73,43 +77,42 @@ uint32_t wasi_poll_oneoff(wasm_exec_env_t exec_env,
     module->validateNativePointer(eventsPtr, nSubs * sizeof(__wasi_event_t));
     auto* outEvents = reinterpret_cast<__wasi_event_t*>(eventsPtr);
 
-    // Note: the WAVM implementation is out of date and does not follow the
-    // WASI spec anymore!
+    std::vector<PollSubscription> subs(nSubs);
     for (int i = 0; i < nSubs; i++) {
-        const __wasi_subscription_t* thisSub = &inEvents[i];
-
-        if (thisSub->u.type == __WASI_EVENTTYPE_CLOCK) {
-            // This is a timing event like a sleep
-            uint64_t timeoutNanos = thisSub->u.u.clock.timeout;
-            int clockType = 0;
-            if (thisSub->u.u.clock.clock_id == __WASI_CLOCK_MONOTONIC) {
-                clockType = CLOCK_MONOTONIC;
-            } else if (thisSub->u.u.clock.clock_id == __WASI_CLOCK_REALTIME) {
-                clockType = CLOCK_REALTIME;
-            } else {
-                throw std::runtime_error("Unimplemented clock type");
-            }
-
-            // Do the sleep
-            timespec t{};
-            faabric::util::nanosToTimespec(timeoutNanos, &t);
-            clock_nanosleep(clockType, 0, &t, nullptr);
+        const __wasi_subscription_t& inSub = inEvents[i];
+        subs[i].userdata = inSub.userdata;
+        subs[i].type = inSub.u.type;
+
+        if (inSub.u.type == __WASI_EVENTTYPE_CLOCK) {
+            subs[i].clockId = inSub.u.u.clock.clock_id;
+            subs[i].timeout = inSub.u.u.clock.timeout;
+            subs[i].flags = inSub.u.u.clock.flags;
+        } else if (inSub.u.type == __WASI_EVENTTYPE_FD_READ) {
+            subs[i].fd = inSub.u.u.fd_read.file_descriptor;
         } else {
-            throw std::runtime_error("Unimplemented event type");
+            subs[i].fd = inSub.u.u.fd_write.file_descriptor;
         }
+    }
+
+    std::vector<PollEvent> events =
+      pollOneoff(module->getFileSystem(), subs, false);
 
-        // Say that the event has occurred
-        __wasi_event_t* thisEvent = &outEvents[i];
-        thisEvent->type = thisSub->u.type;
-        thisEvent->error = __WASI_ESUCCESS;
+    for (size_t i = 0; i < events.size(); i++) {
+        __wasi_event_t* outEvent = &outEvents[i];
+        outEvent->userdata = events[i].userdata;
+        outEvent->error = events[i].error;
+        outEvent->type = events[i].type;
+        outEvent->fd_readwrite.nbytes = events[i].nBytes;
+        outEvent->fd_readwrite.flags = events[i].flags;
     }
 
-    *resNEvents = nSubs;
+    *resNEvents = events.size();
 
     return __WASI_ESUCCESS;
 }
 
 static NativeSymbol wasiNs[] = {
+    REG_WASI_NATIVE_FUNC(clock_res_get, "(i*)i"),
     REG_WASI_NATIVE_FUNC(clock_time_get, "(iI*)i"),
     REG_WASI_NATIVE_FUNC(poll_oneoff, "(**i*)i"),
 };
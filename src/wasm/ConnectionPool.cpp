@@ -0,0 +1,297 @@
+#include <conf/FaasmConfig.h>
+#include <faabric/util/logging.h>
+#include <wasm/ConnectionPool.h>
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <unistd.h>
+
+namespace wasm {
+
+static bool isPoolingOn()
+{
+    return conf::getFaasmConfig().connPoolMode == "on";
+}
+
+// Only ports that are explicitly listed are pooled, as a pooled TLS
+// connection can't be reused
+static bool isPoolablePort(uint16_t port)
+{
+    const std::string& ports = conf::getFaasmConfig().connPoolPorts;
+    std::istringstream portsStream(ports);
+    std::string p;
+    while (std::getline(portsStream, p, ',')) {
+        if (!p.empty() && std::stoi(p) == port) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Connections are pooled by address and port. Only TCP connections to
+ * permitted ports are pooled, anything else gets an empty key.
+ */
+static std::string getDestinationKey(int fd,
+                                     const ::sockaddr* addr,
+                                     socklen_t addrLen)
+{
+    int sockType = 0;
+    socklen_t sockTypeLen = sizeof(sockType);
+    if (::getsockopt(fd, SOL_SOCKET, SO_TYPE, &sockType, &sockTypeLen) != 0 ||
+        sockType != SOCK_STREAM) {
+        return "";
+    }
+
+    char addrStr[INET6_ADDRSTRLEN] = { 0 };
+    uint16_t port;
+    if (addr->sa_family == AF_INET && addrLen >= sizeof(::sockaddr_in)) {
+        auto inAddr = reinterpret_cast<const ::sockaddr_in*>(addr);
+        ::inet_ntop(AF_INET, &inAddr->sin_addr, addrStr, sizeof(addrStr));
+        port = ntohs(inAddr->sin_port);
+    } else if (addr->sa_family == AF_INET6 &&
+               addrLen >= sizeof(::sockaddr_in6)) {
+        auto in6Addr = reinterpret_cast<const ::sockaddr_in6*>(addr);
+        ::inet_ntop(AF_INET6, &in6Addr->sin6_addr, addrStr, sizeof(addrStr));
+        port = ntohs(in6Addr->sin6_port);
+    } else {
+        return "";
+    }
+
+    if (!isPoolablePort(port)) {
+        return "";
+    }
+
+    return std::string(addrStr) + ":" + std::to_string(port);
+}
+
+/**
+ * An idle connection is healthy if it's connected and nothing has happened on
+ * it. Anything to read means the peer has closed it, or the guest left a
+ * response unread, so either way it can't be reused.
+ */
+static bool isHealthy(int fd)
+{
+    ::pollfd pfd{ .fd = fd, .events = POLLIN | POLLRDHUP, .revents = 0 };
+    if (::poll(&pfd, 1, 0) != 0) {
+        return false;
+    }
+
+    // Peek without blocking too, a read of zero means the peer has closed it
+    char peekBuf;
+    ssize_t peeked = ::recv(fd, &peekBuf, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (peeked >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        return false;
+    }
+
+    // Also catch connects that never finished
+    ::sockaddr_storage peer{};
+    socklen_t peerLen = sizeof(peer);
+    return ::getpeername(fd, (::sockaddr*)&peer, &peerLen) == 0;
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    for (const auto& [fd, destKey] : guestSockets) {
+        ::close(fd);
+    }
+
+    clear();
+}
+
+void ConnectionPool::addGuestSocket(int fd)
+{
+    std::scoped_lock<std::mutex> lock(mx);
+    guestSockets[fd] = "";
+}
+
+int ConnectionPool::connect(int fd, const ::sockaddr* addr, socklen_t addrLen)
+{
+    std::string destKey;
+    if (isPoolingOn()) {
+        destKey = getDestinationKey(fd, addr, addrLen);
+    }
+
+    if (!destKey.empty()) {
+        std::scoped_lock<std::mutex> lock(mx);
+
+        // Options the guest has set would be lost when swapping in a pooled
+        // connection, and couldn't be undone if this one were pooled later
+        int pooledFd = -1;
+        if (customisedSockets.count(fd) > 0) {
+            destKey.clear();
+        } else {
+            pooledFd = claimIdleConnection(destKey);
+        }
+
+        if (pooledFd >= 0) {
+            // Swap the pooled connection in under the guest's fd, keeping any
+            // flags the guest has set (e.g. O_NONBLOCK)
+            int flags = ::fcntl(fd, F_GETFL);
+            int res = ::dup2(pooledFd, fd);
+            int err = errno;
+            ::close(pooledFd);
+
+            if (res < 0) {
+                SPDLOG_ERROR("Failed to reuse connection to {}: {}",
+                             destKey,
+                             strerror(err));
+                return -err;
+            }
+
+            if (flags >= 0) {
+                ::fcntl(fd, F_SETFL, flags);
+            }
+
+            SPDLOG_TRACE("Reusing pooled connection to {} ({})", destKey, fd);
+            guestSockets[fd] = destKey;
+            return 0;
+        }
+    }
+
+    int res = 0;
+    if (::connect(fd, addr, addrLen) != 0) {
+        res = -errno;
+    }
+
+    // Non-blocking connects finish later, so can still be pooled
+    if (res == 0 || res == -EINPROGRESS) {
+        std::scoped_lock<std::mutex> lock(mx);
+        guestSockets[fd] = destKey;
+    }
+
+    return res;
+}
+
+int ConnectionPool::setSockOpt(int fd,
+                               int level,
+                               int optName,
+                               const void* optVal,
+                               socklen_t optLen)
+{
+    std::scoped_lock<std::mutex> lock(mx);
+
+    auto it = guestSockets.find(fd);
+    if (it == guestSockets.end()) {
+        return -EBADF;
+    }
+
+    if (::setsockopt(fd, level, optName, optVal, optLen) != 0) {
+        return -errno;
+    }
+
+    // Some options (e.g. buffer sizes) can't be put back to their defaults,
+    // so this socket can never be pooled
+    customisedSockets.insert(fd);
+    it->second = "";
+
+    return 0;
+}
+
+bool ConnectionPool::closeGuestSocket(int fd)
+{
+    std::scoped_lock<std::mutex> lock(mx);
+
+    auto it = guestSockets.find(fd);
+    if (it == guestSockets.end()) {
+        return false;
+    }
+
+    std::string destKey = it->second;
+    guestSockets.erase(it);
+    customisedSockets.erase(fd);
+
+    returnOrClose(fd, destKey);
+
+    return true;
+}
+
+void ConnectionPool::releaseGuestSockets()
+{
+    std::scoped_lock<std::mutex> lock(mx);
+
+    for (const auto& [fd, destKey] : guestSockets) {
+        returnOrClose(fd, destKey);
+    }
+
+    guestSockets.clear();
+    customisedSockets.clear();
+}
+
+void ConnectionPool::clear()
+{
+    std::scoped_lock<std::mutex> lock(mx);
+
+    for (auto& [destKey, conns] : idle) {
+        for (auto& conn : conns) {
+            ::close(conn.fd);
+        }
+    }
+
+    idle.clear();
+}
+
+int ConnectionPool::getIdleCount()
+{
+    std::scoped_lock<std::mutex> lock(mx);
+
+    int count = 0;
+    for (const auto& [destKey, conns] : idle) {
+        count += conns.size();
+    }
+
+    return count;
+}
+
+int ConnectionPool::claimIdleConnection(const std::string& destKey)
+{
+    auto it = idle.find(destKey);
+    if (it == idle.end()) {
+        return -1;
+    }
+
+    const conf::FaasmConfig& conf = conf::getFaasmConfig();
+    std::vector<IdleConnection>& conns = it->second;
+
+    // Take the most recently used first, as it's the least likely to have
+    // been dropped by the peer
+    while (!conns.empty()) {
+        IdleConnection conn = conns.back();
+        conns.pop_back();
+
+        double idleMs = faabric::util::getTimeDiffMillis(conn.idleSince);
+        if (idleMs <= conf.connPoolIdleTimeoutMs && isHealthy(conn.fd)) {
+            return conn.fd;
+        }
+
+        SPDLOG_TRACE("Dropping stale pooled connection to {}", destKey);
+        ::close(conn.fd);
+    }
+
+    return -1;
+}
+
+void ConnectionPool::returnOrClose(int fd, const std::string& destKey)
+{
+    if (destKey.empty() || !isPoolingOn() || !isHealthy(fd)) {
+        ::close(fd);
+        return;
+    }
+
+    const conf::FaasmConfig& conf = conf::getFaasmConfig();
+    std::vector<IdleConnection>& conns = idle[destKey];
+    if ((int)conns.size() >= conf.connPoolMaxPerDest) {
+        ::close(fd);
+        return;
+    }
+
+    SPDLOG_TRACE("Returning connection to {} to pool ({})", destKey, fd);
+    conns.push_back({ fd, faabric::util::startTimer() });
+}
+}
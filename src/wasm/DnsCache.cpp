@@ -0,0 +1,249 @@
+#include <conf/FaasmConfig.h>
+#include <faabric/util/locks.h>
+#include <faabric/util/logging.h>
+#include <wasm/DnsCache.h>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <climits>
+#include <fstream>
+#include <netdb.h>
+#include <resolv.h>
+#include <sstream>
+
+namespace wasm {
+
+// Most answers fit in a UDP response
+#define DNS_ANSWER_BUFFER_SIZE 4096
+
+enum class LookupStatus
+{
+    Found,
+    NotFound,
+    Failed
+};
+
+struct LookupResult
+{
+    LookupStatus status = LookupStatus::Failed;
+    std::vector<::in_addr> addrs;
+    int ttlSeconds = 0;
+};
+
+static std::string toLower(const std::string& str)
+{
+    std::string res = str;
+    std::transform(res.begin(), res.end(), res.begin(), ::tolower);
+    return res;
+}
+
+/**
+ * The hosts file is small and rarely changes, so we just scan it on each miss
+ */
+static LookupResult lookupHostsFile(const std::string& hostname)
+{
+    const conf::FaasmConfig& conf = conf::getFaasmConfig();
+
+    LookupResult result;
+    result.status = LookupStatus::NotFound;
+    result.ttlSeconds = conf.dnsCacheMaxTtlSeconds;
+
+    std::ifstream hostsFile(conf.dnsHostsFile);
+    std::string line;
+    while (std::getline(hostsFile, line)) {
+        size_t commentIdx = line.find('#');
+        if (commentIdx != std::string::npos) {
+            line.resize(commentIdx);
+        }
+
+        std::istringstream fields(line);
+        std::string addrStr;
+        if (!(fields >> addrStr)) {
+            continue;
+        }
+
+        ::in_addr addr{};
+        if (::inet_pton(AF_INET, addrStr.c_str(), &addr) != 1) {
+            continue;
+        }
+
+        std::string name;
+        while (fields >> name) {
+            if (toLower(name) == hostname) {
+                result.status = LookupStatus::Found;
+                result.addrs.push_back(addr);
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Resolver state isn't thread-safe, so each thread has its own, which is
+// closed when the thread exits
+struct ThreadResolverState
+{
+    struct __res_state state
+    {};
+    bool initialised = false;
+
+    ~ThreadResolverState()
+    {
+        if (initialised) {
+            ::res_nclose(&state);
+        }
+    }
+};
+
+static LookupResult lookupDns(const std::string& hostname)
+{
+    static thread_local ThreadResolverState resolver;
+    if (!resolver.initialised) {
+        if (::res_ninit(&resolver.state) != 0) {
+            SPDLOG_ERROR("Failed to initialise resolver");
+            return {};
+        }
+        resolver.initialised = true;
+    }
+
+    struct __res_state& resState = resolver.state;
+
+    const conf::FaasmConfig& conf = conf::getFaasmConfig();
+
+    LookupResult result;
+    std::vector<uint8_t> answer(DNS_ANSWER_BUFFER_SIZE);
+    int answerLen = ::res_nsearch(&resState,
+                                  hostname.c_str(),
+                                  ns_c_in,
+                                  ns_t_a,
+                                  answer.data(),
+                                  answer.size());
+
+    if (answerLen < 0) {
+        int err = resState.res_h_errno;
+        if (err == HOST_NOT_FOUND || err == NO_DATA) {
+            result.status = LookupStatus::NotFound;
+            result.ttlSeconds = conf.dnsCacheNegativeTtlSeconds;
+        } else {
+            SPDLOG_WARN(
+              "DNS lookup for {} failed: {}", hostname, ::hstrerror(err));
+        }
+
+        return result;
+    }
+
+    ::ns_msg msg;
+    answerLen = std::min<int>(answerLen, answer.size());
+    if (::ns_initparse(answer.data(), answerLen, &msg) != 0) {
+        SPDLOG_WARN("Failed to parse DNS answer for {}", hostname);
+        return result;
+    }
+
+    // The answer may include CNAMEs on the way to the A records, the whole
+    // chain is only valid for the shortest TTL
+    int ttl = conf.dnsCacheMaxTtlSeconds;
+    int nRecords = ns_msg_count(msg, ns_s_an);
+    for (int i = 0; i < nRecords; i++) {
+        ::ns_rr rr;
+        if (::ns_parserr(&msg, ns_s_an, i, &rr) != 0) {
+            continue;
+        }
+
+        ttl = std::min<int>(ttl, ns_rr_ttl(rr));
+
+        if (ns_rr_type(rr) == ns_t_a && ns_rr_rdlen(rr) == sizeof(::in_addr)) {
+            ::in_addr addr{};
+            std::copy(ns_rr_rdata(rr),
+                      ns_rr_rdata(rr) + sizeof(::in_addr),
+                      reinterpret_cast<uint8_t*>(&addr));
+            result.addrs.push_back(addr);
+        }
+    }
+
+    if (result.addrs.empty()) {
+        result.status = LookupStatus::NotFound;
+        result.ttlSeconds = conf.dnsCacheNegativeTtlSeconds;
+    } else {
+        result.status = LookupStatus::Found;
+        result.ttlSeconds = ttl;
+    }
+
+    return result;
+}
+
+static LookupResult lookup(const std::string& hostname)
+{
+    const conf::FaasmConfig& conf = conf::getFaasmConfig();
+
+    LookupResult result = lookupHostsFile(hostname);
+    if (result.status == LookupStatus::Found) {
+        return result;
+    }
+
+    if (conf.dnsCacheMode == "hosts") {
+        result.ttlSeconds = conf.dnsCacheNegativeTtlSeconds;
+        return result;
+    }
+
+    return lookupDns(hostname);
+}
+
+std::vector<::in_addr> DnsCache::resolve(const std::string& hostname)
+{
+    ::in_addr literal{};
+    if (::inet_pton(AF_INET, hostname.c_str(), &literal) == 1) {
+        return { literal };
+    }
+
+    std::string key = toLower(hostname);
+    const conf::FaasmConfig& conf = conf::getFaasmConfig();
+    bool useCache = conf.dnsCacheMode != "off";
+    auto now = std::chrono::steady_clock::now();
+
+    if (useCache) {
+        faabric::util::SharedLock lock(mx);
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.expiry > now) {
+            return it->second.addrs;
+        }
+    }
+
+    LookupResult result = lookup(key);
+    if (result.status == LookupStatus::Failed) {
+        return {};
+    }
+
+    SPDLOG_TRACE("Resolved {} to {} addresses (TTL {}s)",
+                 hostname,
+                 result.addrs.size(),
+                 result.ttlSeconds);
+
+    if (useCache && result.ttlSeconds > 0) {
+        faabric::util::FullLock lock(mx);
+        entries[key] = { result.addrs,
+                         now + std::chrono::seconds(result.ttlSeconds) };
+    }
+
+    return result.addrs;
+}
+
+void DnsCache::clear()
+{
+    faabric::util::FullLock lock(mx);
+    entries.clear();
+}
+
+size_t DnsCache::size()
+{
+    faabric::util::SharedLock lock(mx);
+    return entries.size();
+}
+
+DnsCache& getDnsCache()
+{
+    static DnsCache cache;
+    return cache;
+}
+}
@@ -0,0 +1,61 @@
+#include <wasm/GuestMutex.h>
+
+#include <atomic>
+
+#define GUEST_MUTEX_UNLOCKED 0
+#define GUEST_MUTEX_LOCKED 1
+#define GUEST_MUTEX_CONTENDED 2
+
+namespace wasm {
+
+GuestMutex::GuestMutex(ParkingLot& parkingLotIn,
+                       uint32_t lockAddrIn,
+                       uint32_t* wordIn)
+  : parkingLot(parkingLotIn)
+  , lockAddr(lockAddrIn)
+  , word(wordIn)
+{}
+
+void GuestMutex::lock()
+{
+    std::atomic_ref<uint32_t> state(*word);
+
+    uint32_t expected = GUEST_MUTEX_UNLOCKED;
+    if (state.compare_exchange_strong(expected, GUEST_MUTEX_LOCKED)) {
+        return;
+    }
+
+    // Mark the mutex as contended so the holder knows to wake us, and sleep
+    // until we're the ones that take it from unlocked
+    if (expected != GUEST_MUTEX_CONTENDED) {
+        expected = state.exchange(GUEST_MUTEX_CONTENDED);
+    }
+
+    while (expected != GUEST_MUTEX_UNLOCKED) {
+        parkingLot.park(
+          lockAddr,
+          [&state] { return state.load() == GUEST_MUTEX_CONTENDED; },
+          [] {},
+          std::nullopt);
+
+        expected = state.exchange(GUEST_MUTEX_CONTENDED);
+    }
+}
+
+bool GuestMutex::tryLock()
+{
+    std::atomic_ref<uint32_t> state(*word);
+
+    uint32_t expected = GUEST_MUTEX_UNLOCKED;
+    return state.compare_exchange_strong(expected, GUEST_MUTEX_LOCKED);
+}
+
+void GuestMutex::unlock()
+{
+    std::atomic_ref<uint32_t> state(*word);
+
+    if (state.exchange(GUEST_MUTEX_UNLOCKED) == GUEST_MUTEX_CONTENDED) {
+        parkingLot.unpark(lockAddr, 1);
+    }
+}
+}
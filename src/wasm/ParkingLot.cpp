@@ -0,0 +1,88 @@
+#include <wasm/ParkingLot.h>
+
+#include <cerrno>
+
+namespace wasm {
+
+ParkingLot::Bucket& ParkingLot::getBucket(uint32_t addr)
+{
+    // Futex words are at least 4-byte aligned, so ignore the bottom bits
+    return buckets.at((addr >> 2) % buckets.size());
+}
+
+int ParkingLot::park(uint32_t addr,
+                     const std::function<bool()>& validate,
+                     const std::function<void()>& beforeSleep,
+                     std::optional<Deadline> deadline)
+{
+    Bucket& bucket = getBucket(addr);
+    std::unique_lock<std::mutex> lock(bucket.mx);
+
+    if (!validate()) {
+        return -EAGAIN;
+    }
+
+    Waiter waiter;
+    waiter.addr = addr;
+    auto it = bucket.waiters.insert(bucket.waiters.end(), &waiter);
+
+    // We're queued, so anything beforeSleep allows to happen will wake us
+    lock.unlock();
+    beforeSleep();
+    lock.lock();
+
+    if (deadline.has_value()) {
+        waiter.cv.wait_until(
+          lock, deadline.value(), [&waiter] { return waiter.woken; });
+    } else {
+        waiter.cv.wait(lock, [&waiter] { return waiter.woken; });
+    }
+
+    // Wakers remove the waiters they wake, so we only remove ourselves if we
+    // timed out
+    if (!waiter.woken) {
+        bucket.waiters.erase(it);
+        return -ETIMEDOUT;
+    }
+
+    return 0;
+}
+
+int ParkingLot::unpark(uint32_t addr, int maxWaiters)
+{
+    Bucket& bucket = getBucket(addr);
+    std::unique_lock<std::mutex> lock(bucket.mx);
+
+    int nWoken = 0;
+    auto it = bucket.waiters.begin();
+    while (it != bucket.waiters.end() && nWoken < maxWaiters) {
+        Waiter* waiter = *it;
+        if (waiter->addr != addr) {
+            ++it;
+            continue;
+        }
+
+        it = bucket.waiters.erase(it);
+        waiter->woken = true;
+        waiter->cv.notify_one();
+        nWoken++;
+    }
+
+    return nWoken;
+}
+
+int ParkingLot::getParkedCount(uint32_t addr)
+{
+    Bucket& bucket = getBucket(addr);
+    std::unique_lock<std::mutex> lock(bucket.mx);
+
+    int count = 0;
+    for (const Waiter* waiter : bucket.waiters) {
+        if (waiter->addr == addr) {
+            count++;
+        }
+    }
+
+    return count;
+}
+}
@@ -16,8 +16,10 @@
 #include <faabric/util/testing.h>
 #include <faabric/util/timing.h>
 #include <threads/ThreadState.h>
+#include <wasm/GuestMutex.h>
 #include <wasm/WasmExecutionContext.h>
 #include <wasm/WasmModule.h>
+#include <wasm/scheduling.h>
 
 #include <boost/filesystem.hpp>
 #include <sstream>
@@ -75,6 +77,21 @@ storage::FileSystem& WasmModule::getFileSystem()
     return filesystem;
 }
 
+ConnectionPool& WasmModule::getConnectionPool()
+{
+    return connectionPool;
+}
+
+ParkingLot& WasmModule::getParkingLot()
+{
+    return parkingLot;
+}
+
+threads::PthreadKeys& WasmModule::getPthreadKeys()
+{
+    return pthreadKeys;
+}
+
 wasm::WasmEnvironment& WasmModule::getWasmEnvironment()
 {
     return wasmEnvironment;
@@ -401,6 +418,17 @@ int32_t WasmModule::executeTask(
         switch (req->subtype()) {
             case ThreadRequestType::PTHREAD: {
                 SPDLOG_TRACE("Executing {} as pthread", funcStr);
+
+                // Threads on another host won't have seen the main thread
+                // decide this
+                setThreadsSingleHost(req->singlehost());
+
+                // Pick up keys created by the main thread
+                if (!req->contextdata().empty()) {
+                    pthreadKeys.deserialise(
+                      faabric::util::stringToBytes(req->contextdata()));
+                }
+
                 returnValue = executePthread(threadPoolIdx, stackTop, msg);
                 break;
             }
@@ -425,9 +453,33 @@ int32_t WasmModule::executeTask(
     } else {
         // Vanilla function
         SPDLOG_TRACE("Executing {} as standard function", funcStr);
+
+        // In the local tests, we always run threads on a single host to
+        // avoid having to synchronise snapshots. This also fixes the guest
+        // mutex mode before the guest starts, as it may hold mutexes across
+        // creating threads
+        setThreadsSingleHost(faabric::util::isTestMode());
+
+        // Files may have been created outside this module since its last
+        // invocation, so don't trust lookups cached before this one
+        filesystem.clearPathCache();
+
         returnValue = executeFunction(msg);
+
+        // Threads that were created but never joined may still be running
+        awaitAllPthreadCalls();
+        pthreadKeys.clear();
+
+        // Don't leave sockets open between invocations. Threads share the
+        // main function's sockets, so only do this once it's finished
+        connectionPool.releaseGuestSockets();
     }
 
+    // Executor threads are reused, so don't leak the guest's priority or
+    // thread-local values
+    resetGuestPriority();
+    threads::clearPthreadKeyValues();
+
     if (returnValue != 0) {
         msg.set_outputdata(
           fmt::format("Call failed (return value={})", returnValue));
@@ -490,99 +542,266 @@ void WasmModule::clearMergeRegions()
 
 void WasmModule::queuePthreadCall(threads::PthreadCall call)
 {
-    // We assume that all pthread calls are queued from the main thread before
-    // await is called from the same thread, so this doesn't need to be
-    // thread-safe.
+    const conf::FaasmConfig& conf = conf::getFaasmConfig();
+    auto ctx = faabric::scheduler::ExecutorContext::get();
+
+    std::unique_lock<std::mutex> lock(pthreadCallsMx);
     queuedPthreadCalls.emplace_back(call);
+
+    if (!dispatchesPthreadsEagerly()) {
+        return;
+    }
+
+    if (conf.pthreadBatchWindowUs <= 0) {
+        dispatchQueuedPthreadCalls(
+          ctx->getExecutor(), ctx->getBatchRequest(), ctx->getMsgIdx());
+        return;
+    }
+
+    // The first call in a batch starts the window, and any calls made before
+    // it closes go out with it. A join before then dispatches straight away,
+    // in which case the timer finds nothing (or a later batch) to send
+    if (queuedPthreadCalls.size() == 1) {
+        pthreadDispatchTimers.emplace_back(std::async(
+          std::launch::async,
+          [this,
+           executor = ctx->getExecutor(),
+           parentReq = ctx->getBatchRequest(),
+           parentMsgIdx = ctx->getMsgIdx(),
+           window = conf.pthreadBatchWindowUs] {
+              std::this_thread::sleep_for(std::chrono::microseconds(window));
+
+              std::unique_lock<std::mutex> lock(pthreadCallsMx);
+              dispatchQueuedPthreadCalls(executor, parentReq, parentMsgIdx);
+          }));
+    }
 }
 
-int WasmModule::awaitPthreadCall(faabric::Message* msg, int pthreadPtr)
+bool WasmModule::dispatchesPthreadsEagerly()
 {
-    // We assume that await is called in a loop from the main thread, after
-    // all pthread calls have been queued, so this function doesn't need to be
-    // thread safe.
-    assert(msg != nullptr);
+    // Must be called with the pthread calls mutex held. Each batch sent to
+    // other hosts would need its own snapshot, and its changes merged back
+    // while the main thread and other batches are still writing to memory, so
+    // threads that may be spread across hosts are only sent on join
+    return pthreadsSingleHost &&
+           conf::getFaasmConfig().pthreadDispatchMode == "eager";
+}
 
-    // Execute the queued pthread calls
-    faabric::scheduler::Executor* executor =
-      faabric::scheduler::ExecutorContext::get()->getExecutor();
-    if (!queuedPthreadCalls.empty()) {
-        int nPthreadCalls = queuedPthreadCalls.size();
+void WasmModule::dispatchQueuedPthreadCalls(
+  faabric::scheduler::Executor* executor,
+  std::shared_ptr<faabric::BatchExecuteRequest> parentReq,
+  int parentMsgIdx)
+{
+    // Must be called with the pthread calls mutex held
+    if (queuedPthreadCalls.empty()) {
+        return;
+    }
 
-        std::string funcStr = faabric::util::funcToString(*msg, true);
-        SPDLOG_DEBUG(
-          "Executing {} pthread calls for {}", nPthreadCalls, funcStr);
+    const faabric::Message& msg = parentReq->messages().at(parentMsgIdx);
+    int nPthreadCalls = queuedPthreadCalls.size();
 
-        std::shared_ptr<faabric::BatchExecuteRequest> req =
-          faabric::util::batchExecFactory(
-            msg->user(), msg->function(), nPthreadCalls);
-        faabric::util::updateBatchExecAppId(req, msg->appid());
+    std::string funcStr = faabric::util::funcToString(msg, true);
+    SPDLOG_DEBUG("Dispatching {} pthread calls for {}", nPthreadCalls, funcStr);
+
+    std::shared_ptr<faabric::BatchExecuteRequest> req =
+      faabric::util::batchExecFactory(
+        msg.user(), msg.function(), nPthreadCalls);
+    faabric::util::updateBatchExecAppId(req, msg.appid());
+
+    req->set_type(faabric::BatchExecuteRequest::THREADS);
+    req->set_subtype(wasm::ThreadRequestType::PTHREAD);
+
+    req->set_singlehost(pthreadsSingleHost);
+
+    for (int i = 0; i < nPthreadCalls; i++) {
+        threads::PthreadCall p = queuedPthreadCalls.at(i);
+        faabric::Message& m = req->mutable_messages()->at(i);
+
+        // Function pointer and args
+        // NOTE - with a pthread interface we only ever pass the
+        // function a single pointer argument, hence we use the
+        // input data here to hold this argument as a string
+        m.set_funcptr(p.entryFunc);
+        m.set_inputdata(std::to_string(p.argsPtr));
+
+        // Assign a thread ID. Our pthread IDs start at 1, as the main thread
+        // has the first stack, and carry on across batches in this call so
+        // that threads in concurrent batches don't share a stack. Once every
+        // stack has been handed out we wrap round, as the IDs pick the stack.
+        // Set this as part of the group with the other threads in the batch.
+        m.set_appidx(nextPthreadIdx);
+        m.set_groupidx(i + 1);
+
+        if (nextPthreadIdx >= threadPoolSize - 1) {
+            SPDLOG_DEBUG(
+              "Pthread IDs for {} wrapped at {}", funcStr, nextPthreadIdx);
+            nextPthreadIdx = 1;
+        } else {
+            nextPthreadIdx++;
+        }
+    }
 
-        req->set_type(faabric::BatchExecuteRequest::THREADS);
-        req->set_subtype(wasm::ThreadRequestType::PTHREAD);
+    std::vector<uint8_t> keyBytes = pthreadKeys.serialise(msg.appid());
+    req->set_contextdata(keyBytes.data(), keyBytes.size());
+
+    // Track the threads that could wake the main thread's condition waits
+    inFlightPthreads += nPthreadCalls;
+
+    // Execute the threads in the background, taking the merge regions as they
+    // are now, as they are registered before the threads are created
+    PthreadBatchResults results =
+      std::async(std::launch::async,
+                 [this,
+                  executor,
+                  parentReq,
+                  parentMsgIdx,
+                  req,
+                  nPthreadCalls,
+                  regions = mergeRegions] {
+                     faabric::scheduler::ExecutorContext::set(
+                       executor, parentReq, parentMsgIdx);
+                     auto batchResults = executor->executeThreads(req, regions);
+
+                     std::unique_lock<std::mutex> lock(pthreadCallsMx);
+                     inFlightPthreads -= nPthreadCalls;
+
+                     return batchResults;
+                 })
+        .share();
+
+    // Record this thread -> call ID
+    for (int i = 0; i < nPthreadCalls; i++) {
+        int32_t pthreadPtr = queuedPthreadCalls.at(i).pthreadPtr;
+        uint32_t msgId = req->messages().at(i).id();
+
+        SPDLOG_TRACE("pthread {} mapped to call {}", pthreadPtr, msgId);
+        pthreadPtrsToChainedCalls[pthreadPtr] = { msgId, results };
+    }
 
-        // In the local tests, we always set the single-host flag to avoid
-        // having to synchronise snapshots
-        if (faabric::util::isTestMode()) {
-            req->set_singlehost(true);
+    pthreadBatches.emplace_back(results);
+    queuedPthreadCalls.clear();
+}
+
+int WasmModule::awaitPthreadCall(faabric::Message* msg, int pthreadPtr)
+{
+    assert(msg != nullptr);
+
+    uint32_t pthreadMsgId;
+    PthreadBatchResults batchResults;
+    {
+        std::unique_lock<std::mutex> lock(pthreadCallsMx);
+
+        // Send the queued calls if this thread hasn't gone out yet
+        if (pthreadPtrsToChainedCalls.find(pthreadPtr) ==
+            pthreadPtrsToChainedCalls.end()) {
+            auto ctx = faabric::scheduler::ExecutorContext::get();
+            dispatchQueuedPthreadCalls(
+              ctx->getExecutor(), ctx->getBatchRequest(), ctx->getMsgIdx());
         }
 
-        for (int i = 0; i < nPthreadCalls; i++) {
-            threads::PthreadCall p = queuedPthreadCalls.at(i);
-            faabric::Message& m = req->mutable_messages()->at(i);
-
-            // Function pointer and args
-            // NOTE - with a pthread interface we only ever pass the
-            // function a single pointer argument, hence we use the
-            // input data here to hold this argument as a string
-            m.set_funcptr(p.entryFunc);
-            m.set_inputdata(std::to_string(p.argsPtr));
-
-            // Assign a thread ID and increment. Our pthread IDs start
-            // at 1. Set this as part of the group with the other threads.
-            m.set_appidx(i + 1);
-            m.set_groupidx(i + 1);
-
-            // Record this thread -> call ID
-            SPDLOG_TRACE("pthread {} mapped to call {}", p.pthreadPtr, m.id());
-            pthreadPtrsToChainedCalls.insert({ p.pthreadPtr, m.id() });
+        auto it = pthreadPtrsToChainedCalls.find(pthreadPtr);
+        if (it == pthreadPtrsToChainedCalls.end()) {
+            SPDLOG_ERROR("Awaiting unknown pthread: ptr {}", pthreadPtr);
+            throw std::runtime_error("Awaiting unknown pthread");
         }
 
-        // Execute the threads and await results
-        lastPthreadResults = executor->executeThreads(req, mergeRegions);
+        std::tie(pthreadMsgId, batchResults) = it->second;
 
-        // Empty the queue
-        queuedPthreadCalls.clear();
+        // Remove the mapping for this pointer
+        pthreadPtrsToChainedCalls.erase(it);
     }
 
-    // Get the result of this call
-    unsigned int pthreadMsgId = pthreadPtrsToChainedCalls[pthreadPtr];
-    bool found = false;
-    int thisResult = 0;
-    for (auto [mid, res] : lastPthreadResults) {
+    // Get the result of this call, waiting for the batch if need be
+    for (auto [mid, res] : batchResults.get()) {
         if (pthreadMsgId == mid) {
-            thisResult = res;
-            found = true;
+            return res;
+        }
+    }
+
+    SPDLOG_ERROR("Did not find a result for pthread: ptr {}, mid {}",
+                 pthreadPtr,
+                 pthreadMsgId);
+    throw std::runtime_error("Result not found for pthread");
+}
+
+void WasmModule::awaitAllPthreadCalls()
+{
+    // Timers may dispatch a final batch while we're waiting, so keep going
+    // until there's nothing left in flight
+    while (true) {
+        std::vector<std::future<void>> timers;
+        std::vector<PthreadBatchResults> batches;
+        {
+            std::unique_lock<std::mutex> lock(pthreadCallsMx);
+            timers.swap(pthreadDispatchTimers);
+            batches.swap(pthreadBatches);
+        }
+
+        if (timers.empty() && batches.empty()) {
             break;
         }
+
+        for (auto& t : timers) {
+            t.wait();
+        }
+
+        for (auto& b : batches) {
+            b.wait();
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(pthreadCallsMx);
+
+    // Calls are only left queued in join dispatch mode, where threads that
+    // are never joined are never run
+    if (!queuedPthreadCalls.empty()) {
+        SPDLOG_DEBUG("Dropping {} pthread calls that were never joined",
+                     queuedPthreadCalls.size());
+        queuedPthreadCalls.clear();
     }
 
-    if (!found) {
-        SPDLOG_ERROR("Did not find a result for pthread: ptr {}, mid {}",
-                     pthreadPtr,
-                     pthreadMsgId);
-        throw std::runtime_error("Result not found for pthread");
+    pthreadPtrsToChainedCalls.clear();
+    nextPthreadIdx = 1;
+    inFlightPthreads = 0;
+}
+
+void WasmModule::setThreadsSingleHost(bool singleHost)
+{
+    {
+        std::unique_lock<std::mutex> lock(pthreadCallsMx);
+        pthreadsSingleHost = singleHost;
     }
 
-    // Remove the mapping for this pointer
-    pthreadPtrsToChainedCalls.erase(pthreadPtr);
+    // The mode is an explicit switch rather than following where threads
+    // run, so that it doesn't change under a guest holding a mutex
+    hostGuestMutexes = conf::getFaasmConfig().guestMutexMode == "host";
+}
 
-    // If we're done, clear the results
-    if (pthreadPtrsToChainedCalls.empty()) {
-        lastPthreadResults.clear();
+bool WasmModule::usesHostGuestMutexes()
+{
+    return hostGuestMutexes.load(std::memory_order_relaxed);
+}
+
+void WasmModule::runPthreadKeyDestructors(
+  const std::function<void(uint32_t, uint32_t)>& callDestructor)
+{
+    // Destructors may set values again, so we go round a few times
+    for (int i = 0; i < PTHREAD_DESTRUCTOR_ITERATIONS; i++) {
+        std::vector<std::pair<uint32_t, uint32_t>> values =
+          threads::takePthreadKeyValues();
+        if (values.empty()) {
+            return;
+        }
+
+        for (auto [key, value] : values) {
+            uint32_t destructor = pthreadKeys.getDestructor(key);
+            if (destructor != 0) {
+                callDestructor(destructor, value);
+            }
+        }
     }
 
-    return thisResult;
+    threads::clearPthreadKeyValues();
 }
 
 void WasmModule::createThreadStacks()
@@ -613,6 +832,120 @@ std::vector<uint32_t> WasmModule::getThreadStacks()
     return threadStacks;
 }
 
+void WasmModule::initGuestMutex(uint32_t mxPtr)
+{
+    if (usesHostGuestMutexes()) {
+        return;
+    }
+
+    // Mutexes on the stack or heap may not be zeroed
+    uint32_t lockAddr = mxPtr + GUEST_MUTEX_LOCK_OFFSET;
+    auto word = reinterpret_cast<uint32_t*>(wasmPointerToNative(lockAddr));
+    std::atomic_ref<uint32_t>(*word).store(0);
+}
+
+void WasmModule::lockGuestMutex(uint32_t mxPtr)
+{
+    if (usesHostGuestMutexes()) {
+        getOrCreatePthreadMutex(mxPtr)->lock();
+        return;
+    }
+
+    uint32_t lockAddr = mxPtr + GUEST_MUTEX_LOCK_OFFSET;
+    auto word = reinterpret_cast<uint32_t*>(wasmPointerToNative(lockAddr));
+    GuestMutex(parkingLot, lockAddr, word).lock();
+}
+
+bool WasmModule::tryLockGuestMutex(uint32_t mxPtr)
+{
+    if (usesHostGuestMutexes()) {
+        return getOrCreatePthreadMutex(mxPtr)->try_lock();
+    }
+
+    uint32_t lockAddr = mxPtr + GUEST_MUTEX_LOCK_OFFSET;
+    auto word = reinterpret_cast<uint32_t*>(wasmPointerToNative(lockAddr));
+    return GuestMutex(parkingLot, lockAddr, word).tryLock();
+}
+
+void WasmModule::unlockGuestMutex(uint32_t mxPtr)
+{
+    if (usesHostGuestMutexes()) {
+        getPthreadMutex(mxPtr)->unlock();
+        return;
+    }
+
+    uint32_t lockAddr = mxPtr + GUEST_MUTEX_LOCK_OFFSET;
+    auto word = reinterpret_cast<uint32_t*>(wasmPointerToNative(lockAddr));
+    GuestMutex(parkingLot, lockAddr, word).unlock();
+}
+
+int WasmModule::checkGuestCondCanBeSignalled()
+{
+    auto req = faabric::scheduler::ExecutorContext::get()->getBatchRequest();
+    bool isPthread = req->type() == faabric::BatchExecuteRequest::THREADS &&
+                     req->subtype() == ThreadRequestType::PTHREAD;
+
+    // Only threads of this module on this host can wake a waiter. Threads
+    // that may be elsewhere usually aren't, so we only warn about them
+    if (isPthread) {
+        if (!req->singlehost()) {
+            SPDLOG_WARN("Untimed condition wait in a batch that may span "
+                        "hosts, only threads on this host can signal it");
+        }
+
+        return 0;
+    }
+
+    // The main thread can only be woken by the threads it has sent out, or
+    // queued calls that will be sent without it joining them
+    std::unique_lock<std::mutex> lock(pthreadCallsMx);
+    int nPending = inFlightPthreads;
+    if (dispatchesPthreadsEagerly()) {
+        nPending += queuedPthreadCalls.size();
+    }
+
+    if (nPending == 0) {
+        return EDEADLK;
+    }
+
+    if (!pthreadsSingleHost) {
+        SPDLOG_WARN("Untimed condition wait with threads that may span "
+                    "hosts, only threads on this host can signal it");
+    }
+
+    return 0;
+}
+
+int WasmModule::waitOnGuestCond(uint32_t condPtr,
+                                uint32_t mxPtr,
+                                std::optional<ParkingLot::Deadline> deadline)
+{
+    // Without a deadline, waiting when no other thread can signal us would
+    // block forever
+    if (!deadline.has_value()) {
+        int err = checkGuestCondCanBeSignalled();
+        if (err != 0) {
+            SPDLOG_ERROR("Condition variable {} can never be signalled ({})",
+                         condPtr,
+                         strerror(err));
+            return err;
+        }
+    }
+
+    // Waiters park on the address of the condition variable, and release the
+    // mutex once they're queued, so a signal sent after taking the mutex
+    // can't be missed
+    int res = parkingLot.park(
+      condPtr,
+      [] { return true; },
+      [this, mxPtr] { unlockGuestMutex(mxPtr); },
+      deadline);
+
+    lockGuestMutex(mxPtr);
+
+    return res == -ETIMEDOUT ? ETIMEDOUT : 0;
+}
+
 std::shared_ptr<std::mutex> WasmModule::getPthreadMutex(uint32_t id)
 {
     faabric::util::SharedLock lock(pthreadLocksMx);
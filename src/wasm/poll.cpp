@@ -0,0 +1,279 @@
+#include <wasm/poll.h>
+
+#include <faabric/util/logging.h>
+#include <faabric/util/timing.h>
+
+#include <WAVM/WASI/WASIABI.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace wasm {
+
+static uint64_t nowNanos(clockid_t clockId)
+{
+    timespec ts{};
+    clock_gettime(clockId, &ts);
+    return faabric::util::timespecToNanos(&ts);
+}
+
+int wasiClockToLinux(uint32_t wasiClockId)
+{
+    switch (wasiClockId) {
+        case __WASI_CLOCK_REALTIME:
+            return CLOCK_REALTIME;
+        case __WASI_CLOCK_MONOTONIC:
+            return CLOCK_MONOTONIC;
+        case __WASI_CLOCK_PROCESS_CPUTIME_ID:
+            return CLOCK_PROCESS_CPUTIME_ID;
+        case __WASI_CLOCK_THREAD_CPUTIME_ID:
+            return CLOCK_THREAD_CPUTIME_ID;
+        default:
+            return -1;
+    }
+}
+
+bool canSleepOnClock(clockid_t linuxClockId)
+{
+    // Sleeping on CPU-time clocks would measure the whole host process
+    return linuxClockId == CLOCK_REALTIME || linuxClockId == CLOCK_MONOTONIC ||
+           linuxClockId == CLOCK_BOOTTIME;
+}
+
+uint16_t wasiClockResolution(uint32_t wasiClockId, uint64_t* resNanos)
+{
+    int linuxClockId = wasiClockToLinux(wasiClockId);
+    if (linuxClockId < 0) {
+        return __WASI_EINVAL;
+    }
+
+    timespec ts{};
+    if (clock_getres(linuxClockId, &ts) < 0) {
+        return __WASI_EINVAL;
+    }
+
+    *resNanos = faabric::util::timespecToNanos(&ts);
+
+    return __WASI_ESUCCESS;
+}
+
+int sleepOnClock(clockid_t linuxClockId,
+                 int flags,
+                 const timespec& req,
+                 timespec* rem)
+{
+    if (!canSleepOnClock(linuxClockId)) {
+        return ENOTSUP;
+    }
+
+    if (req.tv_sec < 0 || req.tv_nsec < 0 || req.tv_nsec >= 1000000000) {
+        return EINVAL;
+    }
+
+    // Note that clock_nanosleep returns the error rather than setting errno
+    timespec hostRem{};
+    int res = clock_nanosleep(linuxClockId, flags, &req, &hostRem);
+    if (res == EINTR && rem != nullptr && !(flags & TIMER_ABSTIME)) {
+        *rem = hostRem;
+    }
+
+    return res;
+}
+
+// Returns -1 for clocks we can't wait on
+static int waitableClock(uint32_t wasiClockId)
+{
+    int linuxClockId = wasiClockToLinux(wasiClockId);
+    if (linuxClockId < 0 || !canSleepOnClock(linuxClockId)) {
+        return -1;
+    }
+
+    return linuxClockId;
+}
+
+// Bytes available to read or write without blocking, where we can tell
+static uint64_t availableBytes(int linuxFd, bool isRead)
+{
+    struct ::stat nativeStat
+    {};
+    if (::fstat(linuxFd, &nativeStat) != 0) {
+        return 0;
+    }
+
+    if (S_ISREG(nativeStat.st_mode)) {
+        if (!isRead) {
+            return 0;
+        }
+
+        off_t offset = ::lseek(linuxFd, 0, SEEK_CUR);
+        if (offset < 0 || offset >= nativeStat.st_size) {
+            return 0;
+        }
+
+        return nativeStat.st_size - offset;
+    }
+
+    int nBytes = 0;
+    if (isRead && ::ioctl(linuxFd, FIONREAD, &nBytes) == 0 && nBytes > 0) {
+        return nBytes;
+    }
+
+    return 0;
+}
+
+std::vector<PollEvent> pollOneoff(storage::FileSystem& fs,
+                                  const std::vector<PollSubscription>& subs,
+                                  bool allowHostFds)
+{
+    std::vector<PollEvent> events;
+
+    // Fd subscriptions are polled all together, clock subscriptions are
+    // turned into a single timeout for the earliest one
+    std::vector<::pollfd> pollFds;
+    std::vector<size_t> pollFdSubs;
+    std::vector<uint64_t> clockTimeouts(subs.size(), 0);
+    uint64_t minTimeout = std::numeric_limits<uint64_t>::max();
+    bool hasClock = false;
+
+    for (size_t i = 0; i < subs.size(); i++) {
+        const PollSubscription& sub = subs[i];
+
+        PollEvent errorEvent;
+        errorEvent.userdata = sub.userdata;
+        errorEvent.type = sub.type;
+
+        if (sub.type == __WASI_EVENTTYPE_CLOCK) {
+            int linuxClock = waitableClock(sub.clockId);
+            if (linuxClock < 0) {
+                SPDLOG_WARN("Unsupported poll clock: {}", sub.clockId);
+                errorEvent.error = __WASI_EINVAL;
+                events.push_back(errorEvent);
+                continue;
+            }
+
+            // Absolute deadlines become relative ones
+            uint64_t timeout = sub.timeout;
+            if (sub.flags & __WASI_SUBSCRIPTION_CLOCK_ABSTIME) {
+                uint64_t now = nowNanos(linuxClock);
+                timeout = sub.timeout > now ? sub.timeout - now : 0;
+            }
+
+            clockTimeouts[i] = timeout;
+            minTimeout = std::min(minTimeout, timeout);
+            hasClock = true;
+        } else if (sub.type == __WASI_EVENTTYPE_FD_READ ||
+                   sub.type == __WASI_EVENTTYPE_FD_WRITE) {
+            int linuxFd = -1;
+            if (fs.fileDescriptorExists(sub.fd)) {
+                linuxFd = fs.getFileDescriptor(sub.fd).getLinuxFd();
+            } else if (allowHostFds && sub.fd >= 0) {
+                linuxFd = sub.fd;
+            }
+
+            if (linuxFd < 0) {
+                errorEvent.error = __WASI_EBADF;
+                events.push_back(errorEvent);
+                continue;
+            }
+
+            short pollEvents =
+              sub.type == __WASI_EVENTTYPE_FD_READ ? POLLIN : POLLOUT;
+            pollFds.push_back({ linuxFd, pollEvents, 0 });
+            pollFdSubs.push_back(i);
+        } else {
+            SPDLOG_WARN("Unsupported poll event type: {}", sub.type);
+            errorEvent.error = __WASI_EINVAL;
+            events.push_back(errorEvent);
+        }
+    }
+
+    // Don't wait if something has already failed
+    uint64_t waitTimeout = events.empty() ? minTimeout : 0;
+    if (!hasClock && pollFds.empty()) {
+        return events;
+    }
+
+    // Wait until an fd is ready or the first clock goes off. We track the
+    // elapsed time ourselves as ppoll can be interrupted
+    uint64_t start = nowNanos(CLOCK_MONOTONIC);
+    uint64_t elapsed = 0;
+    while (true) {
+        timespec ts{};
+        timespec* tsPtr = nullptr;
+        if (hasClock || waitTimeout == 0) {
+            uint64_t remaining =
+              waitTimeout > elapsed ? waitTimeout - elapsed : 0;
+            faabric::util::nanosToTimespec(remaining, &ts);
+            tsPtr = &ts;
+        }
+
+        int res = ::ppoll(pollFds.data(), pollFds.size(), tsPtr, nullptr);
+        elapsed = nowNanos(CLOCK_MONOTONIC) - start;
+
+        if (res >= 0) {
+            break;
+        }
+
+        if (errno != EINTR) {
+            SPDLOG_ERROR("ppoll failed: {}", strerror(errno));
+            for (size_t subIdx : pollFdSubs) {
+                PollEvent event;
+                event.userdata = subs[subIdx].userdata;
+                event.type = subs[subIdx].type;
+                event.error = storage::errnoToWasi(errno);
+                events.push_back(event);
+            }
+            return events;
+        }
+    }
+
+    for (size_t p = 0; p < pollFds.size(); p++) {
+        const ::pollfd& pollFd = pollFds[p];
+        if (pollFd.revents == 0) {
+            continue;
+        }
+
+        const PollSubscription& sub = subs[pollFdSubs[p]];
+        PollEvent event;
+        event.userdata = sub.userdata;
+        event.type = sub.type;
+
+        if (pollFd.revents & POLLNVAL) {
+            event.error = __WASI_EBADF;
+        } else {
+            bool isRead = sub.type == __WASI_EVENTTYPE_FD_READ;
+            event.nBytes = availableBytes(pollFd.fd, isRead);
+
+            if (pollFd.revents & POLLHUP) {
+                event.flags |= __WASI_EVENT_FD_READWRITE_HANGUP;
+            }
+        }
+
+        events.push_back(event);
+    }
+
+    // Report every clock that has gone off by now, which will include the
+    // earliest if we timed out
+    for (size_t i = 0; i < subs.size(); i++) {
+        if (subs[i].type != __WASI_EVENTTYPE_CLOCK ||
+            waitableClock(subs[i].clockId) < 0) {
+            continue;
+        }
+
+        if (clockTimeouts[i] <= elapsed) {
+            PollEvent event;
+            event.userdata = subs[i].userdata;
+            event.type = subs[i].type;
+            events.push_back(event);
+        }
+    }
+
+    return events;
+}
+}
@@ -0,0 +1,125 @@
+#include <conf/FaasmConfig.h>
+#include <faabric/util/logging.h>
+#include <wasm/scheduling.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/capability.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace wasm {
+
+// Nice level of this thread before the guest first changed it, and the one
+// currently applied. Executor threads are reused across invocations, so we
+// track these to restore the original level afterwards.
+static thread_local bool priorityChanged = false;
+static thread_local int originalNice = 0;
+static thread_local int currentNice = 0;
+
+static int getThreadNice()
+{
+    errno = 0;
+    int nice = ::getpriority(PRIO_PROCESS, ::gettid());
+    if (nice == -1 && errno != 0) {
+        SPDLOG_WARN("Failed to get thread priority: {}", strerror(errno));
+        return 0;
+    }
+
+    return nice;
+}
+
+static bool hasSysNiceCapability()
+{
+    __user_cap_header_struct header{ .version = _LINUX_CAPABILITY_VERSION_3,
+                                     .pid = 0 };
+    __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3]{};
+    if (::syscall(SYS_capget, &header, data) != 0) {
+        return false;
+    }
+
+    return (data[CAP_TO_INDEX(CAP_SYS_NICE)].effective &
+            CAP_TO_MASK(CAP_SYS_NICE)) != 0;
+}
+
+// Lowering the nice level needs CAP_SYS_NICE, unless RLIMIT_NICE allows it
+static bool canLowerNiceTo(int nice)
+{
+    ::rlimit limit{};
+    if (::getrlimit(RLIMIT_NICE, &limit) == 0) {
+        if (limit.rlim_cur == RLIM_INFINITY ||
+            20 - (int)limit.rlim_cur <= nice) {
+            return true;
+        }
+    }
+
+    return hasSysNiceCapability();
+}
+
+int getGuestPriority()
+{
+    if (priorityChanged) {
+        return currentNice;
+    }
+
+    return getThreadNice();
+}
+
+int setGuestPriority(int nice)
+{
+    conf::FaasmConfig& conf = conf::getFaasmConfig();
+    int clamped = std::clamp(nice, conf.guestNiceMin, conf.guestNiceMax);
+    if (clamped != nice) {
+        SPDLOG_DEBUG("Clamping guest nice level {} to {}", nice, clamped);
+    }
+
+    if (!priorityChanged) {
+        originalNice = getThreadNice();
+    }
+
+    // Executor threads are reused, so we mustn't let the guest raise the nice
+    // level unless we can lower it again afterwards
+    if (clamped > originalNice && !canLowerNiceTo(originalNice)) {
+        SPDLOG_DEBUG("Refusing guest nice level {}, can't restore {}",
+                     clamped,
+                     originalNice);
+        return -EPERM;
+    }
+
+    if (::setpriority(PRIO_PROCESS, ::gettid(), clamped) != 0) {
+        int err = errno;
+        SPDLOG_WARN("Failed to set thread nice level to {}: {}",
+                    clamped,
+                    strerror(err));
+        return -err;
+    }
+
+    priorityChanged = true;
+    currentNice = clamped;
+
+    return 0;
+}
+
+void resetGuestPriority()
+{
+    if (!priorityChanged) {
+        return;
+    }
+
+    if (::setpriority(PRIO_PROCESS, ::gettid(), originalNice) != 0) {
+        SPDLOG_WARN("Failed to restore thread nice level to {}: {}",
+                    originalNice,
+                    strerror(errno));
+    }
+
+    priorityChanged = false;
+}
+
+void yieldGuest()
+{
+    ::sched_yield();
+}
+}
@@ -181,11 +181,17 @@ void WAVMWasmModule::clone(const WAVMWasmModule& other,
     threadPoolSize = other.threadPoolSize;
     threadStacks = other.threadStacks;
     openMPContexts = std::vector<Runtime::Context*>(threadPoolSize, nullptr);
+    pthreadContexts = std::vector<Runtime::Context*>(threadPoolSize, nullptr);
 
     // Do not copy over any captured stdout
     stdoutMemFd = 0;
     stdoutSize = 0;
 
+    // The guest memory may be restored from a snapshot, so we can't assume
+    // the other module's hostent buffer is still there
+    hostentBuffer = 0;
+    hostentBufferSize = 0;
+
     if (other._isBound) {
         assert(other.compartment != nullptr);
 
@@ -428,14 +434,74 @@ void WAVMWasmModule::executeWasmFunction(
       executionContext, func, funcType, arguments.data(), &result);
 }
 
+uint32_t WAVMWasmModule::getHostentBuffer(size_t size)
+{
+    // As in libc, the result of gethostbyname lives in a static buffer that's
+    // overwritten by the next call, so we only grow memory when it won't fit
+    if (size > hostentBufferSize) {
+        hostentBufferSize = roundUpToWasmPageAligned(size);
+        hostentBuffer = growMemory(hostentBufferSize);
+    }
+
+    return hostentBuffer;
+}
+
+void WAVMWasmModule::setGuestErrno(Runtime::Context* ctx, int err)
+{
+    // errno lives in the guest's memory (and is thread-local when threads are
+    // enabled), so we have to ask the guest where it is from the calling
+    // context
+    Runtime::Function* errnoFunc =
+      getFunction(moduleInstance, "__errno_location", false);
+    if (errnoFunc == nullptr) {
+        SPDLOG_DEBUG("Guest does not export __errno_location, not setting {}",
+                     err);
+        return;
+    }
+
+    IR::UntaggedValue result;
+    executeWasmFunction(ctx, errnoFunc, {}, result);
+    Runtime::memoryRef<I32>(defaultMemory, (Uptr)result.u32) = err;
+}
+
 void WAVMWasmModule::doBindToFunction(faabric::Message& msg, bool cache)
 {
     doBindToFunctionInternal(msg, true, cache);
+
+    // Ensure Python function file in place (if necessary)
+    syncPythonFunctionFile(msg);
 }
 
 void WAVMWasmModule::bindToFunctionNoZygote(faabric::Message& msg)
 {
     doBindToFunctionInternal(msg, false, true);
+
+    syncPythonFunctionFile(msg);
+}
+
+/**
+ * Python Faaslets are bound to the Python runtime, so may execute different
+ * Python functions over their lifetime. We only go to the shared files when
+ * the function changes or a new version has been uploaded (through any host),
+ * so that warm invocations only need to read the version.
+ */
+void WAVMWasmModule::syncPythonFunctionFile(const faabric::Message& msg)
+{
+    if (!msg.ispython()) {
+        return;
+    }
+
+    std::string version = storage::SharedFiles::checkPythonFunctionVersion(msg);
+    std::string pythonFunction = msg.pythonuser() + "/" + msg.pythonfunction();
+    if (pythonFunction == syncedPythonFunction &&
+        version == syncedPythonFunctionVersion) {
+        return;
+    }
+
+    storage::SharedFiles::syncPythonFunctionFile(msg);
+
+    syncedPythonFunction = pythonFunction;
+    syncedPythonFunctionVersion = version;
 }
 
 void WAVMWasmModule::doBindToFunctionInternal(faabric::Message& msg,
@@ -479,8 +545,9 @@ void WAVMWasmModule::doBindToFunctionInternal(faabric::Message& msg,
     // Set up thread stacks
     createThreadStacks();
 
-    // Allocate a pool of OpenMP contexts
+    // Allocate pools of OpenMP and pthread contexts
     openMPContexts = std::vector<Runtime::Context*>(threadPoolSize, nullptr);
+    pthreadContexts = std::vector<Runtime::Context*>(threadPoolSize, nullptr);
 
     // Execute the wasm ctors function. This is a hook generated by the linker
     // that lets things set up the environment (e.g. handling preopened
@@ -856,8 +923,8 @@ int32_t WAVMWasmModule::executeFunction(faabric::Message& msg)
         throw std::runtime_error("Module must be bound before executing");
     }
 
-    // Ensure Python function file in place (if necessary)
-    storage::SharedFiles::syncPythonFunctionFile(msg);
+    // Ensure Python function file in place (a no-op when already synced)
+    syncPythonFunctionFile(msg);
 
     int funcPtr = msg.funcptr();
     std::vector<IR::UntaggedValue> invokeArgs;
@@ -946,18 +1013,32 @@ int32_t WAVMWasmModule::executePthread(int threadPoolIdx,
     int argsPtr = std::stoi(msg.inputdata());
     std::vector<IR::UntaggedValue> invokeArgs = { argsPtr };
 
-    Runtime::ContextRuntimeData* contextRuntimeData =
-      getContextRuntimeData(executionContext);
-
-    // Set up the context
-    Runtime::Context* threadContext =
-      createThreadContext(stackTop, contextRuntimeData);
+    // Reuse this executor thread's context if it has one. Unlike OpenMP
+    // microtasks, pthreads expect to start from a clean context
+    Runtime::Context* threadContext = pthreadContexts.at(threadPoolIdx);
+    if (threadContext == nullptr) {
+        Runtime::ContextRuntimeData* contextRuntimeData =
+          getContextRuntimeData(executionContext);
+        threadContext = createThreadContext(stackTop, contextRuntimeData);
+        pthreadContexts.at(threadPoolIdx) = threadContext;
+    } else {
+        resetThreadContext(threadContext, stackTop);
+    }
 
     // Execute the function
     IR::UntaggedValue returnValue;
     executeWasmFunction(threadContext, funcInstance, invokeArgs, returnValue);
     msg.set_returnvalue(returnValue.i32);
 
+    runPthreadKeyDestructors([this, threadContext](uint32_t destructor,
+                                                   uint32_t value) {
+        IR::UntaggedValue destructorResult;
+        executeWasmFunction(threadContext,
+                            getFunctionFromPtr(destructor),
+                            { value },
+                            destructorResult);
+    });
+
     return returnValue.i32;
 }
 
@@ -1377,6 +1458,16 @@ int WAVMWasmModule::getDataOffsetFromGOT(const std::string& name)
     return globalOffsetMemoryMap[name].first;
 }
 
+static void checkThreadStackTop(uint32_t stackTop)
+{
+    if ((stackTop & 15) != 0) {
+        SPDLOG_CRITICAL("Thread stack top {} is not 16 byte aligned, violating "
+                        "ABI requirements.",
+                        stackTop);
+        throw std::runtime_error("Thread stack top not 16 byte aligned");
+    }
+}
+
 Runtime::Context* WAVMWasmModule::createThreadContext(
   uint32_t stackTop,
   Runtime::ContextRuntimeData* contextRuntimeData)
@@ -1394,18 +1485,27 @@ Runtime::Context* WAVMWasmModule::createThreadContext(
         throw std::runtime_error("Unexpected mutable global format");
     }
 
-    if ((stackTop & 15) != 0) {
-        SPDLOG_CRITICAL("Thread stack top {} is not 16 byte aligned, violating "
-                        "ABI requirements.",
-                        stackTop);
-        throw std::runtime_error("Thread stack top not 16 byte aligned");
-    }
+    checkThreadStackTop(stackTop);
 
     ctx->runtimeData->mutableGlobals[0] = stackTop;
 
     return ctx;
 }
 
+void WAVMWasmModule::resetThreadContext(Runtime::Context* ctx,
+                                        uint32_t stackTop)
+{
+    checkThreadStackTop(stackTop);
+
+    // Put the mutable globals back to how they are in a new context, then
+    // point the stack pointer at the thread's stack
+    std::copy(std::begin(ctx->compartment->initialContextMutableGlobals),
+              std::end(ctx->compartment->initialContextMutableGlobals),
+              std::begin(ctx->runtimeData->mutableGlobals));
+
+    ctx->runtimeData->mutableGlobals[0] = stackTop;
+}
+
 Runtime::Function* WAVMWasmModule::getMainFunction(Runtime::Instance* module)
 {
     std::string mainFuncName(ENTRY_FUNC_NAME);
@@ -200,15 +200,9 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
     storage::FileDescriptor& fileDesc =
       getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
 
-    bool isStartCookie = startCookie == __WASI_DIRCOOKIE_START;
-    if (fileDesc.iterStarted() && isStartCookie) {
-        // Return invalid if we've already started the iterator but also get the
-        // start cookie
-        return __WASI_EINVAL;
-    } else if (!fileDesc.iterStarted() && !isStartCookie) {
-        throw std::runtime_error(
-          "No directory iterator exists, and this is not the start cookie");
-    }
+    // Sequential calls pass the cookie we're already at, so this only seeks
+    // when the guest rewinds or jumps elsewhere in the directory
+    fileDesc.iterSeek(startCookie);
 
     U8* buffer = Runtime::memoryArrayPtr<U8>(
       getExecutingWAVMModule()->defaultMemory, buf, bufLen);
@@ -317,10 +311,15 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi, "fd_close", I32, wasi_fd_close, I32 fd)
 {
     SPDLOG_DEBUG("S - fd_close - {}", fd);
 
-    // TODO - actually closing here can close the preopened fds which messes
-    // things up Ignore for now.
+    // Sockets are host fds that the filesystem doesn't know about, and may be
+    // returned to the connection pool rather than closed. Anything else we
+    // don't recognise is ignored. Preopened fds are also left open
+    WAVMWasmModule* module = getExecutingWAVMModule();
+    if (!module->getFileSystem().closeFileDescriptor(fd)) {
+        module->getConnectionPool().closeGuestSocket(fd);
+    }
 
-    return 0;
+    return __WASI_ESUCCESS;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
@@ -383,8 +382,11 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
     storage::FileDescriptor& fileDesc = fileSystem.getFileDescriptor(fd);
     auto nativeIovecs = wasiIovecsToNativeIovecs(iovecsPtr, iovecCount);
 
-    int bytesRead =
-      readv(fileDesc.getLinuxFd(), nativeIovecs.data(), iovecCount);
+    ssize_t bytesRead = fileDesc.read(nativeIovecs, iovecCount);
+    if (bytesRead < 0) {
+        return fileDesc.getWasiErrno();
+    }
+
     Runtime::memoryRef<int>(getExecutingWAVMModule()->defaultMemory,
                             resBytesRead) = (int)bytesRead;
 
@@ -393,6 +395,111 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
     return __WASI_ESUCCESS;
 }
 
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "fd_pread",
+                               I32,
+                               wasi_fd_pread,
+                               I32 fd,
+                               I32 iovecsPtr,
+                               I32 iovecCount,
+                               I64 offset,
+                               I32 resBytesRead)
+{
+    SPDLOG_TRACE(
+      "S - fd_pread - {} {} {} {}", fd, iovecsPtr, iovecCount, offset);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+    auto nativeIovecs = wasiIovecsToNativeIovecs(iovecsPtr, iovecCount);
+
+    ssize_t bytesRead = fileDesc.pread(nativeIovecs, iovecCount, offset);
+    if (bytesRead < 0) {
+        return fileDesc.getWasiErrno();
+    }
+
+    Runtime::memoryRef<U32>(getExecutingWAVMModule()->defaultMemory,
+                            resBytesRead) = (U32)bytesRead;
+
+    return __WASI_ESUCCESS;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "fd_pwrite",
+                               I32,
+                               wasi_fd_pwrite,
+                               I32 fd,
+                               I32 iovecsPtr,
+                               I32 iovecCount,
+                               I64 offset,
+                               I32 resBytesWrittenPtr)
+{
+    SPDLOG_TRACE(
+      "S - fd_pwrite - {} {} {} {}", fd, iovecsPtr, iovecCount, offset);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+    auto nativeIovecs = wasiIovecsToNativeIovecs(iovecsPtr, iovecCount);
+
+    ssize_t bytesWritten = fileDesc.pwrite(nativeIovecs, iovecCount, offset);
+    if (bytesWritten < 0) {
+        return fileDesc.getWasiErrno();
+    }
+
+    Runtime::memoryRef<U32>(getExecutingWAVMModule()->defaultMemory,
+                            resBytesWrittenPtr) = (U32)bytesWritten;
+
+    return __WASI_ESUCCESS;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi, "fd_sync", I32, wasi_fd_sync, I32 fd)
+{
+    SPDLOG_TRACE("S - fd_sync - {}", fd);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+    if (!fileDesc.sync(false)) {
+        return fileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "fd_datasync",
+                               I32,
+                               wasi_fd_datasync,
+                               I32 fd)
+{
+    SPDLOG_TRACE("S - fd_datasync - {}", fd);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+    if (!fileDesc.sync(true)) {
+        return fileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "fd_allocate",
+                               I32,
+                               wasi_fd_allocate,
+                               I32 fd,
+                               I64 offset,
+                               I64 len)
+{
+    SPDLOG_TRACE("S - fd_allocate - {} {} {}", fd, offset, len);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+    if (!fileDesc.allocate(offset, len)) {
+        return fileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
+}
+
 I32 s__mkdir(I32 pathPtr, I32 mode)
 {
     const std::string fakePath = getMaskedPathFromWasm(pathPtr);
@@ -405,6 +512,9 @@ I32 s__mkdir(I32 pathPtr, I32 mode)
         throw std::runtime_error("Failed on mkdir");
     }
 
+    // This bypasses the file descriptors, so drop any cached lookups
+    getExecutingWAVMModule()->getFileSystem().clearPathCache();
+
     return res;
 }
 
@@ -449,6 +559,9 @@ I32 s__rename(I32 srcPtr, I32 destPtr)
 
         throw std::runtime_error("Failed renaming file");
     }
+
+    getExecutingWAVMModule()->getFileSystem().clearPathCache();
+
     return res;
 }
 
@@ -484,6 +597,64 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
     return __WASI_ESUCCESS;
 }
 
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "path_link",
+                               I32,
+                               wasi_path_link,
+                               I32 oldFd,
+                               I32 oldFlags,
+                               I32 oldPath,
+                               I32 oldPathLen,
+                               I32 newFd,
+                               I32 newPath,
+                               I32 newPathLen)
+{
+    std::string oldPathStr = getStringFromWasm(oldPath);
+    std::string newPathStr = getStringFromWasm(newPath);
+
+    SPDLOG_DEBUG(
+      "S - path_link - {} {} {} {}", oldFd, oldPathStr, newFd, newPathStr);
+
+    WAVMWasmModule* module = getExecutingWAVMModule();
+    storage::FileDescriptor& oldFileDesc =
+      module->getFileSystem().getFileDescriptor(oldFd);
+    storage::FileDescriptor& newFileDesc =
+      module->getFileSystem().getFileDescriptor(newFd);
+
+    const std::string& fullNewPath = newFileDesc.absPath(newPathStr);
+    bool success = oldFileDesc.link(fullNewPath, oldPathStr);
+    if (!success) {
+        return oldFileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "path_symlink",
+                               I32,
+                               wasi_path_symlink,
+                               I32 oldPath,
+                               I32 oldPathLen,
+                               I32 fd,
+                               I32 newPath,
+                               I32 newPathLen)
+{
+    std::string targetStr = getStringFromWasm(oldPath);
+    std::string newPathStr = getStringFromWasm(newPath);
+
+    SPDLOG_DEBUG("S - path_symlink - {} {} {}", targetStr, fd, newPathStr);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+    bool success = fileDesc.symlink(targetStr, newPathStr);
+    if (!success) {
+        return fileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
+}
+
 WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
                                "path_unlink_file",
                                I32,
@@ -518,6 +689,8 @@ I32 s__unlink(I32 pathPtr)
         throw std::runtime_error("Failed on mkdir");
     }
 
+    getExecutingWAVMModule()->getFileSystem().clearPathCache();
+
     return res;
 }
 
@@ -672,13 +845,72 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
                                I32 fstFlags)
 {
     const std::string& pathStr = getStringFromWasm(path);
-    SPDLOG_TRACE("S - path_filestat_set_times - {} {} {} {}",
+    SPDLOG_TRACE("S - path_filestat_set_times - {} {} {} {} {} {}",
                  fd,
                  lookupFlags,
                  pathStr,
-                 pathLen);
+                 accessTimeStamp,
+                 modTimeStamp,
+                 fstFlags);
 
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+
+    bool followSymlinks = lookupFlags & __WASI_LOOKUP_SYMLINK_FOLLOW;
+    bool success = fileDesc.setTimes(
+      pathStr, accessTimeStamp, modTimeStamp, fstFlags, followSymlinks);
+    if (!success) {
+        return fileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "fd_filestat_set_times",
+                               I32,
+                               wasi_fd_filestat_set_times,
+                               I32 fd,
+                               I64 accessTimeStamp,
+                               I64 modTimeStamp,
+                               I32 fstFlags)
+{
+    SPDLOG_TRACE("S - fd_filestat_set_times - {} {} {} {}",
+                 fd,
+                 accessTimeStamp,
+                 modTimeStamp,
+                 fstFlags);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+
+    bool success =
+      fileDesc.setTimes("", accessTimeStamp, modTimeStamp, fstFlags);
+    if (!success) {
+        return fileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
+                               "fd_filestat_set_size",
+                               I32,
+                               wasi_fd_filestat_set_size,
+                               I32 fd,
+                               I64 size)
+{
+    SPDLOG_TRACE("S - fd_filestat_set_size - {} {}", fd, size);
+
+    storage::FileDescriptor& fileDesc =
+      getExecutingWAVMModule()->getFileSystem().getFileDescriptor(fd);
+
+    bool success = fileDesc.truncate(size);
+    if (!success) {
+        return fileDesc.getWasiErrno();
+    }
+
+    return __WASI_ESUCCESS;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
@@ -959,107 +1191,6 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(env, "chmod", I32, s__chmod, I32 a, I32 b)
     throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
 }
 
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "fd_datasync",
-                               I32,
-                               wasi_fd_datasync,
-                               I32 a)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "fd_pwrite",
-                               I32,
-                               wasi_fd_pwrite,
-                               I32 a,
-                               I32 b,
-                               I32 c,
-                               I64 d,
-                               I32 e)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "fd_pread",
-                               I32,
-                               wasi_fd_pread,
-                               I32 a,
-                               I32 b,
-                               I32 c,
-                               I64 d,
-                               I32 e)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "fd_filestat_set_size",
-                               I32,
-                               wasi_fd_filestat_set_size,
-                               I32 a,
-                               I64 b)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi, "fd_sync", I32, wasi_fd_sync, I32 a)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "fd_allocate",
-                               I32,
-                               wasi_fd_allocate,
-                               I32 a,
-                               I64 b,
-                               I64 c)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "fd_filestat_set_times",
-                               I32,
-                               fd_filestat_set_times,
-                               I32 a,
-                               I64 b,
-                               I64 c,
-                               I32 d)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "path_link",
-                               I32,
-                               wasi_path_link,
-                               I32 a,
-                               I32 b,
-                               I32 c,
-                               I32 d,
-                               I32 e,
-                               I32 f,
-                               I32 g)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-                               "path_symlink",
-                               I32,
-                               wasi_path_symlink,
-                               I32 a,
-                               I32 b,
-                               I32 c,
-                               I32 d,
-                               I32 e)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
 WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
                                "path_remove_directory",
                                I32,
@@ -3,14 +3,23 @@
 
 #include <faabric/util/bytes.h>
 #include <faabric/util/logging.h>
+#include <wasm/DnsCache.h>
 
+#include <climits>
 #include <netdb.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 
 #include <WAVM/Runtime/Intrinsics.h>
 #include <WAVM/Runtime/Runtime.h>
 
 using namespace WAVM;
 
+// Upper bound on the addresses we copy into a guest hostent
+#define MAX_HOSTENT_ADDRS 16
+
 namespace wasm {
 /** Writes changes to a native sockaddr back to a wasm sockaddr. This is
  * important in several networking syscalls that receive responses and modify
@@ -36,6 +45,103 @@ void setSockLen(socklen_t nativeValue, I32 wasmPtr)
     std::copy(&nativeValue, &nativeValue + 1, wasmAddrPtr);
 }
 
+/**
+ * Vectored sends and receives point the host's iovecs straight at the guest's
+ * buffers in linear memory, so nothing is copied on the way through.
+ */
+static I32 doSendRecvMsg(bool isSend, I32 sockfd, I32 msgPtr, I32 flags)
+{
+    Runtime::Memory* memoryPtr = getExecutingWAVMModule()->defaultMemory;
+    wasm_msghdr* wasmMsg = &Runtime::memoryRef<wasm_msghdr>(memoryPtr, msgPtr);
+
+    if (wasmMsg->msg_iovlen < 0 || wasmMsg->msg_iovlen > IOV_MAX) {
+        return -EMSGSIZE;
+    }
+
+    std::vector<::iovec> nativeIovecs =
+      wasmIovecsToNativeIovecs(wasmMsg->msg_iov, wasmMsg->msg_iovlen);
+
+    ::msghdr nativeMsg{};
+    nativeMsg.msg_iov = nativeIovecs.data();
+    nativeMsg.msg_iovlen = nativeIovecs.size();
+
+    // Guest sockaddrs have the same layout as the host's
+    if (wasmMsg->msg_name != 0) {
+        nativeMsg.msg_name = Runtime::memoryArrayPtr<U8>(
+          memoryPtr, wasmMsg->msg_name, wasmMsg->msg_namelen);
+        nativeMsg.msg_namelen = wasmMsg->msg_namelen;
+    }
+
+    ssize_t result;
+    if (isSend) {
+        if (wasmMsg->msg_controllen != 0) {
+            SPDLOG_ERROR("sendmsg with control messages not supported");
+            return -EOPNOTSUPP;
+        }
+
+        result = ::sendmsg(sockfd, &nativeMsg, flags);
+    } else {
+        result = ::recvmsg(sockfd, &nativeMsg, flags);
+    }
+
+    if (result < 0) {
+        return -errno;
+    }
+
+    if (!isSend) {
+        if (wasmMsg->msg_name != 0) {
+            wasmMsg->msg_namelen = nativeMsg.msg_namelen;
+        }
+        wasmMsg->msg_controllen = 0;
+        wasmMsg->msg_flags = nativeMsg.msg_flags;
+    }
+
+    return (I32)result;
+}
+
+/**
+ * Copies between a file and a socket in the kernel, so the data never passes
+ * through linear memory. The input must be one of the guest's files and the
+ * output a socket, i.e. a host fd. Guest musl uses sendfile64 in place of
+ * sendfile, so the offset is 64-bit.
+ */
+I32 s__sendfile64(I32 outFd, I32 inFd, I32 offsetPtr, I32 count)
+{
+    SPDLOG_DEBUG("S - sendfile64 - {} {} {} {}", outFd, inFd, offsetPtr, count);
+
+    WAVMWasmModule* module = getExecutingWAVMModule();
+    storage::FileSystem& fs = module->getFileSystem();
+
+    if (!fs.fileDescriptorExists(inFd)) {
+        return -EBADF;
+    }
+
+    // Writing to guest files directly would skip the filesystem's accounting
+    if (fs.fileDescriptorExists(outFd)) {
+        SPDLOG_ERROR("sendfile to a guest file not supported ({})", outFd);
+        return -EINVAL;
+    }
+
+    int nativeInFd = fs.getFileDescriptor(inFd).getLinuxFd();
+
+    ssize_t result;
+    if (offsetPtr == 0) {
+        result = ::sendfile(outFd, nativeInFd, nullptr, (U32)count);
+    } else {
+        I64* wasmOffset =
+          &Runtime::memoryRef<I64>(module->defaultMemory, offsetPtr);
+        off_t nativeOffset = *wasmOffset;
+        result = ::sendfile(outFd, nativeInFd, &nativeOffset, (U32)count);
+        *wasmOffset = nativeOffset;
+    }
+
+    if (result < 0) {
+        return -errno;
+    }
+
+    return (I32)result;
+}
+
 /**
  * When properly isolated, functions will run in their own network namespace,
  * therefore we can be relatively comfortable passing some of the syscalls
@@ -115,6 +221,8 @@ I32 s__socketcall(I32 call, I32 argsPtr)
 
             if (sock < 0) {
                 printf("Socket error: %i\n", sock);
+            } else {
+                module->getConnectionPool().addGuestSocket(sock);
             }
 
             return sock;
@@ -130,8 +238,10 @@ I32 s__socketcall(I32 call, I32 argsPtr)
             SPDLOG_DEBUG(
               "S - connect - {} {} {}", sockfd, addrPtr, subCallArgs[2]);
 
+            // This may reuse a pooled connection to the same destination
             sockaddr addr = getSockAddr(addrPtr);
-            int result = connect(sockfd, &addr, sizeof(sockaddr));
+            int result = module->getConnectionPool().connect(
+              sockfd, &addr, sizeof(sockaddr));
 
             return result;
         }
@@ -252,6 +362,63 @@ I32 s__socketcall(I32 call, I32 argsPtr)
             return result;
         }
 
+        case (SocketCalls::sc_setsockopt): {
+            U32* subCallArgs =
+              Runtime::memoryArrayPtr<U32>(memoryPtr, argsPtr, 5);
+            I32 sockfd = subCallArgs[0];
+            I32 level = subCallArgs[1];
+            I32 optName = subCallArgs[2];
+            I32 optValPtr = subCallArgs[3];
+            U32 optLen = subCallArgs[4];
+
+            SPDLOG_DEBUG("S - setsockopt - {} {} {} {} {}",
+                         sockfd,
+                         level,
+                         optName,
+                         optValPtr,
+                         optLen);
+
+            ConnectionPool& pool = module->getConnectionPool();
+
+            // Timeouts are timevals, which have a different layout in the
+            // guest. Other options are ints or byte arrays
+            if (level == SOL_SOCKET &&
+                (optName == SO_RCVTIMEO || optName == SO_SNDTIMEO)) {
+                if (optLen < sizeof(wasm_timeval)) {
+                    return -EINVAL;
+                }
+
+                auto wasmTv =
+                  &Runtime::memoryRef<wasm_timeval>(memoryPtr, optValPtr);
+                ::timeval tv{ .tv_sec = (time_t)wasmTv->tv_sec,
+                              .tv_usec = (suseconds_t)wasmTv->tv_usec };
+
+                return pool.setSockOpt(sockfd, level, optName, &tv, sizeof(tv));
+            }
+
+            U8* optVal =
+              Runtime::memoryArrayPtr<U8>(memoryPtr, optValPtr, optLen);
+            return pool.setSockOpt(sockfd, level, optName, optVal, optLen);
+        }
+
+        case (SocketCalls::sc_sendmsg):
+        case (SocketCalls::sc_recvmsg): {
+            U32* subCallArgs =
+              Runtime::memoryArrayPtr<U32>(memoryPtr, argsPtr, 3);
+            I32 sockfd = subCallArgs[0];
+            I32 msgPtr = subCallArgs[1];
+            I32 flags = subCallArgs[2];
+
+            bool isSend = call == SocketCalls::sc_sendmsg;
+            SPDLOG_DEBUG("S - {} - {} {} {}",
+                         isSend ? "sendmsg" : "recvmsg",
+                         sockfd,
+                         msgPtr,
+                         flags);
+
+            return doSendRecvMsg(isSend, sockfd, msgPtr, flags);
+        }
+
             // ----------------------------
             // Unfinished
             // ----------------------------
@@ -271,25 +438,11 @@ I32 s__socketcall(I32 call, I32 argsPtr)
             return 0;
         }
 
-        case (SocketCalls::sc_setsockopt): {
-            SPDLOG_DEBUG("S - setsockopt - {} {}", call, argsPtr);
-            return 0;
-        }
         case (SocketCalls::sc_getsockopt): {
             SPDLOG_DEBUG("S - getsockopt - {} {}", call, argsPtr);
             return 0;
         }
 
-        case (SocketCalls::sc_sendmsg): {
-            SPDLOG_DEBUG("S - sendmsg - {} {}", call, argsPtr);
-            return 0;
-        }
-
-        case (SocketCalls::sc_recvmsg): {
-            SPDLOG_DEBUG("S - recvmsg - {} {}", call, argsPtr);
-            return 0;
-        }
-
         case (SocketCalls::sc_accept4): {
             SPDLOG_DEBUG("S - accept4 - {} {}", call, argsPtr);
             return 0;
@@ -342,7 +495,51 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(env,
     const std::string hostname = getStringFromWasm(hostnamePtr);
     SPDLOG_DEBUG("S - gethostbyname {}", hostname);
 
-    return 0;
+    std::vector<::in_addr> addrs = getDnsCache().resolve(hostname);
+    if (addrs.empty()) {
+        return 0;
+    }
+
+    if (addrs.size() > MAX_HOSTENT_ADDRS) {
+        addrs.resize(MAX_HOSTENT_ADDRS);
+    }
+
+    // Lay out the hostent, followed by the null-terminated aliases and address
+    // lists, the addresses themselves, then the name
+    size_t aliasesOffset = sizeof(wasm_hostent);
+    size_t addrListOffset = aliasesOffset + sizeof(uint32_t);
+    size_t addrsOffset = addrListOffset + (addrs.size() + 1) * sizeof(uint32_t);
+    size_t nameOffset = addrsOffset + addrs.size() * sizeof(::in_addr);
+    size_t newMemSize = nameOffset + hostname.size() + 1;
+
+    WAVMWasmModule* module = getExecutingWAVMModule();
+    U32 wasmMemPtr = module->getHostentBuffer(newMemSize);
+    U8* hostBuffer = Runtime::memoryArrayPtr<U8>(
+      module->defaultMemory, wasmMemPtr, newMemSize);
+
+    auto wasmHostent = reinterpret_cast<wasm_hostent*>(hostBuffer);
+    wasmHostent->h_name = wasmMemPtr + nameOffset;
+    wasmHostent->h_aliases = wasmMemPtr + aliasesOffset;
+    wasmHostent->h_addrtype = AF_INET;
+    wasmHostent->h_length = sizeof(::in_addr);
+    wasmHostent->h_addr_list = wasmMemPtr + addrListOffset;
+
+    auto aliases = reinterpret_cast<uint32_t*>(hostBuffer + aliasesOffset);
+    aliases[0] = 0;
+
+    auto addrList = reinterpret_cast<uint32_t*>(hostBuffer + addrListOffset);
+    for (size_t i = 0; i < addrs.size(); i++) {
+        addrList[i] = wasmMemPtr + addrsOffset + i * sizeof(::in_addr);
+        std::copy_n(reinterpret_cast<U8*>(&addrs.at(i)),
+                    sizeof(::in_addr),
+                    hostBuffer + addrsOffset + i * sizeof(::in_addr));
+    }
+    addrList[addrs.size()] = 0;
+
+    std::copy(hostname.begin(), hostname.end(), hostBuffer + nameOffset);
+    hostBuffer[nameOffset + hostname.size()] = '\0';
+
+    return wasmMemPtr;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
@@ -2,39 +2,69 @@
 #include "syscalls.h"
 
 #include <faabric/util/logging.h>
+#include <wasm/WasmEnvironment.h>
+#include <wasm/scheduling.h>
 
 #include <WAVM/Runtime/Intrinsics.h>
+#include <WAVM/WASI/WASIABI.h>
+
+#include <sys/resource.h>
 
 using namespace WAVM;
 
 namespace wasm {
 
+// Guests can only see and change their own priority
+static bool isOwnPriority(I32 which, I32 who)
+{
+    return which == PRIO_PROCESS && (who == 0 || who == FAKE_PID);
+}
+
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
                                "getpriority",
                                I32,
                                getpriority,
-                               I32 a,
-                               I32 b)
+                               I32 which,
+                               I32 who)
 {
-    SPDLOG_DEBUG("S - getpriority - {} {}", a, b);
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
+    SPDLOG_DEBUG("S - getpriority - {} {}", which, who);
+
+    if (!isOwnPriority(which, who)) {
+        getExecutingWAVMModule()->setGuestErrno(
+          Runtime::getContextFromRuntimeData(contextRuntimeData), ESRCH);
+        return -1;
+    }
+
+    return getGuestPriority();
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
                                "setpriority",
                                I32,
                                setpriority,
-                               I32 a,
-                               I32 b,
-                               I32 c)
+                               I32 which,
+                               I32 who,
+                               I32 prio)
 {
-    SPDLOG_DEBUG("S - setpriority - {} {} {}", a, b, c);
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
+    SPDLOG_DEBUG("S - setpriority - {} {} {}", which, who, prio);
+
+    int err = isOwnPriority(which, who) ? -setGuestPriority(prio) : ESRCH;
+    if (err != 0) {
+        getExecutingWAVMModule()->setGuestErrno(
+          Runtime::getContextFromRuntimeData(contextRuntimeData), err);
+        return -1;
+    }
+
+    return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(wasi, "sched_yield", I32, wasi_sched_yield)
 {
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
+    SPDLOG_TRACE("S - sched_yield");
+
+    yieldGuest();
+
+    return __WASI_ESUCCESS;
 }
 
 void schedulingLink() {}
@@ -225,12 +225,18 @@ I32 executeSyscall(int syscallNumber,
             return s__getdents64(a, b, c);
         case 224:
             return s__gettid();
+        case 239:
+            return s__sendfile64(a, b, c, d);
         case 240:
             return s__futex(a, b, c, d, e, f);
         case 242:
             return s__sched_getaffinity(a, b, c);
         case 265:
             return s__clock_gettime(a, b);
+        case 266:
+            return s__clock_getres(a, b);
+        case 267:
+            return s__clock_nanosleep(a, b, c, d);
         case 355:
             return s__getrandom(a, b, c);
         case 375:
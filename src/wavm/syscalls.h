@@ -60,6 +60,20 @@ struct wasm_iovec
     uint32_t iov_len;
 };
 
+// Taken from musl's include/sys/socket.h for a 32-bit target. Note that
+// control messages aren't supported, as cmsghdr's layout differs from the
+// host's
+struct wasm_msghdr
+{
+    uint32_t msg_name;
+    uint32_t msg_namelen;
+    uint32_t msg_iov;
+    int32_t msg_iovlen;
+    uint32_t msg_control;
+    uint32_t msg_controllen;
+    int32_t msg_flags;
+};
+
 /* MPI-related interfacing structs and calls.
  */
 struct wasm_faabric_win_t
@@ -119,6 +133,15 @@ struct wasm_passwd
     uint32_t pw_shell; // char*
 };
 
+struct wasm_hostent
+{
+    uint32_t h_name;      // char*
+    uint32_t h_aliases;   // char**
+    int32_t h_addrtype;
+    int32_t h_length;
+    uint32_t h_addr_list; // char**
+};
+
 /**
  * To double check this, work out which header from the sysroot is resolved
  * Currently this is:
@@ -246,8 +269,15 @@ int executeSyscall(int syscallNumber,
 
 int32_t s__access(int32_t pathPtr, int32_t mode);
 
+int32_t s__clock_getres(int32_t clockId, int32_t resPtr);
+
 int32_t s__clock_gettime(int32_t clockId, int32_t timespecPtr);
 
+int32_t s__clock_nanosleep(int32_t clockId,
+                           int32_t flags,
+                           int32_t reqPtr,
+                           int32_t remPtr);
+
 int32_t s__close(int32_t fd);
 
 int32_t s__dup(int32_t oldFd);
@@ -330,6 +360,11 @@ int32_t s__rt_sigprocmask(int32_t how,
 
 int32_t s__sched_getaffinity(int32_t pid, int32_t cpuSetSize, int32_t maskPtr);
 
+int32_t s__sendfile64(int32_t outFd,
+                      int32_t inFd,
+                      int32_t offsetPtr,
+                      int32_t count);
+
 int32_t s__sigaction(int32_t a, int32_t b, int32_t c);
 
 int32_t s__sigemptyset(int32_t a);
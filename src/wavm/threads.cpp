@@ -10,12 +10,16 @@
 #include <faabric/util/logging.h>
 
 #include <threads/ThreadState.h>
+#include <wasm/ParkingLot.h>
 #include <wasm/WasmExecutionContext.h>
 #include <wasm/WasmModule.h>
 #include <wasm/chaining.h>
 #include <wavm/WAVMWasmModule.h>
 
+#include <atomic>
+#include <climits>
 #include <linux/futex.h>
+#include <optional>
 
 #include <WAVM/Platform/Thread.h>
 #include <WAVM/Runtime/Intrinsics.h>
@@ -119,6 +123,10 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(env,
 // FUTEX
 // ----------------------------------------------
 
+/**
+ * Futex waits and wakes are served by the module's parking lot, so they only
+ * reach threads of the same module on this host.
+ */
 I32 s__futex(I32 uaddrPtr,
              I32 futex_op,
              I32 val,
@@ -126,185 +134,242 @@ I32 s__futex(I32 uaddrPtr,
              I32 uaddr2Ptr,
              I32 other)
 {
+    SPDLOG_TRACE("S - futex - {} {} {} {} {} {}",
+                 uaddrPtr,
+                 futex_op,
+                 val,
+                 timeoutPtr,
+                 uaddr2Ptr,
+                 other);
 
-    std::string opStr;
-    int returnValue = 0;
+    WAVMWasmModule* module = getExecutingWAVMModule();
+    ParkingLot& parkingLot = module->getParkingLot();
 
-    // Reference to uaddr
     // The value pointed to by uaddr is always a four byte integer
-    Runtime::Memory* memoryPtr = getExecutingWAVMModule()->defaultMemory;
-    I32* actualValPtr = &Runtime::memoryRef<I32>(memoryPtr, (Uptr)uaddrPtr);
-    I32 actualVal = *actualValPtr;
-
-    if (futex_op == FUTEX_WAIT || futex_op == FUTEX_WAIT_PRIVATE) {
-        // Waiting needs to be handled using Faasm mechanisms so we ignore
-        opStr = futex_op == FUTEX_WAIT ? "FUTEX_WAIT" : "FUTEX_WAIT_PRIVATE";
-
-        // Need to set the value to be unequal to the expected, otherwise we get
-        // into a loop
-        I32 newVal = actualVal + 1;
-        std::copy(&newVal, &newVal + sizeof(I32), actualValPtr);
-
-        // val here is the expected value, we need to make sure the address
-        // still has that value
-        returnValue = 0;
-    } else if (futex_op == FUTEX_WAKE || futex_op == FUTEX_WAKE_PRIVATE) {
-        // Waking also needs to be handled with Faasm mechanisms so we also
-        // ignore
-        opStr = futex_op == FUTEX_WAKE ? "FUTEX_WAKE" : "FUTEX_WAKE_PRIVATE";
+    I32* actualValPtr =
+      &Runtime::memoryRef<I32>(module->defaultMemory, (Uptr)uaddrPtr);
+
+    int cmd = futex_op & FUTEX_CMD_MASK;
+    if (cmd == FUTEX_WAIT) {
+        // The timeout is relative
+        std::optional<ParkingLot::Deadline> deadline;
+        if (timeoutPtr != 0) {
+            auto timeout = &Runtime::memoryRef<wasm_timespec>(
+              module->defaultMemory, (Uptr)timeoutPtr);
+            if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 ||
+                timeout->tv_nsec >= 1000000000) {
+                return -EINVAL;
+            }
+
+            deadline = std::chrono::steady_clock::now() +
+                       std::chrono::seconds(timeout->tv_sec) +
+                       std::chrono::nanoseconds(timeout->tv_nsec);
+        }
+
+        // Only sleep if the value is still the one the guest expects
+        return parkingLot.park(
+          uaddrPtr,
+          [actualValPtr, val] {
+              return std::atomic_ref<I32>(*actualValPtr).load() == val;
+          },
+          [] {},
+          deadline);
+    }
 
+    if (cmd == FUTEX_WAKE) {
         // val here means "max waiters to wake"
-        returnValue = val;
-    } else {
-        SPDLOG_ERROR("Unsupported futex syscall with operation {}", futex_op);
-        throw std::runtime_error("Unuspported futex syscall");
+        return parkingLot.unpark(uaddrPtr, val);
     }
 
-    SPDLOG_DEBUG("S - futex - {} {} {} {} {} {} (uaddr = {})",
-                 uaddrPtr,
-                 opStr,
-                 val,
-                 timeoutPtr,
-                 uaddr2Ptr,
-                 other,
-                 actualVal);
-    return returnValue;
+    SPDLOG_ERROR("Unsupported futex syscall with operation {}", futex_op);
+    throw std::runtime_error("Unuspported futex syscall");
 }
 
 // --------------------------
-// PTHREAD MUTEXES - We support pthread mutexes locally as they're important to
-// support thread-safe libc operations.
-// Note we use trace logging here as these are invoked a lot
+// CONDITION VARIABLES - Waiters park on the address of the condition variable
+// in the module's parking lot, so as with pthread mutexes, these only work
+// between threads on the same host.
 // --------------------------
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_mutex_init",
+                               "pthread_cond_init",
                                I32,
-                               pthread_mutex_init,
-                               I32 mx,
-                               I32 attr)
+                               pthread_cond_init,
+                               I32 a,
+                               I32 b)
 {
-    SPDLOG_TRACE("S - pthread_mutex_init {} {}", mx, attr);
+    SPDLOG_TRACE("S - pthread_cond_init {} {}", a, b);
 
     return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_mutex_lock",
+                               "pthread_cond_wait",
                                I32,
-                               pthread_mutex_lock,
+                               pthread_cond_wait,
+                               I32 cond,
                                I32 mx)
 {
-    SPDLOG_TRACE("S - pthread_mutex_lock {}", mx);
-    getExecutingModule()->getOrCreatePthreadMutex(mx)->lock();
+    SPDLOG_TRACE("S - pthread_cond_wait {} {}", cond, mx);
 
-    return 0;
+    return getExecutingModule()->waitOnGuestCond(cond, mx, std::nullopt);
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_mutex_trylock",
+                               "pthread_cond_timedwait",
                                I32,
-                               s__pthread_mutex_trylock,
-                               I32 mx)
+                               pthread_cond_timedwait,
+                               I32 cond,
+                               I32 mx,
+                               I32 abstimePtr)
 {
-    SPDLOG_TRACE("S - pthread_mutex_trylock {}", mx);
+    SPDLOG_TRACE("S - pthread_cond_timedwait {} {} {}", cond, mx, abstimePtr);
+
+    // The timeout is an absolute time on the realtime clock, but we wait on
+    // the steady clock so that the wait isn't affected by clock changes
+    auto abstime = &Runtime::memoryRef<wasm_timespec>(
+      getExecutingWAVMModule()->defaultMemory, (Uptr)abstimePtr);
+    if (abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000) {
+        return EINVAL;
+    }
 
-    bool success =
-      getExecutingModule()->getOrCreatePthreadMutex(mx)->try_lock();
+    auto target = std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::seconds(abstime->tv_sec) +
+        std::chrono::nanoseconds(abstime->tv_nsec)));
+    ParkingLot::Deadline deadline =
+      std::chrono::steady_clock::now() +
+      (target - std::chrono::system_clock::now());
 
-    if (!success) {
-        return EBUSY;
-    }
+    return getExecutingModule()->waitOnGuestCond(cond, mx, deadline);
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(env,
+                               "pthread_cond_signal",
+                               I32,
+                               pthread_cond_signal,
+                               I32 cond)
+{
+    SPDLOG_TRACE("S - pthread_cond_signal {}", cond);
+    getExecutingModule()->getParkingLot().unpark(cond, 1);
 
     return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_mutex_unlock",
+                               "pthread_cond_broadcast",
                                I32,
-                               pthread_mutex_unlock,
-                               I32 mx)
+                               pthread_cond_broadcast,
+                               I32 cond)
 {
-    SPDLOG_TRACE("S - pthread_mutex_unlock {}", mx);
-    getExecutingModule()->getPthreadMutex(mx)->unlock();
+    SPDLOG_TRACE("S - pthread_cond_broadcast {}", cond);
+    getExecutingModule()->getParkingLot().unpark(cond, INT_MAX);
 
     return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_mutex_destroy",
+                               "pthread_cond_destroy",
                                I32,
-                               pthread_mutex_destroy,
-                               I32 mx)
+                               pthread_cond_destroy,
+                               I32 a)
 {
-    SPDLOG_TRACE("S - pthread_mutex_destroy {}", mx);
+    SPDLOG_TRACE("S - pthread_cond_destroy {}", a);
+
     return 0;
 }
 
 // --------------------------
-// STUBBED PTHREADS - We can safely ignore the following functions
+// PTHREAD MUTEXES - We support pthread mutexes locally as they're important to
+// support thread-safe libc operations. By default these use a lock word in the
+// guest's mutex, so an uncontended lock or unlock is a single atomic operation.
+// Note we use trace logging here as these are invoked a lot
 // --------------------------
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_mutexattr_init",
+                               "pthread_mutex_init",
                                I32,
-                               pthread_mutexattr_init,
-                               I32 a)
+                               pthread_mutex_init,
+                               I32 mx,
+                               I32 attr)
 {
-    SPDLOG_TRACE("S - pthread_mutexattr_init {}", a);
+    SPDLOG_TRACE("S - pthread_mutex_init {} {}", mx, attr);
+    getExecutingModule()->initGuestMutex(mx);
 
     return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_mutexattr_destroy",
+                               "pthread_mutex_lock",
                                I32,
-                               pthread_mutexattr_destroy,
-                               I32 a)
+                               pthread_mutex_lock,
+                               I32 mx)
 {
-    SPDLOG_TRACE("S - pthread_mutexattr_destroy {}", a);
+    SPDLOG_TRACE("S - pthread_mutex_lock {}", mx);
+    getExecutingModule()->lockGuestMutex(mx);
 
     return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_cond_init",
+                               "pthread_mutex_trylock",
                                I32,
-                               pthread_cond_init,
-                               I32 a,
-                               I32 b)
+                               s__pthread_mutex_trylock,
+                               I32 mx)
 {
-    SPDLOG_TRACE("S - pthread_cond_init {} {}", a, b);
+    SPDLOG_TRACE("S - pthread_mutex_trylock {}", mx);
+
+    if (!getExecutingModule()->tryLockGuestMutex(mx)) {
+        return EBUSY;
+    }
 
     return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_cond_signal",
+                               "pthread_mutex_unlock",
                                I32,
-                               pthread_cond_signal,
-                               I32 a)
+                               pthread_mutex_unlock,
+                               I32 mx)
 {
-    SPDLOG_TRACE("S - pthread_cond_signal {}", a);
+    SPDLOG_TRACE("S - pthread_mutex_unlock {}", mx);
+    getExecutingModule()->unlockGuestMutex(mx);
 
     return 0;
 }
 
-WAVM_DEFINE_INTRINSIC_FUNCTION(env, "pthread_self", I32, pthread_self)
+WAVM_DEFINE_INTRINSIC_FUNCTION(env,
+                               "pthread_mutex_destroy",
+                               I32,
+                               pthread_mutex_destroy,
+                               I32 mx)
 {
-    SPDLOG_TRACE("S - pthread_self");
-
+    SPDLOG_TRACE("S - pthread_mutex_destroy {}", mx);
     return 0;
 }
 
+// --------------------------
+// PTHREAD KEYS - Keys belong to the module, and values to the host thread
+// running the guest thread. Destructors run when a pthread's entry function
+// returns.
+// --------------------------
+
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
                                "pthread_key_create",
                                I32,
                                s__pthread_key_create,
-                               I32 a,
-                               I32 b)
+                               I32 keyPtr,
+                               I32 destructor)
 {
-    SPDLOG_TRACE("S - pthread_key_create {} {}", a, b);
+    SPDLOG_TRACE("S - pthread_key_create {} {}", keyPtr, destructor);
+
+    WAVMWasmModule* module = getExecutingWAVMModule();
+    int key = module->getPthreadKeys().createKey(destructor);
+    if (key < 0) {
+        return EAGAIN;
+    }
+
+    Runtime::memoryRef<U32>(module->defaultMemory, keyPtr) = key;
 
     return 0;
 }
@@ -313,9 +378,13 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(env,
                                "pthread_key_delete",
                                I32,
                                s__pthread_key_delete,
-                               I32 a)
+                               I32 key)
 {
-    SPDLOG_TRACE("S - pthread_key_delete {}", a);
+    SPDLOG_TRACE("S - pthread_key_delete {}", key);
+
+    if (!getExecutingModule()->getPthreadKeys().deleteKey(key)) {
+        return EINVAL;
+    }
 
     return 0;
 }
@@ -324,43 +393,64 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(env,
                                "pthread_getspecific",
                                I32,
                                s__pthread_getspecific,
-                               I32 a)
+                               I32 key)
 {
-    SPDLOG_TRACE("S - pthread_getspecific {}", a);
+    SPDLOG_TRACE("S - pthread_getspecific {}", key);
 
-    return 0;
+    if (!getExecutingModule()->getPthreadKeys().isKeyInUse(key)) {
+        return 0;
+    }
+
+    return threads::getPthreadKeyValue(key);
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
                                "pthread_setspecific",
                                I32,
                                s__pthread_setspecific,
-                               I32 a,
-                               I32 b)
+                               I32 key,
+                               I32 value)
 {
-    SPDLOG_TRACE("S - pthread_setspecific {} {}", a, b);
+    SPDLOG_TRACE("S - pthread_setspecific {} {}", key, value);
+
+    if (!getExecutingModule()->getPthreadKeys().isKeyInUse(key)) {
+        return EINVAL;
+    }
+
+    threads::setPthreadKeyValue(key, value);
 
     return 0;
 }
 
+// --------------------------
+// STUBBED PTHREADS - We can safely ignore the following functions
+// --------------------------
+
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_cond_destroy",
+                               "pthread_mutexattr_init",
                                I32,
-                               pthread_cond_destroy,
+                               pthread_mutexattr_init,
                                I32 a)
 {
-    SPDLOG_TRACE("S - pthread_cond_destroy {}", a);
+    SPDLOG_TRACE("S - pthread_mutexattr_init {}", a);
 
     return 0;
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_cond_broadcast",
+                               "pthread_mutexattr_destroy",
                                I32,
-                               pthread_cond_broadcast,
+                               pthread_mutexattr_destroy,
                                I32 a)
 {
-    SPDLOG_TRACE("S - pthread_cond_broadcast {}", a);
+    SPDLOG_TRACE("S - pthread_mutexattr_destroy {}", a);
+
+    return 0;
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(env, "pthread_self", I32, pthread_self)
+{
+    SPDLOG_TRACE("S - pthread_self");
 
     return 0;
 }
@@ -380,27 +470,6 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(env,
     throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
 }
 
-WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_cond_timedwait",
-                               I32,
-                               pthread_cond_timedwait,
-                               I32 a,
-                               I32 b,
-                               I32 c)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
-WAVM_DEFINE_INTRINSIC_FUNCTION(env,
-                               "pthread_cond_wait",
-                               I32,
-                               pthread_cond_wait,
-                               I32 a,
-                               I32 b)
-{
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
-}
-
 WAVM_DEFINE_INTRINSIC_FUNCTION(env,
                                "pthread_attr_init",
                                I32,
@@ -1,7 +1,11 @@
 #include "WAVMWasmModule.h"
 #include "syscalls.h"
 
+#include <wasm/poll.h>
+
+#include <cerrno>
 #include <sys/time.h>
+#include <time.h>
 
 #include <WAVM/Runtime/Intrinsics.h>
 #include <WAVM/WASI/WASIABI.h>
@@ -54,23 +58,69 @@ I32 s__gettimeofday(int tvPtr, int tzPtr)
     return 0;
 }
 
-/**
- * Allow sleep for now
- */
-I32 s__nanosleep(I32 reqPtr, I32 remPtr)
+I32 s__clock_getres(I32 clockId, I32 resPtr)
 {
-    SPDLOG_DEBUG("S - nanosleep - {} {}", reqPtr, remPtr);
+    SPDLOG_DEBUG("S - clock_getres - {} {}", clockId, resPtr);
 
-    auto request = &Runtime::memoryRef<wasm_timespec>(
-      getExecutingWAVMModule()->defaultMemory, (Uptr)reqPtr);
+    timespec ts{};
+    if (clock_getres(clockId, &ts) == -1) {
+        return -errno;
+    }
 
-    // TODO - is this ok? Should we allow?
-    // Round up
-    sleep(request->tv_sec + 1);
+    // A null result just checks the clock is valid
+    if (resPtr != 0) {
+        auto result = &Runtime::memoryRef<wasm_timespec>(
+          getExecutingWAVMModule()->defaultMemory, (Uptr)resPtr);
+        result->tv_sec = I64(ts.tv_sec);
+        result->tv_nsec = I32(ts.tv_nsec);
+    }
 
     return 0;
 }
 
+static I32 doNanosleep(clockid_t clockId, int flags, I32 reqPtr, I32 remPtr)
+{
+    Runtime::Memory* memoryPtr = getExecutingWAVMModule()->defaultMemory;
+    auto request = &Runtime::memoryRef<wasm_timespec>(memoryPtr, (Uptr)reqPtr);
+
+    timespec req{};
+    req.tv_sec = (time_t)request->tv_sec;
+    req.tv_nsec = (long)request->tv_nsec;
+
+    // The remaining time is only set if the sleep was interrupted
+    timespec rem{ .tv_sec = -1, .tv_nsec = 0 };
+    int res = sleepOnClock(clockId, flags, req, remPtr != 0 ? &rem : nullptr);
+    if (rem.tv_sec >= 0) {
+        auto remaining =
+          &Runtime::memoryRef<wasm_timespec>(memoryPtr, (Uptr)remPtr);
+        remaining->tv_sec = I64(rem.tv_sec);
+        remaining->tv_nsec = I32(rem.tv_nsec);
+    }
+
+    return -res;
+}
+
+I32 s__nanosleep(I32 reqPtr, I32 remPtr)
+{
+    SPDLOG_TRACE("S - nanosleep - {} {}", reqPtr, remPtr);
+
+    // Like nanosleep, this isn't affected by changes to the realtime clock
+    return doNanosleep(CLOCK_MONOTONIC, 0, reqPtr, remPtr);
+}
+
+I32 s__clock_nanosleep(I32 clockId, I32 flags, I32 reqPtr, I32 remPtr)
+{
+    SPDLOG_TRACE(
+      "S - clock_nanosleep - {} {} {} {}", clockId, flags, reqPtr, remPtr);
+
+    int linuxClockId = wasiClockToLinux(clockId);
+    if (linuxClockId < 0) {
+        return -EINVAL;
+    }
+
+    return doNanosleep(linuxClockId, flags & TIMER_ABSTIME, reqPtr, remPtr);
+}
+
 WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
                                "poll_oneoff",
                                I32,
@@ -85,6 +135,10 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
                  eventsPtr,
                  nSubs,
                  resNEvents);
+    if (nSubs <= 0) {
+        return __WASI_EINVAL;
+    }
+
     WAVMWasmModule* module = getExecutingWAVMModule();
 
     auto inEvents = Runtime::memoryArrayPtr<__wasi_subscription_t>(
@@ -92,37 +146,36 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
     auto outEvents = Runtime::memoryArrayPtr<__wasi_event_t>(
       module->defaultMemory, eventsPtr, nSubs);
 
+    std::vector<PollSubscription> subs(nSubs);
     for (int i = 0; i < nSubs; i++) {
-        __wasi_subscription_t* thisSub = &inEvents[i];
-
-        if (thisSub->type == __WASI_EVENTTYPE_CLOCK) {
-            // This is a timing event like a sleep
-            uint64_t timeoutNanos = thisSub->u.clock.timeout;
-            int clockType = 0;
-            if (thisSub->u.clock.clock_id == __WASI_CLOCK_MONOTONIC) {
-                clockType = CLOCK_MONOTONIC;
-            } else if (thisSub->u.clock.clock_id == __WASI_CLOCK_REALTIME) {
-                clockType = CLOCK_REALTIME;
-            } else {
-                throw std::runtime_error("Unimplemented clock type");
-            }
-
-            // Do the sleep
-            timespec t{};
-            faabric::util::nanosToTimespec(timeoutNanos, &t);
-            clock_nanosleep(clockType, 0, &t, nullptr);
+        const __wasi_subscription_t& inSub = inEvents[i];
+        subs[i].userdata = inSub.userdata;
+        subs[i].type = inSub.type;
+
+        if (inSub.type == __WASI_EVENTTYPE_CLOCK) {
+            subs[i].clockId = inSub.u.clock.clock_id;
+            subs[i].timeout = inSub.u.clock.timeout;
+            subs[i].flags = inSub.u.clock.flags;
         } else {
-            throw std::runtime_error("Unimplemented event type");
+            subs[i].fd = inSub.u.fd_readwrite.fd;
         }
+    }
 
-        // Say that the event has occurred
-        __wasi_event_t* thisEvent = &outEvents[i];
-        thisEvent->type = thisSub->type;
-        thisEvent->error = __WASI_ESUCCESS;
+    // Sockets are plain host fds in WAVM, so we let those through
+    std::vector<PollEvent> events =
+      pollOneoff(module->getFileSystem(), subs, true);
+
+    for (size_t i = 0; i < events.size(); i++) {
+        __wasi_event_t* outEvent = &outEvents[i];
+        outEvent->userdata = events[i].userdata;
+        outEvent->error = events[i].error;
+        outEvent->type = events[i].type;
+        outEvent->u.fd_readwrite.nbytes = events[i].nBytes;
+        outEvent->u.fd_readwrite.flags = events[i].flags;
     }
 
-    // Write the result
-    Runtime::memoryRef<U32>(module->defaultMemory, resNEvents) = (U32)nSubs;
+    Runtime::memoryRef<U32>(module->defaultMemory, resNEvents) =
+      (U32)events.size();
 
     return __WASI_ESUCCESS;
 }
@@ -143,21 +196,12 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
     SPDLOG_TRACE(
       "S - clock_time_get - {} {} {}", clockId, precision, resultPtr);
 
-    timespec ts{};
-
-    int linuxClockId;
-    if (clockId == __WASI_CLOCK_REALTIME) {
-        linuxClockId = CLOCK_REALTIME;
-    } else if (clockId == __WASI_CLOCK_MONOTONIC) {
-        linuxClockId = CLOCK_MONOTONIC;
-    } else if (clockId == __WASI_CLOCK_PROCESS_CPUTIME_ID) {
-        linuxClockId = CLOCK_PROCESS_CPUTIME_ID;
-    } else if (clockId == __WASI_CLOCK_THREAD_CPUTIME_ID) {
-        linuxClockId = CLOCK_THREAD_CPUTIME_ID;
-    } else {
+    int linuxClockId = wasiClockToLinux(clockId);
+    if (linuxClockId < 0) {
         throw std::runtime_error("Unknown clock ID");
     }
 
+    timespec ts{};
     int retVal = clock_gettime(linuxClockId, &ts);
     if (retVal < 0) {
         if (EINVAL) {
@@ -178,10 +222,19 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
                                "clock_res_get",
                                I32,
                                wasi_clock_res_get,
-                               I32 a,
-                               I32 b)
+                               I32 clockId,
+                               I32 resultPtr)
 {
-    throwException(Runtime::ExceptionTypes::calledUnimplementedIntrinsic);
+    SPDLOG_TRACE("S - clock_res_get - {} {}", clockId, resultPtr);
+
+    uint64_t result = 0;
+    uint16_t err = wasiClockResolution(clockId, &result);
+    if (err == __WASI_ESUCCESS) {
+        Runtime::memoryRef<uint64_t>(getExecutingWAVMModule()->defaultMemory,
+                                     resultPtr) = result;
+    }
+
+    return err;
 }
 
 void timingLink() {}
@@ -52,7 +52,7 @@ std::pair<std::string, std::string> getUserKeyPairFromWasm(I32 keyPtr)
 std::string getMaskedPathFromWasm(I32 strPtr)
 {
     const std::string originalPath = getStringFromWasm(strPtr);
-    return storage::prependRuntimeRoot(originalPath);
+    return getExecutingWAVMModule()->getFileSystem().realPathFor(originalPath);
 }
 
 /** Translates a wasm sockaddr into a native sockaddr */
@@ -112,8 +112,11 @@ std::vector<::iovec> wasmIovecsToNativeIovecs(I32 wasmIovecPtr,
     std::vector<::iovec> nativeIovecs(wasmIovecCount, (::iovec){});
     for (int i = 0; i < wasmIovecCount; i++) {
 
+        // Check the whole buffer is in bounds, as the host will access all
+        // of it directly
         wasm_iovec wasmIovec = wasmIovecs[i];
-        U8* outputPtr = &Runtime::memoryRef<U8>(memoryPtr, wasmIovec.iov_base);
+        U8* outputPtr = Runtime::memoryArrayPtr<U8>(
+          memoryPtr, wasmIovec.iov_base, wasmIovec.iov_len);
 
         nativeIovecs[i] = {
             .iov_base = outputPtr,
@@ -19,8 +19,27 @@ TEST_CASE("Test default faasm config initialisation", "[conf]")
         cgroupExpected = "off";
     }
     REQUIRE(conf.cgroupMode == cgroupExpected);
+    REQUIRE(conf.cgroupGranularity == "function");
+    REQUIRE(conf.cgroupCpuWeight.empty());
+    REQUIRE(conf.cgroupCpuMax.empty());
+    REQUIRE(conf.cgroupMemoryMax.empty());
     REQUIRE(conf.netNsMode == "off");
     REQUIRE(conf.maxNetNs == 100);
+    REQUIRE(conf.netNsPrejoin == "off");
+
+    REQUIRE(conf.connPoolMode == "off");
+    REQUIRE(conf.connPoolPorts.empty());
+    REQUIRE(conf.connPoolMaxPerDest == 8);
+    REQUIRE(conf.connPoolIdleTimeoutMs == 30000);
+    REQUIRE(conf.dnsCacheMode == "on");
+    REQUIRE(conf.dnsHostsFile == "/etc/hosts");
+    REQUIRE(conf.dnsCacheMaxTtlSeconds == 300);
+    REQUIRE(conf.dnsCacheNegativeTtlSeconds == 30);
+    REQUIRE(conf.guestNiceMin == 0);
+    REQUIRE(conf.guestNiceMax == 19);
+    REQUIRE(conf.pthreadDispatchMode == "join");
+    REQUIRE(conf.pthreadBatchWindowUs == 500);
+    REQUIRE(conf.guestMutexMode == "atomic");
 
     REQUIRE(conf.pythonPreload == "off");
     REQUIRE(conf.captureStdout == "off");
@@ -29,6 +48,16 @@ TEST_CASE("Test default faasm config initialisation", "[conf]")
 
     REQUIRE(conf.wasmVm == "wavm");
 
+    REQUIRE(conf.sharedFilesNegativeTtlMs == 5000);
+    REQUIRE(conf.sharedFilesPrefetch.empty());
+
+    REQUIRE(conf.storageBackend == "s3");
+    REQUIRE(conf.localStorageDir == "/usr/local/faasm/storage");
+    REQUIRE(conf.fileIoBackend == "syscall");
+    REQUIRE(conf.fsOverlayPaths.empty());
+    REQUIRE(conf.fsOverlayDir == "/dev/shm/faasm-overlay");
+    REQUIRE(conf.fsOverlayMaxMb == 64);
+
     REQUIRE(conf.s3Bucket == "faasm");
     REQUIRE(conf.s3Host == "minio");
     REQUIRE(conf.s3Port == "9000");
@@ -44,8 +73,27 @@ TEST_CASE("Test overriding faasm config initialisation", "[conf]")
 
     std::string hostType = setEnvVar("HOST_TYPE", "magic");
     std::string cgMode = setEnvVar("CGROUP_MODE", "off");
+    std::string cgGranularity = setEnvVar("CGROUP_GRANULARITY", "user");
+    std::string cgCpuWeight = setEnvVar("CGROUP_CPU_WEIGHT", "50");
+    std::string cgCpuMax = setEnvVar("CGROUP_CPU_MAX", "50000 100000");
+    std::string cgMemoryMax = setEnvVar("CGROUP_MEMORY_MAX", "1G");
     std::string nsMode = setEnvVar("NETNS_MODE", "on");
     std::string maxNetNs = setEnvVar("MAX_NET_NAMESPACES", "300");
+    std::string nsPrejoin = setEnvVar("NETNS_PREJOIN", "on");
+
+    std::string connPoolMode = setEnvVar("CONN_POOL_MODE", "on");
+    std::string connPoolPorts = setEnvVar("CONN_POOL_PORTS", "80,8080");
+    std::string connPoolMax = setEnvVar("CONN_POOL_MAX_PER_DEST", "2");
+    std::string connPoolIdle = setEnvVar("CONN_POOL_IDLE_TIMEOUT_MS", "500");
+    std::string dnsCacheMode = setEnvVar("DNS_CACHE_MODE", "hosts");
+    std::string dnsHostsFile = setEnvVar("DNS_HOSTS_FILE", "/tmp/hosts");
+    std::string dnsMaxTtl = setEnvVar("DNS_CACHE_MAX_TTL_S", "60");
+    std::string dnsNegTtl = setEnvVar("DNS_CACHE_NEGATIVE_TTL_S", "5");
+    std::string guestNiceMin = setEnvVar("GUEST_NICE_MIN", "5");
+    std::string guestNiceMax = setEnvVar("GUEST_NICE_MAX", "10");
+    std::string pthreadDispatch = setEnvVar("PTHREAD_DISPATCH_MODE", "eager");
+    std::string pthreadWindow = setEnvVar("PTHREAD_BATCH_WINDOW_US", "0");
+    std::string guestMutexMode = setEnvVar("GUEST_MUTEX_MODE", "host");
 
     std::string pythonPre = setEnvVar("PYTHON_PRELOAD", "on");
     std::string captureStdout = setEnvVar("CAPTURE_STDOUT", "on");
@@ -54,6 +102,16 @@ TEST_CASE("Test overriding faasm config initialisation", "[conf]")
     std::string chainedTimeout = setEnvVar("CHAINED_CALL_TIMEOUT", "9999");
 
     std::string faasmLocalDir = setEnvVar("FAASM_LOCAL_DIR", "/tmp/blah");
+    std::string sharedNegTtl = setEnvVar("SHARED_FILES_NEGATIVE_TTL_MS", "123");
+    std::string sharedPrefetch =
+      setEnvVar("SHARED_FILES_PREFETCH", "foo/bar,baz");
+
+    std::string storageBackend = setEnvVar("STORAGE_BACKEND", "local");
+    std::string localStorageDir = setEnvVar("LOCAL_STORAGE_DIR", "/tmp/store");
+    std::string fileIoBackend = setEnvVar("FILE_IO_BACKEND", "io_uring");
+    std::string fsOverlayPaths = setEnvVar("FS_OVERLAY_PATHS", "/tmp,/scratch");
+    std::string fsOverlayDir = setEnvVar("FS_OVERLAY_DIR", "/tmp/overlay");
+    std::string fsOverlayMaxMb = setEnvVar("FS_OVERLAY_MAX_MB", "16");
 
     std::string s3Bucket = setEnvVar("S3_BUCKET", "dummy-bucket");
     std::string s3Host = setEnvVar("S3_HOST", "dummy-host");
@@ -69,8 +127,27 @@ TEST_CASE("Test overriding faasm config initialisation", "[conf]")
 
     REQUIRE(conf.hostType == "magic");
     REQUIRE(conf.cgroupMode == "off");
+    REQUIRE(conf.cgroupGranularity == "user");
+    REQUIRE(conf.cgroupCpuWeight == "50");
+    REQUIRE(conf.cgroupCpuMax == "50000 100000");
+    REQUIRE(conf.cgroupMemoryMax == "1G");
     REQUIRE(conf.netNsMode == "on");
     REQUIRE(conf.maxNetNs == 300);
+    REQUIRE(conf.netNsPrejoin == "on");
+
+    REQUIRE(conf.connPoolMode == "on");
+    REQUIRE(conf.connPoolPorts == "80,8080");
+    REQUIRE(conf.connPoolMaxPerDest == 2);
+    REQUIRE(conf.connPoolIdleTimeoutMs == 500);
+    REQUIRE(conf.dnsCacheMode == "hosts");
+    REQUIRE(conf.dnsHostsFile == "/tmp/hosts");
+    REQUIRE(conf.dnsCacheMaxTtlSeconds == 60);
+    REQUIRE(conf.dnsCacheNegativeTtlSeconds == 5);
+    REQUIRE(conf.guestNiceMin == 5);
+    REQUIRE(conf.guestNiceMax == 10);
+    REQUIRE(conf.pthreadDispatchMode == "eager");
+    REQUIRE(conf.pthreadBatchWindowUs == 0);
+    REQUIRE(conf.guestMutexMode == "host");
 
     REQUIRE(conf.pythonPreload == "on");
     REQUIRE(conf.captureStdout == "on");
@@ -82,6 +159,15 @@ TEST_CASE("Test overriding faasm config initialisation", "[conf]")
     REQUIRE(conf.objectFileDir == "/tmp/blah/object");
     REQUIRE(conf.runtimeFilesDir == "/tmp/blah/runtime_root");
     REQUIRE(conf.sharedFilesDir == "/tmp/blah/shared");
+    REQUIRE(conf.sharedFilesNegativeTtlMs == 123);
+    REQUIRE(conf.sharedFilesPrefetch == "foo/bar,baz");
+
+    REQUIRE(conf.storageBackend == "local");
+    REQUIRE(conf.localStorageDir == "/tmp/store");
+    REQUIRE(conf.fileIoBackend == "io_uring");
+    REQUIRE(conf.fsOverlayPaths == "/tmp,/scratch");
+    REQUIRE(conf.fsOverlayDir == "/tmp/overlay");
+    REQUIRE(conf.fsOverlayMaxMb == 16);
 
     REQUIRE(conf.s3Bucket == "dummy-bucket");
     REQUIRE(conf.s3Host == "dummy-host");
@@ -95,8 +181,27 @@ TEST_CASE("Test overriding faasm config initialisation", "[conf]")
     setEnvVar("HOST_TYPE", originalHostType);
 
     setEnvVar("CGROUP_MODE", cgMode);
+    setEnvVar("CGROUP_GRANULARITY", cgGranularity);
+    setEnvVar("CGROUP_CPU_WEIGHT", cgCpuWeight);
+    setEnvVar("CGROUP_CPU_MAX", cgCpuMax);
+    setEnvVar("CGROUP_MEMORY_MAX", cgMemoryMax);
     setEnvVar("NETNS_MODE", nsMode);
     setEnvVar("MAX_NET_NAMESPACES", maxNetNs);
+    setEnvVar("NETNS_PREJOIN", nsPrejoin);
+
+    setEnvVar("CONN_POOL_MODE", connPoolMode);
+    setEnvVar("CONN_POOL_PORTS", connPoolPorts);
+    setEnvVar("CONN_POOL_MAX_PER_DEST", connPoolMax);
+    setEnvVar("CONN_POOL_IDLE_TIMEOUT_MS", connPoolIdle);
+    setEnvVar("DNS_CACHE_MODE", dnsCacheMode);
+    setEnvVar("DNS_HOSTS_FILE", dnsHostsFile);
+    setEnvVar("DNS_CACHE_MAX_TTL_S", dnsMaxTtl);
+    setEnvVar("DNS_CACHE_NEGATIVE_TTL_S", dnsNegTtl);
+    setEnvVar("GUEST_NICE_MIN", guestNiceMin);
+    setEnvVar("GUEST_NICE_MAX", guestNiceMax);
+    setEnvVar("PTHREAD_DISPATCH_MODE", pthreadDispatch);
+    setEnvVar("PTHREAD_BATCH_WINDOW_US", pthreadWindow);
+    setEnvVar("GUEST_MUTEX_MODE", guestMutexMode);
 
     setEnvVar("PYTHON_PRELOAD", pythonPre);
     setEnvVar("CAPTURE_STDOUT", captureStdout);
@@ -105,6 +210,15 @@ TEST_CASE("Test overriding faasm config initialisation", "[conf]")
     setEnvVar("CHAINED_CALL_TIMEOUT", chainedTimeout);
 
     setEnvVar("FAASM_LOCAL_DIR", faasmLocalDir);
+    setEnvVar("SHARED_FILES_NEGATIVE_TTL_MS", sharedNegTtl);
+    setEnvVar("SHARED_FILES_PREFETCH", sharedPrefetch);
+
+    setEnvVar("STORAGE_BACKEND", storageBackend);
+    setEnvVar("LOCAL_STORAGE_DIR", localStorageDir);
+    setEnvVar("FILE_IO_BACKEND", fileIoBackend);
+    setEnvVar("FS_OVERLAY_PATHS", fsOverlayPaths);
+    setEnvVar("FS_OVERLAY_DIR", fsOverlayDir);
+    setEnvVar("FS_OVERLAY_MAX_MB", fsOverlayMaxMb);
 
     setEnvVar("S3_BUCKET", s3Bucket);
     setEnvVar("S3_HOST", s3Host);
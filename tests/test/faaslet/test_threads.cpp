@@ -4,18 +4,27 @@
 #include "utils.h"
 
 #include <faabric/proto/faabric.pb.h>
+#include <faabric/scheduler/ExecutorContext.h>
 #include <faabric/scheduler/FunctionCallClient.h>
 #include <faabric/scheduler/Scheduler.h>
 #include <faabric/util/config.h>
 #include <faabric/util/func.h>
 #include <faabric/util/testing.h>
+#include <wasm/GuestMutex.h>
+#include <wasm/WasmExecutionContext.h>
+#include <wamr/WAMRWasmModule.h>
+#include <wasm/WasmModule.h>
 #include <wavm/WAVMWasmModule.h>
 
+#include <future>
+#include <thread>
+
 namespace tests {
 
 class PthreadTestFixture
   : public FunctionExecTestFixture
   , public ConfFixture
+  , public FaasmConfTestFixture
 {
   public:
     PthreadTestFixture() { conf.overrideCpuCount = nThreads + 2; }
@@ -27,6 +36,17 @@ class PthreadTestFixture
         std::shared_ptr<faabric::BatchExecuteRequest> req =
           faabric::util::batchExecFactory("demo", function, 1);
 
+        // WAMR threads share the main thread's linear memory, which needs
+        // the function to be built with shared memory
+        if (faasmConf.wasmVm == "wamr") {
+            wasm::WAMRWasmModule module;
+            module.bindToFunction(req->mutable_messages()->at(0));
+
+            INFO("WAMR threads need demo/" << function
+                                           << " built with shared memory");
+            REQUIRE(module.isMemoryShared());
+        }
+
         executeWithPool(req);
     }
 
@@ -36,11 +56,206 @@ class PthreadTestFixture
 
 TEST_CASE_METHOD(PthreadTestFixture, "Test local-only threading", "[threads]")
 {
+    SECTION("WAVM") { faasmConf.wasmVm = "wavm"; }
+
+    SECTION("WAMR") { faasmConf.wasmVm = "wamr"; }
+
     runTestLocally("threads_local");
 }
 
 TEST_CASE_METHOD(PthreadTestFixture, "Run thread checks locally", "[threads]")
 {
+    SECTION("WAVM") { faasmConf.wasmVm = "wavm"; }
+
+    SECTION("WAMR") { faasmConf.wasmVm = "wamr"; }
+
+    runTestLocally("threads_check");
+}
+
+TEST_CASE_METHOD(PthreadTestFixture,
+                 "Test pthread dispatch modes",
+                 "[threads]")
+{
+    SECTION("Eager with batch window")
+    {
+        faasmConf.pthreadDispatchMode = "eager";
+        faasmConf.pthreadBatchWindowUs = 500;
+    }
+
+    SECTION("Eager without batch window")
+    {
+        faasmConf.pthreadDispatchMode = "eager";
+        faasmConf.pthreadBatchWindowUs = 0;
+    }
+
+    SECTION("Dispatch on join") { faasmConf.pthreadDispatchMode = "join"; }
+
+    runTestLocally("threads_local");
     runTestLocally("threads_check");
 }
+
+TEST_CASE_METHOD(PthreadTestFixture,
+                 "Test condition waits fail when they can't be signalled",
+                 "[threads]")
+{
+    std::shared_ptr<faabric::BatchExecuteRequest> req =
+      faabric::util::batchExecFactory("demo", "echo", 1);
+    faabric::Message& call = req->mutable_messages()->at(0);
+
+    wasm::WAVMWasmModule module;
+    module.bindToFunction(call);
+    uint32_t mxPtr = module.growMemory(WASM_BYTES_PER_PAGE);
+    uint32_t condPtr = mxPtr + 64;
+
+    int expected = 0;
+
+    SECTION("Main thread with no threads")
+    {
+        faasmConf.pthreadDispatchMode = "eager";
+        expected = EDEADLK;
+    }
+
+    SECTION("Main thread with threads that are only sent on join")
+    {
+        // Queued threads are never sent if the main thread is stuck waiting
+        faasmConf.pthreadDispatchMode = "join";
+        faabric::scheduler::ExecutorContext::set(nullptr, req, 0);
+        threads::PthreadCall pthreadCall;
+        pthreadCall.pthreadPtr = 1;
+        pthreadCall.entryFunc = 1;
+        pthreadCall.argsPtr = 0;
+        module.queuePthreadCall(pthreadCall);
+        expected = EDEADLK;
+    }
+
+    SECTION("Main thread with eager threads spread across hosts")
+    {
+        // Threads on other hosts aren't sent eagerly, so are only sent on
+        // join just as above
+        faasmConf.pthreadDispatchMode = "eager";
+        faasmConf.pthreadBatchWindowUs = 0;
+        module.setThreadsSingleHost(false);
+        faabric::scheduler::ExecutorContext::set(nullptr, req, 0);
+        threads::PthreadCall pthreadCall;
+        pthreadCall.pthreadPtr = 1;
+        pthreadCall.entryFunc = 1;
+        pthreadCall.argsPtr = 0;
+        module.queuePthreadCall(pthreadCall);
+        expected = EDEADLK;
+    }
+
+    faabric::scheduler::ExecutorContext::set(nullptr, req, 0);
+    wasm::WasmExecutionContext ctx(&module);
+
+    // The wait fails straight away, leaving the mutex held
+    module.lockGuestMutex(mxPtr);
+    REQUIRE(module.waitOnGuestCond(condPtr, mxPtr, std::nullopt) == expected);
+    REQUIRE(!module.tryLockGuestMutex(mxPtr));
+
+    // Timed waits still wait, as the deadline wakes them
+    auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+    REQUIRE(module.waitOnGuestCond(condPtr, mxPtr, deadline) == ETIMEDOUT);
+
+    module.unlockGuestMutex(mxPtr);
+    module.awaitAllPthreadCalls();
+}
+
+TEST_CASE_METHOD(PthreadTestFixture,
+                 "Test condition waits in a multi-host batch still wait",
+                 "[threads]")
+{
+    std::shared_ptr<faabric::BatchExecuteRequest> req =
+      faabric::util::batchExecFactory("demo", "echo", 1);
+    faabric::Message& call = req->mutable_messages()->at(0);
+
+    wasm::WAVMWasmModule module;
+    module.bindToFunction(call);
+    uint32_t mxPtr = module.growMemory(WASM_BYTES_PER_PAGE);
+    uint32_t condPtr = mxPtr + 64;
+
+    // Other threads in the batch may well be on this host
+    req->set_type(faabric::BatchExecuteRequest::THREADS);
+    req->set_subtype(wasm::ThreadRequestType::PTHREAD);
+    req->set_singlehost(false);
+    faabric::scheduler::ExecutorContext::set(nullptr, req, 0);
+    wasm::WasmExecutionContext ctx(&module);
+
+    auto signaller = std::async(std::launch::async, [&module, condPtr] {
+        while (module.getParkingLot().getParkedCount(condPtr) != 1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return module.getParkingLot().unpark(condPtr, 1);
+    });
+
+    module.lockGuestMutex(mxPtr);
+    REQUIRE(module.waitOnGuestCond(condPtr, mxPtr, std::nullopt) == 0);
+    REQUIRE(signaller.get() == 1);
+    module.unlockGuestMutex(mxPtr);
+}
+
+TEST_CASE_METHOD(PthreadTestFixture,
+                 "Test guest mutex mode follows config",
+                 "[threads]")
+{
+    faabric::Message call = faabric::util::messageFactory("demo", "echo");
+    wasm::WAVMWasmModule module;
+    module.bindToFunction(call);
+    uint32_t mxPtr = module.growMemory(WASM_BYTES_PER_PAGE);
+
+    bool singleHost = true;
+    bool expectHost = false;
+
+    SECTION("Single host")
+    {
+        singleHost = true;
+        expectHost = false;
+    }
+
+    SECTION("Single host with host mutexes")
+    {
+        faasmConf.guestMutexMode = "host";
+        singleHost = true;
+        expectHost = true;
+    }
+
+    SECTION("Multiple hosts")
+    {
+        singleHost = false;
+        expectHost = false;
+    }
+
+    SECTION("Multiple hosts with host mutexes")
+    {
+        faasmConf.guestMutexMode = "host";
+        singleHost = false;
+        expectHost = true;
+    }
+
+    module.setThreadsSingleHost(singleHost);
+    REQUIRE(module.usesHostGuestMutexes() == expectHost);
+
+    // The mode is fixed until the next call decides it again
+    faasmConf.guestMutexMode = expectHost ? "atomic" : "host";
+    REQUIRE(module.usesHostGuestMutexes() == expectHost);
+
+    // Only the atomic path touches the lock word
+    auto* word = reinterpret_cast<uint32_t*>(
+      module.wasmPointerToNative(mxPtr + GUEST_MUTEX_LOCK_OFFSET));
+
+    wasm::WasmExecutionContext ctx(&module);
+    module.initGuestMutex(mxPtr);
+    module.lockGuestMutex(mxPtr);
+    REQUIRE(*word == (expectHost ? 0 : 1));
+
+    // Host mutexes can't be tried by the thread holding them
+    bool otherThreadLocked = std::async(std::launch::async, [&module, mxPtr] {
+                                 return module.tryLockGuestMutex(mxPtr);
+                             }).get();
+    REQUIRE(!otherThreadLocked);
+
+    module.unlockGuestMutex(mxPtr);
+    REQUIRE(*word == 0);
+}
 }
@@ -8,10 +8,12 @@
 #include <faabric/util/files.h>
 #include <storage/FileDescriptor.h>
 #include <storage/FileLoader.h>
+#include <storage/PathCache.h>
 #include <storage/SharedFiles.h>
 
 #include <WAVM/WASI/WASIABI.h>
 #include <boost/filesystem.hpp>
+#include <fcntl.h>
 #include <string_view>
 
 using namespace storage;
@@ -249,6 +251,261 @@ TEST_CASE_METHOD(FileDescriptorTestFixture, "Test seek", "[storage]")
     boost::filesystem::remove(realPath);
 }
 
+TEST_CASE_METHOD(FileDescriptorTestFixture,
+                 "Test sequential read/ write",
+                 "[storage]")
+{
+    SECTION("Syscall backend") { faasmConf.fileIoBackend = "syscall"; }
+
+    SECTION("io_uring backend") { faasmConf.fileIoBackend = "io_uring"; }
+
+    std::string dummyPath = "dummy_rw_file.txt";
+    std::string realPath = faasmConf.runtimeFilesDir + "/" + dummyPath;
+
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int newFd = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, dummyPath, rights, 0, 0, __WASI_O_CREAT, 0);
+    REQUIRE(newFd > 0);
+    FileDescriptor& fileDesc = fs.getFileDescriptor(newFd);
+
+    // Write across two buffers, which should move the file offset
+    std::vector<uint8_t> bufA = { 0, 1, 2 };
+    std::vector<uint8_t> bufB = { 3, 4 };
+    std::vector<::iovec> writeIovecs = {
+        { .iov_base = bufA.data(), .iov_len = bufA.size() },
+        { .iov_base = bufB.data(), .iov_len = bufB.size() },
+    };
+    REQUIRE(fileDesc.write(writeIovecs, 2) == 5);
+    REQUIRE(fileDesc.tell() == 5);
+
+    std::vector<uint8_t> expected = { 0, 1, 2, 3, 4 };
+    REQUIRE(faabric::util::readFileToBytes(realPath) == expected);
+
+    // Read back from part way through
+    uint64_t newOffset = 0;
+    REQUIRE(fileDesc.seek(1, __WASI_WHENCE_SET, &newOffset) == 0);
+
+    std::vector<uint8_t> readBuf(8, 0);
+    std::vector<::iovec> readIovecs = {
+        { .iov_base = readBuf.data(), .iov_len = readBuf.size() },
+    };
+    REQUIRE(fileDesc.read(readIovecs, 1) == 4);
+    REQUIRE(fileDesc.tell() == 5);
+    REQUIRE(std::vector<uint8_t>(readBuf.begin(), readBuf.begin() + 4) ==
+            std::vector<uint8_t>({ 1, 2, 3, 4 }));
+
+    // Nothing left to read
+    REQUIRE(fileDesc.read(readIovecs, 1) == 0);
+
+    boost::filesystem::remove(realPath);
+}
+
+TEST_CASE_METHOD(FileDescriptorTestFixture,
+                 "Test positional read/ write, sync and truncate",
+                 "[storage]")
+{
+    SECTION("Syscall backend") { faasmConf.fileIoBackend = "syscall"; }
+
+    SECTION("io_uring backend") { faasmConf.fileIoBackend = "io_uring"; }
+
+    std::string dummyPath = "dummy_pread_file.txt";
+    std::string realPath = faasmConf.runtimeFilesDir + "/" + dummyPath;
+
+    std::vector<uint8_t> contents = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    faabric::util::writeBytesToFile(realPath, contents);
+
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int newFd =
+      fs.openFileDescriptor(DEFAULT_ROOT_FD, dummyPath, rights, 0, 0, 0, 0);
+    REQUIRE(newFd > 0);
+    FileDescriptor& fileDesc = fs.getFileDescriptor(newFd);
+
+    // Read across two buffers from an offset
+    std::vector<uint8_t> bufA(2);
+    std::vector<uint8_t> bufB(3);
+    std::vector<::iovec> readIovecs = {
+        { .iov_base = bufA.data(), .iov_len = bufA.size() },
+        { .iov_base = bufB.data(), .iov_len = bufB.size() },
+    };
+    REQUIRE(fileDesc.pread(readIovecs, 2, 3) == 5);
+    REQUIRE(bufA == std::vector<uint8_t>({ 3, 4 }));
+    REQUIRE(bufB == std::vector<uint8_t>({ 5, 6, 7 }));
+
+    // Positional I/O must not move the file offset
+    REQUIRE(fileDesc.tell() == 0);
+
+    // Write at an offset
+    std::vector<uint8_t> writeBuf = { 9, 9 };
+    std::vector<::iovec> writeIovecs = {
+        { .iov_base = writeBuf.data(), .iov_len = writeBuf.size() },
+    };
+    REQUIRE(fileDesc.pwrite(writeIovecs, 1, 1) == 2);
+    REQUIRE(fileDesc.tell() == 0);
+    REQUIRE(fileDesc.sync(true));
+    REQUIRE(fileDesc.sync(false));
+
+    std::vector<uint8_t> expected = { 0, 9, 9, 3, 4, 5, 6, 7 };
+    REQUIRE(faabric::util::readFileToBytes(realPath) == expected);
+
+    // Truncate and extend
+    REQUIRE(fileDesc.truncate(4));
+    REQUIRE(fileDesc.stat().st_size == 4);
+
+    REQUIRE(fileDesc.allocate(0, 16));
+    REQUIRE(fileDesc.stat().st_size == 16);
+
+    // Reading past the end returns nothing
+    REQUIRE(fileDesc.pread(readIovecs, 2, 100) == 0);
+
+    boost::filesystem::remove(realPath);
+}
+
+TEST_CASE_METHOD(FileDescriptorTestFixture,
+                 "Test links and setting file times",
+                 "[storage]")
+{
+    FileDescriptor& rootFileDesc = fs.getFileDescriptor(DEFAULT_ROOT_FD);
+
+    std::string filePath = "dummy_link_target.txt";
+    std::string hardLinkPath = "dummy_hard_link.txt";
+    std::string symLinkPath = "dummy_sym_link.txt";
+
+    std::string realFilePath = prependRuntimeRoot(filePath);
+    std::string realHardLinkPath = prependRuntimeRoot(hardLinkPath);
+    std::string realSymLinkPath = prependRuntimeRoot(symLinkPath);
+
+    boost::filesystem::remove(realHardLinkPath);
+    boost::filesystem::remove(realSymLinkPath);
+
+    std::vector<uint8_t> contents = { 1, 2, 3 };
+    faabric::util::writeBytesToFile(realFilePath, contents);
+
+    // Hard link
+    REQUIRE(rootFileDesc.link(hardLinkPath, filePath));
+    REQUIRE(faabric::util::readFileToBytes(realHardLinkPath) == contents);
+    REQUIRE(rootFileDesc.stat(filePath).st_nlink == 2);
+
+    // Linking over an existing file fails
+    REQUIRE(!rootFileDesc.link(hardLinkPath, filePath));
+    REQUIRE(rootFileDesc.getWasiErrno() == __WASI_EEXIST);
+
+    // Symlink, absolute targets must stay inside the runtime root
+    SECTION("Relative target")
+    {
+        REQUIRE(rootFileDesc.symlink(filePath, symLinkPath));
+    }
+
+    SECTION("Absolute target")
+    {
+        REQUIRE(rootFileDesc.symlink("/" + filePath, symLinkPath));
+    }
+
+    REQUIRE(boost::filesystem::is_symlink(realSymLinkPath));
+    REQUIRE(faabric::util::readFileToBytes(realSymLinkPath) == contents);
+
+    // Set explicit times
+    uint64_t accessTime = 1000000000ULL * 1000;
+    uint64_t modTime = 1000000000ULL * 2000;
+    uint16_t flags = __WASI_FILESTAT_SET_ATIM | __WASI_FILESTAT_SET_MTIM;
+    REQUIRE(rootFileDesc.setTimes(filePath, accessTime, modTime, flags));
+
+    Stat statRes = rootFileDesc.stat(filePath);
+    REQUIRE(statRes.st_atim == accessTime);
+    REQUIRE(statRes.st_mtim == modTime);
+
+    // Only update the modification time
+    REQUIRE(rootFileDesc.setTimes(
+      filePath, 0, 0, __WASI_FILESTAT_SET_MTIM_NOW));
+    statRes = rootFileDesc.stat(filePath);
+    REQUIRE(statRes.st_atim == accessTime);
+    REQUIRE(statRes.st_mtim > modTime);
+
+    boost::filesystem::remove(realHardLinkPath);
+    boost::filesystem::remove(realSymLinkPath);
+    boost::filesystem::remove(realFilePath);
+}
+
+TEST_CASE_METHOD(FileDescriptorTestFixture,
+                 "Test path cache invalidation",
+                 "[storage]")
+{
+    FileDescriptor& rootFileDesc = fs.getFileDescriptor(DEFAULT_ROOT_FD);
+
+    std::string filePath = "dummy_cached_file.txt";
+    std::string realPath = prependRuntimeRoot(filePath);
+    boost::filesystem::remove(realPath);
+
+    // Missing file is cached, even once it's created behind our back
+    REQUIRE(rootFileDesc.stat(filePath).wasiErrno == __WASI_ENOENT);
+    std::vector<uint8_t> contents = { 0, 1, 2 };
+    faabric::util::writeBytesToFile(realPath, contents);
+    REQUIRE(rootFileDesc.stat(filePath).wasiErrno == __WASI_ENOENT);
+    REQUIRE(fs.openFileDescriptor(DEFAULT_ROOT_FD, filePath, 0, 0, 0, 0, 0) ==
+            -1 * __WASI_ENOENT);
+
+    // Copies of the filesystem don't share the cache
+    FileSystem fsCopy = fs;
+    REQUIRE(!fsCopy.getFileDescriptor(DEFAULT_ROOT_FD).stat(filePath).failed);
+
+    // Clearing the cache picks up the change
+    fs.clearPathCache();
+    Stat statRes = rootFileDesc.stat(filePath);
+    REQUIRE(!statRes.failed);
+    REQUIRE(statRes.st_size == contents.size());
+
+    // Writes through a descriptor invalidate the cached stat
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int fileFd =
+      fs.openFileDescriptor(DEFAULT_ROOT_FD, filePath, rights, 0, 0, 0, 0);
+    REQUIRE(fileFd > 0);
+    FileDescriptor& fileDesc = fs.getFileDescriptor(fileFd);
+
+    std::vector<uint8_t> extra = { 3, 4, 5, 6 };
+    std::vector<::iovec> iovecs = {
+        { .iov_base = extra.data(), .iov_len = extra.size() },
+    };
+    REQUIRE(fileDesc.pwrite(iovecs, 1, contents.size()) == extra.size());
+    REQUIRE(rootFileDesc.stat(filePath).st_size ==
+            contents.size() + extra.size());
+
+    // Renames invalidate both paths
+    std::string newPath = "dummy_cached_file_renamed.txt";
+    boost::filesystem::remove(prependRuntimeRoot(newPath));
+    REQUIRE(rootFileDesc.stat(newPath).failed);
+
+    REQUIRE(rootFileDesc.rename(newPath, filePath));
+    REQUIRE(rootFileDesc.stat(filePath).wasiErrno == __WASI_ENOENT);
+    REQUIRE(!rootFileDesc.stat(newPath).failed);
+
+    // Unlinking invalidates the path
+    REQUIRE(rootFileDesc.unlink(newPath));
+    REQUIRE(rootFileDesc.stat(newPath).wasiErrno == __WASI_ENOENT);
+}
+
+TEST_CASE("Test path cache content invalidation", "[storage]")
+{
+    PathCache cache;
+    struct ::stat nativeStat
+    {};
+    nativeStat.st_size = 10;
+    cache.putStat("/foo/bar.txt", nativeStat, 0);
+    cache.putStat("/foo", nativeStat, 0);
+
+    // Writing to a file leaves its directory cached
+    cache.invalidateContents("/foo/bar.txt");
+
+    struct ::stat statOut
+    {};
+    int errnoOut = 0;
+    REQUIRE(!cache.getStat("/foo/bar.txt", statOut, errnoOut));
+    REQUIRE(cache.getStat("/foo", statOut, errnoOut));
+    REQUIRE(statOut.st_size == 10);
+
+    // Uncached paths are a no-op
+    cache.invalidateContents("/foo/baz.txt");
+    REQUIRE(cache.size() == 1);
+}
+
 TEST_CASE_METHOD(FileDescriptorTestFixture,
                  "Test stat and read shared file",
                  "[storage]")
@@ -340,12 +597,13 @@ TEST_CASE_METHOD(FileDescriptorTestFixture,
         REQUIRE(fileDesc.iterStarted() == false);
         REQUIRE(fileDesc.iterFinished() == false);
 
-        // Make sure first few items are the same
+        // Make sure first few items are the same, and that the cookie tracks
+        // each entry's "next" value
         int step = 3;
         for (int i = 0; i < step; i++) {
             storage::DirEnt ent = fileDesc.iterNext();
-            REQUIRE(ent.next == i + 1);
             REQUIRE(ent.path == expectedList.at(i));
+            REQUIRE(fileDesc.iterCookie() == ent.next);
         }
 
         REQUIRE(fileDesc.iterStarted() == true);
@@ -371,6 +629,31 @@ TEST_CASE_METHOD(FileDescriptorTestFixture,
         REQUIRE(fileDesc.iterFinished() == true);
     }
 
+    SECTION("Cookies")
+    {
+        // Walk the whole directory, recording the cookie after each entry
+        std::vector<uint64_t> cookies;
+        while (!fileDesc.iterFinished()) {
+            cookies.push_back(fileDesc.iterNext().next);
+        }
+        REQUIRE(cookies.size() == expectedList.size());
+
+        // Seek to an entry's cookie, and check we resume at the one after
+        size_t idx = expectedList.size() / 2;
+        fileDesc.iterSeek(cookies.at(idx));
+        REQUIRE(fileDesc.iterNext().path == expectedList.at(idx + 1));
+
+        // Seek back to the start
+        fileDesc.iterSeek(__WASI_DIRCOOKIE_START);
+        REQUIRE(fileDesc.iterNext().path == expectedList.at(0));
+
+        // Step back after seeking
+        fileDesc.iterSeek(cookies.at(idx));
+        fileDesc.iterNext();
+        fileDesc.iterBack();
+        REQUIRE(fileDesc.iterNext().path == expectedList.at(idx + 1));
+    }
+
     SECTION("WASI dirent buffer")
     {
         // Get the first three entries
@@ -409,4 +692,132 @@ TEST_CASE_METHOD(FileDescriptorTestFixture,
         checkWasiDirentInBuffer(buffer2.data(), entC);
     }
 }
+
+TEST_CASE_METHOD(FileDescriptorTestFixture,
+                 "Test file descriptor table",
+                 "[storage]")
+{
+    // Stdio and preopens
+    for (int fd = 0; fd <= DEFAULT_ROOT_FD; fd++) {
+        REQUIRE(fs.fileDescriptorExists(fd));
+    }
+    REQUIRE(!fs.fileDescriptorExists(-1));
+    REQUIRE(!fs.fileDescriptorExists(DEFAULT_ROOT_FD + 1));
+    REQUIRE(fs.getPathForFd(3) == "/");
+    REQUIRE(fs.getPathForFd(100).empty());
+
+    std::string pathA = "fd_table_a.txt";
+    std::string pathB = "fd_table_b.txt";
+
+    int fdA = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, pathA, 0, 0, 0, __WASI_O_CREAT, 0);
+    int fdB = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, pathB, 0, 0, 0, __WASI_O_CREAT, 0);
+    REQUIRE(fdA == DEFAULT_ROOT_FD + 1);
+    REQUIRE(fdB == DEFAULT_ROOT_FD + 2);
+
+    // Descriptors must stay put as the table grows
+    FileDescriptor& descA = fs.getFileDescriptor(fdA);
+    std::vector<int> extraFds;
+    for (int i = 0; i < 100; i++) {
+        extraFds.push_back(fs.dup(fdB));
+    }
+    REQUIRE(descA.getPath() == pathA);
+
+    // Failed opens don't use up an fd
+    int failedFd = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, "fd_table_missing.txt", 0, 0, 0, 0, 0);
+    REQUIRE(failedFd == -__WASI_ENOENT);
+
+    // Closed fds are reused, lowest first
+    REQUIRE(fs.closeFileDescriptor(extraFds.at(10)));
+    REQUIRE(fs.closeFileDescriptor(fdA));
+    REQUIRE(!fs.fileDescriptorExists(fdA));
+    REQUIRE(!fs.closeFileDescriptor(fdA));
+    REQUIRE_THROWS(fs.getFileDescriptor(fdA));
+
+    REQUIRE(fs.dup(fdB) == fdA);
+    REQUIRE(fs.dup(fdB) == extraFds.at(10));
+    REQUIRE(fs.dup(fdB) == extraFds.back() + 1);
+
+    // Stdio and preopens can't be closed
+    REQUIRE(fs.closeFileDescriptor(1));
+    REQUIRE(fs.closeFileDescriptor(DEFAULT_ROOT_FD));
+    REQUIRE(fs.fileDescriptorExists(1));
+    REQUIRE(fs.fileDescriptorExists(DEFAULT_ROOT_FD));
+
+    // Resetting goes back to the start
+    fs.prepareFilesystem();
+    REQUIRE(!fs.fileDescriptorExists(fdB));
+    int fdC = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, pathA, 0, 0, 0, __WASI_O_CREAT, 0);
+    REQUIRE(fdC == DEFAULT_ROOT_FD + 1);
+
+    boost::filesystem::remove(faasmConf.runtimeFilesDir + "/" + pathA);
+    boost::filesystem::remove(faasmConf.runtimeFilesDir + "/" + pathB);
+}
+
+TEST_CASE_METHOD(FileDescriptorTestFixture,
+                 "Test tear down closes owned fds",
+                 "[storage]")
+{
+    std::string dummyPath = "dummy_teardown_file.txt";
+    std::string realPath = faasmConf.runtimeFilesDir + "/" + dummyPath;
+
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int newFd = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, dummyPath, rights, 0, 0, __WASI_O_CREAT, 0);
+    REQUIRE(newFd > 0);
+
+    int linuxFd = fs.getFileDescriptor(newFd).getLinuxFd();
+    int rootLinuxFd = fs.getFileDescriptor(DEFAULT_ROOT_FD).getLinuxFd();
+    REQUIRE(::fcntl(linuxFd, F_GETFD) != -1);
+
+    fs.tearDown();
+
+    // The guest's fd and the preopened root are both closed, stdio isn't
+    REQUIRE(::fcntl(linuxFd, F_GETFD) == -1);
+    REQUIRE(errno == EBADF);
+    REQUIRE(::fcntl(rootLinuxFd, F_GETFD) == -1);
+    REQUIRE(::fcntl(STDERR_FILENO, F_GETFD) != -1);
+    REQUIRE(!fs.fileDescriptorExists(DEFAULT_ROOT_FD));
+
+    boost::filesystem::remove(realPath);
+}
+
+TEST_CASE_METHOD(FileDescriptorTestFixture,
+                 "Test filesystem copies own their host fds",
+                 "[storage]")
+{
+    std::string dummyPath = "dummy_copied_file.txt";
+    std::string realPath = faasmConf.runtimeFilesDir + "/" + dummyPath;
+
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int newFd = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, dummyPath, rights, 0, 0, __WASI_O_CREAT, 0);
+    REQUIRE(newFd > 0);
+
+    int linuxFd = fs.getFileDescriptor(newFd).getLinuxFd();
+    int rootLinuxFd = fs.getFileDescriptor(DEFAULT_ROOT_FD).getLinuxFd();
+
+    {
+        FileSystem fsCopy = fs;
+        REQUIRE(fsCopy.getFileDescriptor(newFd).getLinuxFd() != linuxFd);
+        REQUIRE(fsCopy.getFileDescriptor(DEFAULT_ROOT_FD).getLinuxFd() !=
+                rootLinuxFd);
+        REQUIRE(fsCopy.getFileDescriptor(STDOUT_FILENO).getLinuxFd() ==
+                STDOUT_FILENO);
+
+        // Closing in the copy leaves the original open
+        REQUIRE(fsCopy.closeFileDescriptor(newFd));
+        REQUIRE(::fcntl(linuxFd, F_GETFD) != -1);
+    }
+
+    // As does destroying the copy
+    REQUIRE(::fcntl(linuxFd, F_GETFD) != -1);
+    REQUIRE(::fcntl(rootLinuxFd, F_GETFD) != -1);
+    REQUIRE(::fcntl(STDOUT_FILENO, F_GETFD) != -1);
+
+    boost::filesystem::remove(realPath);
+}
 }
@@ -183,6 +183,45 @@ TEST_CASE_METHOD(FileLoaderTestFixture,
                       SharedFileNotExistsException);
 }
 
+TEST_CASE_METHOD(FileLoaderTestFixture,
+                 "Test mapping WAMR AoT files",
+                 "[storage]")
+{
+    bool useFsCache;
+    SECTION("With cache") { useFsCache = true; }
+
+    SECTION("Without cache") { useFsCache = false; }
+
+    storage::FileLoader loader(useFsCache);
+    loader.clearLocalCache();
+
+    std::vector<uint8_t> objBytes = { 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+    loader.uploadFunctionWamrAotFile(msgA, objBytes);
+    loader.clearLocalCache();
+
+    storage::MappedFile mapped = loader.mapFunctionWamrAotFile(msgA);
+    REQUIRE(mapped.isMapped() == useFsCache);
+    REQUIRE(mapped.toVector() == objBytes);
+
+    std::string cachedAotFile = loader.getFunctionAotFile(msgA);
+    REQUIRE(boost::filesystem::exists(cachedAotFile) == useFsCache);
+
+    if (useFsCache) {
+        // Writes to the mapping must not reach the file
+        mapped.data()[0] = 0;
+        REQUIRE(faabric::util::readFileToBytes(cachedAotFile) == objBytes);
+
+        // Re-uploading must not disturb existing mappings
+        std::vector<uint8_t> newObjBytes = { 1, 2, 3 };
+        loader.uploadFunctionWamrAotFile(msgA, newObjBytes);
+        REQUIRE(mapped.size() == objBytes.size());
+        REQUIRE(mapped.data()[1] == objBytes[1]);
+
+        storage::MappedFile remapped = loader.mapFunctionWamrAotFile(msgA);
+        REQUIRE(remapped.toVector() == newObjBytes);
+    }
+}
+
 TEST_CASE_METHOD(FileLoaderTestFixture,
                  "Test uploading and loading python files",
                  "[storage]")
@@ -227,4 +266,36 @@ TEST_CASE_METHOD(FileLoaderTestFixture,
     storage::FileLoader loader;
     REQUIRE_THROWS(loader.uploadPythonFunction(msg));
 }
+
+TEST_CASE_METHOD(FileLoaderTestFixture,
+                 "Test loading function limits",
+                 "[storage]")
+{
+    storage::FileLoader loader;
+    loader.clearLocalCache();
+
+    faasmConf.sharedFilesNegativeTtlMs = 200;
+    std::string limitsFile = loader.getFunctionLimitsFile(msgA);
+
+    // Most functions won't have any limits, and the miss is cached locally
+    REQUIRE(loader.loadFunctionLimits(msgA).empty());
+    REQUIRE(boost::filesystem::exists(limitsFile));
+    REQUIRE(boost::filesystem::file_size(limitsFile) == 0);
+
+    std::string limits = "cpu.weight=50\ncpu.max=50000 100000\n";
+    s3.addKeyStr(faasmConf.s3Bucket, "demo/hello/function.limits", limits);
+
+    // The second call doesn't go back to storage
+    REQUIRE(loader.loadFunctionLimits(msgA).empty());
+
+    // Once the miss expires, the limits are picked up and cached
+    SLEEP_MS(300);
+    REQUIRE(loader.loadFunctionLimits(msgA) == limits);
+    REQUIRE(boost::filesystem::file_size(limitsFile) == limits.size());
+
+    // The cached limits don't expire
+    SLEEP_MS(300);
+    s3.deleteKey(faasmConf.s3Bucket, "demo/hello/function.limits");
+    REQUIRE(loader.loadFunctionLimits(msgA) == limits);
+}
 }
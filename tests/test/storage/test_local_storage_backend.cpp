@@ -0,0 +1,133 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <faabric/util/files.h>
+
+#include <conf/FaasmConfig.h>
+#include <storage/FileLoader.h>
+#include <storage/LocalStorageBackend.h>
+
+#include <filesystem>
+
+namespace tests {
+
+class LocalStorageTestFixture : public FaasmConfTestFixture
+{
+  public:
+    LocalStorageTestFixture()
+      : rootDir("/tmp/faasm-local-storage-test")
+      , backend(rootDir)
+    {
+        std::filesystem::remove_all(rootDir);
+        faasmConf.storageBackend = "local";
+        faasmConf.localStorageDir = rootDir;
+        backend.createBucket(bucket);
+    }
+
+    ~LocalStorageTestFixture() { std::filesystem::remove_all(rootDir); }
+
+  protected:
+    std::string rootDir;
+    std::string bucket = "faasm-test";
+    storage::LocalStorageBackend backend;
+};
+
+TEST_CASE_METHOD(LocalStorageTestFixture,
+                 "Test read/write keys in local storage",
+                 "[storage]")
+{
+    std::vector<uint8_t> byteDataA = { 0, 1, 2, 3, 'c', '\\', '@', '$', '%' };
+    std::vector<uint8_t> byteDataB = { 11, 99, 123, '#', '\n', '\t' };
+
+    SECTION("Test list buckets")
+    {
+        backend.createBucket("other");
+        std::vector<std::string> actual = backend.listBuckets();
+        std::sort(actual.begin(), actual.end());
+        std::vector<std::string> expected = { bucket, "other" };
+        REQUIRE(actual == expected);
+
+        backend.deleteBucket("other");
+        REQUIRE(backend.listBuckets() == std::vector<std::string>{ bucket });
+    }
+
+    SECTION("Test string read/ write")
+    {
+        backend.addKeyStr(bucket, "alpha", "I am a string");
+        REQUIRE(backend.getKeyStr(bucket, "alpha") == "I am a string");
+    }
+
+    SECTION("Test byte read/ write with nested keys")
+    {
+        backend.addKeyBytes(bucket, "dir/alpha", byteDataA);
+        backend.addKeyBytes(bucket, "dir/sub/beta", byteDataB);
+
+        REQUIRE(backend.getKeyBytes(bucket, "dir/alpha") == byteDataA);
+        REQUIRE(backend.getKeyBytes(bucket, "dir/sub/beta") == byteDataB);
+
+        // Overwrite
+        backend.addKeyBytes(bucket, "dir/alpha", byteDataB);
+        REQUIRE(backend.getKeyBytes(bucket, "dir/alpha") == byteDataB);
+    }
+
+    SECTION("Test listing keys")
+    {
+        backend.addKeyBytes(bucket, "dir/alpha", byteDataA);
+        backend.addKeyBytes(bucket, "dir/sub/beta", byteDataB);
+        backend.addKeyBytes(bucket, "other/gamma", byteDataB);
+
+        std::vector<std::string> all = backend.listKeys(bucket);
+        std::sort(all.begin(), all.end());
+        std::vector<std::string> expectedAll = { "dir/alpha",
+                                                 "dir/sub/beta",
+                                                 "other/gamma" };
+        REQUIRE(all == expectedAll);
+
+        std::vector<std::string> prefixed = backend.listKeys(bucket, "dir/");
+        std::sort(prefixed.begin(), prefixed.end());
+        std::vector<std::string> expectedPrefixed = { "dir/alpha",
+                                                      "dir/sub/beta" };
+        REQUIRE(prefixed == expectedPrefixed);
+    }
+
+    SECTION("Test deleting and tolerating missing keys")
+    {
+        backend.addKeyBytes(bucket, "alpha", byteDataA);
+        backend.deleteKey(bucket, "alpha");
+
+        REQUIRE(backend.getKeyBytes(bucket, "alpha", true).empty());
+        REQUIRE_THROWS(backend.getKeyBytes(bucket, "alpha"));
+        REQUIRE(backend.listKeys(bucket).empty());
+    }
+
+    SECTION("Test keys can't escape bucket")
+    {
+        REQUIRE_THROWS(backend.addKeyBytes(bucket, "../escape", byteDataA));
+        REQUIRE_THROWS(backend.getKeyBytes(bucket, "/etc/passwd"));
+    }
+}
+
+TEST_CASE_METHOD(LocalStorageTestFixture,
+                 "Test file loader with local storage backend",
+                 "[storage]")
+{
+    faasmConf.s3Bucket = bucket;
+    faasmConf.sharedFilesDir = "/tmp/faasm-local-storage-shared";
+
+    storage::FileLoader loader(false);
+
+    std::string relPath = "local_dir/file.txt";
+    std::vector<uint8_t> bytes = { 5, 4, 3, 2, 1 };
+    loader.uploadSharedFile(relPath, bytes);
+
+    REQUIRE(backend.getKeyBytes(bucket, relPath) == bytes);
+    REQUIRE(loader.loadSharedFile(relPath) == bytes);
+    REQUIRE(loader.listSharedFiles("local_dir") ==
+            std::vector<std::string>{ relPath });
+
+    loader.deleteSharedFile(relPath);
+    REQUIRE_THROWS_AS(loader.loadSharedFile(relPath),
+                      storage::SharedFileNotExistsException);
+}
+}
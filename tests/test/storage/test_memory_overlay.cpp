@@ -0,0 +1,164 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <conf/FaasmConfig.h>
+#include <storage/FileSystem.h>
+#include <storage/MemoryOverlay.h>
+
+#include <WAVM/WASI/WASIABI.h>
+#include <boost/filesystem.hpp>
+
+using namespace storage;
+
+namespace tests {
+
+class MemoryOverlayTestFixture : public FaasmConfTestFixture
+{
+  public:
+    MemoryOverlayTestFixture()
+    {
+        faasmConf.fsOverlayPaths = "/tmp,scratch";
+        faasmConf.fsOverlayDir = overlayDir;
+        faasmConf.fsOverlayMaxMb = 1;
+    }
+
+    ~MemoryOverlayTestFixture() { boost::filesystem::remove_all(overlayDir); }
+
+  protected:
+    std::string overlayDir = "/tmp/faasm-overlay-test";
+
+    ssize_t writeBytes(FileDescriptor& fileDesc, std::vector<uint8_t>& bytes)
+    {
+        std::vector<::iovec> iovecs = {
+            { .iov_base = bytes.data(), .iov_len = bytes.size() },
+        };
+        return fileDesc.write(iovecs, 1);
+    }
+};
+
+TEST_CASE_METHOD(MemoryOverlayTestFixture,
+                 "Test memory overlay paths",
+                 "[storage]")
+{
+    MemoryOverlay overlay(overlayDir + "/paths", { "/tmp", "scratch" }, 100);
+
+    REQUIRE(overlay.covers("/tmp"));
+    REQUIRE(overlay.covers("tmp"));
+    REQUIRE(overlay.covers("/tmp/foo.txt"));
+    REQUIRE(overlay.covers("./tmp/a/b"));
+    REQUIRE(overlay.covers("/scratch/x"));
+
+    REQUIRE(!overlay.covers("/"));
+    REQUIRE(!overlay.covers("/tmpfoo"));
+    REQUIRE(!overlay.covers("/etc/hosts"));
+    REQUIRE(!overlay.covers("/tmp/../etc/hosts"));
+
+    REQUIRE(overlay.realPath("/tmp/foo.txt") ==
+            overlayDir + "/paths/tmp/foo.txt");
+    REQUIRE(overlay.realPath("tmp/foo.txt") ==
+            overlayDir + "/paths/tmp/foo.txt");
+
+    // Mount points exist up front
+    REQUIRE(boost::filesystem::is_directory(overlayDir + "/paths/tmp"));
+    REQUIRE(boost::filesystem::is_directory(overlayDir + "/paths/scratch"));
+
+    // Space is capped
+    REQUIRE(overlay.reserve(60));
+    REQUIRE(!overlay.reserve(50));
+    REQUIRE(overlay.getUsedBytes() == 60);
+    overlay.release(20);
+    REQUIRE(overlay.reserve(50));
+    REQUIRE(overlay.getUsedBytes() == 90);
+
+    overlay.clear();
+    REQUIRE(overlay.getUsedBytes() == 0);
+}
+
+TEST_CASE_METHOD(MemoryOverlayTestFixture,
+                 "Test writing files in memory overlay",
+                 "[storage]")
+{
+    FileSystem fs;
+    fs.prepareFilesystem();
+
+    MemoryOverlay* overlay = fs.getOverlay();
+    REQUIRE(overlay != nullptr);
+
+    std::string guestPath = "/tmp/overlay_test.txt";
+    std::string overlayPath = overlay->realPath(guestPath);
+    std::string hostPath = prependRuntimeRoot(guestPath);
+    boost::filesystem::remove(hostPath);
+
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int fd = fs.openFileDescriptor(
+      DEFAULT_ROOT_FD, guestPath, rights, 0, 0, __WASI_O_CREAT, 0);
+    REQUIRE(fd > 0);
+    FileDescriptor& fileDesc = fs.getFileDescriptor(fd);
+
+    // Writes go to the overlay, not the runtime root
+    std::vector<uint8_t> bytes(1000, 1);
+    REQUIRE(writeBytes(fileDesc, bytes) == 1000);
+    REQUIRE(boost::filesystem::file_size(overlayPath) == 1000);
+    REQUIRE(!boost::filesystem::exists(hostPath));
+    REQUIRE(overlay->getUsedBytes() == 1000);
+
+    Stat s = fileDesc.stat();
+    REQUIRE(!s.failed);
+    REQUIRE(s.st_size == 1000);
+
+    // Overwriting doesn't use any more space
+    std::vector<::iovec> iovecs = {
+        { .iov_base = bytes.data(), .iov_len = 500 },
+    };
+    REQUIRE(fileDesc.pwrite(iovecs, 1, 0) == 500);
+    REQUIRE(overlay->getUsedBytes() == 1000);
+
+    // Going over the cap fails
+    std::vector<uint8_t> bigBytes(1024 * 1024, 2);
+    REQUIRE(writeBytes(fileDesc, bigBytes) == -1);
+    REQUIRE(fileDesc.getWasiErrno() == __WASI_ENOSPC);
+    REQUIRE(overlay->getUsedBytes() == 1000);
+
+    // Truncating gives space back
+    REQUIRE(fileDesc.truncate(100));
+    REQUIRE(overlay->getUsedBytes() == 100);
+
+    // Can't rename out of the overlay
+    FileDescriptor& rootDesc = fs.getFileDescriptor(DEFAULT_ROOT_FD);
+    REQUIRE(!rootDesc.rename("overlay_test_renamed.txt", guestPath));
+    REQUIRE(rootDesc.getWasiErrno() == __WASI_EXDEV);
+
+    SECTION("Unlink")
+    {
+        REQUIRE(rootDesc.unlink(guestPath));
+        REQUIRE(!boost::filesystem::exists(overlayPath));
+        REQUIRE(overlay->getUsedBytes() == 0);
+    }
+
+    SECTION("Reset")
+    {
+        // Preparing the filesystem again (i.e. on reset) discards everything
+        fs.prepareFilesystem();
+        REQUIRE(!boost::filesystem::exists(overlayPath));
+        REQUIRE(fs.getOverlay()->getUsedBytes() == 0);
+
+        Stat afterReset =
+          fs.getFileDescriptor(DEFAULT_ROOT_FD).stat(guestPath);
+        REQUIRE(afterReset.failed);
+        REQUIRE(afterReset.wasiErrno == __WASI_ENOENT);
+    }
+}
+
+TEST_CASE_METHOD(MemoryOverlayTestFixture,
+                 "Test memory overlay disabled by default",
+                 "[storage]")
+{
+    faasmConf.fsOverlayPaths = "";
+
+    FileSystem fs;
+    fs.prepareFilesystem();
+    REQUIRE(fs.getOverlay() == nullptr);
+    REQUIRE(fs.realPathFor("/tmp/foo") == prependRuntimeRoot("/tmp/foo"));
+}
+}
@@ -61,6 +61,20 @@ TEST_CASE_METHOD(S3TestFixture, "Test read/write keys in bucket", "[s3]")
         REQUIRE(actual == expected);
     }
 
+    SECTION("Test listing keys with prefix")
+    {
+        s3.addKeyStr(faasmConf.s3Bucket, "dir/alpha", dataA);
+        s3.addKeyStr(faasmConf.s3Bucket, "dir/beta", dataB);
+        s3.addKeyStr(faasmConf.s3Bucket, "other/gamma", dataB);
+
+        std::vector<std::string> actual =
+          s3.listKeys(faasmConf.s3Bucket, "dir/");
+        std::sort(actual.begin(), actual.end());
+        std::vector<std::string> expected = { "dir/alpha", "dir/beta" };
+
+        REQUIRE(actual == expected);
+    }
+
     SECTION("Test byte read/write")
     {
         s3.addKeyBytes(faasmConf.s3Bucket, "alpha", byteDataA);
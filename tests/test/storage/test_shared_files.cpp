@@ -8,8 +8,11 @@
 #include <conf/FaasmConfig.h>
 #include <faabric/util/files.h>
 #include <faabric/util/func.h>
+#include <faabric/util/macros.h>
 #include <storage/FileLoader.h>
 
+#include <thread>
+
 using namespace storage;
 
 namespace tests {
@@ -100,4 +103,312 @@ TEST_CASE_METHOD(SharedFilesTestFixture, "Check sync python file", "[storage]")
     REQUIRE(actualBytes.size() == contents.size());
     REQUIRE(actualBytes == contents);
 }
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check re-uploading python file invalidates synced copy",
+                 "[storage]")
+{
+    faabric::Message msg;
+    msg.set_ispython(true);
+    msg.set_pythonuser("alpha");
+    msg.set_pythonfunction("gamma");
+
+    std::string runtimeFilePath =
+      fmt::format("{}/{}",
+                  faasmConf.runtimeFilesDir,
+                  loader.getPythonFunctionRelativePath(msg));
+
+    std::vector<uint8_t> contentsA = { 0, 1, 2 };
+    std::vector<uint8_t> contentsB = { 3, 4, 5, 6 };
+
+    msg.set_inputdata(contentsA.data(), contentsA.size());
+    loader.uploadPythonFunction(msg);
+    SharedFiles::syncPythonFunctionFile(msg);
+    REQUIRE(faabric::util::readFileToBytes(runtimeFilePath) == contentsA);
+
+    // Re-upload and check the version changes and the synced copy is dropped
+    std::string versionBefore = SharedFiles::checkPythonFunctionVersion(msg);
+    REQUIRE(!versionBefore.empty());
+    msg.set_inputdata(contentsB.data(), contentsB.size());
+    loader.uploadPythonFunction(msg);
+    REQUIRE(SharedFiles::checkPythonFunctionVersion(msg) != versionBefore);
+    REQUIRE(!boost::filesystem::exists(runtimeFilePath));
+
+    // Sync again and check we get the new contents
+    SharedFiles::syncPythonFunctionFile(msg);
+    REQUIRE(faabric::util::readFileToBytes(runtimeFilePath) == contentsB);
+}
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check python files re-uploaded elsewhere are picked up",
+                 "[storage]")
+{
+    faabric::Message msg;
+    msg.set_ispython(true);
+    msg.set_pythonuser("alpha");
+    msg.set_pythonfunction("delta");
+
+    std::string runtimeFilePath =
+      fmt::format("{}/{}",
+                  faasmConf.runtimeFilesDir,
+                  loader.getPythonFunctionRelativePath(msg));
+
+    std::vector<uint8_t> contentsA = { 0, 1, 2 };
+    std::vector<uint8_t> contentsB = { 3, 4, 5, 6 };
+
+    msg.set_inputdata(contentsA.data(), contentsA.size());
+    loader.uploadPythonFunction(msg);
+    std::string versionA = SharedFiles::checkPythonFunctionVersion(msg);
+    SharedFiles::syncPythonFunctionFile(msg);
+    REQUIRE(faabric::util::readFileToBytes(runtimeFilePath) == contentsA);
+
+    // Upload a new version straight to the object store, as another host
+    // would, leaving this host's copies in place
+    s3.addKeyBytes(faasmConf.s3Bucket,
+                   loader.getPythonFunctionRelativePath(msg),
+                   contentsB);
+    s3.addKeyStr(faasmConf.s3Bucket,
+                 loader.getPythonFunctionVersionRelativePath(msg),
+                 versionA + "-other");
+
+    // Syncing without checking the version still sees the old copy
+    SharedFiles::syncPythonFunctionFile(msg);
+    REQUIRE(faabric::util::readFileToBytes(runtimeFilePath) == contentsA);
+
+    // Checking the version drops it, so the next sync gets the new contents
+    std::string versionB = SharedFiles::checkPythonFunctionVersion(msg);
+    REQUIRE(versionB == versionA + "-other");
+    REQUIRE(!boost::filesystem::exists(runtimeFilePath));
+
+    SharedFiles::syncPythonFunctionFile(msg);
+    REQUIRE(faabric::util::readFileToBytes(runtimeFilePath) == contentsB);
+}
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check negative shared file entries expire",
+                 "[storage]")
+{
+    std::string relPath = "shared_test_dir/late_file.txt";
+    std::string sharedPath = "faasm://" + relPath;
+    std::string syncedPath = loader.getSharedFileFile(relPath);
+
+    boost::filesystem::remove(syncedPath);
+    s3.deleteKey(faasmConf.s3Bucket, relPath);
+
+    faasmConf.sharedFilesNegativeTtlMs = 200;
+
+    // File doesn't exist yet
+    REQUIRE(SharedFiles::syncSharedFile(sharedPath) == ENOENT);
+
+    // Upload straight to S3 so the loader doesn't cache it locally
+    std::vector<uint8_t> bytes = { 0, 1, 2, 3 };
+    s3.addKeyBytes(faasmConf.s3Bucket, relPath, bytes);
+
+    // Negative entry still cached
+    REQUIRE(SharedFiles::syncSharedFile(sharedPath) == ENOENT);
+
+    // Once expired the file should be synced
+    SLEEP_MS(300);
+    REQUIRE(SharedFiles::syncSharedFile(sharedPath) == 0);
+    REQUIRE(faabric::util::readFileToBytes(syncedPath) == bytes);
+}
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check concurrent syncs of shared files",
+                 "[storage]")
+{
+    int nFiles = 5;
+    int nThreads = 10;
+
+    std::vector<std::string> sharedPaths;
+    std::vector<std::string> syncedPaths;
+    for (int i = 0; i < nFiles; i++) {
+        std::string relPath =
+          fmt::format("shared_test_dir/concurrent_{}.txt", i);
+        std::vector<uint8_t> bytes(10, (uint8_t)i);
+        loader.uploadSharedFile(relPath, bytes);
+
+        std::string syncedPath = loader.getSharedFileFile(relPath);
+        boost::filesystem::remove(syncedPath);
+
+        sharedPaths.emplace_back("faasm://" + relPath);
+        syncedPaths.emplace_back(syncedPath);
+    }
+
+    std::vector<int> results(nThreads * nFiles, -1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; t++) {
+        threads.emplace_back([&sharedPaths, &results, nFiles, t] {
+            for (int i = 0; i < nFiles; i++) {
+                results.at(t * nFiles + i) =
+                  SharedFiles::syncSharedFile(sharedPaths.at(i));
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+
+    std::vector<int> expected(nThreads * nFiles, 0);
+    REQUIRE(results == expected);
+
+    for (int i = 0; i < nFiles; i++) {
+        std::vector<uint8_t> expectedBytes(10, (uint8_t)i);
+        REQUIRE(faabric::util::readFileToBytes(syncedPaths.at(i)) ==
+                expectedBytes);
+    }
+}
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check prefetching shared directories",
+                 "[storage]")
+{
+    std::vector<std::string> relPaths = {
+        "prefetch_dir/a.py",
+        "prefetch_dir/b.py",
+        "prefetch_dir/sub/c.py",
+    };
+
+    // A sibling directory sharing the prefix should not be pulled
+    std::string siblingPath = "prefetch_dir_other/d.py";
+
+    std::vector<uint8_t> bytes = { 1, 2, 3 };
+    for (const auto& p : relPaths) {
+        loader.uploadSharedFile(p, bytes);
+        boost::filesystem::remove(loader.getSharedFileFile(p));
+    }
+    loader.uploadSharedFile(siblingPath, bytes);
+    boost::filesystem::remove(loader.getSharedFileFile(siblingPath));
+
+    int nSynced = 0;
+    SECTION("Directly")
+    {
+        nSynced = SharedFiles::prefetchSharedDirectory("faasm://prefetch_dir");
+    }
+
+    SECTION("From Python function manifest")
+    {
+        faabric::Message msg;
+        msg.set_ispython(true);
+        msg.set_pythonuser("alpha");
+        msg.set_pythonfunction("prefetch");
+
+        std::string manifest = "faasm://prefetch_dir\n";
+        std::string manifestPath =
+          loader.getPythonFunctionPrefetchRelativePath(msg);
+        loader.uploadSharedFile(
+          manifestPath, std::vector<uint8_t>(manifest.begin(), manifest.end()));
+
+        nSynced = SharedFiles::prefetchForPythonFunction(msg);
+    }
+
+    REQUIRE(nSynced == relPaths.size());
+
+    for (const auto& p : relPaths) {
+        std::string localPath = loader.getSharedFileFile(p);
+        REQUIRE(boost::filesystem::exists(localPath));
+        REQUIRE(faabric::util::readFileToBytes(localPath) == bytes);
+    }
+
+    REQUIRE(!boost::filesystem::exists(loader.getSharedFileFile(siblingPath)));
+}
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check missing prefetch manifests are cached",
+                 "[storage]")
+{
+    faabric::Message msg;
+    msg.set_ispython(true);
+    msg.set_pythonuser("alpha");
+    msg.set_pythonfunction("no_manifest");
+
+    std::string manifestPath =
+      loader.getPythonFunctionPrefetchRelativePath(msg);
+    std::string relPath = "prefetch_late_dir/a.py";
+    std::vector<uint8_t> bytes = { 1, 2, 3 };
+    loader.uploadSharedFile(relPath, bytes);
+    boost::filesystem::remove(loader.getSharedFileFile(relPath));
+    boost::filesystem::remove(loader.getSharedFileFile(manifestPath));
+    s3.deleteKey(faasmConf.s3Bucket, manifestPath);
+
+    faasmConf.sharedFilesNegativeTtlMs = 200;
+
+    REQUIRE(SharedFiles::prefetchForPythonFunction(msg) == 0);
+
+    // Upload straight to S3 so the loader doesn't cache it locally
+    std::string manifest = "faasm://prefetch_late_dir\n";
+    s3.addKeyBytes(faasmConf.s3Bucket,
+                   manifestPath,
+                   std::vector<uint8_t>(manifest.begin(), manifest.end()));
+
+    // Miss still cached
+    REQUIRE(SharedFiles::prefetchForPythonFunction(msg) == 0);
+
+    // Once expired the manifest is picked up
+    SLEEP_MS(300);
+    REQUIRE(SharedFiles::prefetchForPythonFunction(msg) == 1);
+    REQUIRE(boost::filesystem::exists(loader.getSharedFileFile(relPath)));
+}
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check prefetch manifest that is a directory is ignored",
+                 "[storage]")
+{
+    faabric::Message msg;
+    msg.set_ispython(true);
+    msg.set_pythonuser("alpha");
+    msg.set_pythonfunction("dir_manifest");
+
+    std::string manifestPath =
+      loader.getPythonFunctionPrefetchRelativePath(msg);
+    boost::filesystem::create_directories(
+      loader.getSharedFileFile(manifestPath));
+
+    REQUIRE(SharedFiles::prefetchForPythonFunction(msg) == 0);
+
+    boost::filesystem::remove_all(loader.getSharedFileFile(manifestPath));
+}
+
+TEST_CASE_METHOD(SharedFilesTestFixture,
+                 "Check prefetch manifests are only read once",
+                 "[storage]")
+{
+    faabric::Message msg;
+    msg.set_ispython(true);
+    msg.set_pythonuser("alpha");
+    msg.set_pythonfunction("manifest_once");
+
+    std::string manifestPath =
+      loader.getPythonFunctionPrefetchRelativePath(msg);
+    std::vector<uint8_t> bytes = { 1, 2, 3 };
+    std::vector<std::string> relPaths = { "prefetch_once_a/a.py",
+                                          "prefetch_once_b/b.py" };
+    for (const auto& p : relPaths) {
+        loader.uploadSharedFile(p, bytes);
+        boost::filesystem::remove(loader.getSharedFileFile(p));
+    }
+
+    auto writeManifest = [this, &manifestPath](const std::string& manifest) {
+        boost::filesystem::remove(loader.getSharedFileFile(manifestPath));
+        s3.addKeyBytes(faasmConf.s3Bucket,
+                       manifestPath,
+                       std::vector<uint8_t>(manifest.begin(), manifest.end()));
+    };
+
+    writeManifest("faasm://prefetch_once_a\n");
+    REQUIRE(SharedFiles::prefetchForPythonFunction(msg) == 1);
+
+    // Later Faaslets don't read or prefetch it again
+    writeManifest("faasm://prefetch_once_b\n");
+    REQUIRE(SharedFiles::prefetchForPythonFunction(msg) == 0);
+    REQUIRE(!boost::filesystem::exists(loader.getSharedFileFile(relPaths[1])));
+
+    // Re-uploading the function picks up its new manifest
+    SharedFiles::invalidatePythonFunctionFile(msg);
+    REQUIRE(SharedFiles::prefetchForPythonFunction(msg) == 1);
+    REQUIRE(boost::filesystem::exists(loader.getSharedFileFile(relPaths[1])));
+}
 }
@@ -1,8 +1,11 @@
 #include <catch2/catch.hpp>
 
+#include "faasm_fixtures.h"
+
 #include <faabric/util/config.h>
 #include <faabric/util/environment.h>
 #include <faabric/util/files.h>
+#include <faabric/util/func.h>
 #include <faabric/util/logging.h>
 #include <faabric/util/string_tools.h>
 
@@ -12,8 +15,11 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
+#include <fstream>
 #include <syscall.h>
 #include <thread>
+#include <unistd.h>
 
 using namespace isolation;
 
@@ -39,6 +45,12 @@ TEST_CASE("Test cgroup on/ off", "[faaslet]")
         expected = CgroupMode::cg_on;
     }
 
+    SECTION("Test cgroup v2")
+    {
+        envValue = "v2";
+        expected = CgroupMode::cg_v2;
+    }
+
     SECTION("Test cgroup off")
     {
         envValue = "off";
@@ -119,4 +131,155 @@ TEST_CASE("Test adding thread to cpu controller", "[faaslet]")
     REQUIRE(cgroupCheckPassed);
     */
 }
+
+TEST_CASE_METHOD(FaasmConfTestFixture,
+                 "Test function cgroup names",
+                 "[faaslet]")
+{
+    faabric::Message msg = faabric::util::messageFactory("demo", "echo");
+
+    std::string expected;
+
+    SECTION("cgroup v1")
+    {
+        faasmConf.cgroupMode = "on";
+        expected = BASE_CGROUP_NAME;
+    }
+
+    SECTION("Per function")
+    {
+        faasmConf.cgroupMode = "v2";
+        faasmConf.cgroupGranularity = "function";
+        expected = "faasm/demo-echo";
+    }
+
+    SECTION("Per user")
+    {
+        faasmConf.cgroupMode = "v2";
+        faasmConf.cgroupGranularity = "user";
+        expected = "faasm/demo";
+    }
+
+    REQUIRE(getFunctionCgroupName(msg) == expected);
+}
+
+TEST_CASE_METHOD(FaasmConfTestFixture,
+                 "Test parsing cgroup limits",
+                 "[faaslet]")
+{
+    faasmConf.cgroupCpuWeight = "100";
+    faasmConf.cgroupCpuMax = "";
+
+    std::string metadata;
+    std::string expectedWeight;
+    std::string expectedMax;
+
+    SECTION("No metadata")
+    {
+        expectedWeight = "100";
+        expectedMax = "";
+    }
+
+    SECTION("Override both")
+    {
+        metadata = "cpu.weight=50\ncpu.max = 50000 100000\n";
+        expectedWeight = "50";
+        expectedMax = "50000 100000";
+    }
+
+    SECTION("Comments and unsupported keys")
+    {
+        metadata = "# Limits\nmemory.max=1G\nfoo\ncpu.max=max 100000";
+        expectedWeight = "100";
+        expectedMax = "max 100000";
+    }
+
+    CgroupLimits limits = parseCgroupLimits(metadata);
+    REQUIRE(limits.cpuWeight == expectedWeight);
+    REQUIRE(limits.cpuMax == expectedMax);
+}
+
+// Finds a writable cgroup v2 mount with the cpu controller available, or
+// returns an empty string if there isn't one
+static std::string findCgroupV2Mount()
+{
+    std::ifstream mounts("/proc/mounts");
+    std::string device;
+    std::string mountPoint;
+    std::string fsType;
+    std::string rest;
+    while (mounts >> device >> mountPoint >> fsType &&
+           std::getline(mounts, rest)) {
+        if (fsType != "cgroup2" || ::access(mountPoint.c_str(), W_OK) != 0) {
+            continue;
+        }
+
+        std::string controllers =
+          faabric::util::readFileToString(mountPoint + "/cgroup.controllers");
+        std::vector<std::string> names;
+        boost::algorithm::split(names,
+                                boost::algorithm::trim_copy(controllers),
+                                boost::algorithm::is_space());
+        if (std::find(names.begin(), names.end(), "cpu") != names.end()) {
+            return mountPoint;
+        }
+    }
+
+    return "";
+}
+
+// Path of this process's cgroup relative to the v2 mount
+static std::string currentCgroupV2Path()
+{
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroups, line)) {
+        if (faabric::util::startsWith(line, "0::")) {
+            return line.substr(3);
+        }
+    }
+
+    return "";
+}
+
+TEST_CASE_METHOD(FaasmConfTestFixture,
+                 "Test setting up the cgroup v2 base group",
+                 "[faaslet]")
+{
+    std::string mountPoint = findCgroupV2Mount();
+    if (mountPoint.empty()) {
+        WARN("No writable cgroup v2 mount with the cpu controller, skipping");
+        return;
+    }
+
+    // Make sure the cpu controller reaches our test group
+    std::string rootControl = mountPoint + "/cgroup.subtree_control";
+    std::ofstream(rootControl) << "+cpu";
+
+    std::string originalPath = mountPoint + currentCgroupV2Path();
+    boost::filesystem::path basePath(mountPoint);
+    basePath.append("faasm-cgroup-test");
+    boost::filesystem::create_directory(basePath);
+
+    faasmConf.cgroupMemoryMax = "";
+    setUpBaseCgroup(basePath.string());
+
+    // The base is a threaded domain holding this process
+    auto readTrimmed = [](const boost::filesystem::path& p) {
+        return boost::algorithm::trim_copy(
+          faabric::util::readFileToString(p.string()));
+    };
+    REQUIRE(readTrimmed(basePath / "cgroup.type") == "domain threaded");
+    REQUIRE(faabric::util::contains(
+      readTrimmed(basePath / "cgroup.subtree_control"), "cpu"));
+    REQUIRE(readTrimmed(basePath / BASE_CGROUP_MAIN_NAME / "cgroup.type") ==
+            "threaded");
+    REQUIRE(faabric::util::contains(readTrimmed(basePath / "cgroup.procs"),
+                                    std::to_string(::getpid())));
+
+    // Move back out and tidy up
+    std::ofstream(originalPath + "/cgroup.procs") << ::getpid();
+    boost::filesystem::remove(basePath / BASE_CGROUP_MAIN_NAME);
+    boost::filesystem::remove(basePath);
+}
 }
@@ -32,4 +32,31 @@ TEST_CASE_METHOD(FaasmConfTestFixture,
         returnNetworkNamespace(ns);
     }
 }
+
+TEST_CASE_METHOD(FaasmConfTestFixture,
+                 "Test joining network namespaces",
+                 "[faaslet][network]")
+{
+    NetworkNamespace ns("foobar-missing");
+    REQUIRE(ns.getName() == "foobar-missing");
+
+    SECTION("Namespaces off")
+    {
+        faasmConf.netNsMode = "off";
+
+        // Should be a no-op, even though the namespace doesn't exist
+        REQUIRE_NOTHROW(ns.prepare());
+        REQUIRE_NOTHROW(ns.addCurrentThread());
+        REQUIRE_NOTHROW(ns.removeCurrentThread());
+    }
+
+    SECTION("Missing namespace")
+    {
+        faasmConf.netNsMode = "on";
+
+        // Failing to open the fd should not be cached
+        REQUIRE_THROWS(ns.prepare());
+        REQUIRE_THROWS(ns.addCurrentThread());
+    }
+}
 }
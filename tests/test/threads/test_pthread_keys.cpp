@@ -0,0 +1,112 @@
+#include <catch2/catch.hpp>
+
+#include <threads/ThreadState.h>
+
+#include <thread>
+
+using namespace threads;
+
+namespace tests {
+
+TEST_CASE("Test creating and deleting pthread keys", "[threads]")
+{
+    PthreadKeys keys;
+
+    int keyA = keys.createKey(0);
+    int keyB = keys.createKey(123);
+    REQUIRE(keyA == 0);
+    REQUIRE(keyB == 1);
+
+    REQUIRE(keys.isKeyInUse(keyA));
+    REQUIRE(keys.isKeyInUse(keyB));
+    REQUIRE(!keys.isKeyInUse(2));
+    REQUIRE(!keys.isKeyInUse(PTHREAD_KEYS_MAX + 1));
+
+    REQUIRE(keys.getDestructor(keyA) == 0);
+    REQUIRE(keys.getDestructor(keyB) == 123);
+
+    // Deleted keys are reused
+    REQUIRE(keys.deleteKey(keyA));
+    REQUIRE(!keys.deleteKey(keyA));
+    REQUIRE(!keys.isKeyInUse(keyA));
+    REQUIRE(keys.createKey(456) == keyA);
+    REQUIRE(keys.getDestructor(keyA) == 456);
+
+    // Run out of keys
+    for (int i = 2; i < PTHREAD_KEYS_MAX; i++) {
+        REQUIRE(keys.createKey(0) == i);
+    }
+    REQUIRE(keys.createKey(0) == -1);
+
+    keys.clear();
+    REQUIRE(!keys.isKeyInUse(keyA));
+    REQUIRE(keys.createKey(0) == 0);
+}
+
+TEST_CASE("Test shipping pthread keys to other hosts", "[threads]")
+{
+    int appId = 1234;
+
+    PthreadKeys mainKeys;
+    int keyA = mainKeys.createKey(11);
+    std::vector<uint8_t> bytes = mainKeys.serialise(appId);
+
+    // A module on another host picks up the keys
+    PthreadKeys remoteKeys;
+    remoteKeys.createKey(99);
+    remoteKeys.createKey(99);
+    remoteKeys.deserialise(bytes);
+
+    REQUIRE(remoteKeys.isKeyInUse(keyA));
+    REQUIRE(remoteKeys.getDestructor(keyA) == 11);
+    REQUIRE(!remoteKeys.isKeyInUse(1));
+
+    // Deserialising on the main host doesn't undo later changes
+    int keyB = mainKeys.createKey(22);
+    mainKeys.deserialise(bytes);
+    REQUIRE(mainKeys.isKeyInUse(keyB));
+
+    // Newer keys replace older ones from the same app
+    std::vector<uint8_t> newBytes = mainKeys.serialise(appId);
+    remoteKeys.deserialise(newBytes);
+    REQUIRE(remoteKeys.getDestructor(keyB) == 22);
+
+    remoteKeys.deserialise(bytes);
+    REQUIRE(remoteKeys.isKeyInUse(keyB));
+
+    // Keys from another app always replace what's there
+    PthreadKeys otherKeys;
+    remoteKeys.deserialise(otherKeys.serialise(appId + 1));
+    REQUIRE(!remoteKeys.isKeyInUse(keyA));
+    REQUIRE(!remoteKeys.isKeyInUse(keyB));
+
+    REQUIRE_THROWS(remoteKeys.deserialise({ 1, 2, 3 }));
+}
+
+TEST_CASE("Test pthread key values are per thread", "[threads]")
+{
+    clearPthreadKeyValues();
+
+    setPthreadKeyValue(1, 100);
+    setPthreadKeyValue(5, 500);
+    REQUIRE(getPthreadKeyValue(1) == 100);
+    REQUIRE(getPthreadKeyValue(5) == 500);
+    REQUIRE(getPthreadKeyValue(2) == 0);
+    REQUIRE(getPthreadKeyValue(PTHREAD_KEYS_MAX + 1) == 0);
+
+    std::thread otherThread([] {
+        REQUIRE(getPthreadKeyValue(1) == 0);
+        setPthreadKeyValue(1, 111);
+        REQUIRE(getPthreadKeyValue(1) == 111);
+    });
+    otherThread.join();
+
+    REQUIRE(getPthreadKeyValue(1) == 100);
+
+    std::vector<std::pair<uint32_t, uint32_t>> expected = { { 1, 100 },
+                                                            { 5, 500 } };
+    REQUIRE(takePthreadKeyValues() == expected);
+    REQUIRE(getPthreadKeyValue(1) == 0);
+    REQUIRE(takePthreadKeyValues().empty());
+}
+}
@@ -0,0 +1,318 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <faabric/util/func.h>
+#include <threads/ThreadState.h>
+#include <wamr/WAMRWasmModule.h>
+#include <wamr/native.h>
+#include <wamr/types.h>
+#include <wasm/WasmExecutionContext.h>
+
+#include <wasm_export.h>
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace wasm;
+
+namespace tests {
+
+typedef int32_t (*PthreadWrapper1)(wasm_exec_env_t, int32_t);
+typedef int32_t (*PthreadWrapper2)(wasm_exec_env_t, int32_t, int32_t);
+
+// Exposes the key destructor loop, which otherwise needs a guest function to
+// call as the destructor
+class TestWAMRModule : public WAMRWasmModule
+{
+  public:
+    using WAMRWasmModule::WAMRWasmModule;
+
+    using WasmModule::runPthreadKeyDestructors;
+};
+
+class WAMRPthreadTestFixture : public MultiRuntimeFunctionExecTestFixture
+{
+  public:
+    // Threads need the function to be built with shared memory, which the
+    // demo threads functions are
+    WAMRPthreadTestFixture()
+      : call(faabric::util::messageFactory("demo", "threads_check"))
+      , module(nThreads)
+    {
+        faasmConf.wasmVm = "wamr";
+
+        module.bindToFunction(call);
+        basePtr = module.growMemory(WASM_BYTES_PER_PAGE);
+
+        NativeSymbol* symbols;
+        uint32_t nSymbols = getFaasmPthreadApi(&symbols);
+        for (uint32_t i = 0; i < nSymbols; i++) {
+            wrappers[symbols[i].symbol] = symbols[i].func_ptr;
+        }
+    }
+
+    ~WAMRPthreadTestFixture() { threads::clearPthreadKeyValues(); }
+
+  protected:
+    faabric::Message call;
+    TestWAMRModule module;
+    uint32_t basePtr = 0;
+    std::unordered_map<std::string, void*> wrappers;
+
+    static const int nThreads = 4;
+
+    template<typename T>
+    T getWrapper(const std::string& name)
+    {
+        REQUIRE(wrappers.count(name) == 1);
+        return reinterpret_cast<T>(wrappers[name]);
+    }
+
+    template<typename T>
+    T* nativePtr(uint32_t offset)
+    {
+        return reinterpret_cast<T*>(
+          module.wasmPointerToNative(basePtr + offset));
+    }
+
+    // Guest mutexes can't be tried by the thread that holds them
+    int32_t tryLockOnOtherThread(uint32_t mx)
+    {
+        auto tryLock = getWrapper<PthreadWrapper1>("pthread_mutex_trylock");
+
+        return std::async(std::launch::async, [this, tryLock, mx] {
+                   WasmExecutionContext ctx(&module);
+                   return tryLock(nullptr, mx);
+               })
+          .get();
+    }
+
+    void setAbsTime(uint32_t offset, std::chrono::milliseconds fromNow)
+    {
+        auto target = std::chrono::system_clock::now() + fromNow;
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       target.time_since_epoch())
+                       .count();
+
+        auto* abstime = nativePtr<wasm_timespec_app_t>(offset);
+        abstime->tv_sec = nanos / 1000000000;
+        abstime->tv_nsec = nanos % 1000000000;
+    }
+
+    static const uint32_t MX_OFFSET = 0;
+    static const uint32_t COND_OFFSET = 64;
+    static const uint32_t ABSTIME_OFFSET = 128;
+    static const uint32_t KEY_OFFSET = 192;
+};
+
+TEST_CASE_METHOD(WAMRPthreadTestFixture,
+                 "Test WAMR pthread mutex trylock",
+                 "[wamr][threads]")
+{
+    WasmExecutionContext ctx(&module);
+
+    auto init = getWrapper<PthreadWrapper2>("pthread_mutex_init");
+    auto lock = getWrapper<PthreadWrapper1>("pthread_mutex_lock");
+    auto tryLock = getWrapper<PthreadWrapper1>("pthread_mutex_trylock");
+    auto unlock = getWrapper<PthreadWrapper1>("pthread_mutex_unlock");
+
+    uint32_t mx = basePtr + MX_OFFSET;
+    REQUIRE(init(nullptr, mx, 0) == 0);
+
+    // Held with lock
+    REQUIRE(lock(nullptr, mx) == 0);
+    REQUIRE(tryLockOnOtherThread(mx) == EBUSY);
+    REQUIRE(unlock(nullptr, mx) == 0);
+
+    // Held with trylock
+    REQUIRE(tryLock(nullptr, mx) == 0);
+    REQUIRE(tryLockOnOtherThread(mx) == EBUSY);
+    REQUIRE(unlock(nullptr, mx) == 0);
+
+    // Free again
+    REQUIRE(tryLock(nullptr, mx) == 0);
+    REQUIRE(unlock(nullptr, mx) == 0);
+}
+
+TEST_CASE_METHOD(WAMRPthreadTestFixture,
+                 "Test WAMR pthread condition timed wait",
+                 "[wamr][threads]")
+{
+    WasmExecutionContext ctx(&module);
+
+    typedef int32_t (*TimedWaitWrapper)(
+      wasm_exec_env_t, int32_t, int32_t, wasm_timespec_app_t*);
+    auto timedWait = getWrapper<TimedWaitWrapper>("pthread_cond_timedwait");
+    auto signal = getWrapper<PthreadWrapper1>("pthread_cond_signal");
+    auto init = getWrapper<PthreadWrapper2>("pthread_mutex_init");
+    auto lock = getWrapper<PthreadWrapper1>("pthread_mutex_lock");
+    auto unlock = getWrapper<PthreadWrapper1>("pthread_mutex_unlock");
+
+    uint32_t mx = basePtr + MX_OFFSET;
+    uint32_t cond = basePtr + COND_OFFSET;
+    auto* abstime = nativePtr<wasm_timespec_app_t>(ABSTIME_OFFSET);
+
+    REQUIRE(init(nullptr, mx, 0) == 0);
+    REQUIRE(lock(nullptr, mx) == 0);
+
+    SECTION("Times out")
+    {
+        setAbsTime(ABSTIME_OFFSET, std::chrono::milliseconds(20));
+
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(timedWait(nullptr, cond, mx, abstime) == ETIMEDOUT);
+        REQUIRE(std::chrono::steady_clock::now() - start >=
+                std::chrono::milliseconds(15));
+    }
+
+    SECTION("Deadline in the past")
+    {
+        setAbsTime(ABSTIME_OFFSET, std::chrono::milliseconds(-1000));
+        REQUIRE(timedWait(nullptr, cond, mx, abstime) == ETIMEDOUT);
+    }
+
+    SECTION("Signalled")
+    {
+        setAbsTime(ABSTIME_OFFSET, std::chrono::milliseconds(10000));
+
+        // Signal once the waiter has released the mutex and parked
+        auto signaller =
+          std::async(std::launch::async, [this, signal, cond] {
+              WasmExecutionContext ctx(&module);
+              while (module.getParkingLot().getParkedCount(cond) != 1) {
+                  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+              }
+
+              return signal(nullptr, cond);
+          });
+
+        REQUIRE(timedWait(nullptr, cond, mx, abstime) == 0);
+        REQUIRE(signaller.get() == 0);
+    }
+
+    SECTION("Invalid time")
+    {
+        abstime->tv_sec = 0;
+        abstime->tv_nsec = 1000000000;
+        REQUIRE(timedWait(nullptr, cond, mx, abstime) == EINVAL);
+    }
+
+    // The mutex is held again whatever the outcome
+    REQUIRE(tryLockOnOtherThread(mx) == EBUSY);
+    REQUIRE(unlock(nullptr, mx) == 0);
+}
+
+TEST_CASE_METHOD(WAMRPthreadTestFixture,
+                 "Test WAMR pthread keys and destructors",
+                 "[wamr][threads]")
+{
+    WasmExecutionContext ctx(&module);
+
+    typedef int32_t (*KeyCreateWrapper)(wasm_exec_env_t, uint32_t*, int32_t);
+    auto keyCreate = getWrapper<KeyCreateWrapper>("pthread_key_create");
+    auto keyDelete = getWrapper<PthreadWrapper1>("pthread_key_delete");
+    auto getSpecific = getWrapper<PthreadWrapper1>("pthread_getspecific");
+    auto setSpecific = getWrapper<PthreadWrapper2>("pthread_setspecific");
+
+    uint32_t* keyPtr = nativePtr<uint32_t>(KEY_OFFSET);
+
+    int32_t destructor = 123;
+    REQUIRE(keyCreate(nullptr, keyPtr, destructor) == 0);
+    uint32_t keyA = *keyPtr;
+
+    REQUIRE(keyCreate(nullptr, keyPtr, 0) == 0);
+    uint32_t keyB = *keyPtr;
+    REQUIRE(keyB != keyA);
+
+    // Values start null, and are per thread
+    REQUIRE(getSpecific(nullptr, keyA) == 0);
+    REQUIRE(setSpecific(nullptr, keyA, 42) == 0);
+    REQUIRE(setSpecific(nullptr, keyB, 43) == 0);
+    REQUIRE(getSpecific(nullptr, keyA) == 42);
+    REQUIRE(getSpecific(nullptr, keyB) == 43);
+
+    int32_t otherThreadValue = std::async(std::launch::async, [&] {
+                                   WasmExecutionContext ctx(&module);
+                                   return getSpecific(nullptr, keyA);
+                               }).get();
+    REQUIRE(otherThreadValue == 0);
+
+    // Only keys with a destructor have it called, and values are then null
+    std::vector<std::pair<uint32_t, uint32_t>> called;
+    module.runPthreadKeyDestructors(
+      [&called](uint32_t destructor, uint32_t value) {
+          called.emplace_back(destructor, value);
+      });
+
+    std::vector<std::pair<uint32_t, uint32_t>> expected = { { 123, 42 } };
+    REQUIRE(called == expected);
+    REQUIRE(getSpecific(nullptr, keyA) == 0);
+    REQUIRE(getSpecific(nullptr, keyB) == 0);
+
+    // Deleted keys can't be used
+    REQUIRE(keyDelete(nullptr, keyA) == 0);
+    REQUIRE(keyDelete(nullptr, keyA) == EINVAL);
+    REQUIRE(setSpecific(nullptr, keyA, 1) == EINVAL);
+    REQUIRE(getSpecific(nullptr, keyA) == 0);
+}
+
+TEST_CASE_METHOD(WAMRPthreadTestFixture,
+                 "Test WAMR pthread exec envs reused across resets",
+                 "[wamr][threads]")
+{
+    INFO("WAMR threads need demo/threads_check built with shared memory");
+    REQUIRE(module.isMemoryShared());
+
+    // Each executor thread keeps its own exec env
+    std::vector<uint32_t> stacks = module.getThreadStacks();
+    WASMExecEnv* envA = module.getPthreadExecEnv(1, stacks.at(1));
+    WASMExecEnv* envB = module.getPthreadExecEnv(2, stacks.at(2));
+    REQUIRE(envA != envB);
+    REQUIRE(module.getPthreadExecEnv(1, stacks.at(1)) == envA);
+
+    // Threads run on the module's memory
+    auto checkSharesMemory = [this](WASMExecEnv* env) {
+        return wasm_runtime_addr_app_to_native(
+                 wasm_runtime_get_module_inst(env), 0) ==
+               module.getMemoryBase();
+    };
+    REQUIRE(checkSharesMemory(envA));
+    REQUIRE(checkSharesMemory(envB));
+
+    // Resetting drops the exec envs along with the instance they were spawned
+    // from, so new ones share the new instance's memory
+    for (int i = 0; i < 3; i++) {
+        module.reset(call, "");
+
+        stacks = module.getThreadStacks();
+        WASMExecEnv* env = module.getPthreadExecEnv(1, stacks.at(1));
+        REQUIRE(checkSharesMemory(env));
+        REQUIRE(module.getPthreadExecEnv(1, stacks.at(1)) == env);
+    }
+}
+
+TEST_CASE_METHOD(MultiRuntimeFunctionExecTestFixture,
+                 "Test WAMR pthreads need shared memory",
+                 "[wamr][threads]")
+{
+    faasmConf.wasmVm = "wamr";
+
+    faabric::Message call = faabric::util::messageFactory("demo", "echo");
+    WAMRWasmModule module(4);
+    module.bindToFunction(call);
+
+    if (module.isMemoryShared()) {
+        WARN("demo/echo is built with shared memory, skipping");
+        return;
+    }
+
+    // Threads would otherwise run on a private copy of memory
+    std::vector<uint32_t> stacks = module.getThreadStacks();
+    REQUIRE_THROWS(module.getPthreadExecEnv(1, stacks.at(1)));
+}
+}
@@ -0,0 +1,255 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <wasm/ConnectionPool.h>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace wasm;
+
+namespace tests {
+
+class ConnectionPoolTestFixture : public FaasmConfTestFixture
+{
+  public:
+    ConnectionPoolTestFixture()
+    {
+        faasmConf.connPoolMode = "on";
+
+        // Local echo server, which handles one connection at a time
+        listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(listenFd >= 0);
+
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        serverAddr.sin_port = 0;
+        REQUIRE(::bind(listenFd, (sockaddr*)&serverAddr, sizeof(serverAddr)) ==
+                0);
+        REQUIRE(::listen(listenFd, 8) == 0);
+
+        socklen_t addrLen = sizeof(serverAddr);
+        ::getsockname(listenFd, (sockaddr*)&serverAddr, &addrLen);
+        faasmConf.connPoolPorts =
+          "1," + std::to_string(ntohs(serverAddr.sin_port));
+
+        serverThread = std::thread([this] {
+            while (true) {
+                int connFd = ::accept(listenFd, nullptr, nullptr);
+                if (connFd < 0) {
+                    break;
+                }
+
+                nAccepted++;
+
+                char buf[64];
+                ssize_t n;
+                while ((n = ::recv(connFd, buf, sizeof(buf), 0)) > 0) {
+                    ::send(connFd, buf, n, 0);
+                }
+
+                ::close(connFd);
+            }
+        });
+    }
+
+    ~ConnectionPoolTestFixture()
+    {
+        // Close everything so the server can finish
+        pool.releaseGuestSockets();
+        pool.clear();
+
+        ::shutdown(listenFd, SHUT_RDWR);
+        serverThread.join();
+        ::close(listenFd);
+    }
+
+    int connectGuestSocket()
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        pool.addGuestSocket(fd);
+
+        int res = pool.connect(fd, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        REQUIRE(res == 0);
+
+        return fd;
+    }
+
+    std::string echo(int fd, const std::string& msg)
+    {
+        REQUIRE(::send(fd, msg.c_str(), msg.size(), 0) == (ssize_t)msg.size());
+
+        std::string res(msg.size(), '\0');
+        size_t received = 0;
+        while (received < msg.size()) {
+            ssize_t n = ::recv(fd, res.data() + received, msg.size(), 0);
+            REQUIRE(n > 0);
+            received += n;
+        }
+
+        return res;
+    }
+
+    void waitForAccepted(int expected)
+    {
+        // The server only accepts once it's done with the previous connection
+        for (int i = 0; i < 100 && nAccepted < expected; i++) {
+            usleep(10000);
+        }
+    }
+
+  protected:
+    ConnectionPool pool;
+
+    int listenFd = -1;
+    sockaddr_in serverAddr{};
+    std::thread serverThread;
+    std::atomic<int> nAccepted = 0;
+};
+
+TEST_CASE_METHOD(ConnectionPoolTestFixture,
+                 "Test reusing pooled connections",
+                 "[wasm]")
+{
+    int fdA = connectGuestSocket();
+    REQUIRE(echo(fdA, "hello") == "hello");
+
+    SECTION("Closed by guest") { REQUIRE(pool.closeGuestSocket(fdA)); }
+
+    SECTION("Left open at end of invocation") { pool.releaseGuestSockets(); }
+
+    REQUIRE(pool.getIdleCount() == 1);
+
+    // Connecting again should get the same connection under the new fd
+    int fdB = connectGuestSocket();
+    REQUIRE(pool.getIdleCount() == 0);
+    REQUIRE(echo(fdB, "again") == "again");
+
+    REQUIRE(nAccepted == 1);
+}
+
+TEST_CASE_METHOD(ConnectionPoolTestFixture,
+                 "Test connections not pooled",
+                 "[wasm]")
+{
+    SECTION("Pooling off") { faasmConf.connPoolMode = "off"; }
+
+    SECTION("Port not allowed") { faasmConf.connPoolPorts = "1,2,3"; }
+
+    SECTION("No ports allowed") { faasmConf.connPoolPorts = ""; }
+
+    int fdA = connectGuestSocket();
+    REQUIRE(echo(fdA, "hello") == "hello");
+    REQUIRE(pool.closeGuestSocket(fdA));
+    REQUIRE(pool.getIdleCount() == 0);
+
+    int fdB = connectGuestSocket();
+    REQUIRE(echo(fdB, "again") == "again");
+
+    waitForAccepted(2);
+    REQUIRE(nAccepted == 2);
+}
+
+TEST_CASE_METHOD(ConnectionPoolTestFixture,
+                 "Test stale connections not reused",
+                 "[wasm]")
+{
+    int fdA = connectGuestSocket();
+
+    SECTION("Idle timeout passed")
+    {
+        faasmConf.connPoolIdleTimeoutMs = 0;
+
+        REQUIRE(echo(fdA, "hello") == "hello");
+        REQUIRE(pool.closeGuestSocket(fdA));
+        REQUIRE(pool.getIdleCount() == 1);
+
+        usleep(2000);
+    }
+
+    SECTION("Response left unread")
+    {
+        // Wait for the echo to arrive, but don't read it
+        REQUIRE(::send(fdA, "x", 1, 0) == 1);
+        pollfd pfd{ .fd = fdA, .events = POLLIN, .revents = 0 };
+        REQUIRE(::poll(&pfd, 1, 1000) == 1);
+
+        REQUIRE(pool.closeGuestSocket(fdA));
+        REQUIRE(pool.getIdleCount() == 0);
+    }
+
+    int fdB = connectGuestSocket();
+    REQUIRE(pool.getIdleCount() == 0);
+    REQUIRE(echo(fdB, "again") == "again");
+
+    waitForAccepted(2);
+    REQUIRE(nAccepted == 2);
+}
+
+TEST_CASE_METHOD(ConnectionPoolTestFixture,
+                 "Test sockets with options not pooled",
+                 "[wasm]")
+{
+    int noDelay = 1;
+
+    SECTION("Options set after connecting")
+    {
+        // The connection isn't returned to the pool
+        int fdA = connectGuestSocket();
+        REQUIRE(pool.setSockOpt(
+                  fdA, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) ==
+                0);
+        REQUIRE(echo(fdA, "hello") == "hello");
+        REQUIRE(pool.closeGuestSocket(fdA));
+        REQUIRE(pool.getIdleCount() == 0);
+    }
+
+    SECTION("Options set before connecting")
+    {
+        int fdA = connectGuestSocket();
+        REQUIRE(echo(fdA, "hello") == "hello");
+        REQUIRE(pool.closeGuestSocket(fdA));
+        REQUIRE(pool.getIdleCount() == 1);
+
+        // The pooled connection isn't swapped in, as the option would be lost
+        int fdB = ::socket(AF_INET, SOCK_STREAM, 0);
+        pool.addGuestSocket(fdB);
+        REQUIRE(pool.setSockOpt(
+                  fdB, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) ==
+                0);
+        REQUIRE(pool.connect(fdB, (sockaddr*)&serverAddr, sizeof(serverAddr)) ==
+                0);
+        REQUIRE(pool.getIdleCount() == 1);
+
+        int actual = 0;
+        socklen_t actualLen = sizeof(actual);
+        ::getsockopt(fdB, IPPROTO_TCP, TCP_NODELAY, &actual, &actualLen);
+        REQUIRE(actual == 1);
+
+        // Close the pooled connection so the server can accept the new one
+        pool.clear();
+        REQUIRE(echo(fdB, "again") == "again");
+
+        waitForAccepted(2);
+        REQUIRE(nAccepted == 2);
+    }
+}
+
+TEST_CASE_METHOD(ConnectionPoolTestFixture,
+                 "Test closing unknown sockets",
+                 "[wasm]")
+{
+    REQUIRE(!pool.closeGuestSocket(12345));
+
+    int opt = 1;
+    REQUIRE(pool.setSockOpt(12345, SOL_SOCKET, SO_KEEPALIVE, &opt, 4) ==
+            -EBADF);
+}
+}
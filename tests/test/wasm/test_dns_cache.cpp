@@ -0,0 +1,135 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <wasm/DnsCache.h>
+
+#include <arpa/inet.h>
+#include <filesystem>
+#include <fstream>
+
+using namespace wasm;
+
+namespace tests {
+
+class DnsCacheTestFixture : public FaasmConfTestFixture
+{
+  public:
+    DnsCacheTestFixture()
+    {
+        faasmConf.dnsCacheMode = "hosts";
+        faasmConf.dnsHostsFile = hostsPath;
+
+        writeHostsFile("# Test hosts\n"
+                       "10.0.0.1  foo.faasm.test foo\n"
+                       "10.0.0.2  bar.faasm.test\n"
+                       "10.0.0.3  bar.faasm.test # second address\n"
+                       "fe80::1   ipv6.faasm.test\n");
+
+        getDnsCache().clear();
+    }
+
+    ~DnsCacheTestFixture()
+    {
+        getDnsCache().clear();
+        std::filesystem::remove(hostsPath);
+    }
+
+    void writeHostsFile(const std::string& contents)
+    {
+        std::ofstream out(hostsPath, std::ios::trunc);
+        out << contents;
+    }
+
+    std::vector<std::string> resolveToStrings(const std::string& hostname)
+    {
+        std::vector<std::string> res;
+        for (const auto& addr : getDnsCache().resolve(hostname)) {
+            res.emplace_back(::inet_ntoa(addr));
+        }
+
+        return res;
+    }
+
+  protected:
+    const std::string hostsPath = "/tmp/faasm_test_hosts";
+};
+
+TEST_CASE_METHOD(DnsCacheTestFixture,
+                 "Test resolving from hosts file",
+                 "[wasm][dns]")
+{
+    std::vector<std::string> expectedFoo = { "10.0.0.1" };
+    REQUIRE(resolveToStrings("foo.faasm.test") == expectedFoo);
+    REQUIRE(resolveToStrings("foo") == expectedFoo);
+    REQUIRE(resolveToStrings("FOO.Faasm.Test") == expectedFoo);
+
+    std::vector<std::string> expectedBar = { "10.0.0.2", "10.0.0.3" };
+    REQUIRE(resolveToStrings("bar.faasm.test") == expectedBar);
+
+    // Only IPv4 addresses are returned
+    REQUIRE(resolveToStrings("ipv6.faasm.test").empty());
+    REQUIRE(resolveToStrings("missing.faasm.test").empty());
+
+    // Case variations share an entry, and misses are cached too
+    REQUIRE(getDnsCache().size() == 5);
+}
+
+TEST_CASE_METHOD(DnsCacheTestFixture,
+                 "Test DNS cache serves cached answers",
+                 "[wasm][dns]")
+{
+    REQUIRE(resolveToStrings("foo.faasm.test").size() == 1);
+    REQUIRE(resolveToStrings("new.faasm.test").empty());
+
+    writeHostsFile("10.0.0.9 foo.faasm.test\n"
+                   "10.0.0.8 new.faasm.test\n");
+
+    std::vector<std::string> expectedOld = { "10.0.0.1" };
+    std::vector<std::string> expectedNew;
+    bool cleared = false;
+
+    SECTION("Cache enabled") {}
+
+    SECTION("Cache cleared")
+    {
+        getDnsCache().clear();
+        cleared = true;
+    }
+
+    SECTION("Cache off")
+    {
+        faasmConf.dnsCacheMode = "off";
+        cleared = true;
+    }
+
+    if (cleared) {
+        expectedOld = { "10.0.0.9" };
+        expectedNew = { "10.0.0.8" };
+    }
+
+    REQUIRE(resolveToStrings("foo.faasm.test") == expectedOld);
+    REQUIRE(resolveToStrings("new.faasm.test") == expectedNew);
+}
+
+TEST_CASE_METHOD(DnsCacheTestFixture,
+                 "Test DNS cache with zero TTL does not cache",
+                 "[wasm][dns]")
+{
+    faasmConf.dnsCacheMaxTtlSeconds = 0;
+    faasmConf.dnsCacheNegativeTtlSeconds = 0;
+
+    REQUIRE(resolveToStrings("foo.faasm.test").size() == 1);
+    REQUIRE(resolveToStrings("missing.faasm.test").empty());
+    REQUIRE(getDnsCache().size() == 0);
+}
+
+TEST_CASE_METHOD(DnsCacheTestFixture,
+                 "Test DNS cache passes through IP literals",
+                 "[wasm][dns]")
+{
+    std::vector<std::string> expected = { "192.168.1.20" };
+    REQUIRE(resolveToStrings("192.168.1.20") == expected);
+    REQUIRE(getDnsCache().size() == 0);
+}
+}
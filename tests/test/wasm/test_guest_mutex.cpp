@@ -0,0 +1,90 @@
+#include <catch2/catch.hpp>
+
+#include <wasm/GuestMutex.h>
+#include <wasm/ParkingLot.h>
+
+#include <thread>
+#include <vector>
+
+using namespace wasm;
+
+namespace tests {
+
+TEST_CASE("Test guest mutex lock word", "[wasm][threads]")
+{
+    ParkingLot lot;
+    uint32_t word = 0;
+    GuestMutex mx(lot, 8, &word);
+
+    mx.lock();
+    REQUIRE(word == 1);
+    REQUIRE(!mx.tryLock());
+
+    mx.unlock();
+    REQUIRE(word == 0);
+
+    REQUIRE(mx.tryLock());
+    REQUIRE(word == 1);
+    mx.unlock();
+    REQUIRE(word == 0);
+}
+
+TEST_CASE("Test guest mutex wakes waiters", "[wasm][threads]")
+{
+    ParkingLot lot;
+    uint32_t word = 0;
+    GuestMutex mx(lot, 8, &word);
+
+    mx.lock();
+
+    bool acquired = false;
+    std::thread waiter([&lot, &word, &acquired] {
+        GuestMutex waiterMx(lot, 8, &word);
+        waiterMx.lock();
+        acquired = true;
+        waiterMx.unlock();
+    });
+
+    // Waiter marks the mutex as contended and parks
+    while (lot.getParkedCount(8) != 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(word == 2);
+
+    mx.unlock();
+    waiter.join();
+
+    REQUIRE(acquired);
+    REQUIRE(word == 0);
+}
+
+TEST_CASE("Test guest mutex exclusion", "[wasm][threads]")
+{
+    ParkingLot lot;
+    uint32_t word = 0;
+
+    int nThreads = 8;
+    int nIncrements = 20000;
+    int counter = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back([&lot, &word, &counter, nIncrements] {
+            GuestMutex mx(lot, 8, &word);
+            for (int j = 0; j < nIncrements; j++) {
+                mx.lock();
+                counter++;
+                mx.unlock();
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    REQUIRE(counter == nThreads * nIncrements);
+    REQUIRE(word == 0);
+    REQUIRE(lot.getParkedCount(8) == 0);
+}
+}
@@ -0,0 +1,101 @@
+#include <catch2/catch.hpp>
+
+#include <wasm/ParkingLot.h>
+
+#include <atomic>
+#include <climits>
+#include <thread>
+#include <vector>
+
+using namespace wasm;
+
+namespace tests {
+
+static void waitForParked(ParkingLot& lot, uint32_t addr, int expected)
+{
+    while (lot.getParkedCount(addr) != expected) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST_CASE("Test parking lot validation", "[wasm][threads]")
+{
+    ParkingLot lot;
+    bool slept = false;
+
+    int res = lot.park(
+      16, [] { return false; }, [&slept] { slept = true; }, std::nullopt);
+
+    REQUIRE(res == -EAGAIN);
+    REQUIRE(!slept);
+    REQUIRE(lot.getParkedCount(16) == 0);
+}
+
+TEST_CASE("Test parking lot timeout", "[wasm][threads]")
+{
+    ParkingLot lot;
+    bool slept = false;
+
+    auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+    int res = lot.park(
+      16, [] { return true; }, [&slept] { slept = true; }, deadline);
+
+    REQUIRE(res == -ETIMEDOUT);
+    REQUIRE(slept);
+    REQUIRE(std::chrono::steady_clock::now() >= deadline);
+
+    // Timed out waiters remove themselves
+    REQUIRE(lot.getParkedCount(16) == 0);
+}
+
+TEST_CASE("Test parking lot wakes waiters", "[wasm][threads]")
+{
+    ParkingLot lot;
+    uint32_t addr = 16;
+
+    // Collides with the address above in the lot's buckets
+    uint32_t otherAddr = addr + 64 * 4;
+
+    int nWaiters = 3;
+    std::atomic<int> nWoken = 0;
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < nWaiters; i++) {
+        waiters.emplace_back([&lot, &nWoken, addr] {
+            int res = lot.park(
+              addr, [] { return true; }, [] {}, std::nullopt);
+            REQUIRE(res == 0);
+            nWoken++;
+        });
+    }
+
+    std::thread otherWaiter([&lot, otherAddr] {
+        int res = lot.park(
+          otherAddr, [] { return true; }, [] {}, std::nullopt);
+        REQUIRE(res == 0);
+    });
+
+    waitForParked(lot, addr, nWaiters);
+    waitForParked(lot, otherAddr, 1);
+
+    // Wake one, then the rest
+    REQUIRE(lot.unpark(addr, 1) == 1);
+    while (nWoken.load() < 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(lot.getParkedCount(addr) == nWaiters - 1);
+
+    REQUIRE(lot.unpark(addr, INT_MAX) == nWaiters - 1);
+    for (auto& t : waiters) {
+        t.join();
+    }
+    REQUIRE(nWoken.load() == nWaiters);
+
+    // Waiters on other addresses are untouched
+    REQUIRE(lot.getParkedCount(otherAddr) == 1);
+    REQUIRE(lot.unpark(addr, INT_MAX) == 0);
+
+    REQUIRE(lot.unpark(otherAddr, 1) == 1);
+    otherWaiter.join();
+}
+}
@@ -0,0 +1,316 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <faabric/util/files.h>
+#include <faabric/util/macros.h>
+#include <faabric/util/timing.h>
+#include <storage/FileSystem.h>
+#include <wasm/poll.h>
+
+#include <WAVM/WASI/WASIABI.h>
+#include <boost/filesystem.hpp>
+#include <csignal>
+#include <pthread.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace wasm;
+
+namespace tests {
+
+class PollTestFixture : public FaasmConfTestFixture
+{
+  public:
+    PollTestFixture()
+    {
+        fs.prepareFilesystem();
+        REQUIRE(::pipe(pipeFds) == 0);
+    }
+
+    ~PollTestFixture()
+    {
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+    }
+
+  protected:
+    storage::FileSystem fs;
+    int pipeFds[2];
+
+    PollSubscription clockSub(uint64_t userdata, uint64_t timeoutNanos)
+    {
+        PollSubscription sub;
+        sub.userdata = userdata;
+        sub.type = __WASI_EVENTTYPE_CLOCK;
+        sub.clockId = __WASI_CLOCK_MONOTONIC;
+        sub.timeout = timeoutNanos;
+        return sub;
+    }
+
+    PollSubscription fdSub(uint64_t userdata, uint8_t type, int fd)
+    {
+        PollSubscription sub;
+        sub.userdata = userdata;
+        sub.type = type;
+        sub.fd = fd;
+        return sub;
+    }
+};
+
+TEST_CASE_METHOD(PollTestFixture, "Test poll on clocks", "[wasm]")
+{
+    // Only the earliest clock should fire, and we shouldn't wait for the
+    // others in turn
+    std::vector<PollSubscription> subs = {
+        clockSub(1, 2000L * 1000 * 1000),
+        clockSub(2, 10L * 1000 * 1000),
+        clockSub(3, 5000L * 1000 * 1000),
+    };
+
+    auto start = faabric::util::startTimer();
+    std::vector<PollEvent> events = pollOneoff(fs, subs, false);
+    double elapsedMs = faabric::util::getTimeDiffMillis(start);
+
+    REQUIRE(events.size() == 1);
+    REQUIRE(events.at(0).userdata == 2);
+    REQUIRE(events.at(0).type == __WASI_EVENTTYPE_CLOCK);
+    REQUIRE(events.at(0).error == 0);
+    REQUIRE(elapsedMs >= 10);
+    REQUIRE(elapsedMs < 1000);
+}
+
+TEST_CASE_METHOD(PollTestFixture, "Test poll on fds", "[wasm]")
+{
+    std::vector<PollSubscription> subs = {
+        fdSub(1, __WASI_EVENTTYPE_FD_READ, pipeFds[0]),
+        clockSub(2, 20L * 1000 * 1000),
+    };
+
+    SECTION("Nothing to read")
+    {
+        std::vector<PollEvent> events = pollOneoff(fs, subs, true);
+        REQUIRE(events.size() == 1);
+        REQUIRE(events.at(0).userdata == 2);
+    }
+
+    SECTION("Data to read")
+    {
+        REQUIRE(::write(pipeFds[1], "hello", 5) == 5);
+
+        std::vector<PollEvent> events = pollOneoff(fs, subs, true);
+        REQUIRE(events.size() == 1);
+        REQUIRE(events.at(0).userdata == 1);
+        REQUIRE(events.at(0).type == __WASI_EVENTTYPE_FD_READ);
+        REQUIRE(events.at(0).nBytes == 5);
+        REQUIRE(events.at(0).flags == 0);
+    }
+
+    SECTION("Hang up")
+    {
+        ::close(pipeFds[1]);
+        pipeFds[1] = -1;
+
+        std::vector<PollEvent> events = pollOneoff(fs, subs, true);
+        REQUIRE(events.size() == 1);
+        REQUIRE(events.at(0).userdata == 1);
+        REQUIRE(events.at(0).flags == __WASI_EVENT_FD_READWRITE_HANGUP);
+    }
+
+    SECTION("Host fds not allowed")
+    {
+        std::vector<PollEvent> events = pollOneoff(fs, subs, false);
+        REQUIRE(events.size() == 1);
+        REQUIRE(events.at(0).userdata == 1);
+        REQUIRE(events.at(0).error == __WASI_EBADF);
+    }
+}
+
+TEST_CASE_METHOD(PollTestFixture, "Test poll on files", "[wasm]")
+{
+    std::string path = "poll_test_file.txt";
+    std::string realPath = storage::prependRuntimeRoot(path);
+    std::vector<uint8_t> contents = { 0, 1, 2, 3, 4, 5 };
+    faabric::util::writeBytesToFile(realPath, contents);
+
+    uint64_t rights = __WASI_RIGHT_FD_READ | __WASI_RIGHT_FD_WRITE;
+    int fd = fs.openFileDescriptor(DEFAULT_ROOT_FD, path, rights, 0, 0, 0, 0);
+    REQUIRE(fd > 0);
+
+    // Regular files are always ready
+    std::vector<PollSubscription> subs = {
+        fdSub(1, __WASI_EVENTTYPE_FD_READ, fd),
+        fdSub(2, __WASI_EVENTTYPE_FD_WRITE, fd),
+        fdSub(3, __WASI_EVENTTYPE_FD_READ, 1234),
+    };
+
+    std::vector<PollEvent> events = pollOneoff(fs, subs, false);
+    REQUIRE(events.size() == 3);
+
+    // Errors come first
+    REQUIRE(events.at(0).userdata == 3);
+    REQUIRE(events.at(0).error == __WASI_EBADF);
+
+    REQUIRE(events.at(1).userdata == 1);
+    REQUIRE(events.at(1).error == 0);
+    REQUIRE(events.at(1).nBytes == contents.size());
+
+    REQUIRE(events.at(2).userdata == 2);
+    REQUIRE(events.at(2).error == 0);
+
+    boost::filesystem::remove(realPath);
+}
+
+TEST_CASE("Test mapping WASI clocks", "[wasm]")
+{
+    REQUIRE(wasiClockToLinux(__WASI_CLOCK_REALTIME) == CLOCK_REALTIME);
+    REQUIRE(wasiClockToLinux(__WASI_CLOCK_MONOTONIC) == CLOCK_MONOTONIC);
+    REQUIRE(wasiClockToLinux(__WASI_CLOCK_PROCESS_CPUTIME_ID) ==
+            CLOCK_PROCESS_CPUTIME_ID);
+    REQUIRE(wasiClockToLinux(__WASI_CLOCK_THREAD_CPUTIME_ID) ==
+            CLOCK_THREAD_CPUTIME_ID);
+    REQUIRE(wasiClockToLinux(99) == -1);
+
+    REQUIRE(canSleepOnClock(CLOCK_REALTIME));
+    REQUIRE(canSleepOnClock(CLOCK_MONOTONIC));
+    REQUIRE(canSleepOnClock(CLOCK_BOOTTIME));
+    REQUIRE(!canSleepOnClock(CLOCK_PROCESS_CPUTIME_ID));
+    REQUIRE(!canSleepOnClock(CLOCK_THREAD_CPUTIME_ID));
+}
+
+TEST_CASE("Test WASI clock resolution", "[wasm]")
+{
+    uint32_t wasiClockId = 0;
+    int linuxClockId = 0;
+
+    SECTION("Realtime")
+    {
+        wasiClockId = __WASI_CLOCK_REALTIME;
+        linuxClockId = CLOCK_REALTIME;
+    }
+
+    SECTION("Monotonic")
+    {
+        wasiClockId = __WASI_CLOCK_MONOTONIC;
+        linuxClockId = CLOCK_MONOTONIC;
+    }
+
+    SECTION("Process CPU time")
+    {
+        wasiClockId = __WASI_CLOCK_PROCESS_CPUTIME_ID;
+        linuxClockId = CLOCK_PROCESS_CPUTIME_ID;
+    }
+
+    SECTION("Thread CPU time")
+    {
+        wasiClockId = __WASI_CLOCK_THREAD_CPUTIME_ID;
+        linuxClockId = CLOCK_THREAD_CPUTIME_ID;
+    }
+
+    timespec expected{};
+    REQUIRE(clock_getres(linuxClockId, &expected) == 0);
+
+    uint64_t actual = 0;
+    REQUIRE(wasiClockResolution(wasiClockId, &actual) == __WASI_ESUCCESS);
+    REQUIRE(actual == faabric::util::timespecToNanos(&expected));
+    REQUIRE(actual > 0);
+}
+
+TEST_CASE("Test WASI clock resolution on unknown clock", "[wasm]")
+{
+    uint64_t actual = 123;
+    REQUIRE(wasiClockResolution(99, &actual) == __WASI_EINVAL);
+    REQUIRE(actual == 123);
+}
+
+TEST_CASE("Test sleeping on a clock", "[wasm]")
+{
+    timespec req{ .tv_sec = 0, .tv_nsec = 20L * 1000 * 1000 };
+    timespec rem{ .tv_sec = 7, .tv_nsec = 7 };
+
+    auto start = faabric::util::startTimer();
+    REQUIRE(sleepOnClock(CLOCK_MONOTONIC, 0, req, &rem) == 0);
+    double elapsedMs = faabric::util::getTimeDiffMillis(start);
+
+    // Well under the second the old implementation rounded up to
+    REQUIRE(elapsedMs >= 20);
+    REQUIRE(elapsedMs < 500);
+
+    // Remaining time is only written on interruption
+    REQUIRE(rem.tv_sec == 7);
+    REQUIRE(rem.tv_nsec == 7);
+}
+
+TEST_CASE("Test invalid sleeps", "[wasm]")
+{
+    timespec req{ .tv_sec = 0, .tv_nsec = 1000 };
+    clockid_t clockId = CLOCK_MONOTONIC;
+    int expected = EINVAL;
+
+    SECTION("Negative seconds") { req.tv_sec = -1; }
+
+    SECTION("Negative nanoseconds") { req.tv_nsec = -1; }
+
+    SECTION("Nanoseconds overflow") { req.tv_nsec = 1000000000; }
+
+    SECTION("CPU-time clock")
+    {
+        clockId = CLOCK_PROCESS_CPUTIME_ID;
+        expected = ENOTSUP;
+    }
+
+    REQUIRE(sleepOnClock(clockId, 0, req, nullptr) == expected);
+}
+
+static void noopSignalHandler(int) {}
+
+TEST_CASE("Test interrupted sleep writes remaining time", "[wasm]")
+{
+    struct sigaction action
+    {};
+    struct sigaction oldAction
+    {};
+    action.sa_handler = noopSignalHandler;
+    sigemptyset(&action.sa_mask);
+    REQUIRE(::sigaction(SIGUSR1, &action, &oldAction) == 0);
+
+    int flags = 0;
+    bool expectRemaining = true;
+
+    SECTION("Relative sleep") {}
+
+    SECTION("Absolute sleep")
+    {
+        flags = TIMER_ABSTIME;
+        expectRemaining = false;
+    }
+
+    timespec req{ .tv_sec = 5, .tv_nsec = 0 };
+    if (flags & TIMER_ABSTIME) {
+        timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        req.tv_sec += now.tv_sec;
+    }
+
+    timespec rem{ .tv_sec = -1, .tv_nsec = 0 };
+    int res = 0;
+    std::thread sleeper([&] {
+        res = sleepOnClock(CLOCK_MONOTONIC, flags, req, &rem);
+    });
+
+    // Interrupt the sleep part way through
+    SLEEP_MS(100);
+    ::pthread_kill(sleeper.native_handle(), SIGUSR1);
+    sleeper.join();
+
+    REQUIRE(res == EINTR);
+    if (expectRemaining) {
+        REQUIRE(rem.tv_sec >= 3);
+        REQUIRE(rem.tv_sec < 5);
+    } else {
+        REQUIRE(rem.tv_sec == -1);
+    }
+
+    REQUIRE(::sigaction(SIGUSR1, &oldAction, nullptr) == 0);
+}
+}
@@ -0,0 +1,160 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <wasm/scheduling.h>
+
+#include <linux/capability.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace wasm;
+
+namespace tests {
+
+static int getThreadNice()
+{
+    return ::getpriority(PRIO_PROCESS, ::gettid());
+}
+
+// Capabilities are per-thread, so this only affects the calling thread
+static bool dropSysNiceCapability()
+{
+    __user_cap_header_struct header{ .version = _LINUX_CAPABILITY_VERSION_3,
+                                     .pid = 0 };
+    __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3]{};
+    if (::syscall(SYS_capget, &header, data) != 0) {
+        return false;
+    }
+
+    data[CAP_TO_INDEX(CAP_SYS_NICE)].effective &= ~CAP_TO_MASK(CAP_SYS_NICE);
+    return ::syscall(SYS_capset, &header, data) == 0;
+}
+
+static bool canLowerNice()
+{
+    ::rlimit limit{};
+    REQUIRE(::getrlimit(RLIMIT_NICE, &limit) == 0);
+    if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= 20) {
+        return true;
+    }
+
+    __user_cap_header_struct header{ .version = _LINUX_CAPABILITY_VERSION_3,
+                                     .pid = 0 };
+    __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3]{};
+    REQUIRE(::syscall(SYS_capget, &header, data) == 0);
+
+    return (data[CAP_TO_INDEX(CAP_SYS_NICE)].effective &
+            CAP_TO_MASK(CAP_SYS_NICE)) != 0;
+}
+
+TEST_CASE_METHOD(FaasmConfTestFixture,
+                 "Test guest priorities are clamped",
+                 "[wasm]")
+{
+    int originalNice = 0;
+    int setResult = 0;
+    int actualNice = 0;
+    int guestNice = 0;
+    int resetNice = 0;
+    int expected = 0;
+    int requested = 0;
+
+    faasmConf.guestNiceMin = 5;
+    faasmConf.guestNiceMax = 10;
+
+    SECTION("Within range")
+    {
+        requested = 7;
+        expected = 7;
+    }
+
+    SECTION("Above range")
+    {
+        requested = 19;
+        expected = 10;
+    }
+
+    SECTION("Below range")
+    {
+        requested = -20;
+        expected = 5;
+    }
+
+    // Raising the nice level is only allowed if it can be lowered again, so
+    // these checks need privileges
+    if (!canLowerNice()) {
+        WARN("Skipping guest priority checks without CAP_SYS_NICE");
+        return;
+    }
+
+    // Change the level on a separate thread to avoid leaving the test thread
+    // niced if something fails
+    std::thread t([&] {
+        originalNice = getThreadNice();
+
+        setResult = setGuestPriority(requested);
+        actualNice = getThreadNice();
+        guestNice = getGuestPriority();
+
+        resetGuestPriority();
+        resetNice = getThreadNice();
+    });
+    t.join();
+
+    REQUIRE(setResult == 0);
+    REQUIRE(actualNice == expected);
+    REQUIRE(guestNice == expected);
+    REQUIRE(resetNice == originalNice);
+}
+
+TEST_CASE_METHOD(FaasmConfTestFixture,
+                 "Test guest priorities without CAP_SYS_NICE",
+                 "[wasm]")
+{
+    faasmConf.guestNiceMin = 0;
+    faasmConf.guestNiceMax = 19;
+
+    // RLIMIT_NICE can also allow lowering the level, so make sure it doesn't
+    ::rlimit oldLimit{};
+    REQUIRE(::getrlimit(RLIMIT_NICE, &oldLimit) == 0);
+    ::rlimit noLimit = oldLimit;
+    noLimit.rlim_cur = 0;
+    REQUIRE(::setrlimit(RLIMIT_NICE, &noLimit) == 0);
+
+    bool dropped = false;
+    int originalNice = 0;
+    int setResult = 0;
+    int actualNice = 0;
+    int guestNice = 0;
+
+    std::thread t([&] {
+        dropped = dropSysNiceCapability();
+        originalNice = getThreadNice();
+
+        // The guest can't raise its nice level, as we couldn't restore it
+        setResult = setGuestPriority(originalNice + 5);
+        actualNice = getThreadNice();
+        guestNice = getGuestPriority();
+
+        resetGuestPriority();
+    });
+    t.join();
+
+    REQUIRE(::setrlimit(RLIMIT_NICE, &oldLimit) == 0);
+
+    REQUIRE(dropped);
+    REQUIRE(setResult == -EPERM);
+    REQUIRE(actualNice == originalNice);
+    REQUIRE(guestNice == originalNice);
+}
+
+TEST_CASE("Test yielding guest", "[wasm]")
+{
+    // Just check that it doesn't trap or block
+    yieldGuest();
+    yieldGuest();
+}
+}
@@ -6,10 +6,14 @@
 
 #include <faabric/util/bytes.h>
 #include <faabric/util/config.h>
+#include <faabric/util/files.h>
 #include <faabric/util/func.h>
 
+#include <storage/FileDescriptor.h>
 #include <wavm/WAVMWasmModule.h>
 
+#include <boost/filesystem.hpp>
+
 using namespace WAVM;
 
 namespace tests {
@@ -101,6 +105,34 @@ TEST_CASE_METHOD(SimpleWasmTestFixture,
     executeX2(module);
 }
 
+TEST_CASE_METHOD(SimpleWasmTestFixture,
+                 "Test cached path lookups don't outlive an invocation",
+                 "[wasm]")
+{
+    auto req = setUpContext("demo", "dummy");
+    faabric::Message& msg = req->mutable_messages()->at(0);
+
+    wasm::WAVMWasmModule module;
+    module.bindToFunction(msg);
+
+    std::string filePath = "dummy_invocation_cached.txt";
+    std::string realPath = storage::prependRuntimeRoot(filePath);
+    boost::filesystem::remove(realPath);
+
+    // Cache a miss, then create the file behind the module's back
+    storage::FileDescriptor& rootFileDesc =
+      module.getFileSystem().getFileDescriptor(DEFAULT_ROOT_FD);
+    REQUIRE(rootFileDesc.stat(filePath).failed);
+    faabric::util::writeBytesToFile(realPath, { 0, 1, 2 });
+    REQUIRE(rootFileDesc.stat(filePath).failed);
+
+    // The next invocation sees the file
+    REQUIRE(module.executeTask(0, 0, req) == 0);
+    REQUIRE(!rootFileDesc.stat(filePath).failed);
+
+    boost::filesystem::remove(realPath);
+}
+
 TEST_CASE_METHOD(SimpleWasmTestFixture,
                  "Test execution without binding fails",
                  "[wasm]")
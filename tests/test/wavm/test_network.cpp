@@ -0,0 +1,310 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+#include "utils.h"
+
+#include <faabric/util/func.h>
+#include <storage/FileSystem.h>
+#include <wasm/WasmExecutionContext.h>
+#include <wavm/WAVMWasmModule.h>
+
+#include <WAVM/WASI/WASIABI.h>
+#include <boost/filesystem.hpp>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace WAVM;
+
+// The syscall header is private to the WAVM module, so we declare the
+// intrinsics under test here
+namespace wasm {
+int32_t s__socketcall(int32_t call, int32_t argsPtr);
+
+int32_t s__sendfile64(int32_t outFd,
+                      int32_t inFd,
+                      int32_t offsetPtr,
+                      int32_t count);
+}
+
+namespace tests {
+
+// Values from musl, see SocketCalls in src/wavm/syscalls.h
+#define SC_SENDMSG 16
+#define SC_RECVMSG 17
+
+// Layout of musl's msghdr and iovec on a 32-bit target
+struct TestWasmMsgHdr
+{
+    uint32_t msg_name;
+    uint32_t msg_namelen;
+    uint32_t msg_iov;
+    int32_t msg_iovlen;
+    uint32_t msg_control;
+    uint32_t msg_controllen;
+    int32_t msg_flags;
+};
+
+struct TestWasmIovec
+{
+    uint32_t iov_base;
+    uint32_t iov_len;
+};
+
+class WAVMNetworkTestFixture : public FunctionExecTestFixture
+{
+  public:
+    WAVMNetworkTestFixture()
+      : call(faabric::util::messageFactory("demo", "echo"))
+    {
+        module.bindToFunction(call);
+        basePtr = module.growMemory(WASM_BYTES_PER_PAGE);
+    }
+
+    ~WAVMNetworkTestFixture()
+    {
+        for (int fd : hostFds) {
+            ::close(fd);
+        }
+    }
+
+  protected:
+    faabric::Message call;
+    wasm::WAVMWasmModule module;
+    uint32_t basePtr = 0;
+    std::vector<int> hostFds;
+
+    template<typename T>
+    T& at(uint32_t offset)
+    {
+        return Runtime::memoryRef<T>(module.defaultMemory, basePtr + offset);
+    }
+
+    uint8_t* bytesAt(uint32_t offset, size_t len)
+    {
+        return Runtime::memoryArrayPtr<U8>(
+          module.defaultMemory, basePtr + offset, len);
+    }
+
+    void socketPair(int type, int fds[2])
+    {
+        REQUIRE(::socketpair(AF_UNIX, type, 0, fds) == 0);
+        hostFds.push_back(fds[0]);
+        hostFds.push_back(fds[1]);
+    }
+
+    // Lays out a msghdr at the start of the region, pointing at two iovecs
+    // whose buffers have the given sizes
+    void writeMsg(uint32_t lenA, uint32_t lenB)
+    {
+        auto& iovecs = at<TestWasmIovec[2]>(IOVECS_OFFSET);
+        iovecs[0] = { .iov_base = basePtr + BUF_A_OFFSET, .iov_len = lenA };
+        iovecs[1] = { .iov_base = basePtr + BUF_B_OFFSET, .iov_len = lenB };
+
+        auto& msg = at<TestWasmMsgHdr>(MSG_OFFSET);
+        msg = {};
+        msg.msg_iov = basePtr + IOVECS_OFFSET;
+        msg.msg_iovlen = 2;
+    }
+
+    int32_t sendRecvMsg(int sockCall, int sockfd, int flags)
+    {
+        auto& args = at<uint32_t[3]>(ARGS_OFFSET);
+        args[0] = sockfd;
+        args[1] = basePtr + MSG_OFFSET;
+        args[2] = flags;
+
+        return wasm::s__socketcall(sockCall, basePtr + ARGS_OFFSET);
+    }
+
+    static const uint32_t MSG_OFFSET = 0;
+    static const uint32_t IOVECS_OFFSET = 64;
+    static const uint32_t ARGS_OFFSET = 128;
+    static const uint32_t OFFSET_OFFSET = 192;
+    static const uint32_t BUF_A_OFFSET = 256;
+    static const uint32_t BUF_B_OFFSET = 512;
+};
+
+TEST_CASE_METHOD(WAVMNetworkTestFixture,
+                 "Test WAVM sendmsg and recvmsg scatter/ gather",
+                 "[wavm]")
+{
+    wasm::WasmExecutionContext ctx(&module);
+
+    int fds[2];
+    socketPair(SOCK_DGRAM, fds);
+
+    // Gather from two guest buffers
+    std::string partA = "hello ";
+    std::string partB = "world";
+    std::copy(partA.begin(), partA.end(), bytesAt(BUF_A_OFFSET, 6));
+    std::copy(partB.begin(), partB.end(), bytesAt(BUF_B_OFFSET, 5));
+    writeMsg(partA.size(), partB.size());
+
+    REQUIRE(sendRecvMsg(SC_SENDMSG, fds[0], 0) == 11);
+
+    // Scatter into two guest buffers, split at a different point
+    std::fill_n(bytesAt(BUF_A_OFFSET, 64), 64, 0);
+    std::fill_n(bytesAt(BUF_B_OFFSET, 64), 64, 0);
+    writeMsg(3, 64);
+
+    REQUIRE(sendRecvMsg(SC_RECVMSG, fds[1], 0) == 11);
+
+    std::string actualA((char*)bytesAt(BUF_A_OFFSET, 3), 3);
+    std::string actualB((char*)bytesAt(BUF_B_OFFSET, 8), 8);
+    REQUIRE(actualA == "hel");
+    REQUIRE(actualB == "lo world");
+    REQUIRE(at<TestWasmMsgHdr>(MSG_OFFSET).msg_flags == 0);
+}
+
+TEST_CASE_METHOD(WAVMNetworkTestFixture,
+                 "Test WAVM recvmsg truncation",
+                 "[wavm]")
+{
+    wasm::WasmExecutionContext ctx(&module);
+
+    int fds[2];
+    socketPair(SOCK_DGRAM, fds);
+
+    std::string data = "a datagram too long for the buffers";
+    REQUIRE(::send(fds[0], data.data(), data.size(), 0) ==
+            (ssize_t)data.size());
+
+    int flags = 0;
+    int32_t expected = 0;
+
+    SECTION("Without MSG_TRUNC")
+    {
+        flags = 0;
+        expected = 8;
+    }
+
+    SECTION("With MSG_TRUNC")
+    {
+        // The real length is returned, even though it didn't fit
+        flags = MSG_TRUNC;
+        expected = data.size();
+    }
+
+    writeMsg(4, 4);
+    REQUIRE(sendRecvMsg(SC_RECVMSG, fds[1], flags) == expected);
+
+    // Whatever fits is copied, and the guest is told it was truncated
+    std::string actualA((char*)bytesAt(BUF_A_OFFSET, 4), 4);
+    std::string actualB((char*)bytesAt(BUF_B_OFFSET, 4), 4);
+    REQUIRE(actualA + actualB == data.substr(0, 8));
+    REQUIRE(at<TestWasmMsgHdr>(MSG_OFFSET).msg_flags & MSG_TRUNC);
+}
+
+TEST_CASE_METHOD(WAVMNetworkTestFixture,
+                 "Test WAVM sendmsg with control messages",
+                 "[wavm]")
+{
+    wasm::WasmExecutionContext ctx(&module);
+
+    int fds[2];
+    socketPair(SOCK_DGRAM, fds);
+
+    writeMsg(4, 4);
+    at<TestWasmMsgHdr>(MSG_OFFSET).msg_control = basePtr + BUF_B_OFFSET;
+    at<TestWasmMsgHdr>(MSG_OFFSET).msg_controllen = 16;
+
+    REQUIRE(sendRecvMsg(SC_SENDMSG, fds[0], 0) == -EOPNOTSUPP);
+}
+
+TEST_CASE_METHOD(WAVMNetworkTestFixture, "Test WAVM sendfile", "[wavm]")
+{
+    wasm::WasmExecutionContext ctx(&module);
+
+    int fds[2];
+    socketPair(SOCK_STREAM, fds);
+
+    // Write a guest file to send from
+    std::string contents = "0123456789";
+    std::string relativePath = "sendfile_test.txt";
+    storage::FileSystem& fs = module.getFileSystem();
+    int guestFd = fs.openFileDescriptor(DEFAULT_ROOT_FD,
+                                        relativePath,
+                                        __WASI_RIGHT_FD_READ |
+                                          __WASI_RIGHT_FD_WRITE |
+                                          __WASI_RIGHT_FD_SEEK |
+                                          __WASI_RIGHT_FD_TELL,
+                                        0,
+                                        0,
+                                        __WASI_O_CREAT | __WASI_O_TRUNC,
+                                        0);
+    REQUIRE(guestFd > 0);
+    int nativeInFd = fs.getFileDescriptor(guestFd).getLinuxFd();
+    REQUIRE(::pwrite(nativeInFd, contents.data(), contents.size(), 0) ==
+            (ssize_t)contents.size());
+    REQUIRE(::lseek(nativeInFd, 2, SEEK_SET) == 2);
+
+    std::string expected;
+    off_t expectedFilePos = 0;
+    int64_t expectedOffset = 0;
+    int32_t offsetPtr = 0;
+
+    SECTION("Without offset")
+    {
+        // Sends from, and moves, the file position
+        expected = "2345";
+        expectedFilePos = 6;
+    }
+
+    SECTION("With offset")
+    {
+        // Sends from the offset, which is updated in place, and leaves the
+        // file position alone
+        at<int64_t>(OFFSET_OFFSET) = 5;
+        offsetPtr = basePtr + OFFSET_OFFSET;
+        expected = "5678";
+        expectedFilePos = 2;
+        expectedOffset = 9;
+    }
+
+    REQUIRE(wasm::s__sendfile64(fds[0], guestFd, offsetPtr, 4) == 4);
+
+    std::string actual(4, '\0');
+    REQUIRE(::recv(fds[1], actual.data(), actual.size(), 0) == 4);
+    REQUIRE(actual == expected);
+    REQUIRE(::lseek(nativeInFd, 0, SEEK_CUR) == expectedFilePos);
+
+    if (offsetPtr != 0) {
+        REQUIRE(at<int64_t>(OFFSET_OFFSET) == expectedOffset);
+    }
+
+    // Guest files can't be the output, and the input must be a guest file
+    REQUIRE(wasm::s__sendfile64(guestFd, guestFd, 0, 4) == -EINVAL);
+    REQUIRE(wasm::s__sendfile64(fds[0], 999, 0, 4) == -EBADF);
+
+    boost::filesystem::remove(conf::getFaasmConfig().runtimeFilesDir + "/" +
+                              relativePath);
+}
+
+TEST_CASE_METHOD(WAVMNetworkTestFixture,
+                 "Test WAVM hostent buffer reused",
+                 "[wavm]")
+{
+    size_t initialMemSize = module.getMemorySizeBytes();
+
+    // The first lookup grows memory
+    uint32_t bufA = module.getHostentBuffer(100);
+    size_t memSize = module.getMemorySizeBytes();
+    REQUIRE(memSize == initialMemSize + WASM_BYTES_PER_PAGE);
+
+    // Later ones that fit reuse the same buffer
+    REQUIRE(module.getHostentBuffer(200) == bufA);
+    REQUIRE(module.getHostentBuffer(WASM_BYTES_PER_PAGE) == bufA);
+    REQUIRE(module.getMemorySizeBytes() == memSize);
+
+    // Only results that don't fit grow memory again
+    uint32_t bufB = module.getHostentBuffer(WASM_BYTES_PER_PAGE + 1);
+    REQUIRE(bufB != bufA);
+    REQUIRE(module.getMemorySizeBytes() == memSize + 2 * WASM_BYTES_PER_PAGE);
+
+    // Resetting the module drops the buffer along with the memory it was in
+    module.reset(call, "");
+    size_t resetMemSize = module.getMemorySizeBytes();
+    module.getHostentBuffer(100);
+    REQUIRE(module.getMemorySizeBytes() == resetMemSize + WASM_BYTES_PER_PAGE);
+}
+}
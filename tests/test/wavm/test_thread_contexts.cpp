@@ -0,0 +1,57 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <faabric/util/func.h>
+#include <wasm/WasmExecutionContext.h>
+#include <wavm/WAVMWasmModule.h>
+
+#include <Runtime/RuntimePrivate.h>
+
+using namespace WAVM;
+
+namespace tests {
+
+TEST_CASE_METHOD(FunctionExecTestFixture,
+                 "Test WAVM thread context reuse",
+                 "[wavm][threads]")
+{
+    faabric::Message call = faabric::util::messageFactory("demo", "echo");
+    wasm::WAVMWasmModule module;
+    module.bindToFunction(call);
+    wasm::WasmExecutionContext execCtx(&module);
+
+    std::vector<uint32_t> stacks = module.getThreadStacks();
+    REQUIRE(stacks.size() > 2);
+
+    Runtime::ContextRuntimeData* runtimeData =
+      Runtime::getContextRuntimeData(module.executionContext);
+    const auto& initialGlobals =
+      module.compartment->initialContextMutableGlobals;
+
+    // Context for the first batch on this pool slot
+    Runtime::Context* ctx =
+      wasm::WAVMWasmModule::createThreadContext(stacks.at(1), runtimeData);
+    REQUIRE(ctx->runtimeData->mutableGlobals[0].u32 == stacks.at(1));
+
+    // The first thread leaves its globals dirty
+    for (auto& global : ctx->runtimeData->mutableGlobals) {
+        global.u64 = 0xdeadbeef;
+    }
+
+    // A thread in the next batch on the same slot gets a clean context, with
+    // the stack pointer at its own stack
+    wasm::WAVMWasmModule::resetThreadContext(ctx, stacks.at(2));
+    REQUIRE(ctx->runtimeData->mutableGlobals[0].u32 == stacks.at(2));
+    for (size_t i = 1; i < std::size(initialGlobals); i++) {
+        REQUIRE(ctx->runtimeData->mutableGlobals[i].u64 ==
+                initialGlobals[i].u64);
+    }
+
+    // Misaligned stacks are rejected when reusing, as when creating
+    REQUIRE_THROWS(
+      wasm::WAVMWasmModule::resetThreadContext(ctx, stacks.at(2) - 8));
+    REQUIRE_THROWS(wasm::WAVMWasmModule::createThreadContext(
+      stacks.at(2) - 8, runtimeData));
+}
+}
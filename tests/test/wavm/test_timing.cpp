@@ -0,0 +1,60 @@
+#include <catch2/catch.hpp>
+
+#include "faasm_fixtures.h"
+
+#include <faabric/util/func.h>
+#include <faabric/util/timing.h>
+#include <wasm/WasmExecutionContext.h>
+#include <wavm/WAVMWasmModule.h>
+
+#include <WAVM/WASI/WASIABI.h>
+
+using namespace WAVM;
+
+// The syscall header is private to the WAVM module, so we declare the
+// intrinsics under test here
+namespace wasm {
+int32_t s__clock_nanosleep(int32_t clockId,
+                           int32_t flags,
+                           int32_t reqPtr,
+                           int32_t remPtr);
+}
+
+namespace tests {
+
+// Layout of musl's timespec on a 32-bit target with 64-bit time_t
+struct TestWasmTimespec
+{
+    int64_t tv_sec;
+    int32_t tv_nsec;
+};
+
+TEST_CASE_METHOD(FunctionExecTestFixture,
+                 "Test WAVM clock_nanosleep clock IDs",
+                 "[wavm]")
+{
+    faabric::Message call = faabric::util::messageFactory("demo", "echo");
+    wasm::WAVMWasmModule module;
+    module.bindToFunction(call);
+    uint32_t reqPtr = module.growMemory(WASM_BYTES_PER_PAGE);
+
+    wasm::WasmExecutionContext ctx(&module);
+
+    Runtime::memoryRef<TestWasmTimespec>(module.defaultMemory, reqPtr) = {
+        .tv_sec = 0, .tv_nsec = 5 * 1000 * 1000
+    };
+
+    // Guest clock IDs are translated before sleeping
+    auto start = faabric::util::startTimer();
+    REQUIRE(wasm::s__clock_nanosleep(__WASI_CLOCK_MONOTONIC, 0, reqPtr, 0) ==
+            0);
+    REQUIRE(faabric::util::getTimeDiffMillis(start) >= 5);
+
+    // Unknown clocks are rejected rather than passed to the host
+    REQUIRE(wasm::s__clock_nanosleep(99, 0, reqPtr, 0) == -EINVAL);
+
+    // CPU time clocks are known, but can't be slept on
+    REQUIRE(wasm::s__clock_nanosleep(
+              __WASI_CLOCK_PROCESS_CPUTIME_ID, 0, reqPtr, 0) == -ENOTSUP);
+}
+}